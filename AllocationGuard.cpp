@@ -0,0 +1,280 @@
+#include "AllocationGuard.h"
+#include "Logger.h"
+#include "MqttClient.h"
+#include "NumberFormat.h"
+#include "RuleEngine.h"
+#include "SensorDS18B20.h"
+#include "SimulatedTemperatureBus.h"
+#include <assert.h>
+#include <new>
+#include <stdlib.h>
+#if !defined(ESP8266) && !defined(ESP32)
+#include <pthread.h>
+#endif
+
+static volatile bool     guardArmed          = false;
+static volatile uint32_t guardAllocations    = 0;
+static const void*       guardLastCaller     = nullptr;
+static uint32_t          reportedAllocations = 0; // allocations already logged by check()
+#if defined(ESP32)
+static TaskHandle_t guardTask = nullptr; // task which armed the guard, other tasks are not counted
+#elif !defined(ESP8266)
+static pthread_t guardThread; // thread which armed the guard, e.g. not the broker stand-in of the host tests
+#endif
+
+#ifdef ALLOCATION_GUARD
+/**
+ * Return TRUE if the current task is the one which armed the guard
+ */
+static inline bool isGuardedTask(void)
+{
+#if defined(ESP32)
+    return xTaskGetCurrentTaskHandle() == guardTask;
+#elif defined(ESP8266)
+    return true;
+#else
+    return pthread_equal(pthread_self(), guardThread);
+#endif
+}
+
+/**
+ * Count allocation and remember the caller, if the guard is armed
+ */
+static inline void countAllocation(const void* caller)
+{
+    if (guardArmed && isGuardedTask()) {
+        ++guardAllocations;
+        guardLastCaller = caller;
+    }
+}
+
+#ifdef ALLOCATION_GUARD_WRAP_MALLOC
+extern "C" void* __real_malloc(size_t size);
+
+/**
+ * Replacement of malloc() by the linker flag -Wl,--wrap=malloc
+ */
+extern "C" void* __wrap_malloc(size_t size)
+{
+    countAllocation(__builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+#define GUARD_MALLOC __real_malloc // operator new counts its callers itself
+#else
+#define GUARD_MALLOC malloc
+#endif
+
+static inline void* guardedAllocation(size_t size, const void* caller)
+{
+    countAllocation(caller);
+    return GUARD_MALLOC(size);
+}
+
+void* operator new(size_t size)
+{
+    return guardedAllocation(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size)
+{
+    return guardedAllocation(size, __builtin_return_address(0));
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+#endif // ALLOCATION_GUARD
+
+/**
+ * Start counting allocations of the calling task, e.g. at the end of the first loop() run when all lazy
+ * initializations are done - on ESP32 the network task and the tasks of the core are not counted
+ */
+void AllocationGuard::arm(void)
+{
+    if (!guardArmed) {
+        reportedAllocations = guardAllocations;
+#if defined(ESP32)
+        guardTask = xTaskGetCurrentTaskHandle();
+#elif !defined(ESP8266)
+        guardThread = pthread_self();
+#endif
+        guardArmed = true;
+    }
+}
+
+void AllocationGuard::disarm(void)
+{
+    guardArmed = false;
+}
+
+bool AllocationGuard::armed(void)
+{
+    return guardArmed;
+}
+
+/**
+ * Return count of allocations while armed since start
+ */
+uint32_t AllocationGuard::allocations(void)
+{
+    return guardAllocations;
+}
+
+/**
+ * Return code address of the last counted allocation
+ */
+const void* AllocationGuard::lastCaller(void)
+{
+    return guardLastCaller;
+}
+
+/**
+ * Log an error for allocations since the last check
+ *
+ * @return FALSE if there were new allocations
+ */
+bool AllocationGuard::check(void)
+{
+    uint32_t count = guardAllocations;
+    if (count == reportedAllocations) {
+        return true;
+    }
+
+    // logging must not allocate, so the guard keeps armed
+    LOG_ERROR(PROFILE, "%u heap allocations in steady state, last caller %p", (unsigned int)(count - reportedAllocations), guardLastCaller);
+    reportedAllocations = count;
+    return false;
+}
+
+#if defined(ALLOCATION_GUARD) && !defined(ESP8266) && !defined(ESP32)
+/**
+ * Notify callback of the test: count the calls in the int given as context
+ */
+static bool countNotify(const char*, const char*, void* context)
+{
+    ++*static_cast<int*>(context);
+    return true;
+}
+#endif
+
+/**
+ * Run the hot paths of loop() and expect no counted allocation - the host build publishes to a connected broker
+ * and dispatches to a wildcard subscription, the device build runs the publish error path only
+ */
+bool TestAllocationGuard::runTests()
+{
+#ifdef ALLOCATION_GUARD
+    bool     wasArmed = AllocationGuard::armed();
+    uint32_t before   = AllocationGuard::allocations();
+
+    // the guard counts allocations only while armed
+    AllocationGuard::disarm();
+    delete new int(1);
+    assert(AllocationGuard::allocations() == before);
+    AllocationGuard::arm();
+    delete new int(1);
+    assert(AllocationGuard::allocations() == before + 1);
+    assert(AllocationGuard::lastCaller() != nullptr);
+    AllocationGuard::disarm();
+
+    // setup outside of the guard
+    SimulatedTemperatureBus bus(2);
+    SensorDS18B20           sensor(&bus);
+    sensor.sensorsAvailable();
+
+    RuleEngine rules;
+    rules.registerSensor(0, &sensor);
+    bool compiled = rules.compile("R0=T0<21.5~0.5");
+    assert(compiled);
+
+    Logger  testLogger(nullptr);
+    uint8_t phase = testProfiler.addPhase("alloc test");
+
+#if !defined(ESP8266) && !defined(ESP32)
+    // topics and connection are set up outside of the guard, the host client connects to the broker stand-in
+    int  notified = 0;
+    bool created  = client.createPublishTopic("allocpub", "alloc/value", MqttClient::SENSOR) &&
+                   client.createSubscribeTopic("alloc+", "alloc/+", MqttClient::COMMAND) &&
+                   client.addNotifyCallback("alloc+", &countNotify, &notified);
+    assert(created);
+    bool connected = client.connect();
+    assert(connected);
+    MqttClient::Statistics statsBefore = client.statistics();
+#endif
+
+    before = AllocationGuard::allocations();
+    AllocationGuard::arm();
+
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+    for (int i = 0; i < 10; ++i) {
+        int length = formatDecimal(buffer, sizeof(buffer), 21.5 + i, 1);
+        assert(length > 0);
+
+        float temperature = sensor.temperature();
+        assert(!std::isnan(temperature));
+        temperature = sensor.temperature("sensor1");
+        assert(!std::isnan(temperature));
+
+        uint32_t mask   = 0;
+        uint32_t states = 0;
+        rules.run(0, mask, states, RULE_TIME_UNKNOWN);
+
+        testLogger.log(LOG_LEVEL_INFO, "test", "value %s", buffer);
+        testLogger.drain();
+        testProfiler.record(phase, i);
+    }
+
+    // topic lookup and error path, a connect would allocate inside WiFiClient
+    bool published = client.publish("alloc***", buffer);
+    assert(!published);
+    published = client.publish("alloc***", 21.5f, 1);
+    assert(!published);
+
+#if !defined(ESP8266) && !defined(ESP32)
+    // publishing over the open connection and dispatching through the topic trie
+    for (int i = 0; i < 10; ++i) {
+        published = client.publish("allocpub", buffer);
+        assert(published);
+        published = client.publish("allocpub", 21.5f + i, 1);
+        assert(published);
+        bool dispatched = client.dispatchMessage("/command/alloc/set", buffer);
+        assert(dispatched);
+    }
+#endif
+
+    AllocationGuard::disarm();
+    uint32_t counted = AllocationGuard::allocations() - before;
+    if (counted > 0) {
+        LOG_ERROR(PROFILE, "%u heap allocations in hot paths, last caller %p", (unsigned int)counted, AllocationGuard::lastCaller());
+    }
+    assert(counted == 0);
+
+#if !defined(ESP8266) && !defined(ESP32)
+    assert(notified == 10 && client.statistics().published == statsBefore.published + 20);
+    bool removed = client.removeSubscribeTopic("alloc+") && client.removePublishTopic("allocpub");
+    assert(removed);
+#endif
+
+#ifdef ALLOCATION_GUARD_WRAP_MALLOC
+    // plain C allocations are counted by the malloc() wrapper
+    before = AllocationGuard::allocations();
+    AllocationGuard::arm();
+    void* volatile block = malloc(16);
+    AllocationGuard::disarm();
+    free(block);
+    assert(AllocationGuard::allocations() == before + 1);
+#endif
+
+    if (wasArmed) {
+        AllocationGuard::arm();
+    }
+#endif // ALLOCATION_GUARD
+    return true;
+}
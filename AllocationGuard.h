@@ -0,0 +1,61 @@
+#ifndef ALLOCATIONGUARD_H
+#define ALLOCATIONGUARD_H
+
+/**
+ * Detection of heap allocations in the steady state after setup()
+ */
+
+#include "Profiler.h"
+#include <Arduino.h>
+#include <stdint.h>
+
+// debug builds: uncomment or pass -DALLOCATION_GUARD to count operator new calls while the guard is armed
+// #define ALLOCATION_GUARD
+// pass -DALLOCATION_GUARD_WRAP_MALLOC together with the linker flag -Wl,--wrap=malloc to count malloc() calls too
+
+class MqttClient;
+
+/**
+ * Allocation guard for the steady state of loop()
+ *
+ * With ALLOCATION_GUARD defined the global operator new and new[] are replaced by versions counting each call
+ * while the guard is armed, together with the caller address of the last allocation, which can be resolved by
+ * addr2line against the firmware ELF file. Allocations of C code calling malloc() directly, e.g. lwIP, are
+ * counted only with ALLOCATION_GUARD_WRAP_MALLOC, which needs the linker to redirect malloc() to __wrap_malloc(),
+ * like the host build does. Only allocations of the task which armed the guard are counted, so the network task
+ * on ESP32 and the broker stand-in of the host tests do not count. Without ALLOCATION_GUARD all functions are
+ * no-ops and allocations() stays 0.
+ */
+class AllocationGuard
+{
+public:
+    static void arm(void);
+    static void disarm(void);
+    static bool armed(void);
+
+    static uint32_t    allocations(void);
+    static const void* lastCaller(void);
+
+    static bool check(void);
+};
+
+/**
+ * Unit test for AllocationGuard: runs the loop() hot paths with armed guard and expects no allocation
+ *
+ * Only meaningful with ALLOCATION_GUARD defined.
+ */
+class TestAllocationGuard
+{
+public:
+    TestAllocationGuard(MqttClient& client) :
+        client(client)
+    {}
+
+    virtual bool runTests();
+
+private:
+    MqttClient& client;
+    Profiler    testProfiler;
+};
+
+#endif // ALLOCATIONGUARD_H
@@ -0,0 +1,211 @@
+/**
+ * Microbenchmarks for the hot paths of the sketch, run on the device
+ */
+
+#include "Benchmarks.h"
+#include "DisplayFont.h"
+#include "Logger.h"
+#include "NumberFormat.h"
+#include <string.h>
+
+#define BENCHMARK_TOPIC "benchmark"
+
+#define BENCHMARK_SUBSCRIBE_TOPICS 8 // topics covered by a wildcard topic, subscribed for the dispatch benchmark
+
+/**
+ * Notify callback of the dispatch benchmark
+ */
+static bool acceptMessage(const char*, const char*, void*)
+{
+    return true;
+}
+
+/**
+ * Set the known result of given benchmark in nanoseconds per call, e.g. of a reference node
+ *
+ * @return FALSE if the name is too long or the table is full
+ */
+bool BenchmarkSuite::setBaseline(const char* name, uint32_t nanos)
+{
+    for (uint8_t i = 0; i < baselines; ++i) {
+        if (strcmp(baselineTable[i].name, name) == 0) {
+            baselineTable[i].nanos = nanos;
+            return true;
+        }
+    }
+    if (baselines >= BENCHMARK_MAX_RESULTS || strlen(name) >= BENCHMARK_NAME_LENGTH) {
+        return false;
+    }
+    strcpy(baselineTable[baselines].name, name);
+    baselineTable[baselines].nanos  = nanos;
+    baselineTable[baselines].spread = 0;
+    ++baselines;
+    return true;
+}
+
+/**
+ * Run given function in batches until at least the given iterations and BENCHMARK_MIN_TIME are done
+ *
+ * The iteration passed to the function counts up to the given iterations and starts over.
+ *
+ * @return average time per call in nanoseconds, the count of calls in given calls
+ */
+uint32_t BenchmarkSuite::run(int iterations, std::function<void(int iteration)>& function, uint32_t& calls)
+{
+    unsigned long start   = micros();
+    unsigned long elapsed = 0;
+    uint32_t      batch   = iterations;
+    calls                 = 0;
+    do {
+        for (uint32_t i = 0; i < batch; ++i) {
+            function((int)((calls + i) % iterations));
+        }
+        calls += batch;
+        batch   = calls; // double the calls until the time is reached
+        elapsed = micros() - start;
+    } while (elapsed < BENCHMARK_MIN_TIME);
+    return (uint32_t)(elapsed * 1000ULL / calls);
+}
+
+/**
+ * Run given function BENCHMARK_REPETITIONS times, log the result and compare it to the baseline
+ *
+ * @return the average time per call of the fastest run in nanoseconds
+ */
+uint32_t BenchmarkSuite::measure(const char* name, int iterations, std::function<void(int iteration)> function)
+{
+    if (iterations < 1) {
+        return 0;
+    }
+
+    // per call times in ascending order
+    uint32_t runs[BENCHMARK_REPETITIONS];
+    uint32_t calls = 0;
+    for (int r = 0; r < BENCHMARK_REPETITIONS; ++r) {
+        uint32_t runCalls = 0;
+        uint32_t perCall  = run(iterations, function, runCalls);
+        int      i        = r;
+        for (; i > 0 && runs[i - 1] > perCall; --i) {
+            runs[i] = runs[i - 1];
+        }
+        runs[i] = perCall;
+        if (i == 0) {
+            calls = runCalls;
+        }
+    }
+    uint32_t fastest = runs[0];
+    uint32_t median  = runs[BENCHMARK_REPETITIONS / 2];
+    uint32_t spread  = fastest > 0 ? (uint32_t)((median - fastest) * 100ULL / fastest) : 0;
+    if (spread > 255) {
+        spread = 255;
+    }
+
+    LOG_INFO(BENCH, "%s: %u ns/op (%u ops, %u%% spread)", name, (unsigned int)fastest, (unsigned int)calls,
+             (unsigned int)spread);
+
+    if (results < BENCHMARK_MAX_RESULTS && strlen(name) < BENCHMARK_NAME_LENGTH) {
+        strcpy(resultTable[results].name, name);
+        resultTable[results].nanos  = fastest;
+        resultTable[results].spread = (uint8_t)spread;
+        ++results;
+    }
+
+    for (uint8_t i = 0; i < baselines; ++i) {
+        if (strcmp(baselineTable[i].name, name) != 0 || baselineTable[i].nanos == 0) {
+            continue;
+        }
+        int deviation = (int)(((int64_t)fastest - baselineTable[i].nanos) * 100 / baselineTable[i].nanos);
+        if (deviation <= BENCHMARK_TOLERANCE) {
+            LOG_INFO(BENCH, "%s: %+d%% against baseline", name, deviation);
+        } else if (spread < BENCHMARK_TOLERANCE) {
+            LOG_WARN(BENCH, "%s: regression by %d%% against baseline of %u ns/op", name, deviation,
+                     (unsigned int)baselineTable[i].nanos);
+            ++regressions;
+        } else {
+            LOG_WARN(BENCH, "%s: %+d%% against baseline of %u ns/op, not counted with %u%% spread", name, deviation,
+                     (unsigned int)baselineTable[i].nanos, (unsigned int)spread);
+        }
+    }
+
+    logger.flush(); // keep serial output out of the next measurement
+    return fastest;
+}
+
+/**
+ * Run all benchmarks with at least given count of iterations (network and 1-wire benchmarks use less)
+ *
+ * @return count of regressions against baselines, only measurements with a spread below BENCHMARK_TOLERANCE count
+ */
+int BenchmarkSuite::runAll(int iterations)
+{
+    regressions = 0;
+    results     = 0;
+
+    measure("stringReplaceAll", iterations, [](int) {
+        stringReplaceAll("//sensor///arbeitszimmer/temperature_heater", "//", "/");
+    });
+
+    measure("createPublishTopic+removePublishTopic", iterations, [this](int) {
+        mqttClient.createPublishTopic(BENCHMARK_TOPIC, "/benchmark/temperature", MqttClient::STATUS);
+        mqttClient.removePublishTopic(BENCHMARK_TOPIC);
+    });
+
+    measure("loop formatting", iterations, [this](int i) {
+        char temperatureStr[NUMBER_FORMAT_BUFFER_SIZE];
+        char humidityStr[NUMBER_FORMAT_BUFFER_SIZE];
+        formatDecimal(temperatureStr, sizeof(temperatureStr), 18.0f + i * 0.1f, 1);
+        formatDecimal(humidityStr, sizeof(humidityStr), 40.0f + i * 0.1f, 1);
+
+        display.clearDisplay();
+        int16_t x = DisplayFont::drawText(display, 8, 0, temperatureStr, 4);
+        DisplayFont::drawChar(display, x, 0, DISPLAY_FONT_DEGREE, 4);
+        x = DisplayFont::drawText(display, 32, 48, humidityStr, 2);
+        DisplayFont::drawChar(display, x, 48, '%', 2);
+    });
+
+    measure("display flush", iterations / 10, [this](int) {
+        display.display();
+    });
+    display.clearDisplay();
+    display.display();
+
+    measure("SensorDS18B20::sensorsAvailable", 5, [this](int) {
+        sensorDS18B20.sensorsAvailable();
+    });
+
+    if (mqttClient.connected()) {
+        mqttClient.createPublishTopic(BENCHMARK_TOPIC, "/benchmark/value", MqttClient::STATUS);
+        measure("MqttClient::publish", 20, [this](int i) {
+            mqttClient.publish(BENCHMARK_TOPIC, i * 0.1f, 1);
+        });
+        mqttClient.removePublishTopic(BENCHMARK_TOPIC);
+    } else {
+        LOG_WARN(BENCH, "MQTT client not connected - skipping network benchmarks");
+    }
+
+    // dispatch of an incoming message by the topic trie to a topic and the wildcard topic covering it
+    char name[MQTT_TOPIC_NAME_LENGTH];
+    char path[MQTT_PATH_LENGTH];
+    mqttClient.createSubscribeTopic(BENCHMARK_TOPIC, "+/set", MqttClient::SWITCH);
+    mqttClient.addNotifyCallback(BENCHMARK_TOPIC, &acceptMessage);
+    for (int i = 0; i < BENCHMARK_SUBSCRIBE_TOPICS; ++i) {
+        snprintf(name, sizeof(name), BENCHMARK_TOPIC "%d", i);
+        snprintf(path, sizeof(path), BENCHMARK_TOPIC "%d/set", i);
+        mqttClient.createSubscribeTopic(name, path, MqttClient::SWITCH);
+        mqttClient.addNotifyCallback(name, &acceptMessage);
+    }
+    measure("MqttClient::dispatchMessage", iterations, [this](int i) {
+        static const char* topics[] = {"/switch/" BENCHMARK_TOPIC "3/set", "/switch/" BENCHMARK_TOPIC "7/set",
+                                       "/switch/" BENCHMARK_TOPIC "/state"};
+        mqttClient.dispatchMessage(topics[i % 3], "true");
+    });
+    for (int i = 0; i < BENCHMARK_SUBSCRIBE_TOPICS; ++i) {
+        snprintf(name, sizeof(name), BENCHMARK_TOPIC "%d", i);
+        mqttClient.removeSubscribeTopic(name);
+    }
+    mqttClient.removeSubscribeTopic(BENCHMARK_TOPIC);
+
+    LOG_INFO(BENCH, "benchmarks done with %d regressions", regressions);
+    logger.flush();
+    return regressions;
+}
@@ -0,0 +1,72 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+/**
+ * Microbenchmarks for the hot paths of the sketch, run on the device
+ */
+
+#include "MqttClient.h"
+#include "SensorDS18B20.h"
+#include <Adafruit_SSD1306.h>
+#include <Arduino.h>
+#include <functional>
+
+#define BENCHMARK_TOLERANCE 20    // percent slower than baseline to report a regression
+#define BENCHMARK_REPETITIONS 5   // timed runs of each benchmark, the fastest one is the result
+#define BENCHMARK_MIN_TIME 100000 // microseconds each run takes at least, so the micros() step does not matter
+#define BENCHMARK_MAX_RESULTS 16  // benchmarks of runAll() and baselines kept
+#define BENCHMARK_NAME_LENGTH 48  // including terminating 0
+
+/**
+ * Benchmark suite measuring average time per call of the hot paths
+ *
+ * Each benchmark runs BENCHMARK_REPETITIONS times for at least BENCHMARK_MIN_TIME and the given iterations. The
+ * fastest run is the result, logged as "[bench] <name>: <ns> ns/op (<iterations> ops, <spread>% spread)" with the
+ * spread of the median run against it. Baselines are results of a reference machine or node, set by setBaseline()
+ * before runAll(), and are compared to the result. A slowdown beyond BENCHMARK_TOLERANCE is logged as warning; it
+ * counts as regression only if the spread is below the tolerance, i.e. the measurement is stable enough to tell a
+ * regression from noise. The publish benchmark is skipped while the MQTT client is not connected, message dispatch
+ * runs without broker.
+ */
+class BenchmarkSuite
+{
+public:
+    /**
+     * Result or baseline of one benchmark
+     */
+    struct Result
+    {
+        char     name[BENCHMARK_NAME_LENGTH];
+        uint32_t nanos;  // per call
+        uint8_t  spread; // percent of the median run above the fastest one
+    };
+
+    BenchmarkSuite(MqttClient& mqttClient, SensorDS18B20& sensorDS18B20, Adafruit_SSD1306& display) :
+        mqttClient(mqttClient),
+        sensorDS18B20(sensorDS18B20),
+        display(display)
+    {}
+
+    bool setBaseline(const char* name, uint32_t nanos);
+
+    int runAll(int iterations = 100);
+
+    uint32_t measure(const char* name, int iterations, std::function<void(int iteration)> function);
+
+    uint8_t       resultCount() const { return results; }
+    const Result& result(uint8_t index) const { return resultTable[index]; }
+
+private:
+    MqttClient&       mqttClient;
+    SensorDS18B20&    sensorDS18B20;
+    Adafruit_SSD1306& display;
+    int               regressions = 0;
+    Result            baselineTable[BENCHMARK_MAX_RESULTS];
+    uint8_t           baselines = 0;
+    Result            resultTable[BENCHMARK_MAX_RESULTS];
+    uint8_t           results = 0;
+
+    uint32_t run(int iterations, std::function<void(int iteration)>& function, uint32_t& calls);
+};
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,249 @@
+/**
+ * Piecewise-linear calibration of sensor values by integer interpolation
+ */
+
+#include "Calibration.h"
+#include "Logger.h"
+#include <Arduino.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Constructor without calibration, values are returned unchanged
+ */
+Calibration::Calibration() :
+    count(0)
+{
+}
+
+/**
+ * Prepare the segments of given curve
+ *
+ * @return FALSE if the table has too many points, its raw values are not ascending or a segment is too steep for the
+ *         fixed-point slope, e.g. "0:-300,0.01:300" - the previous curve is kept
+ */
+bool Calibration::set(const CalibrationTable& table)
+{
+    if (table.count > CALIBRATION_MAX_POINTS) {
+        return false;
+    }
+    int32_t slopes[CALIBRATION_MAX_POINTS];
+    for (uint8_t i = 1; i < table.count; ++i) {
+        const CalibrationPoint& from = table.points[i - 1];
+        const CalibrationPoint& to   = table.points[i];
+        if (to.raw <= from.raw) {
+            return false;
+        }
+        int64_t value = (int64_t)(to.actual - from.actual) * (1LL << CALIBRATION_SLOPE_BITS) / (to.raw - from.raw);
+        if (value > INT32_MAX || value < INT32_MIN) {
+            return false;
+        }
+        slopes[i - 1] = (int32_t)value;
+    }
+
+    count = table.count;
+    for (uint8_t i = 0; i < count; ++i) {
+        raw[i]    = table.points[i].raw;
+        actual[i] = table.points[i].actual;
+        slope[i]  = slopes[i];
+    }
+    return true;
+}
+
+/**
+ * Remove the curve, values are returned unchanged
+ */
+void Calibration::clear(void)
+{
+    count = 0;
+}
+
+/**
+ * Return calibrated value of given fixed-point raw value
+ */
+int32_t Calibration::apply(int32_t value) const
+{
+    if (count == 0) {
+        return value;
+    }
+    if (count == 1) {
+        return value + actual[0] - raw[0];
+    }
+    uint8_t i = 0;
+    while (i + 2 < count && value >= raw[i + 1]) {
+        ++i;
+    }
+    int64_t delta  = (int64_t)(value - raw[i]) * slope[i] + (1L << (CALIBRATION_SLOPE_BITS - 1));
+    int64_t result = actual[i] + (delta >> CALIBRATION_SLOPE_BITS);
+    // steep segments extended far beyond the points saturate
+    return result > INT32_MAX ? INT32_MAX : (result < INT32_MIN ? INT32_MIN : (int32_t)result);
+}
+
+/**
+ * Return calibrated value of given raw value rounded to 1 / CALIBRATION_SCALE, NAN stays NAN
+ */
+float Calibration::apply(float value) const
+{
+    if (count == 0 || isnan(value)) {
+        return value;
+    }
+    int32_t fixed = (int32_t)(value * CALIBRATION_SCALE + (value < 0 ? -0.5f : 0.5f));
+    return apply(fixed) / (float)CALIBRATION_SCALE;
+}
+
+/**
+ * Read curve from text of given length, e.g. from DeviceConfig
+ *
+ * Format: "raw:actual,raw:actual,..." with ascending raw values, empty text for no calibration.
+ *
+ * @return FALSE on syntax errors, too many points, values out of range, not ascending raw values or too steep segments
+ */
+bool Calibration::parse(const char* text, size_t length, CalibrationTable& table)
+{
+    CalibrationTable parsed;
+    parsed.count = 0;
+
+    const char* pos = text;
+    const char* end = text + length;
+    while (pos < end) {
+        char* next;
+        float rawValue = strtod(pos, &next);
+        if (next == pos || next >= end || *next != ':') {
+            return false;
+        }
+        pos               = next + 1;
+        float actualValue = strtod(pos, &next);
+        bool  lastPoint   = (next == end);
+        if (next == pos || next > end || (!lastPoint && (*next != ',' || next + 1 == end))) {
+            return false;
+        }
+        if (!isfinite(rawValue) || !isfinite(actualValue) || fabs(rawValue) > 327.0 || fabs(actualValue) > 327.0 ||
+            parsed.count == CALIBRATION_MAX_POINTS) {
+            return false;
+        }
+        CalibrationPoint point(rawValue, actualValue);
+        if (parsed.count > 0 && point.raw <= parsed.points[parsed.count - 1].raw) {
+            return false;
+        }
+        parsed.points[parsed.count++] = point;
+        pos                           = lastPoint ? end : next + 1;
+    }
+
+    // segments too steep for the fixed-point slope are rejected here already, not only when the curve is applied
+    Calibration check;
+    if (!check.set(parsed)) {
+        return false;
+    }
+    table = parsed;
+    return true;
+}
+
+/**
+ * Unit tests for offsets, interpolation, extrapolation and parsing
+ */
+bool TestCalibration::runTests()
+{
+    Calibration calibration;
+    assert(calibration.apply((int32_t)2150) == 2150);
+    assert(calibration.apply(21.53f) == 21.53f);
+
+    // single point: offset
+    constexpr CalibrationTable offset = {1, {{20.0, 17.3}}};
+    static_assert(offset.points[0].raw == 2000 && offset.points[0].actual == 1730, "compile time table");
+    assert(calibration.set(offset));
+    assert(calibration.apply((int32_t)2500) == 2230);
+    assert(fabs(calibration.apply(-5.0f) + 7.7f) < 0.001);
+    assert(isnan(calibration.apply((float)NAN)));
+
+    constexpr CalibrationTable curve = {3, {{-10.0, -11.2}, {20.0, 17.5}, {40.0, 36.1}}};
+    assert(calibration.set(curve));
+    assert(calibration.size() == 3);
+    assert(calibration.apply((int32_t)-1000) == -1120);
+    assert(calibration.apply((int32_t)2000) == 1750);
+    assert(calibration.apply((int32_t)4000) == 3610);
+    assert(calibration.apply((int32_t)3000) == 2680);
+    assert(calibration.apply((int32_t)-2000) == -2077); // below first point: slope of first segment
+    assert(calibration.apply((int32_t)5000) == 4540);   // above last point: slope of last segment
+    assert(fabs(calibration.apply(30.0f) - 26.8f) < 0.001);
+
+    // invalid tables keep the curve
+    CalibrationTable descending = {2, {{20.0, 20.0}, {10.0, 10.0}}};
+    CalibrationTable tooLarge   = {CALIBRATION_MAX_POINTS + 1, {}};
+    assert(!calibration.set(descending) && !calibration.set(tooLarge));
+    assert(calibration.size() == 3);
+    calibration.clear();
+    assert(calibration.apply((int32_t)1234) == 1234);
+
+    CalibrationTable table;
+    const char*      text = "-10:-11.2,20:17.5,40:36.1";
+    assert(Calibration::parse(text, strlen(text), table) && table.count == 3);
+    assert(table.points[0].raw == -1000 && table.points[2].actual == 3610);
+    assert(Calibration::parse("", 0, table) && table.count == 0);
+    assert(Calibration::parse("1:2;room=/x", 3, table) && table.count == 1);
+
+    // a slope of 600 degrees per 0.01 degree does not fit into 32 bits with CALIBRATION_SLOPE_BITS fraction bits
+    CalibrationTable steep = {2, {{0.0, -300.0}, {0.01, 300.0}}};
+    bool             valid = calibration.set(curve) && !calibration.set(steep);
+    assert(valid && calibration.size() == 3 && calibration.apply((int32_t)2000) == 1750);
+    steep.points[0].actual = 0;
+    steep.points[1].actual = 327;
+    valid                  = calibration.set(steep);
+    assert(valid);
+    assert(calibration.apply((int32_t)1) == 327 && calibration.apply((int32_t)-1) == -327);
+    assert(calibration.apply((int32_t)32700) == 10692900);
+    steep.points[1].actual = -32700;
+    valid                  = calibration.set(steep);
+    assert(valid && calibration.apply((int32_t)-INT32_MAX) == INT32_MAX);
+    assert(calibration.apply((int32_t)INT32_MAX) == INT32_MIN);
+    calibration.clear();
+
+    const char* invalid[] = {"20:17.5,10:9", "1:2,", "1", "1:x", "400:1", "1:2:3", "1:1,2:2,3:3,4:4,5:5,6:6,7:7",
+                             "0:-300,0.01:300"};
+    for (const char* text : invalid) {
+        assert(!Calibration::parse(text, strlen(text), table));
+    }
+    return true;
+}
+
+/**
+ * Log time per sample of an offset add, as done before calibration curves, and of curves of 1 to max points
+ */
+void TestCalibration::runBenchmark(uint32_t samples)
+{
+    volatile float sum   = 0;
+    float          total = 0;
+
+    unsigned long start = micros();
+    for (uint32_t i = 0; i < samples; ++i) {
+        total += (float)(i % 4000) * 0.01f + -2.7f;
+    }
+    unsigned long offsetTime = micros() - start;
+    sum                      = total;
+
+    LOG_INFO(BENCH, "calibration offset: %lu ns/sample (%u samples)",
+             (unsigned long)((uint64_t)offsetTime * 1000 / samples), (unsigned int)samples);
+
+    Calibration      calibration;
+    CalibrationTable table = {0, {}};
+    for (uint8_t points = 1; points <= CALIBRATION_MAX_POINTS; ++points) {
+        table.count = points;
+        for (uint8_t i = 0; i < points; ++i) {
+            table.points[i] = CalibrationPoint(i * 8.0, i * 7.5 - 2.0);
+        }
+        calibration.set(table);
+
+        total = 0;
+        start = micros();
+        for (uint32_t i = 0; i < samples; ++i) {
+            total += calibration.apply((float)(i % 4000) * 0.01f);
+        }
+        unsigned long curveTime = micros() - start;
+        sum                     = total;
+
+        LOG_INFO(BENCH, "calibration %u points: %lu ns/sample (%u samples)", (unsigned int)points,
+                 (unsigned long)((uint64_t)curveTime * 1000 / samples), (unsigned int)samples);
+    }
+    (void)sum;
+}
@@ -0,0 +1,91 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+/**
+ * Piecewise-linear calibration of sensor values by integer interpolation
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CALIBRATION_MAX_POINTS 6  // max points of a calibration curve
+#define CALIBRATION_SCALE 100     // fixed-point values per unit, i.e. 0.01 Celsius degrees
+#define CALIBRATION_SLOPE_BITS 16 // fraction bits of the segment slopes
+
+/**
+ * Return given value as fixed-point number of CALIBRATION_SCALE, rounded - usable at compile time
+ */
+constexpr int16_t calibrationFixed(float value)
+{
+    return (int16_t)(value * CALIBRATION_SCALE + (value < 0 ? -0.5f : 0.5f));
+}
+
+/**
+ * Raw sensor value and the actual value measured by a reference, as fixed-point numbers
+ */
+struct CalibrationPoint
+{
+    CalibrationPoint() = default;
+
+    constexpr CalibrationPoint(float raw, float actual) :
+        raw(calibrationFixed(raw)),
+        actual(calibrationFixed(actual))
+    {}
+
+    int16_t raw;
+    int16_t actual;
+};
+
+/**
+ * Calibration curve as stored in ConfigRecord or defined at compile time, e.g.
+ *
+ *     constexpr CalibrationTable curve = {3, {{-10.0, -11.2}, {20.0, 17.5}, {40.0, 36.1}}};
+ *
+ * Points are ordered by raw value, count 0 is no calibration.
+ */
+struct CalibrationTable
+{
+    uint16_t         count;
+    CalibrationPoint points[CALIBRATION_MAX_POINTS];
+};
+
+/**
+ * Calibration curve prepared for the sample path
+ *
+ * Between two points values are interpolated linearly, outside of the points the first and last segment are
+ * extended. A single point is an offset. Each segment keeps its slope as fixed-point number, so apply() needs one
+ * multiplication and shift but no division, and no floating-point operation besides the conversion of the sample.
+ */
+class Calibration
+{
+public:
+    Calibration();
+
+    bool set(const CalibrationTable& table);
+    void clear(void);
+
+    int32_t apply(int32_t raw) const;
+    float   apply(float raw) const;
+
+    uint8_t size(void) const { return count; }
+
+    static bool parse(const char* text, size_t length, CalibrationTable& table);
+
+private:
+    uint8_t count;
+    int32_t raw[CALIBRATION_MAX_POINTS];    // fixed-point raw values, ascending
+    int32_t actual[CALIBRATION_MAX_POINTS]; // fixed-point actual values
+    int32_t slope[CALIBRATION_MAX_POINTS];  // of the segment from each point to the next one
+};
+
+/**
+ * Unit test and benchmark for Calibration class
+ */
+class TestCalibration
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint32_t samples = 10000);
+};
+
+#endif // CALIBRATION_H
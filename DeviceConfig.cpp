@@ -0,0 +1,687 @@
+#include "DeviceConfig.h"
+#include "Logger.h"
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static_assert(sizeof(ConfigRecord) % 4 == 0, "flash writes need a multiple of 4 bytes");
+
+/**
+ * Stored record size of each CONFIG_VERSION, the records of older versions are prefixes of the current layout
+ * followed by their CRC
+ */
+static const uint16_t configRecordSizes[CONFIG_VERSION + 1] = {
+    0,
+    offsetof(ConfigRecord, dhtCalibration) + sizeof(uint32_t), // 1: without calibration curves
+    offsetof(ConfigRecord, ds18b20Curves) + sizeof(uint32_t),  // 2: without curves of single DS18B20 sensors
+    sizeof(ConfigRecord),
+};
+
+#if defined(ESP8266)
+extern "C" uint32_t _SPIFFS_start;
+extern "C" uint32_t _SPIFFS_end;
+#endif
+
+/**
+ * Locate the config sectors at the end of the SPIFFS area
+ */
+FlashConfigStorage::FlashConfigStorage() :
+    available(false),
+    firstSector(0)
+{
+    buffered[0] = false;
+    buffered[1] = false;
+#if defined(ESP8266)
+    uint32_t start = ((uintptr_t)&_SPIFFS_start - 0x40200000) / SPI_FLASH_SEC_SIZE;
+    uint32_t end   = ((uintptr_t)&_SPIFFS_end - 0x40200000) / SPI_FLASH_SEC_SIZE;
+    if (end >= start + 2) {
+        firstSector = end - 2;
+        available   = true;
+    }
+#elif defined(ESP32)
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    if (partition && partition->size >= 2 * SPI_FLASH_SEC_SIZE) {
+        firstSector = partition->size / SPI_FLASH_SEC_SIZE - 2;
+        available   = true;
+    }
+#endif
+}
+
+uint32_t FlashConfigStorage::sectorAddress(uint8_t index) const
+{
+    return (firstSector + index) * SPI_FLASH_SEC_SIZE;
+}
+
+/**
+ * Return the record area of given sector, read from flash on first access after changes
+ */
+const uint8_t* FlashConfigStorage::sector(uint8_t index)
+{
+    if (!available || index > 1) {
+        return nullptr;
+    }
+    if (!buffered[index]) {
+#if defined(ESP8266)
+        if (!ESP.flashRead(sectorAddress(index), buffer[index], sizeof(buffer[index]))) {
+            return nullptr;
+        }
+#elif defined(ESP32)
+        if (esp_partition_read(partition, sectorAddress(index), buffer[index], sizeof(buffer[index])) != ESP_OK) {
+            return nullptr;
+        }
+#endif
+        buffered[index] = true;
+    }
+    return (const uint8_t*)buffer[index];
+}
+
+bool FlashConfigStorage::erase(uint8_t index)
+{
+    if (!available || index > 1) {
+        return false;
+    }
+    buffered[index] = false;
+#if defined(ESP8266)
+    return ESP.flashEraseSector(firstSector + index);
+#elif defined(ESP32)
+    return esp_partition_erase_range(partition, sectorAddress(index), SPI_FLASH_SEC_SIZE) == ESP_OK;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Write given data to the start of given sector - size must be a multiple of 4 bytes
+ */
+bool FlashConfigStorage::write(uint8_t index, const void* data, size_t size)
+{
+    if (!available || index > 1 || size > sizeof(buffer[index]) || size % 4 != 0) {
+        return false;
+    }
+    // the buffer is the aligned source for the flash write and read again by the next sector() call
+    memcpy(buffer[index], data, size);
+    buffered[index] = false;
+#if defined(ESP8266)
+    return ESP.flashWrite(sectorAddress(index), buffer[index], size);
+#elif defined(ESP32)
+    return esp_partition_write(partition, sectorAddress(index), buffer[index], size) == ESP_OK;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Initialize both sectors as erased flash
+ */
+RamConfigStorage::RamConfigStorage() :
+    writeLimit(-1)
+{
+    memset(data, 0xFF, sizeof(data));
+}
+
+const uint8_t* RamConfigStorage::sector(uint8_t index)
+{
+    return (index > 1) ? nullptr : (const uint8_t*)data[index];
+}
+
+bool RamConfigStorage::erase(uint8_t index)
+{
+    if (index > 1 || writeLimit == 0) {
+        return false;
+    }
+    memset(data[index], 0xFF, sizeof(data[index]));
+    return true;
+}
+
+/**
+ * Write given data like flash, which can only clear bits, and stop at a simulated power loss
+ */
+bool RamConfigStorage::write(uint8_t index, const void* source, size_t size)
+{
+    if (index > 1 || size > sizeof(data[index])) {
+        return false;
+    }
+    uint8_t*       target = (uint8_t*)data[index];
+    const uint8_t* bytes  = (const uint8_t*)source;
+    for (size_t i = 0; i < size; ++i) {
+        if (writeLimit == 0) {
+            return false;
+        }
+        if (writeLimit > 0) {
+            --writeLimit;
+        }
+        target[i] &= bytes[i];
+    }
+    return true;
+}
+
+/**
+ * Text keys of update() and the record fields they change
+ */
+enum ConfigFieldType
+{
+    FIELD_TEXT,
+    FIELD_FLOAT,
+    FIELD_UINT32,
+    FIELD_PIN,
+    FIELD_CALIBRATION,
+    FIELD_SENSOR_CALIBRATION // key is a prefix followed by the sensor name
+};
+
+struct ConfigField
+{
+    const char*     key;
+    ConfigFieldType type;
+    uint16_t        offset;
+    uint16_t        size;
+    uint32_t        minimum; // of FIELD_UINT32 values
+    uint32_t        maximum; // ...
+};
+
+static const ConfigField configFields[] = {
+    {"room", FIELD_TEXT, offsetof(ConfigRecord, room), CONFIG_ROOM_LENGTH, 0, 0},
+    {"heater", FIELD_TEXT, offsetof(ConfigRecord, heaterSensor), CONFIG_SENSOR_LENGTH, 0, 0},
+    {"dht_offset", FIELD_FLOAT, offsetof(ConfigRecord, dhtTemperatureOffset), sizeof(float), 0, 0},
+    {"ds18b20_offset", FIELD_FLOAT, offsetof(ConfigRecord, ds18b20TemperatureOffset), sizeof(float), 0, 0},
+    {"update_timeout", FIELD_UINT32, offsetof(ConfigRecord, updateTimeout), sizeof(uint32_t), CONFIG_MIN_INTERVAL,
+     CONFIG_MAX_INTERVAL},
+    {"display_delay", FIELD_UINT32, offsetof(ConfigRecord, displayUpdateDelay), sizeof(uint32_t), CONFIG_MIN_INTERVAL,
+     CONFIG_MAX_INTERVAL},
+    {"dht_pin", FIELD_PIN, offsetof(ConfigRecord, dhtPin), sizeof(uint8_t), 0, 0},
+    {"onewire_pin", FIELD_PIN, offsetof(ConfigRecord, oneWirePin), sizeof(uint8_t), 0, 0},
+    {"relay_pin", FIELD_PIN, offsetof(ConfigRecord, relayPin), sizeof(uint8_t), 0, 0},
+    {"dht_curve", FIELD_CALIBRATION, offsetof(ConfigRecord, dhtCalibration), sizeof(CalibrationTable), 0, 0},
+    {"ds18b20_curve", FIELD_CALIBRATION, offsetof(ConfigRecord, ds18b20Calibration), sizeof(CalibrationTable), 0, 0},
+    {"ds18b20_curve.", FIELD_SENSOR_CALIBRATION, offsetof(ConfigRecord, ds18b20Curves),
+     sizeof(ConfigSensorCurve) * CONFIG_SENSOR_CURVES, 0, 0},
+};
+
+/**
+ * Set field of given key in given record to the given value text
+ *
+ * @return FALSE for unknown keys and invalid values
+ */
+static bool setConfigField(ConfigRecord& record, const char* key, size_t keyLength, const char* value, size_t valueLength)
+{
+    for (const ConfigField& field : configFields) {
+        size_t fieldKeyLength = strlen(field.key);
+        if (field.type == FIELD_SENSOR_CALIBRATION) {
+            if (keyLength <= fieldKeyLength || strncmp(field.key, key, fieldKeyLength) != 0) {
+                continue;
+            }
+        } else if (fieldKeyLength != keyLength || strncmp(field.key, key, keyLength) != 0) {
+            continue;
+        }
+
+        uint8_t* target = (uint8_t*)&record + field.offset;
+        char*    end    = nullptr;
+
+        switch (field.type) {
+        case FIELD_TEXT:
+            if (valueLength >= field.size) {
+                return false;
+            }
+            memset(target, 0, field.size);
+            memcpy(target, value, valueLength);
+            return true;
+        case FIELD_FLOAT: {
+            float number = strtod(value, &end);
+            if (end != value + valueLength || valueLength == 0 || !isfinite(number)) {
+                return false;
+            }
+            memcpy(target, &number, sizeof(number));
+            return true;
+        }
+        case FIELD_UINT32: {
+            // strtoul() accepts and negates a leading sign, so -1 would become 4294967295
+            if (valueLength == 0 || !isdigit((unsigned char)value[0])) {
+                return false;
+            }
+            unsigned long number = strtoul(value, &end, 10);
+            if (end != value + valueLength || number < field.minimum || number > field.maximum) {
+                return false;
+            }
+            uint32_t limited = number;
+            memcpy(target, &limited, sizeof(limited));
+            return true;
+        }
+        case FIELD_PIN: {
+            unsigned long number = strtoul(value, &end, 10);
+            if (end != value + valueLength || valueLength == 0 || number > CONFIG_MAX_PIN) {
+                return false;
+            }
+            *target = (uint8_t)number;
+            return true;
+        }
+        case FIELD_CALIBRATION: {
+            CalibrationTable table;
+            if (!Calibration::parse(value, valueLength, table)) {
+                return false;
+            }
+            memcpy(target, &table, sizeof(table));
+            return true;
+        }
+        case FIELD_SENSOR_CALIBRATION: {
+            const char*      name       = key + fieldKeyLength;
+            size_t           nameLength = keyLength - fieldKeyLength;
+            CalibrationTable table;
+            if (nameLength >= CONFIG_SENSOR_LENGTH || !Calibration::parse(value, valueLength, table)) {
+                return false;
+            }
+            // replace the curve of the same sensor, or use a free entry
+            ConfigSensorCurve* curves = (ConfigSensorCurve*)target;
+            ConfigSensorCurve* entry  = nullptr;
+            for (uint8_t i = 0; i < CONFIG_SENSOR_CURVES; ++i) {
+                if (strncmp(curves[i].sensor, name, nameLength) == 0 && curves[i].sensor[nameLength] == '\0') {
+                    entry = &curves[i];
+                    break;
+                }
+                if (!entry && curves[i].sensor[0] == '\0') {
+                    entry = &curves[i];
+                }
+            }
+            if (!entry) {
+                return table.count == 0;
+            }
+            memset(entry, 0, sizeof(*entry));
+            if (table.count > 0) {
+                memcpy(entry->sensor, name, nameLength);
+                entry->table = table;
+            }
+            return true;
+        }
+        }
+    }
+    return false;
+}
+
+DeviceConfig::DeviceConfig(ConfigStorage& storage) :
+    storage(storage),
+    current(&defaultRecord),
+    activeSector(-1),
+    errorPos(-1),
+    loadTime(0)
+{
+    memset(&defaultRecord, 0, sizeof(defaultRecord));
+}
+
+/**
+ * Use the newest valid record of the storage in place or a copy of given defaults
+ *
+ * @return FALSE if no valid record is stored and the defaults are used
+ */
+bool DeviceConfig::load(const ConfigRecord& defaults)
+{
+    unsigned long start = micros();
+
+    defaultRecord          = defaults;
+    defaultRecord.magic    = CONFIG_MAGIC;
+    defaultRecord.version  = CONFIG_VERSION;
+    defaultRecord.size     = sizeof(ConfigRecord);
+    defaultRecord.sequence = 0;
+    defaultRecord.crc      = crc32(&defaultRecord, offsetof(ConfigRecord, crc));
+
+    current      = &defaultRecord;
+    activeSector = -1;
+    for (uint8_t i = 0; i < 2; ++i) {
+        const ConfigRecord* stored = (const ConfigRecord*)storage.sector(i);
+        if (isValid(stored) && (activeSector < 0 || stored->sequence > current->sequence)) {
+            current      = stored;
+            activeSector = i;
+        }
+    }
+
+    if (activeSector >= 0 && current->version != CONFIG_VERSION) {
+        migrate(*current, defaults);
+    }
+
+    loadTime = micros() - start;
+    return activeSector >= 0;
+}
+
+/**
+ * Save given record of an older version with the fields appended since taken from given defaults
+ *
+ * If the migrated record cannot be written, it is used from RAM and the stored record is kept.
+ *
+ * @return FALSE on write errors
+ */
+bool DeviceConfig::migrate(const ConfigRecord& stored, const ConfigRecord& defaults)
+{
+    ConfigRecord migrated = defaults;
+    memcpy(&migrated, &stored, stored.size - sizeof(uint32_t));
+    LOG_INFO(CONFIG, "migrating config #%u from version %u", (unsigned int)stored.sequence, stored.version);
+    if (save(migrated)) {
+        return true;
+    }
+
+    // sequence and CRC are kept, so the next save() continues after the stored record
+    defaultRecord         = migrated;
+    defaultRecord.version = CONFIG_VERSION;
+    defaultRecord.size    = sizeof(ConfigRecord);
+    defaultRecord.crc     = crc32(&defaultRecord, offsetof(ConfigRecord, crc));
+    current               = &defaultRecord;
+    return false;
+}
+
+/**
+ * Store given record with next sequence number into the inactive sector and use it
+ *
+ * @return FALSE on write errors - the previous record is kept then
+ */
+bool DeviceConfig::save(const ConfigRecord& changed)
+{
+    ConfigRecord record = changed;
+    record.magic        = CONFIG_MAGIC;
+    record.version      = CONFIG_VERSION;
+    record.size         = sizeof(ConfigRecord);
+    record.sequence     = current->sequence + 1;
+    record.crc          = crc32(&record, offsetof(ConfigRecord, crc));
+
+    uint8_t target = (activeSector == 0) ? 1 : 0;
+    if (!storage.erase(target) || !storage.write(target, &record, sizeof(record))) {
+        LOG_ERROR(CONFIG, "failed to write config #%u to sector %u", (unsigned int)record.sequence, target);
+        return false;
+    }
+
+    const ConfigRecord* written = (const ConfigRecord*)storage.sector(target);
+    if (!isValid(written) || written->sequence != record.sequence) {
+        LOG_ERROR(CONFIG, "failed to verify config #%u in sector %u", (unsigned int)record.sequence, target);
+        return false;
+    }
+
+    current      = written;
+    activeSector = target;
+    LOG_INFO(CONFIG, "saved config #%u to sector %u", (unsigned int)record.sequence, target);
+    return true;
+}
+
+/**
+ * Change fields given as "key=value;key=value" text and save the result as one record
+ *
+ * @return FALSE on unknown keys, invalid values or write errors - errorPosition() returns the position of the
+ *         failing key for invalid text
+ */
+bool DeviceConfig::update(const char* text)
+{
+    ConfigRecord changed = *current;
+    const char*  pos     = text;
+
+    errorPos = -1;
+    if (!text || *text == '\0') {
+        errorPos = 0;
+        return false;
+    }
+
+    while (*pos) {
+        const char* end = strchr(pos, ';');
+        if (!end) {
+            end = pos + strlen(pos);
+        }
+        const char* separator = (const char*)memchr(pos, '=', end - pos);
+        if (!separator || !setConfigField(changed, pos, separator - pos, separator + 1, end - separator - 1)) {
+            errorPos = pos - text;
+            LOG_ERROR(CONFIG, "invalid config '%s' at position %d", text, errorPos);
+            return false;
+        }
+        pos = *end ? end + 1 : end;
+    }
+
+    return save(changed);
+}
+
+/**
+ * Return CRC-32 (IEEE 802.3) of given data, continued from given crc
+ */
+uint32_t DeviceConfig::crc32(const void* data, size_t size, uint32_t crc)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    crc = ~crc;
+    while (size--) {
+        crc ^= *bytes++;
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * Return TRUE if given record has the layout of this or an older firmware and a correct CRC
+ */
+bool DeviceConfig::isValid(const ConfigRecord* record)
+{
+    if (!record || record->magic != CONFIG_MAGIC || record->version == 0 || record->version > CONFIG_VERSION ||
+        record->size != configRecordSizes[record->version]) {
+        return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, (const uint8_t*)record + record->size - sizeof(crc), sizeof(crc));
+    return crc == crc32(record, record->size - sizeof(crc));
+}
+
+/**
+ * Unit tests for DeviceConfig with RAM storage
+ */
+bool TestDeviceConfig::runTests()
+{
+    assert(DeviceConfig::crc32("123456789", 9) == 0xCBF43926);
+
+    ConfigRecord defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    strcpy(defaults.room, "/test");
+    defaults.displayUpdateDelay = 10000;
+    defaults.dhtPin             = 14;
+
+    // load() and update() write the storage, so they are not called inside assert()
+    RamConfigStorage storage;
+    DeviceConfig     config(storage);
+    return runTests(config, storage, defaults) && runPowerLossTests(storage, defaults) &&
+           runMigrationTests(defaults);
+}
+
+/**
+ * Updates and reload of given configuration with empty storage
+ */
+bool TestDeviceConfig::runTests(DeviceConfig& config, ConfigStorage& storage, const ConfigRecord& defaults)
+{
+    // defaults without stored record
+    bool loaded = config.load(defaults);
+    assert(!loaded && !config.isStored());
+    assert(strcmp(config.record().room, "/test") == 0);
+    assert(config.record().sequence == 0);
+
+    // updates are stored alternating in both sectors
+    bool updated = config.update("room=/kueche;dht_offset=-1.5;display_delay=5000");
+    assert(updated && config.isStored());
+    assert(config.record().sequence == 1);
+    assert(strcmp(config.record().room, "/kueche") == 0);
+    assert(config.record().dhtTemperatureOffset == -1.5);
+    assert(config.record().displayUpdateDelay == 5000);
+    assert(config.record().dhtPin == 14);
+    updated = config.update("dht_pin=12");
+    assert(updated && config.record().sequence == 2);
+    updated = config.update("dht_curve=-10:-11.2,20:17.5,40:36.1");
+    assert(updated && config.record().dhtCalibration.count == 3);
+    assert(config.record().dhtCalibration.points[1].actual == 1750);
+    updated = config.update("dht_curve=");
+    assert(updated && config.record().dhtCalibration.count == 0);
+    assert(config.record().sequence == 4);
+
+    // curves of single DS18B20 sensors by name, replaced by name and removed by empty curves
+    updated = config.update("ds18b20_curve.sensor1=20:19.6;ds18b20_curve.heater=20:20.5,60:61");
+    assert(updated && config.record().ds18b20Curves[0].table.count == 1);
+    assert(strcmp(config.record().ds18b20Curves[0].sensor, "sensor1") == 0);
+    assert(strcmp(config.record().ds18b20Curves[1].sensor, "heater") == 0);
+    updated = config.update("ds18b20_curve.sensor1=;ds18b20_curve.heater=20:21");
+    assert(updated && config.record().ds18b20Curves[0].sensor[0] == '\0');
+    const CalibrationTable& heater = config.record().ds18b20Curves[1].table;
+    assert(heater.count == 1 && heater.points[0].actual == 2100);
+    updated = config.update("ds18b20_curve.a=1:2;ds18b20_curve.b=1:2;ds18b20_curve.c=1:2;ds18b20_curve.d=1:2");
+    assert(!updated); // one more than CONFIG_SENSOR_CURVES with heater
+    updated = config.update("ds18b20_curve.sensor_name_too_long=1:2");
+    assert(!updated);
+    updated = config.update("ds18b20_curve.=1:2");
+    assert(!updated);
+    updated = config.update("ds18b20_curve.heater=;ds18b20_curve.unknown=");
+    assert(updated && config.record().ds18b20Curves[1].sensor[0] == '\0');
+    assert(config.record().sequence == 7);
+
+    // invalid text changes nothing
+    updated = config.update("foo=1");
+    assert(!updated && config.errorPosition() == 0);
+    updated = config.update("heater=sensor1;dht_pin=99");
+    assert(!updated && config.errorPosition() == 15);
+    updated = config.update("room");
+    assert(!updated);
+    updated = config.update("update_timeout=12x");
+    assert(!updated);
+    updated = config.update("display_delay=0");
+    assert(!updated);
+    updated = config.update("display_delay=-1");
+    assert(!updated);
+    updated = config.update("display_delay=+5000");
+    assert(!updated);
+    updated = config.update("update_timeout=999");
+    assert(!updated);
+    updated = config.update("update_timeout=3600001");
+    assert(!updated);
+    updated = config.update("display_delay=4294967296");
+    assert(!updated);
+    updated = config.update("");
+    assert(!updated);
+    updated = config.update("ds18b20_curve=20:1,10:2");
+    assert(!updated);
+    assert(config.record().sequence == 7);
+    assert(config.record().heaterSensor[0] == '\0');
+
+    // pins up to the highest GPIO number of the platform
+    char text[24];
+    snprintf(text, sizeof(text), "relay_pin=%d", CONFIG_MAX_PIN + 1);
+    updated = config.update(text);
+    assert(!updated);
+    snprintf(text, sizeof(text), "relay_pin=%d", CONFIG_MAX_PIN);
+    updated = config.update(text);
+    assert(updated && config.record().relayPin == CONFIG_MAX_PIN);
+    updated = config.update("relay_pin=12");
+    assert(updated && config.record().sequence == 9);
+
+    // newest record is loaded in place
+    DeviceConfig reloaded(storage);
+    loaded = reloaded.load(defaults);
+    assert(loaded);
+    assert(reloaded.record().sequence == 9);
+    assert(reloaded.record().dhtPin == 12 && reloaded.record().relayPin == 12);
+    assert(strcmp(reloaded.record().room, "/kueche") == 0);
+    const uint8_t* sector0 = storage.sector(0);
+    const uint8_t* sector1 = storage.sector(1);
+    assert((const uint8_t*)&reloaded.record() == sector0 || (const uint8_t*)&reloaded.record() == sector1);
+
+    return true;
+}
+
+/**
+ * A power loss while writing keeps the previous record
+ */
+bool TestDeviceConfig::runPowerLossTests(RamConfigStorage& storage, const ConfigRecord& defaults)
+{
+    DeviceConfig config(storage);
+    bool         loaded = config.load(defaults);
+    assert(loaded);
+    uint32_t sequence = config.record().sequence;
+
+    storage.failAfter(20);
+    bool updated = config.update("room=/bad");
+    assert(!updated);
+    storage.failAfter(-1);
+    DeviceConfig afterPowerLoss(storage);
+    loaded = afterPowerLoss.load(defaults);
+    assert(loaded);
+    assert(afterPowerLoss.record().sequence == sequence);
+    assert(strcmp(afterPowerLoss.record().room, "/kueche") == 0);
+
+    // and the interrupted sector is used again
+    updated = afterPowerLoss.update("room=/bad");
+    assert(updated && afterPowerLoss.record().sequence == sequence + 1);
+
+    return true;
+}
+
+/**
+ * A record of version 1 keeps its fields, the calibration curves are taken from the defaults
+ */
+bool TestDeviceConfig::runMigrationTests(const ConfigRecord& defaults)
+{
+    ConfigRecord old;
+    memset(&old, 0xFF, sizeof(old)); // erased flash behind the shorter record
+    memset(&old, 0, offsetof(ConfigRecord, dhtCalibration));
+    old.magic    = CONFIG_MAGIC;
+    old.version  = 1;
+    old.size     = configRecordSizes[1];
+    old.sequence = 7;
+    strcpy(old.room, "/bad");
+    strcpy(old.rules, "R0=T0<20");
+    old.dhtTemperatureOffset = -2.5;
+    old.dhtPin               = 5;
+    uint32_t crc             = DeviceConfig::crc32(&old, old.size - sizeof(crc));
+    memcpy((uint8_t*)&old + old.size - sizeof(crc), &crc, sizeof(crc));
+
+    ConfigRecord curves       = defaults;
+    curves.dhtCalibration     = {2, {{10.0, 7.6}, {30.0, 27.0}}};
+    curves.ds18b20Calibration = {1, {{20.0, 19.5}}};
+
+    RamConfigStorage storage;
+    bool             written = storage.write(0, &old, old.size);
+    assert(written && DeviceConfig::isValid((const ConfigRecord*)storage.sector(0)));
+
+    DeviceConfig config(storage);
+    bool         loaded = config.load(curves);
+    assert(loaded && config.isStored());
+    const ConfigRecord& migrated = config.record();
+    assert(migrated.version == CONFIG_VERSION && migrated.size == sizeof(ConfigRecord) && migrated.sequence == 8);
+    assert(strcmp(migrated.room, "/bad") == 0 && strcmp(migrated.rules, "R0=T0<20") == 0);
+    assert(migrated.dhtTemperatureOffset == -2.5f && migrated.dhtPin == 5);
+    assert(migrated.dhtCalibration.count == 2 && migrated.dhtCalibration.points[1].actual == 2700);
+    assert(migrated.ds18b20Calibration.count == 1 && migrated.ds18b20Curves[0].sensor[0] == '\0');
+    assert((const uint8_t*)&migrated == storage.sector(1));
+
+    // the migrated record is loaded in place without another save
+    DeviceConfig reloaded(storage);
+    loaded = reloaded.load(defaults);
+    assert(loaded && reloaded.record().sequence == 8 && reloaded.record().dhtCalibration.count == 2);
+
+    // records of newer firmware or with wrong size are not used
+    old.version = CONFIG_VERSION + 1;
+    assert(!DeviceConfig::isValid(&old));
+    old.version = 1;
+    old.size    = sizeof(ConfigRecord);
+    assert(!DeviceConfig::isValid(&old));
+
+    return true;
+}
+
+/**
+ * Measure load() with RAM storage, i.e. CRC check and sector selection without flash access times
+ */
+void TestDeviceConfig::runBenchmark(int iterations)
+{
+    ConfigRecord defaults;
+    memset(&defaults, 0, sizeof(defaults));
+
+    RamConfigStorage storage;
+    DeviceConfig     config(storage);
+    config.load(defaults);
+    config.update("room=/bench");
+    config.update("room=/bench2");
+
+    unsigned long start = micros();
+    for (int i = 0; i < iterations; ++i) {
+        config.load(defaults);
+    }
+    unsigned long elapsed = micros() - start;
+
+    LOG_INFO(CONFIG, "load: %lu us/op (%d ops), record %u bytes", elapsed / iterations, iterations, (unsigned int)sizeof(ConfigRecord));
+}
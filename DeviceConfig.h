@@ -0,0 +1,207 @@
+#ifndef DEVICECONFIG_H
+#define DEVICECONFIG_H
+
+/**
+ * Versioned, CRC protected device configuration stored in flash
+ */
+
+#include "Calibration.h"
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONFIG_MAGIC 0x46435352 // "RSCF"
+#define CONFIG_VERSION 3
+#define CONFIG_ROOM_LENGTH 32   // max MQTT room path length including terminating zero
+#define CONFIG_SENSOR_LENGTH 16 // max sensor name length including terminating zero, see DS18B20_NAME_LENGTH
+#define CONFIG_RULES_LENGTH 96  // max rules text length including terminating zero, see RuleEngine
+#define CONFIG_SENSOR_CURVES 4  // max calibration curves of single DS18B20 sensors, see DS18B20_MAX_CURVES
+#define CONFIG_MIN_INTERVAL 1000    // min update_timeout and display_delay in milliseconds
+#define CONFIG_MAX_INTERVAL 3600000 // max ...
+
+#if defined(ESP32)
+#include <esp_partition.h>
+#define CONFIG_MAX_PIN 39 // highest GPIO number accepted by update()
+#elif defined(ESP8266)
+#define CONFIG_MAX_PIN 16
+#else
+#define CONFIG_MAX_PIN 39 // simulated board of the host build, see HOST_PINS
+#endif
+
+/**
+ * Calibration curve of the DS18B20 sensor of given name
+ */
+struct ConfigSensorCurve
+{
+    char             sensor[CONFIG_SENSOR_LENGTH]; // empty for unused entries
+    CalibrationTable table;
+};
+
+/**
+ * Binary configuration record as stored in flash
+ *
+ * The record is used in place after the CRC check, so all fields have fixed size and no field needs parsing.
+ * New fields must be appended before crc, CONFIG_VERSION increased and the record size of the previous version
+ * added to configRecordSizes in DeviceConfig.cpp. Records of older versions are migrated by load().
+ */
+struct ConfigRecord
+{
+    uint32_t magic;    // CONFIG_MAGIC
+    uint16_t version;  // CONFIG_VERSION of the writing firmware
+    uint16_t size;     // sizeof(ConfigRecord) of the writing firmware
+    uint32_t sequence; // incremented by each save, the valid record with highest sequence is used
+
+    char     room[CONFIG_ROOM_LENGTH];           // MQTT path of the room, e.g. "/arbeitszimmer"
+    char     heaterSensor[CONFIG_SENSOR_LENGTH]; // name of the DS18B20 sensor of the heater
+    char     rules[CONFIG_RULES_LENGTH];         // RuleEngine rules text
+    float    dhtTemperatureOffset;               // Celsius degrees
+    float    ds18b20TemperatureOffset;           // Celsius degrees
+    uint32_t updateTimeout;                      // milliseconds to wait after invalid sensor values
+    uint32_t displayUpdateDelay;                 // milliseconds between display and MQTT updates
+    uint8_t  dhtPin;
+    uint8_t  oneWirePin;
+    uint8_t  relayPin;
+    uint8_t  reserved;
+
+    CalibrationTable dhtCalibration;     // curve from raw to actual Celsius degrees, applied before the offset
+    CalibrationTable ds18b20Calibration; // DS18B20 devices without own curve in ds18b20Curves
+
+    ConfigSensorCurve ds18b20Curves[CONFIG_SENSOR_CURVES]; // curves of single DS18B20 devices by name
+
+    uint32_t crc; // CRC32 of all previous bytes
+};
+
+/**
+ * Flash area of two sectors holding one ConfigRecord each
+ *
+ * Flash semantics: erase() sets all bytes to 0xFF and write() can only clear bits.
+ */
+class ConfigStorage
+{
+public:
+    virtual ~ConfigStorage() {}
+
+    /**
+     * Return readable content of given sector (0 or 1) of at least sizeof(ConfigRecord) bytes or nullptr
+     */
+    virtual const uint8_t* sector(uint8_t index)                               = 0;
+    virtual bool           erase(uint8_t index)                                = 0;
+    virtual bool           write(uint8_t index, const void* data, size_t size) = 0;
+};
+
+/**
+ * Configuration sectors in the SPI flash of the ESP8266 or ESP32
+ *
+ * Uses the last two sectors of the SPIFFS area, so the flash layout needs at least 8 KB SPIFFS, which must not
+ * be mounted by the sketch. On ESP32 this is the first data partition of subtype spiffs, accessed by the
+ * esp_partition functions. Only the first MB of flash is memory mapped, so each sector is read once into an
+ * aligned buffer by sector() and used from there.
+ */
+class FlashConfigStorage : public ConfigStorage
+{
+public:
+    FlashConfigStorage();
+
+    virtual const uint8_t* sector(uint8_t index);
+    virtual bool           erase(uint8_t index);
+    virtual bool           write(uint8_t index, const void* data, size_t size);
+
+private:
+    uint32_t sectorAddress(uint8_t index) const;
+
+    bool     available;   // FALSE if no flash area is available
+    uint32_t firstSector; // flash sector number of config sector 0, relative to the partition on ESP32
+#if defined(ESP32)
+    const esp_partition_t* partition;
+#endif
+    uint32_t buffer[2][(sizeof(ConfigRecord) + 3) / 4];
+    bool     buffered[2];
+};
+
+/**
+ * Configuration sectors in RAM with flash semantics, e.g. for tests
+ *
+ * failAfter() simulates a power loss: further writes are cut off after given count of bytes.
+ */
+class RamConfigStorage : public ConfigStorage
+{
+public:
+    RamConfigStorage();
+
+    virtual const uint8_t* sector(uint8_t index);
+    virtual bool           erase(uint8_t index);
+    virtual bool           write(uint8_t index, const void* data, size_t size);
+
+    void failAfter(int bytes) { writeLimit = bytes; }
+
+private:
+    uint32_t data[2][(sizeof(ConfigRecord) + 3) / 4];
+    int      writeLimit; // bytes until simulated power loss, -1 for unlimited
+};
+
+/**
+ * Device configuration loaded at boot and updated atomically by double-buffered sectors
+ *
+ * save() writes the new record with increased sequence number into the inactive sector, so a power loss leaves
+ * the previous record intact. load() uses the valid record with the highest sequence number in place, or the given
+ * defaults if no valid record is stored. A record of an older firmware keeps its fields, the fields appended since
+ * are taken from the defaults and the result is saved once in the current layout.
+ *
+ * update() changes single fields by text, e.g. from a MQTT COMMAND topic, in the format "key=value;key=value":
+ *
+ * @li room=/kueche                 - MQTT path of the room
+ * @li heater=sensor1               - DS18B20 sensor of the heater
+ * @li dht_offset=-2.7              - DHT temperature offset in Celsius degrees
+ * @li ds18b20_offset=0.5           - DS18B20 temperature offset in Celsius degrees
+ * @li dht_curve=10:7.6,30:27.0     - DHT calibration points raw:actual in Celsius degrees, empty for none
+ * @li ds18b20_curve=-10:-9.6,85:84 - DS18B20 calibration points of all sensors without own curve
+ * @li ds18b20_curve.sensor1=20:19.6 - DS18B20 calibration points of one sensor, empty to remove its curve
+ * @li update_timeout=2000          - milliseconds from CONFIG_MIN_INTERVAL to CONFIG_MAX_INTERVAL
+ * @li display_delay=10000          - milliseconds, same range
+ * @li dht_pin=14, onewire_pin=2, relay_pin=12 - GPIO numbers up to CONFIG_MAX_PIN
+ */
+class DeviceConfig
+{
+public:
+    DeviceConfig(ConfigStorage& storage);
+
+    bool load(const ConfigRecord& defaults);
+    bool save(const ConfigRecord& changed);
+    bool update(const char* text);
+
+    const ConfigRecord& record(void) const { return *current; }
+    bool                isStored(void) const { return current != &defaultRecord; }
+    int                 errorPosition(void) const { return errorPos; }
+    uint32_t            loadMicros(void) const { return loadTime; }
+
+    static uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+    static bool     isValid(const ConfigRecord* record);
+
+private:
+    bool migrate(const ConfigRecord& stored, const ConfigRecord& defaults);
+
+    ConfigStorage&      storage;
+    const ConfigRecord* current;       // record in storage sector or defaultRecord
+    ConfigRecord        defaultRecord; // used if no valid record is stored
+    int8_t              activeSector;  // sector of current record or -1 for defaults
+    int                 errorPos;      // position of invalid update() text or -1
+    uint32_t            loadTime;      // microseconds of last load()
+};
+
+/**
+ * Unit test and benchmark for DeviceConfig class
+ */
+class TestDeviceConfig
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(int iterations = 1000);
+
+    static bool runTests(DeviceConfig& config, ConfigStorage& storage, const ConfigRecord& defaults);
+
+private:
+    bool runPowerLossTests(RamConfigStorage& storage, const ConfigRecord& defaults);
+    bool runMigrationTests(const ConfigRecord& defaults);
+};
+
+#endif // DEVICECONFIG_H
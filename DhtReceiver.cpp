@@ -0,0 +1,385 @@
+/**
+ * Reading DHT11/DHT22/AM2302 sensors by edge timestamps instead of bit-banging with interrupts disabled
+ */
+
+#include "DhtReceiver.h"
+#include "Logger.h"
+#include <DHT.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// tolerances of the pulse widths in us, the nominal widths are given in the class comment
+#define DHT_RESPONSE_MIN 50
+#define DHT_RESPONSE_MAX 110
+#define DHT_LOW_MIN 20
+#define DHT_LOW_MAX 85
+#define DHT_HIGH_MIN 5
+#define DHT_HIGH_MAX 100
+
+// edges of a frame from the response to the release of the line
+#define DHT_FRAME_EDGES (4 + 2 * DHT_FRAME_BITS)
+
+/**
+ * Constructor, the pin is not touched before the first read
+ */
+DhtReceiver::DhtReceiver(uint8_t pin, uint8_t model) :
+    pin(pin),
+    model(model),
+    lastStatus(NO_RESPONSE),
+    valid(false),
+    started(false),
+    lastRead(0),
+    edgeCount(0)
+{
+    memset(data, 0, sizeof(data));
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * Use given pin for the next reads, the last frame is dropped
+ */
+void DhtReceiver::setPin(uint8_t newPin)
+{
+    pin        = newPin;
+    valid      = false;
+    started    = false;
+    lastStatus = NO_RESPONSE;
+}
+
+/**
+ * Store timestamp of a pin change of the capturing receiver given as interrupt argument
+ */
+void IRAM_ATTR DhtReceiver::onEdge(void* argument)
+{
+    uint32_t     now      = micros();
+    DhtReceiver* receiver = static_cast<DhtReceiver*>(argument);
+    if (receiver->edgeCount < DHT_MAX_EDGES) {
+        receiver->edges[receiver->edgeCount] = now;
+        receiver->edgeCount                  = receiver->edgeCount + 1;
+    }
+}
+
+/**
+ * Request a frame from the sensor and decode it
+ *
+ * The start signal and the capture take about 7 ms (25 ms for DHT11), but interrupts stay enabled and delay()
+ * lets the WiFi stack run. Within DHT_MIN_INTERVAL after the last frame the sensor is not asked again.
+ *
+ * @param force read even within DHT_MIN_INTERVAL, e.g. for tests
+ * @return OK if a valid frame was received
+ */
+DhtReceiver::Status DhtReceiver::read(bool force)
+{
+    unsigned long now = millis();
+    if (!force && started && now - lastRead < DHT_MIN_INTERVAL) {
+        return lastStatus;
+    }
+    started  = true;
+    lastRead = now;
+
+    // start signal, the line is held high by the pull-up resistor otherwise
+    edgeCount = 0;
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    if (model == DHT11) {
+        delay(DHT_START_TIME_DHT11 / 1000);
+    } else {
+        delayMicroseconds(DHT_START_TIME_DHT22);
+    }
+
+    // the sensor answers 20-40 us after the line is released
+    unsigned long start = micros();
+    attachInterruptArg(digitalPinToInterrupt(pin), onEdge, this, CHANGE);
+    pinMode(pin, INPUT_PULLUP);
+    delay(DHT_FRAME_TIME);
+    detachInterrupt(digitalPinToInterrupt(pin));
+
+    // the handler is detached, so the edges are no longer written
+    uint8_t frame[5];
+    lastStatus = decode(const_cast<const uint32_t*>(edges), edgeCount, frame);
+    if (lastStatus == OK) {
+        memcpy(data, frame, sizeof(data));
+        valid = true;
+    }
+    ++stats.frames;
+    ++stats.status[lastStatus];
+    stats.captureTime = micros() - start;
+
+    LOG_DEBUG(DHT, "frame %02x %02x %02x %02x %02x: %s, %u edges in %lu us", frame[0], frame[1], frame[2], frame[3],
+              frame[4], statusText(lastStatus), (unsigned int)edgeCount, (unsigned long)stats.captureTime);
+    return lastStatus;
+}
+
+/**
+ * Return temperature in celsius degrees of the last valid frame or NAN
+ */
+float DhtReceiver::temperature(void) const
+{
+    return valid ? temperature(data, model) : NAN;
+}
+
+/**
+ * Return relative humidity in percent of the last valid frame or NAN
+ */
+float DhtReceiver::humidity(void) const
+{
+    return valid ? humidity(data, model) : NAN;
+}
+
+/**
+ * Decode a frame from the timestamps of all captured edges
+ *
+ * The frame is aligned to the last edge, the release of the line after the checksum.
+ *
+ * @param edges timestamps in us of alternating falling and rising edges
+ * @param count edges captured
+ * @param data humidity, temperature and checksum bytes, also set on checksum errors
+ * @return OK if all pulse widths are within tolerance and the checksum matches
+ */
+DhtReceiver::Status DhtReceiver::decode(const uint32_t* edges, uint8_t count, uint8_t data[5])
+{
+    memset(data, 0, 5);
+    if (count < DHT_FRAME_EDGES) {
+        return NO_RESPONSE;
+    }
+    const uint32_t* frame = edges + count - DHT_FRAME_EDGES;
+
+    // response: low from frame[0] to frame[1], high up to frame[2]
+    uint32_t responseLow  = frame[1] - frame[0];
+    uint32_t responseHigh = frame[2] - frame[1];
+    if (responseLow < DHT_RESPONSE_MIN || responseLow > DHT_RESPONSE_MAX || responseHigh < DHT_RESPONSE_MIN ||
+        responseHigh > DHT_RESPONSE_MAX) {
+        return BAD_TIMING;
+    }
+
+    // each bit: low from frame[2 + 2 * bit] to frame[3 + 2 * bit], high up to the next edge
+    for (uint8_t bit = 0; bit < DHT_FRAME_BITS; ++bit) {
+        const uint32_t* pulse = frame + 2 + 2 * bit;
+        uint32_t        low   = pulse[1] - pulse[0];
+        uint32_t        high  = pulse[2] - pulse[1];
+        if (low < DHT_LOW_MIN || low > DHT_LOW_MAX || high < DHT_HIGH_MIN || high > DHT_HIGH_MAX) {
+            return BAD_TIMING;
+        }
+        data[bit / 8] = (data[bit / 8] << 1) | (high > DHT_BIT_THRESHOLD ? 1 : 0);
+    }
+
+    // end: low up to the release of the line
+    uint32_t end = frame[DHT_FRAME_EDGES - 1] - frame[DHT_FRAME_EDGES - 2];
+    if (end < DHT_LOW_MIN || end > DHT_LOW_MAX) {
+        return BAD_TIMING;
+    }
+
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4]) {
+        return BAD_CHECKSUM;
+    }
+    return OK;
+}
+
+/**
+ * Return temperature in celsius degrees of given frame
+ */
+float DhtReceiver::temperature(const uint8_t data[5], uint8_t model)
+{
+    if (model == DHT11) {
+        return data[2] + (data[3] & 0x0F) * 0.1;
+    }
+    float value = (((data[2] & 0x7F) << 8) | data[3]) * 0.1;
+    return (data[2] & 0x80) ? -value : value;
+}
+
+/**
+ * Return relative humidity in percent of given frame
+ */
+float DhtReceiver::humidity(const uint8_t data[5], uint8_t model)
+{
+    if (model == DHT11) {
+        return data[0] + data[1] * 0.1;
+    }
+    return ((data[0] << 8) | data[1]) * 0.1;
+}
+
+/**
+ * Return readable name of given status for logging
+ */
+const char* DhtReceiver::statusText(Status status)
+{
+    switch (status) {
+    case OK:
+        return "ok";
+    case NO_RESPONSE:
+        return "no response";
+    case BAD_TIMING:
+        return "bad timing";
+    case BAD_CHECKSUM:
+        return "bad checksum";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * Return pulse width with random deviation of up to given jitter
+ */
+static uint32_t jittered(uint32_t width, uint8_t jitter, uint32_t& seed)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    if (jitter == 0) {
+        return width;
+    }
+    return width - jitter + ((seed >> 16) % (2 * jitter + 1));
+}
+
+/**
+ * Write the edges of a DHT22 frame with given bytes as captured by the interrupt handler
+ *
+ * @param edges buffer of at least DHT_MAX_EDGES timestamps
+ * @param start timestamp in us the line is released by the host
+ * @param jitter max deviation in us of each pulse width from its nominal width
+ * @param seed state of the pseudo random jitter
+ * @param releaseEdge add the rising edge of the host releasing the line, as seen on some boards
+ * @return count of edges
+ */
+uint8_t TestDhtReceiver::synthesize(uint32_t* edges, const uint8_t data[5], uint32_t start, uint8_t jitter,
+                                    uint32_t& seed, bool releaseEdge)
+{
+    uint8_t  count = 0;
+    uint32_t time  = start;
+    if (releaseEdge) {
+        edges[count++] = time;
+    }
+    time += jittered(30, jitter, seed);
+    edges[count++] = time;
+    time += jittered(80, jitter, seed);
+    edges[count++] = time;
+    time += jittered(80, jitter, seed);
+    edges[count++] = time;
+    for (uint8_t bit = 0; bit < DHT_FRAME_BITS; ++bit) {
+        bool one = (data[bit / 8] >> (7 - bit % 8)) & 1;
+        time += jittered(50, jitter, seed);
+        edges[count++] = time;
+        time += jittered(one ? 70 : 27, jitter, seed);
+        edges[count++] = time;
+    }
+    time += jittered(50, jitter, seed);
+    edges[count++] = time;
+    return count;
+}
+
+/**
+ * Unit tests of decode() by synthetic frames with and without timing errors
+ */
+bool TestDhtReceiver::runTests()
+{
+    uint32_t edges[DHT_MAX_EDGES];
+    uint8_t  data[5];
+    uint32_t seed = 1;
+
+    // 65.2 %, 35.1 °C
+    const uint8_t warm[5] = {0x02, 0x8C, 0x01, 0x5F, 0xEE};
+    uint8_t       count   = synthesize(edges, warm, 1000, 0, seed);
+    assert(count == DHT_FRAME_EDGES);
+    assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::OK);
+    assert(memcmp(data, warm, 5) == 0);
+    assert(fabs(DhtReceiver::humidity(data, DHT22) - 65.2) < 0.01);
+    assert(fabs(DhtReceiver::temperature(data, DHT22) - 35.1) < 0.01);
+
+    // 40.0 %, -10.1 °C, with release edge of the host and micros() overflow within the frame
+    const uint8_t cold[5] = {0x01, 0x90, 0x80, 0x65, 0x76};
+    count                 = synthesize(edges, cold, 0xFFFFFF00UL, 0, seed, true);
+    assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::OK);
+    assert(fabs(DhtReceiver::humidity(data, DHT22) - 40.0) < 0.01);
+    assert(fabs(DhtReceiver::temperature(data, DHT22) + 10.1) < 0.01);
+
+    // DHT11 frame: 45 %, 23.4 °C
+    const uint8_t dht11[5] = {45, 0, 23, 4, 72};
+    count                  = synthesize(edges, dht11, 1000, 0, seed);
+    assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::OK);
+    assert(fabs(DhtReceiver::humidity(data, DHT11) - 45.0) < 0.01);
+    assert(fabs(DhtReceiver::temperature(data, DHT11) - 23.4) < 0.01);
+
+    // interrupt latency of a few us
+    for (uint8_t i = 0; i < 20; ++i) {
+        count = synthesize(edges, warm, 1000, 10, seed);
+        assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::OK);
+        assert(memcmp(data, warm, 5) == 0);
+    }
+
+    // checksum error
+    const uint8_t corrupt[5] = {0x02, 0x8C, 0x01, 0x5F, 0xEF};
+    count                    = synthesize(edges, corrupt, 1000, 0, seed);
+    assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::BAD_CHECKSUM);
+
+    // missing sensor or frame cut off
+    assert(DhtReceiver::decode(edges, 0, data) == DhtReceiver::NO_RESPONSE);
+    assert(DhtReceiver::decode(edges, DHT_FRAME_EDGES - 1, data) == DhtReceiver::NO_RESPONSE);
+
+    // missed edge within the frame
+    count = synthesize(edges, warm, 1000, 0, seed, true);
+    memmove(edges + 40, edges + 41, (count - 41) * sizeof(uint32_t));
+    assert(DhtReceiver::decode(edges, count - 1, data) == DhtReceiver::BAD_TIMING);
+
+    // glitch of 2 us within a high pulse
+    count = synthesize(edges, warm, 1000, 0, seed);
+    memmove(edges + 42, edges + 40, (count - 40) * sizeof(uint32_t));
+    edges[40] = edges[39] + 10;
+    edges[41] = edges[39] + 12;
+    assert(DhtReceiver::decode(edges, count + 2, data) == DhtReceiver::BAD_TIMING);
+
+    // pulse too long, e.g. delayed interrupt
+    count = synthesize(edges, warm, 1000, 0, seed);
+    for (uint8_t i = 50; i < count; ++i) {
+        edges[i] += 60;
+    }
+    assert(DhtReceiver::decode(edges, count, data) == DhtReceiver::BAD_TIMING);
+
+    DhtReceiver receiver(0, DHT22);
+    assert(receiver.status() == DhtReceiver::NO_RESPONSE);
+    assert(isnan(receiver.temperature()) && isnan(receiver.humidity()));
+
+    return true;
+}
+
+/**
+ * Log decode time per frame and rate of rejected and wrongly accepted frames by timing jitter
+ */
+void TestDhtReceiver::runBenchmark(uint32_t frames)
+{
+    uint32_t edges[DHT_MAX_EDGES];
+    uint8_t  data[5];
+    uint32_t seed = 1;
+
+    const uint8_t frame[5] = {0x02, 0x8C, 0x01, 0x5F, 0xEE};
+    uint8_t       count    = synthesize(edges, frame, 1000, 5, seed);
+    uint32_t      valid    = 0;
+    unsigned long start    = micros();
+    for (uint32_t i = 0; i < frames; ++i) {
+        valid += DhtReceiver::decode(edges, count, data) == DhtReceiver::OK;
+    }
+    unsigned long elapsed = micros() - start;
+    LOG_INFO(BENCH, "dht decode: %lu ns/frame (%u frames, %u valid)", (unsigned long)((uint64_t)elapsed * 1000 / frames),
+             (unsigned int)frames, (unsigned int)valid);
+
+    const uint8_t jitters[] = {0, 10, 20, 25, 30, 40};
+    for (uint8_t j = 0; j < sizeof(jitters); ++j) {
+        uint32_t rejected = 0;
+        uint32_t wrong    = 0;
+        for (uint32_t i = 0; i < frames; ++i) {
+            uint8_t random[5];
+            for (uint8_t b = 0; b < 4; ++b) {
+                seed      = seed * 1103515245UL + 12345UL;
+                random[b] = seed >> 16;
+            }
+            random[4] = random[0] + random[1] + random[2] + random[3];
+            count     = synthesize(edges, random, i * 10000, jitters[j], seed);
+            if (DhtReceiver::decode(edges, count, data) != DhtReceiver::OK) {
+                ++rejected;
+            } else if (memcmp(data, random, 5) != 0) {
+                ++wrong;
+            }
+        }
+        LOG_INFO(BENCH, "dht jitter %2u us: %u.%02u%% rejected, %u wrong of %u frames", (unsigned int)jitters[j],
+                 (unsigned int)(rejected * 100 / frames), (unsigned int)(rejected * 10000 / frames % 100),
+                 (unsigned int)wrong, (unsigned int)frames);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef DHTRECEIVER_H
+#define DHTRECEIVER_H
+
+/**
+ * Reading DHT11/DHT22/AM2302 sensors by edge timestamps instead of bit-banging with interrupts disabled
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DHT_FRAME_BITS 40          // 16 bit humidity, 16 bit temperature, 8 bit checksum
+#define DHT_MAX_EDGES 96           // 84 edges of a frame plus some glitches
+#define DHT_START_TIME_DHT22 1100  // us the host pulls the line low to request a frame
+#define DHT_START_TIME_DHT11 18000 // us, DHT11 needs a longer start signal
+#define DHT_FRAME_TIME 6           // ms to capture edges, a frame takes 4 to 5.5 ms
+#define DHT_MIN_INTERVAL 2000      // ms between two frames, reads in between return the last frame
+#define DHT_BIT_THRESHOLD 48       // us high time between a '0' (26-28 us) and a '1' bit (70 us)
+
+/**
+ * Receiver of DHT frames by pin change interrupt
+ *
+ * After the start signal an interrupt handler stores the micros() timestamp of each edge of the data line, which
+ * takes about 1 us per edge with interrupts enabled. The frame is decoded from the pulse widths afterwards:
+ *
+ * @li response: 80 us low, 80 us high
+ * @li 40 bits: 50 us low, then 26-28 us high for '0' or 70 us high for '1'
+ * @li end: 50 us low, then the line is released
+ *
+ * decode() counts back from the last edge, so edges before the response (e.g. the release of the line by the host)
+ * are ignored. Pulse widths out of tolerance and checksum errors reject the frame.
+ */
+class DhtReceiver
+{
+public:
+    enum Status
+    {
+        OK = 0,
+        NO_RESPONSE,  // too few edges, sensor missing or frame cut off
+        BAD_TIMING,   // pulse width out of tolerance, e.g. a missing or glitch edge
+        BAD_CHECKSUM, // all pulses valid, but checksum mismatch
+        STATUS_COUNT
+    };
+
+    /**
+     * Counters of all reads
+     */
+    struct Statistics
+    {
+        uint32_t frames;               // frames requested from the sensor
+        uint32_t status[STATUS_COUNT]; // frames by decode status, status[OK] counts valid frames
+        uint32_t captureTime;          // us from release of the line to decoded frame of the last read
+    };
+
+    DhtReceiver(uint8_t pin, uint8_t model);
+
+    void setPin(uint8_t pin);
+
+    Status read(bool force = false);
+    Status status(void) const { return lastStatus; }
+
+    float temperature(void) const;
+    float humidity(void) const;
+
+    const Statistics& statistics(void) const { return stats; }
+
+    static Status      decode(const uint32_t* edges, uint8_t count, uint8_t data[5]);
+    static float       temperature(const uint8_t data[5], uint8_t model);
+    static float       humidity(const uint8_t data[5], uint8_t model);
+    static const char* statusText(Status status);
+
+private:
+    static void IRAM_ATTR onEdge(void* receiver); // IRAM_ATTR of both cores, ICACHE_RAM_ATTR is deprecated on ESP8266
+
+    uint8_t           pin;
+    uint8_t           model;
+    uint8_t           data[5];  // last valid frame
+    Status            lastStatus;
+    bool              valid;    // data holds a valid frame
+    bool              started;  // a frame was requested since construction or pin change
+    unsigned long     lastRead; // millis() of the last frame
+    Statistics        stats;
+    volatile uint8_t  edgeCount;
+    volatile uint32_t edges[DHT_MAX_EDGES];
+};
+
+/**
+ * Unit test and benchmark for DhtReceiver by synthetic edge streams
+ */
+class TestDhtReceiver
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint32_t frames = 10000);
+
+    static uint8_t synthesize(uint32_t* edges, const uint8_t data[5], uint32_t start, uint8_t jitter, uint32_t& seed,
+                              bool releaseEdge = false);
+};
+
+#endif // DHTRECEIVER_H
@@ -0,0 +1,343 @@
+/**
+ * Pre-scaled large digit font for the SSD1306 OLED readout
+ */
+
+#include "DisplayFont.h"
+#include "Logger.h"
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+#define GLYPH_COLUMNS 5 // columns of the classic GFX font, the 6th column is spacing only
+#define GLYPH_CHARS "0123456789.%-"
+
+// glyphs of the classic GFX font scaled by 2 and 4 in SSD1306 column-byte layout: [page][column] per char,
+// chars in order of GLYPH_CHARS followed by the degree sign
+static const uint8_t glyphsSize2[][20] PROGMEM = {
+    { // '0'
+        0xFC, 0xFC, 0x03, 0x03, 0xC3, 0xC3, 0x33, 0x33, 0xFC, 0xFC,
+        0x0F, 0x0F, 0x33, 0x33, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F
+    },
+    { // '1'
+        0x00, 0x00, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x30, 0x30, 0x3F, 0x3F, 0x30, 0x30, 0x00, 0x00
+    },
+    { // '2'
+        0x0C, 0x0C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C,
+        0x3F, 0x3F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30
+    },
+    { // '3'
+        0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0xF3, 0xF3, 0x0F, 0x0F,
+        0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F
+    },
+    { // '4'
+        0xC0, 0xC0, 0x30, 0x30, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00,
+        0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x3F, 0x3F, 0x03, 0x03
+    },
+    { // '5'
+        0x3F, 0x3F, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0xC3, 0xC3,
+        0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F
+    },
+    { // '6'
+        0xF0, 0xF0, 0xCC, 0xCC, 0xC3, 0xC3, 0xC3, 0xC3, 0x03, 0x03,
+        0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F
+    },
+    { // '7'
+        0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0x3F, 0x3F,
+        0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '8'
+        0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C,
+        0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F
+    },
+    { // '9'
+        0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFC, 0xFC,
+        0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03
+    },
+    { // '.'
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x3C, 0x3C, 0x3C, 0x3C, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '%'
+        0x0F, 0x0F, 0x0F, 0x0F, 0xC0, 0xC0, 0x30, 0x30, 0x0C, 0x0C,
+        0x0C, 0x0C, 0x03, 0x03, 0x00, 0x00, 0x3C, 0x3C, 0x3C, 0x3C
+    },
+    { // '-'
+        0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    { // degree
+        0x00, 0x00, 0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+};
+
+static const uint8_t glyphsSize4[][80] PROGMEM = {
+    { // '0'
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '1'
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '2'
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F
+    },
+    { // '3'
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+        0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '4'
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x0F, 0x0F, 0x0F,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '5'
+        0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F,
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '6'
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '7'
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F,
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '8'
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '9'
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F,
+        0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '.'
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    { // '%'
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00,
+        0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F
+    },
+    { // '-'
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    { // degree
+        0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0,
+        0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+};
+/**
+ * Return TRUE if pre-scaled glyphs are available for given text size
+ */
+bool DisplayFont::isSupportedSize(uint8_t size)
+{
+    return size == 2 || size == 4;
+}
+
+/**
+ * Return the PROGMEM glyph of given char and size or nullptr, if the char is not part of the font
+ */
+const uint8_t* DisplayFont::glyphData(char c, uint8_t size)
+{
+    int index = -1;
+    if (c == DISPLAY_FONT_DEGREE) {
+        index = sizeof(GLYPH_CHARS) - 1;
+    } else if (c != '\0') {
+        const char* pos = strchr(GLYPH_CHARS, c);
+        if (pos != nullptr) {
+            index = pos - GLYPH_CHARS;
+        }
+    }
+    if (index < 0) {
+        return nullptr;
+    }
+
+    switch (size) {
+    case 2:
+        return glyphsSize2[index];
+    case 4:
+        return glyphsSize4[index];
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * Draw given text in white at given position and return the x position following the last char
+ *
+ * Unsupported text sizes are drawn by Adafruit GFX, unsupported chars are skipped like a space.
+ * Text is clipped at the display borders, there is no line wrapping.
+ */
+int16_t DisplayFont::drawText(Adafruit_SSD1306& display, int16_t x, int16_t y, const char* text, uint8_t size)
+{
+    if (!isSupportedSize(size)) {
+        display.setTextSize(size);
+        display.setCursor(x, y);
+        display.print(text);
+        return display.getCursorX();
+    }
+
+    while (*text != '\0') {
+        x = drawChar(display, x, y, *text++, size);
+    }
+    return x;
+}
+
+/**
+ * Draw single char in white at given position and return the x position of the next char
+ */
+int16_t DisplayFont::drawChar(Adafruit_SSD1306& display, int16_t x, int16_t y, char c, uint8_t size)
+{
+    const uint8_t* glyph  = glyphData(c, size);
+    uint8_t*       buffer = display.getBuffer();
+    int16_t        width  = display.width();
+    int16_t        pages  = display.height() / 8;
+    int16_t        next   = x + (GLYPH_COLUMNS + 1) * size;
+
+    if (glyph == nullptr || buffer == nullptr || y < 0) {
+        return next;
+    }
+
+    int16_t glyphWidth = GLYPH_COLUMNS * size;
+    int16_t firstPage  = y / 8;
+    uint8_t shift      = y % 8;
+
+    for (int16_t p = 0; p < size && firstPage + p < pages; ++p) {
+        uint8_t* target = buffer + (firstPage + p) * width;
+        bool     spills = shift != 0 && firstPage + p + 1 < pages;
+
+        for (int16_t col = 0; col < glyphWidth; ++col) {
+            int16_t px = x + col;
+            if (px < 0 || px >= width) {
+                continue;
+            }
+            uint8_t bits = pgm_read_byte(glyph + p * glyphWidth + col);
+            target[px] |= bits << shift;
+            if (spills) {
+                target[px + width] |= bits >> (8 - shift);
+            }
+        }
+    }
+    return next;
+}
+
+/**
+ * Render given text with GFX and DisplayFont and return TRUE if both display buffers are identical
+ */
+bool TestDisplayFont::compareWithGfx(int16_t x, int16_t y, const char* text, uint8_t size)
+{
+    size_t bufferSize = display.width() * display.height() / 8;
+
+    display.clearDisplay();
+    display.setTextWrap(false);
+    display.setTextColor(WHITE);
+    display.setTextSize(size);
+    display.setCursor(x, y);
+    display.print(text);
+    std::vector<uint8_t> expected(display.getBuffer(), display.getBuffer() + bufferSize);
+
+    display.clearDisplay();
+    DisplayFont::drawText(display, x, y, text, size);
+    bool equal = memcmp(expected.data(), display.getBuffer(), bufferSize) == 0;
+
+    display.clearDisplay();
+    display.setTextWrap(true);
+    return equal;
+}
+
+/**
+ * Unit tests for pixel identical output compared to the Adafruit GFX classic font
+ */
+bool TestDisplayFont::runTests()
+{
+    const char allChars[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '.', '%', '-', DISPLAY_FONT_DEGREE, '\0'};
+
+    assert(DisplayFont::isSupportedSize(2));
+    assert(DisplayFont::isSupportedSize(4));
+    assert(!DisplayFont::isSupportedSize(1));
+
+    // rendering draws into the display buffer, so it is not done inside assert()
+    bool equal = compareWithGfx(0, 0, allChars, 2);
+    assert(equal);
+    equal = compareWithGfx(8, 0, "23.4", 4);
+    assert(equal);
+    equal = compareWithGfx(8, 0, "-9.5\xF7", 4);
+    assert(equal);
+    equal = compareWithGfx(32, 48, "45.6%", 2);
+    assert(equal);
+    equal = compareWithGfx(3, 5, "78.9", 4); // unaligned page
+    assert(equal);
+    equal = compareWithGfx(120, 60, "01", 2); // clipped at right and bottom border
+    assert(equal);
+    equal = compareWithGfx(0, 16, "1.0", 1); // fallback to GFX
+    assert(equal);
+
+    return true;
+}
+
+/**
+ * Compare time to render the readout via GFX scaled text and via pre-scaled glyphs
+ */
+void TestDisplayFont::runBenchmark(int iterations)
+{
+    char temperatureStr[] = {'2', '3', '.', '4', DISPLAY_FONT_DEGREE, '\0'};
+
+    display.setTextColor(WHITE);
+
+    unsigned long start = micros();
+    for (int i = 0; i < iterations; ++i) {
+        display.clearDisplay();
+        display.setCursor(8, 0);
+        display.setTextSize(4);
+        display.print(temperatureStr);
+        display.setCursor(32, 48);
+        display.setTextSize(2);
+        display.print("45.6%");
+    }
+    unsigned long gfxTime = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < iterations; ++i) {
+        display.clearDisplay();
+        DisplayFont::drawText(display, 8, 0, temperatureStr, 4);
+        DisplayFont::drawText(display, 32, 48, "45.6%", 2);
+    }
+    unsigned long fontTime = micros() - start;
+
+    display.clearDisplay();
+
+    LOG_INFO(DISPLAY, "benchmark readout: GFX %lu us, DisplayFont %lu us per frame (%d frames)",
+             gfxTime / iterations, fontTime / iterations, iterations);
+}
@@ -0,0 +1,52 @@
+#ifndef DISPLAYFONT_H
+#define DISPLAYFONT_H
+
+/**
+ * Pre-scaled large digit font for the SSD1306 OLED readout
+ */
+
+#include <Adafruit_SSD1306.h>
+#include <Arduino.h>
+
+#define DISPLAY_FONT_DEGREE ((char)247) // same char code as used with the GFX classic font
+
+/**
+ * Draw the readout characters (digits, '.', '%', '-' and degree sign) with pre-scaled glyphs
+ *
+ * The glyphs of the classic 5x7 GFX font are stored pre-scaled in PROGMEM in the SSD1306 column-byte layout
+ * (one byte = 8 vertical pixels of one page), so drawing a char is a copy of a few bytes into the display buffer
+ * instead of one fillRect() per font pixel. The output is pixel identical to display.setTextSize(size) + print().
+ */
+class DisplayFont
+{
+public:
+    static bool    isSupportedSize(uint8_t size);
+    static int16_t drawText(Adafruit_SSD1306& display, int16_t x, int16_t y, const char* text, uint8_t size);
+    static int16_t drawChar(Adafruit_SSD1306& display, int16_t x, int16_t y, char c, uint8_t size);
+
+protected:
+    static const uint8_t* glyphData(char c, uint8_t size);
+};
+
+/**
+ * Unit test and benchmark for DisplayFont class
+ *
+ * Compares the pre-scaled glyphs against the Adafruit GFX scaled text output, so it needs the real display buffer.
+ */
+class TestDisplayFont
+{
+public:
+    TestDisplayFont(Adafruit_SSD1306& display) :
+        display(display)
+    {}
+
+    virtual bool runTests();
+    virtual void runBenchmark(int iterations = 100);
+
+private:
+    bool compareWithGfx(int16_t x, int16_t y, const char* text, uint8_t size);
+
+    Adafruit_SSD1306& display;
+};
+
+#endif // DISPLAYFONT_H
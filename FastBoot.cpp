@@ -0,0 +1,259 @@
+#include "FastBoot.h"
+#include "DeviceConfig.h"
+#include "Logger.h"
+#include "SensorDS18B20.h"
+#include "SimulatedTemperatureBus.h"
+#if defined(ESP32)
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(ESP8266)
+#if defined(ESP32)
+RTC_NOINIT_ATTR
+#endif
+static uint8_t rtcCache[96]; // RTC memory stand-in, the ESP8266 uses its RTC user memory
+#endif
+
+FastBoot::FastBoot(bool persistent) :
+    persistent(persistent),
+    cacheValid(false),
+    cachedWiFi(false),
+    wifiStart(0),
+    published(false),
+    firstPublishMillis(0)
+{
+    memset(&cache, 0, sizeof(cache));
+}
+
+/**
+ * CRC-32 of the cache content after the crc field
+ */
+uint32_t FastBoot::checksum(void) const
+{
+    return DeviceConfig::crc32((const uint8_t*)&cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc));
+}
+
+/**
+ * Read the cache from RTC memory
+ *
+ * @return FALSE if the cache is invalid, e.g. after power on
+ */
+bool FastBoot::load(void)
+{
+    if (persistent) {
+#if defined(ESP8266)
+        ESP.rtcUserMemoryRead(FASTBOOT_RTC_OFFSET, (uint32_t*)&cache, sizeof(cache));
+#else
+        static_assert(sizeof(cache) <= sizeof(rtcCache), "RTC cache too small");
+        memcpy(&cache, rtcCache, sizeof(cache));
+#endif
+    }
+
+    cacheValid = (cache.magic == FASTBOOT_MAGIC && cache.crc == checksum() && cache.deviceCount <= FASTBOOT_MAX_DEVICES);
+    if (!cacheValid) {
+        memset(&cache, 0, sizeof(cache));
+    }
+    LOG_INFO(BOOT, "boot cache %s: WiFi channel %u, %u 1wire devices", cacheValid ? "valid" : "invalid",
+             cache.channel, cache.deviceCount);
+    return cacheValid;
+}
+
+/**
+ * Write the cache to RTC memory
+ */
+bool FastBoot::save(void)
+{
+    static_assert(sizeof(Cache) % 4 == 0, "RTC memory is written in 4 byte blocks");
+
+    cache.magic = FASTBOOT_MAGIC;
+    cache.crc   = checksum();
+    cacheValid  = true;
+    if (!persistent) {
+        return true;
+    }
+#if defined(ESP8266)
+    return ESP.rtcUserMemoryWrite(FASTBOOT_RTC_OFFSET, (uint32_t*)&cache, sizeof(cache));
+#else
+    memcpy(rtcCache, &cache, sizeof(cache));
+    return true;
+#endif
+}
+
+/**
+ * Forget the cached access point, e.g. if it does not answer anymore
+ */
+void FastBoot::invalidateWiFi(void)
+{
+    cache.channel = 0;
+    save();
+}
+
+/**
+ * Start WiFi association without waiting for it - with cached access point and IP configuration, if available
+ *
+ * @return TRUE if cached data are used
+ */
+bool FastBoot::beginWiFi(const char* ssid, const char* password)
+{
+    WiFi.persistent(false); // no flash writes of the WiFi settings on each boot
+    WiFi.mode(WIFI_STA);
+
+    cachedWiFi = cacheValid && cache.channel != 0;
+    if (cachedWiFi) {
+        LOG_INFO(BOOT, "connecting to WLAN '%s' on channel %u with cached IP configuration...", ssid, cache.channel);
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+        WiFi.begin(ssid, password, cache.channel, cache.bssid, true);
+    } else {
+        LOG_INFO(BOOT, "connecting to WLAN '%s'...", ssid);
+        WiFi.begin(ssid, password);
+    }
+    wifiStart = millis();
+    return cachedWiFi;
+}
+
+/**
+ * Wait for the association started by beginWiFi() and cache its data when connected
+ *
+ * A cached association not connected within FASTBOOT_CACHED_TIMEOUT is restarted with scan and DHCP.
+ *
+ * @return FALSE if not connected within given milliseconds since beginWiFi()
+ */
+bool FastBoot::waitForWiFi(const char* ssid, const char* password, unsigned long timeout)
+{
+    while (WiFi.status() != WL_CONNECTED && millis() - wifiStart < timeout) {
+        if (cachedWiFi && millis() - wifiStart > FASTBOOT_CACHED_TIMEOUT) {
+            LOG_WARN(BOOT, "cached WiFi association failed - connecting with scan and DHCP");
+            invalidateWiFi();
+            WiFi.disconnect();
+            WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u)); // enable DHCP again
+            WiFi.begin(ssid, password);
+            cachedWiFi = false;
+        }
+        logger.idle(10);
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+        return false;
+    }
+    if (!cachedWiFi) {
+        storeWiFi();
+        save();
+    }
+    LOG_INFO(BOOT, "WiFi connected after %lu ms - IP address: %s", millis(), WiFi.localIP().toString().c_str());
+    return true;
+}
+
+/**
+ * Copy access point and IP configuration of the current connection into the cache
+ */
+void FastBoot::storeWiFi(void)
+{
+    const uint8_t* bssid = WiFi.BSSID();
+    if (!bssid) {
+        return;
+    }
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.ip      = (uint32_t)WiFi.localIP();
+    cache.gateway = (uint32_t)WiFi.gatewayIP();
+    cache.subnet  = (uint32_t)WiFi.subnetMask();
+    cache.dns     = (uint32_t)WiFi.dnsIP();
+}
+
+/**
+ * Restore the cached DS18B20 devices without bus search or search the bus and cache the found devices
+ *
+ * @return TRUE if all cached devices were restored
+ */
+bool FastBoot::initSensors(SensorDS18B20& sensors)
+{
+    if (cacheValid && cache.deviceCount > 0) {
+        bool restored = true;
+        for (uint8_t i = 0; i < cache.deviceCount && restored; ++i) {
+            restored = sensors.restoreSensor(cache.devices[i], i);
+        }
+        if (restored) {
+            LOG_INFO(BOOT, "%u cached 1wire devices restored", cache.deviceCount);
+            return true;
+        }
+        LOG_WARN(BOOT, "cached 1wire devices changed - searching bus");
+    }
+
+    int found = sensors.sensorsAvailable();
+
+    // more devices than cache entries would be missing after the next boot
+    cache.deviceCount = 0;
+    if (found <= FASTBOOT_MAX_DEVICES) {
+        for (size_t slot = 0; slot < DS18B20_MAX_SENSORS; ++slot) {
+            const SensorDS18B20::SensorData* data = sensors.registeredSensor(slot);
+            if (data && data->connected) {
+                memcpy(cache.devices[cache.deviceCount++], data->address, sizeof(cache.devices[0]));
+            }
+        }
+    }
+    save();
+    return false;
+}
+
+/**
+ * Take time to first publish on first call
+ *
+ * @return TRUE on first call only
+ */
+bool FastBoot::firstPublished(void)
+{
+    if (published) {
+        return false;
+    }
+    published          = true;
+    firstPublishMillis = millis();
+    return true;
+}
+
+/**
+ * Unit tests of device cache with simulated bus - the RTC memory is not touched
+ */
+bool TestFastBoot::runTests()
+{
+    SimulatedTemperatureBus bus(5);
+    FastBoot                boot(false);
+
+    // initSensors() searches or restores the bus and the first publish is taken once, so neither is called inside
+    // assert()
+    SensorDS18B20 cold(&bus);
+    uint64_t      start      = bus.busTime();
+    bool          restored   = boot.initSensors(cold);
+    uint64_t      searchTime = bus.busTime() - start;
+    assert(!restored && boot.deviceCount() == 5);
+
+    // warm boot restores the same sensors by scratchpad reads only
+    SensorDS18B20 warm(&bus);
+    start                = bus.busTime();
+    restored             = boot.initSensors(warm);
+    uint64_t restoreTime = bus.busTime() - start;
+    assert(restored && restoreTime * 4 < searchTime);
+    assert(warm.sensorsRegistered() == 5);
+    float temperature = warm.temperature("sensor4");
+    assert(!std::isnan(temperature));
+
+    // missing device falls back to bus search
+    bus.setDeviceConnected(2, false);
+    SensorDS18B20 changed(&bus);
+    restored = boot.initSensors(changed);
+    assert(!restored && boot.deviceCount() == 4);
+
+    logger.flush(); // the device log lines may have filled the log buffer
+    LOG_INFO(BOOT, "1wire init of 5 devices: search %u ms, restore %u ms", (unsigned int)(searchTime / 1000), (unsigned int)(restoreTime / 1000));
+
+    // first publish is taken once
+    bool first  = boot.firstPublished();
+    bool second = boot.firstPublished();
+    assert(first && !second);
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef FASTBOOT_H
+#define FASTBOOT_H
+
+/**
+ * Fast boot by WiFi association and 1wire devices cached from the last boot
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+class SensorDS18B20;
+
+#define FASTBOOT_MAGIC 0x42465352     // "RSFB"
+#define FASTBOOT_MAX_DEVICES 8        // cached DS18B20 ROM codes
+#define FASTBOOT_WIFI_TIMEOUT 10000   // milliseconds to wait for the WiFi association
+#define FASTBOOT_CACHED_TIMEOUT 3000  // milliseconds before a cached association is given up
+#define FASTBOOT_RTC_OFFSET 32        // 4 byte blocks of RTC user memory - the first 128 bytes are used by OTA updates
+
+/**
+ * Boot state cached in RTC memory, which keeps its content over resets and deep sleep but not over power loss
+ *
+ * With a valid cache the WiFi association uses the last BSSID, channel and static IP configuration, so neither a
+ * scan nor DHCP is needed, and the known DS18B20 devices are restored without 1wire bus search, see
+ * SensorDS18B20::restoreSensor(). Without valid cache or if the cached access point does not answer within
+ * FASTBOOT_CACHED_TIMEOUT a normal association is started and the cache is written again when connected.
+ *
+ * The time since reset until the first published message is reported as boot metric.
+ */
+class FastBoot
+{
+public:
+    FastBoot(bool persistent = true);
+
+    bool load(void);
+    bool save(void);
+    void invalidateWiFi(void);
+
+    bool beginWiFi(const char* ssid, const char* password);
+    bool waitForWiFi(const char* ssid, const char* password, unsigned long timeout = FASTBOOT_WIFI_TIMEOUT);
+    bool usedCachedWiFi(void) const { return cachedWiFi; }
+
+    bool    initSensors(SensorDS18B20& sensors);
+    uint8_t deviceCount(void) const { return cacheValid ? cache.deviceCount : 0; }
+
+    bool          firstPublished(void);
+    unsigned long timeToFirstPublish(void) const { return firstPublishMillis; }
+
+private:
+    /**
+     * Cache content in RTC memory, a multiple of 4 bytes
+     */
+    struct Cache
+    {
+        uint32_t crc; // CRC-32 of all following bytes
+        uint32_t magic;
+        uint8_t  bssid[6];
+        uint8_t  channel;
+        uint8_t  deviceCount;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+        uint8_t  devices[FASTBOOT_MAX_DEVICES][8];
+    };
+
+    uint32_t checksum(void) const;
+    void     storeWiFi(void);
+
+    Cache         cache;
+    bool          persistent;         // FALSE keeps the cache in RAM, e.g. for tests
+    bool          cacheValid;
+    bool          cachedWiFi;         // association was started with cached data
+    unsigned long wifiStart;          // millis() of last WiFi.begin()
+    bool          published;          // first publish was taken
+    unsigned long firstPublishMillis; // milliseconds since reset until first publish
+};
+
+/**
+ * Unit test for FastBoot device cache and SensorDS18B20::restoreSensor() with a simulated bus
+ */
+class TestFastBoot
+{
+public:
+    virtual bool runTests();
+};
+
+#endif // FASTBOOT_H
@@ -0,0 +1,188 @@
+#include "FleetSimulator.h"
+#include "Logger.h"
+#include "MqttClient.h"
+#include "Profiler.h"
+#include <assert.h>
+#include <memory>
+#include <string.h>
+
+FleetSimulator::FleetSimulator(uint32_t seed) :
+    randomState(seed)
+{
+}
+
+/**
+ * Return next pseudo random number of 16 bits, reproducible by seed
+ */
+uint32_t FleetSimulator::nextRandom(void)
+{
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (randomState >> 16) & 0xFFFF;
+}
+
+/**
+ * Run given scenario
+ *
+ * @return aggregated results, recoveryTime is UINT32_MAX if not all nodes were connected again until the end
+ */
+FleetSimulator::Result FleetSimulator::run(const Scenario& scenario)
+{
+    Result result;
+    memset(&result, 0, sizeof(result));
+    result.recoveryTime = UINT32_MAX;
+
+    Node initial;
+    memset(&initial, 0, sizeof(initial));
+    nodes.assign(scenario.nodes, initial);
+    for (Node& node : nodes) {
+        node.nextLoop = scenario.synchronizedBoot ? 0 : nextRandom() % scenario.loopInterval;
+    }
+
+    std::unique_ptr<Profiler> latencies(new Profiler());
+    uint8_t                   broker    = latencies->addPhase("broker");
+    uint32_t                  capacity  = scenario.brokerRate * FLEET_TICK / 1000; // messages per tick
+    uint32_t                  backlog   = 0;                                         // messages queued by the broker
+    uint32_t                  connected = 0;
+    if (capacity == 0) {
+        capacity = 1;
+    }
+
+    for (uint32_t now = 0; now < scenario.duration; now += FLEET_TICK) {
+        bool brokerUp = now < scenario.outageStart || now >= scenario.outageEnd;
+        if (!brokerUp && connected > 0) {
+            for (Node& node : nodes) {
+                node.connected = false;
+            }
+            connected = 0;
+            backlog   = 0;
+        }
+
+        uint16_t tickConnects = 0;
+        uint16_t tickMessages = 0;
+        for (Node& node : nodes) {
+            if (node.nextLoop > now) {
+                continue;
+            }
+            node.nextLoop += scenario.loopInterval;
+
+            if (!node.connected) {
+                // loop() idles with jitter while disconnected, so the loops of the nodes drift apart
+                uint32_t idle = MqttClient::reconnectWait(scenario.loopInterval, nextRandom(), scenario.jitter);
+                if (node.wait > 0 && now - node.lastAttempt < node.wait) {
+                    node.nextLoop = now + idle;
+                    continue;
+                }
+                uint32_t latency = backlog * 1000 / scenario.brokerRate;
+                ++tickConnects;
+                ++backlog;
+                if (!brokerUp || latency > MQTT_TIMEOUT) {
+                    node.nextLoop = now + idle;
+                    ++result.connectFailures;
+                    node.lastAttempt = now;
+                    node.delay       = MqttClient::nextReconnectDelay(node.delay);
+                    node.wait        = MqttClient::reconnectWait(node.delay, nextRandom(), scenario.jitter);
+                    continue;
+                }
+                latencies->record(broker, latency * 1000);
+                node.connected = true;
+                node.delay     = 0;
+                node.wait      = 0;
+                ++result.connects;
+                if (++connected == nodes.size() && now >= scenario.outageEnd && result.recoveryTime == UINT32_MAX) {
+                    result.recoveryTime = now - scenario.outageEnd;
+                }
+            }
+
+            for (uint8_t i = 0; i < FLEET_MESSAGES_PER_LOOP; ++i) {
+                latencies->record(broker, backlog * 1000 / scenario.brokerRate * 1000);
+                ++backlog;
+            }
+            result.messages += FLEET_MESSAGES_PER_LOOP;
+            tickMessages += FLEET_MESSAGES_PER_LOOP;
+        }
+
+        backlog = (backlog > capacity) ? backlog - capacity : 0;
+        if (now >= scenario.outageEnd && tickConnects > result.peakReconnects) {
+            result.peakReconnects = tickConnects;
+        }
+        if (tickMessages > result.peakMessages) {
+            result.peakMessages = tickMessages;
+        }
+    }
+
+    const Profiler::PhaseStats* stats = latencies->phaseStats(broker);
+    result.messageRate = (uint32_t)((uint64_t)result.messages * 1000 / scenario.duration);
+    result.latencyP50  = latencies->percentile(broker, 50) / 1000;
+    result.latencyP99  = latencies->percentile(broker, 99) / 1000;
+    result.latencyMax  = stats->count > 0 ? stats->max / 1000 : 0;
+    return result;
+}
+
+/**
+ * Unit tests of the fleet model with a broker outage of 60 seconds
+ */
+bool TestFleetSimulator::runTests()
+{
+    FleetSimulator           simulator;
+    FleetSimulator::Scenario scenario;
+    scenario.nodes = 100;
+
+    // without outage all nodes stay connected and publish every loop
+    scenario.outageStart = scenario.outageEnd = scenario.duration;
+    FleetSimulator::Result steady = simulator.run(scenario);
+    assert(steady.connects == 100);
+    assert(steady.connectFailures == 0);
+    assert(steady.messages == 100 * FLEET_MESSAGES_PER_LOOP * (scenario.duration / scenario.loopInterval));
+
+    // a synchronized fleet retries in lockstep without jitter
+    scenario.outageStart = 30000;
+    scenario.outageEnd   = 90000;
+    scenario.jitter      = 0;
+    FleetSimulator::Result lockstep = simulator.run(scenario);
+    assert(lockstep.peakReconnects == 100);
+    assert(lockstep.recoveryTime != UINT32_MAX);
+
+    scenario.jitter                 = 50;
+    FleetSimulator::Result jittered = simulator.run(scenario);
+    assert(jittered.recoveryTime != UINT32_MAX);
+    assert(jittered.connects == 200);
+    assert(jittered.peakReconnects * 2 < lockstep.peakReconnects);
+
+    // a broker too slow for the burst delays the messages
+    scenario.brokerRate               = 100;
+    FleetSimulator::Result overloaded = simulator.run(scenario);
+    assert(overloaded.latencyMax > jittered.latencyMax);
+
+    return true;
+}
+
+/**
+ * Log results of a broker outage for 10 nodes up to maxNodes with and without reconnect jitter
+ */
+void TestFleetSimulator::runBenchmark(uint16_t maxNodes)
+{
+    FleetSimulator           simulator;
+    FleetSimulator::Scenario scenario;
+    const uint8_t            jitters[] = { 0, MQTT_RECONNECT_JITTER };
+
+    for (uint32_t nodes = 10; nodes <= maxNodes; nodes *= 10) {
+        profiler.sampleHeap();
+        uint32_t largestBlock = profiler.heapStats().largestBlock;
+        if (largestBlock > 0 && FleetSimulator::memoryUsage(nodes) > largestBlock) {
+            LOG_WARN(BENCH, "fleet %u nodes skipped - %u bytes heap needed", (unsigned int)nodes,
+                     (unsigned int)FleetSimulator::memoryUsage(nodes));
+            break;
+        }
+        for (uint8_t jitter : jitters) {
+            scenario.nodes  = nodes;
+            scenario.jitter = jitter;
+
+            FleetSimulator::Result result = simulator.run(scenario);
+            logger.flush();
+            LOG_INFO(BENCH, "fleet %u nodes, jitter %u%%: %u msg/s, peak %u conn/tick, recovery %ld ms, latency p50 %u p99 %u ms",
+                     (unsigned int)nodes, jitter, (unsigned int)result.messageRate, result.peakReconnects,
+                     result.recoveryTime == UINT32_MAX ? -1L : (long)result.recoveryTime,
+                     (unsigned int)result.latencyP50, (unsigned int)result.latencyP99);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef FLEETSIMULATOR_H
+#define FLEETSIMULATOR_H
+
+/**
+ * Model of a fleet of room sensor nodes sharing one MQTT broker
+ */
+
+#include "MqttClient.h"
+#include <Arduino.h>
+#include <stdint.h>
+#include <vector>
+
+#define FLEET_TICK 100            // milliseconds per simulation step and window of the peak values
+#define FLEET_MESSAGES_PER_LOOP 3 // temperature, heater temperature and humidity published per loop()
+
+/**
+ * Discrete time simulation of N nodes running the loop() cadence and reconnect policy of MqttClient against a
+ * broker with limited message rate
+ *
+ * Each node runs its loop every loopInterval milliseconds. A connected node publishes FLEET_MESSAGES_PER_LOOP
+ * messages, a disconnected node tries to connect, unless skipped by the reconnect backoff of
+ * MqttClient::nextReconnectDelay() and MqttClient::reconnectWait(), and idles for loopInterval with jitter. The broker accepts brokerRate messages per
+ * second, further messages are queued. The queueing time is the broker-side latency, a connect waiting longer
+ * than MQTT_TIMEOUT fails. During the outage all connections are lost and all connects fail.
+ *
+ * After a power failure all nodes boot at the same time (synchronizedBoot), so their loops and reconnect
+ * attempts start in lockstep - the case the reconnect jitter is made for.
+ */
+class FleetSimulator
+{
+public:
+    /**
+     * Simulation parameters - times in milliseconds
+     */
+    struct Scenario
+    {
+        Scenario() :
+            nodes(100),
+            duration(300000),
+            outageStart(30000),
+            outageEnd(90000),
+            loopInterval(10000),
+            brokerRate(2000),
+            jitter(MQTT_RECONNECT_JITTER),
+            synchronizedBoot(true)
+        {}
+
+        uint16_t nodes;
+        uint32_t duration;
+        uint32_t outageStart; // broker down from outageStart until outageEnd
+        uint32_t outageEnd;
+        uint32_t loopInterval;
+        uint32_t brokerRate;  // messages per second processed by the broker
+        uint8_t  jitter;      // percent, see MqttClient::reconnectWait()
+        bool     synchronizedBoot;
+    };
+
+    /**
+     * Aggregated results of one run
+     */
+    struct Result
+    {
+        uint32_t messages;         // messages published
+        uint32_t messageRate;      // messages per second over the whole run
+        uint32_t connects;         // successful connects including the first ones
+        uint32_t connectFailures;  // failed connect attempts
+        uint16_t peakReconnects;   // highest count of connect attempts within one FLEET_TICK after outage end
+        uint16_t peakMessages;     // highest count of messages within one FLEET_TICK
+        uint32_t recoveryTime;     // milliseconds from outage end until all nodes are connected again
+        uint32_t latencyP50;       // broker-side queueing latency in milliseconds
+        uint32_t latencyP99;
+        uint32_t latencyMax;
+    };
+
+    FleetSimulator(uint32_t seed = 1);
+
+    Result run(const Scenario& scenario);
+
+    static size_t memoryUsage(uint16_t nodes) { return nodes * sizeof(Node); }
+
+private:
+    /**
+     * State of one node, kept small for thousands of nodes
+     */
+    struct Node
+    {
+        uint32_t nextLoop;    // time of next loop() run
+        uint32_t lastAttempt; // time of last failed connect
+        uint32_t delay;       // current backoff
+        uint32_t wait;        // backoff with jitter, 0 if connected or never failed
+        bool     connected;
+    };
+
+    uint32_t nextRandom(void);
+
+    std::vector<Node> nodes;
+    uint32_t          randomState;
+};
+
+/**
+ * Unit test and benchmark for FleetSimulator
+ *
+ * The benchmark runs a broker outage with growing fleet size with and without reconnect jitter and logs the
+ * results. It needs 20 bytes of heap per node, fleet sizes not fitting into the largest free block are skipped.
+ */
+class TestFleetSimulator
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint16_t maxNodes = 1000);
+};
+
+#endif // FLEETSIMULATOR_H
@@ -0,0 +1,235 @@
+/**
+ * Leveled logging into a ring buffer, drained to Serial in idle time
+ */
+
+#include "Logger.h"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define LOG_LEVEL_MASK 0x0F
+#define LOG_FLAG_NO_SINK 0x80 // line was logged by the error sink itself
+#define LOG_ENTRY_HEADER 2    // level and length byte in front of each line
+
+Logger logger;
+
+/**
+ * Create logger writing drained lines to given serial port or discarding them, if nullptr
+ */
+Logger::Logger(HardwareSerial* output) :
+    output(output)
+{
+}
+
+/**
+ * Format given message as line "[tag] message" and queue it without blocking
+ */
+void Logger::log(uint8_t level, const char* tag, const char* format, ...)
+{
+    char line[LOG_LINE_LENGTH + 1];
+    int  length = snprintf(line, sizeof(line), "[%s] ", tag);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + length, sizeof(line) - length, format, args);
+    va_end(args);
+
+    // always terminate with exactly one newline, even for truncated lines
+    length = strlen(line);
+    if (length > 0 && line[length - 1] == '\n') {
+        --length;
+    }
+    if (length > LOG_LINE_LENGTH - 1) {
+        length = LOG_LINE_LENGTH - 1;
+    }
+    line[length++] = '\n';
+
+    if (fromSink()) {
+        level |= LOG_FLAG_NO_SINK;
+    }
+#if defined(ESP32)
+    portENTER_CRITICAL(&producerLock);
+#endif
+    if (pushLine(level, line, length)) {
+        ++loggedCount;
+    } else {
+        ++droppedCount;
+    }
+#if defined(ESP32)
+    portEXIT_CRITICAL(&producerLock);
+#endif
+}
+
+/**
+ * Copy line into ring buffer, if there is enough free space for the whole line
+ */
+bool Logger::pushLine(uint8_t level, const char* line, uint8_t length)
+{
+    uint16_t writePos = head.load(std::memory_order_relaxed);
+    size_t   free     = LOG_BUFFER_SIZE - 1 - queuedBytes();
+    if (free < (size_t)length + LOG_ENTRY_HEADER) {
+        return false;
+    }
+
+    ring[writePos] = level;
+    writePos       = (writePos + 1) % LOG_BUFFER_SIZE;
+    ring[writePos] = length;
+    writePos       = (writePos + 1) % LOG_BUFFER_SIZE;
+    for (uint8_t i = 0; i < length; ++i) {
+        ring[writePos] = line[i];
+        writePos       = (writePos + 1) % LOG_BUFFER_SIZE;
+    }
+
+    head.store(writePos, std::memory_order_release); // publish the line to the consumer
+    return true;
+}
+
+/**
+ * Return count of bytes currently queued in ring buffer
+ */
+size_t Logger::queuedBytes(void) const
+{
+    return (head.load(std::memory_order_acquire) + LOG_BUFFER_SIZE - tail.load(std::memory_order_acquire)) %
+           LOG_BUFFER_SIZE;
+}
+
+/**
+ * Return TRUE if the caller is the error sink, whose lines are not forwarded to the sink again - the sink runs in
+ * the consumer task, so lines of other tasks logged meanwhile are forwarded
+ */
+bool Logger::fromSink(void) const
+{
+    if (!sinkActive.load(std::memory_order_relaxed)) {
+        return false;
+    }
+#if defined(ESP32)
+    return consumerTask == nullptr || xTaskGetCurrentTaskHandle() == consumerTask;
+#else
+    return true;
+#endif
+}
+
+/**
+ * Write as many queued lines to serial port as fit into its TX FIFO without blocking
+ *
+ * @return count of bytes written
+ */
+size_t Logger::drain(void)
+{
+    size_t written = 0;
+#if defined(ESP32)
+    if (consumerTask != nullptr && xTaskGetCurrentTaskHandle() != consumerTask) {
+        return 0;
+    }
+#endif
+
+    for (;;) {
+        // read position of each line anew, the error sink may drain lines itself
+        uint16_t readPos = tail.load(std::memory_order_relaxed);
+        if (readPos == head.load(std::memory_order_acquire)) {
+            break;
+        }
+        uint8_t level  = ring[readPos];
+        uint8_t length = ring[(readPos + 1) % LOG_BUFFER_SIZE];
+
+        if (output != nullptr && output->availableForWrite() < length) {
+            break;
+        }
+
+        char line[LOG_LINE_LENGTH + 1];
+        readPos = (readPos + LOG_ENTRY_HEADER) % LOG_BUFFER_SIZE;
+        for (uint8_t i = 0; i < length; ++i) {
+            line[i] = ring[readPos];
+            readPos = (readPos + 1) % LOG_BUFFER_SIZE;
+        }
+
+        if (output != nullptr) {
+            output->write((const uint8_t*)line, length);
+        }
+        tail.store(readPos, std::memory_order_release); // free the space before calling the sink, which may log itself
+        written += length;
+
+        if ((level & LOG_LEVEL_MASK) == LOG_LEVEL_ERROR && !(level & LOG_FLAG_NO_SINK) && errorSink) {
+            line[length - 1] = '\0'; // strip newline
+            sinkActive.store(true, std::memory_order_relaxed);
+            errorSink(line);
+            sinkActive.store(false, std::memory_order_relaxed);
+        }
+    }
+    return written;
+}
+
+/**
+ * Write all queued lines to serial port, blocking until done - e.g. before a restart
+ */
+void Logger::flush(void)
+{
+    while (queuedBytes() > 0) {
+        drain();
+        yield();
+    }
+}
+
+/**
+ * Replacement for delay(): drain queued lines while waiting given time
+ */
+void Logger::idle(unsigned long milliseconds)
+{
+    unsigned long start = millis();
+    unsigned long elapsed;
+
+    while ((elapsed = millis() - start) < milliseconds) {
+        drain();
+        if (queuedBytes() == 0) {
+            delay(milliseconds - elapsed);
+            return;
+        }
+        delay(1);
+    }
+}
+
+/**
+ * Unit tests for ring buffer handling, overflow counters and error sink
+ */
+bool TestLogger::runTests()
+{
+    std::string forwarded;
+    testLogger.setErrorSink([&](const char* line) {
+        forwarded += line;
+        testLogger.log(LOG_LEVEL_ERROR, "test", "from sink"); // must not be forwarded again
+    });
+
+    assert(testLogger.queuedBytes() == 0);
+
+    testLogger.log(LOG_LEVEL_INFO, "test", "value %d", 42);
+    assert(testLogger.queuedBytes() == strlen("[test] value 42\n") + LOG_ENTRY_HEADER);
+    assert(testLogger.loggedLines() == 1);
+
+    testLogger.log(LOG_LEVEL_ERROR, "test", "failed\n");
+    size_t drained = testLogger.drain();
+    assert(drained == strlen("[test] value 42\n") + strlen("[test] failed\n") + strlen("[test] from sink\n"));
+    assert(forwarded == "[test] failed");
+    assert(testLogger.queuedBytes() == 0);
+
+    // overlong lines get truncated
+    std::string longText(2 * LOG_LINE_LENGTH, 'x');
+    testLogger.log(LOG_LEVEL_INFO, "test", "%s", longText.c_str());
+    assert(testLogger.queuedBytes() == LOG_LINE_LENGTH + LOG_ENTRY_HEADER);
+    drained = testLogger.drain();
+    assert(drained == LOG_LINE_LENGTH);
+
+    // overflow drops whole lines
+    uint32_t logged = testLogger.loggedLines();
+    for (int i = 0; i < LOG_BUFFER_SIZE; ++i) {
+        testLogger.log(LOG_LEVEL_DEBUG, "test", "overflow %d", i);
+    }
+    assert(testLogger.droppedLines() > 0);
+    assert(testLogger.loggedLines() + testLogger.droppedLines() == logged + LOG_BUFFER_SIZE);
+    assert(testLogger.queuedBytes() < LOG_BUFFER_SIZE);
+    testLogger.flush();
+    assert(testLogger.queuedBytes() == 0);
+
+    return true;
+}
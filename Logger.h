@@ -0,0 +1,159 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/**
+ * Leveled logging into a ring buffer, drained to Serial in idle time
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// per module log levels - override by compiler flags, e.g. -DLOG_LEVEL_MQTT=LOG_LEVEL_ERROR
+#ifndef LOG_LEVEL_MAIN
+#define LOG_LEVEL_MAIN LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_MQTT
+#define LOG_LEVEL_MQTT LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_DHT
+#define LOG_LEVEL_DHT LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_DS18B20
+#define LOG_LEVEL_DS18B20 LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_DISPLAY
+#define LOG_LEVEL_DISPLAY LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_FORMAT
+#define LOG_LEVEL_FORMAT LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_RULES
+#define LOG_LEVEL_RULES LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_BENCH
+#define LOG_LEVEL_BENCH LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_PROFILE
+#define LOG_LEVEL_PROFILE LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_CONFIG
+#define LOG_LEVEL_CONFIG LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_BOOT
+#define LOG_LEVEL_BOOT LOG_LEVEL_INFO
+#endif
+#ifndef LOG_LEVEL_HISTORY
+#define LOG_LEVEL_HISTORY LOG_LEVEL_INFO
+#endif
+
+// prefix of each log line per module
+#define LOG_TAG_MAIN "main"
+#define LOG_TAG_MQTT "mqtt"
+#define LOG_TAG_DHT "dht"
+#define LOG_TAG_DS18B20 "ds18b20"
+#define LOG_TAG_DISPLAY "display"
+#define LOG_TAG_FORMAT "format"
+#define LOG_TAG_RULES "rules"
+#define LOG_TAG_BENCH "bench"
+#define LOG_TAG_PROFILE "profile"
+#define LOG_TAG_CONFIG "config"
+#define LOG_TAG_BOOT "boot"
+#define LOG_TAG_HISTORY "history"
+
+#define LOG_BUFFER_SIZE 1024 // ring buffer size in bytes
+#define LOG_LINE_LENGTH 120  // max length of one log line, longer lines are truncated
+
+/**
+ * Log given printf style message, if level is enabled for module - disabled messages are removed by the compiler
+ */
+#define LOG_MESSAGE(module, level, format, ...)                                              \
+    do {                                                                                     \
+        if ((level) <= LOG_LEVEL_##module) {                                                 \
+            logger.log((level), LOG_TAG_##module, format, ##__VA_ARGS__);                    \
+        }                                                                                    \
+    } while (0)
+
+#define LOG_ERROR(module, format, ...) LOG_MESSAGE(module, LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define LOG_WARN(module, format, ...) LOG_MESSAGE(module, LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define LOG_INFO(module, format, ...) LOG_MESSAGE(module, LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_DEBUG(module, format, ...) LOG_MESSAGE(module, LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+
+/**
+ * Logger with lock-free single producer/single consumer ring buffer
+ *
+ * log() formats each line into the ring buffer and never blocks - lines not fitting are dropped and counted.
+ * drain() writes queued lines to Serial only as far as the UART TX FIFO has room, so it never blocks either,
+ * and should be called in idle time, e.g. by idle() instead of delay().
+ *
+ * An optional error sink receives each drained error line, e.g. to forward it to an MQTT log topic.
+ * Lines logged by the sink itself are not forwarded again to prevent endless loops - on ESP32 with a consumer task
+ * set, error lines of other tasks logged meanwhile are forwarded.
+ *
+ * On ESP32 several tasks may log: log() serializes the producers by a spinlock and, once a consumer task is set,
+ * drain() only writes lines and calls the error sink when called by that task. Like SpscQueue, the producer
+ * publishes a line by a release store of head and the consumer frees its space by a release store of tail.
+ */
+class Logger
+{
+public:
+    typedef std::function<void(const char* line)> SinkFunction;
+
+    Logger(HardwareSerial* output = &Serial);
+
+    void log(uint8_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+    size_t drain(void);
+    void   flush(void);
+    void   idle(unsigned long milliseconds);
+
+    void setErrorSink(SinkFunction sink) { errorSink = sink; }
+#if defined(ESP32)
+    void setConsumerTask(TaskHandle_t task) { consumerTask = task; }
+#endif
+
+    uint32_t loggedLines(void) const { return loggedCount; }
+    uint32_t droppedLines(void) const { return droppedCount; }
+    size_t   queuedBytes(void) const;
+
+protected:
+    bool pushLine(uint8_t level, const char* line, uint8_t length);
+    bool fromSink(void) const;
+
+private:
+    HardwareSerial*       output;               // target of drained lines or nullptr to discard them
+    char                  ring[LOG_BUFFER_SIZE];
+    std::atomic<uint16_t> head{0};              // write position, only changed by producer
+    std::atomic<uint16_t> tail{0};              // read position, only changed by consumer
+    uint32_t              loggedCount  = 0;     // count of lines queued
+    uint32_t              droppedCount = 0;     // count of lines dropped on full buffer
+    std::atomic<bool>     sinkActive{false};    // TRUE while error sink is running, read by producers
+    SinkFunction          errorSink;            // optional receiver of error lines
+#if defined(ESP32)
+    portMUX_TYPE producerLock = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t consumerTask = nullptr; // only task draining lines or nullptr for any
+#endif
+};
+
+extern Logger logger;
+
+/**
+ * Unit test for Logger class
+ */
+class TestLogger
+{
+public:
+    virtual bool runTests();
+
+private:
+    Logger testLogger{nullptr};
+};
+
+#endif // LOGGER_H
@@ -0,0 +1,442 @@
+/**
+ * HTTP endpoint serving sensor and node statistics in Prometheus text format
+ */
+
+#include "MetricsServer.h"
+#include "Logger.h"
+#include "NumberFormat.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define METRICS_LINE_SIZE 64        // request line bytes evaluated, longer lines are read in pieces
+#define METRICS_MAX_HEADER_LINES 32 // header lines read at most per request
+
+static const char notFoundResponse[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+/**
+ * Constructor of an empty page
+ */
+MetricsPage::MetricsPage()
+{
+    clear();
+}
+
+/**
+ * Remove all metrics, e.g. before writing a new layout
+ */
+void MetricsPage::clear(void)
+{
+    used     = 0;
+    count    = 0;
+    overflow = false;
+    updateHeader();
+}
+
+/**
+ * Write HELP and TYPE line of a metric family, followed by its metrics
+ *
+ * @param name - metric name, e.g. "room_sensor_temperature_celsius"
+ * @param type - "gauge" or "counter"
+ * @param help - description without line breaks
+ *
+ * @return FALSE if the page is full
+ */
+bool MetricsPage::addFamily(const char* name, const char* type, const char* help)
+{
+    bool written = append("# HELP ", 7) && append(name, strlen(name)) && append(" ", 1) && append(help, strlen(help)) &&
+                   append("\n# TYPE ", 8) && append(name, strlen(name)) && append(" ", 1) &&
+                   append(type, strlen(type)) && append("\n", 1);
+    updateHeader();
+    return written;
+}
+
+/**
+ * Write metric line with an optional label and an empty value slot
+ *
+ * @param name       - metric name of the current family
+ * @param label      - label name or nullptr
+ * @param labelValue - label value, escaped as needed
+ *
+ * @return value slot for set() or METRICS_NONE, if the page is full
+ */
+int16_t MetricsPage::addMetric(const char* name, const char* label, const char* labelValue)
+{
+    uint16_t start = used;
+    bool     written = (count < METRICS_MAX_VALUES) && append(name, strlen(name));
+    if (written && label) {
+        written = append("{", 1) && append(label, strlen(label)) && append("=\"", 2) && appendEscaped(labelValue) &&
+                  append("\"}", 2);
+    }
+    written = written && append(" ", 1) && used + METRICS_VALUE_WIDTH + 1 <= METRICS_PAGE_SIZE;
+    if (!written) {
+        // keep the page valid without the partial line
+        used     = start;
+        overflow = true;
+        updateHeader();
+        return METRICS_NONE;
+    }
+
+    values[count] = used;
+    used += METRICS_VALUE_WIDTH;
+    append("\n", 1);
+    int16_t slot = count++;
+    writeSlot(slot, "NaN", 3);
+    updateHeader();
+    return slot;
+}
+
+/**
+ * Set value of given slot rounded to given decimals, NAN is written as NaN
+ */
+void MetricsPage::set(int16_t slot, float value, uint8_t decimals)
+{
+    char text[NUMBER_FORMAT_BUFFER_SIZE];
+    int  length = isnan(value) ? -1 : formatDecimal(text, sizeof(text), value, decimals);
+    if (length < 0) {
+        writeSlot(slot, "NaN", 3);
+    } else {
+        writeSlot(slot, text, length);
+    }
+}
+
+/**
+ * Set integer value of given slot, e.g. of a counter
+ */
+void MetricsPage::set(int16_t slot, uint32_t value)
+{
+    char  digits[10];
+    char* pos = digits + sizeof(digits);
+    do {
+        *--pos = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    writeSlot(slot, pos, digits + sizeof(digits) - pos);
+}
+
+/**
+ * Append given text to the page, if it fits
+ */
+bool MetricsPage::append(const char* text, size_t length)
+{
+    if (used + length > METRICS_PAGE_SIZE) {
+        overflow = true;
+        return false;
+    }
+    memcpy(buffer + METRICS_HEADER_SIZE + used, text, length);
+    used += length;
+    return true;
+}
+
+/**
+ * Append label value with backslash, double quote and line feed escaped as the text format requires
+ */
+bool MetricsPage::appendEscaped(const char* text)
+{
+    for (const char* pos = text ? text : ""; *pos; ++pos) {
+        bool written;
+        if (*pos == '\\' || *pos == '"') {
+            char escaped[2] = {'\\', *pos};
+            written         = append(escaped, 2);
+        } else if (*pos == '\n') {
+            written = append("\\n", 2);
+        } else {
+            written = append(pos, 1);
+        }
+        if (!written) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Write given value right-aligned into its slot, values wider than the slot as NaN
+ */
+void MetricsPage::writeSlot(int16_t slot, const char* value, size_t length)
+{
+    if (slot < 0 || slot >= count) {
+        return;
+    }
+    if (length > METRICS_VALUE_WIDTH) {
+        value  = "NaN";
+        length = 3;
+    }
+    char* field = buffer + METRICS_HEADER_SIZE + values[slot];
+    memset(field, ' ', METRICS_VALUE_WIDTH - length);
+    memcpy(field + METRICS_VALUE_WIDTH - length, value, length);
+}
+
+/**
+ * Write HTTP header with current text length right in front of the text
+ */
+void MetricsPage::updateHeader(void)
+{
+    char text[METRICS_HEADER_SIZE];
+    int  length = snprintf(text, sizeof(text),
+                          "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\n"
+                          "Connection: close\r\n\r\n",
+                          (unsigned int)used);
+    header = METRICS_HEADER_SIZE - length;
+    memcpy(buffer + header, text, length);
+}
+
+/**
+ * Constructor of a server for given page on given TCP port - listens after begin()
+ */
+MetricsServer::MetricsServer(const MetricsPage& page, uint16_t port) :
+    page(page),
+    server(port)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * Start listening, e.g. once WiFi is connected
+ */
+void MetricsServer::begin(void)
+{
+    server.begin();
+    server.setNoDelay(true);
+}
+
+/**
+ * Milliseconds left until given millis() time, 0 if it passed
+ */
+static unsigned long timeLeft(unsigned long deadline)
+{
+    long left = (long)(deadline - millis());
+    return left > 0 ? (unsigned long)left : 0;
+}
+
+/**
+ * Answer pending connections, at most METRICS_MAX_CLIENTS within METRICS_REQUEST_TIMEOUT for all of them
+ *
+ * Connections left when the time is used up, e.g. by a stalled client, are answered by the next call.
+ *
+ * @return count of connections answered
+ */
+uint8_t MetricsServer::handle(void)
+{
+    unsigned long deadline = millis() + METRICS_REQUEST_TIMEOUT;
+    uint8_t       served   = 0;
+    while (served < METRICS_MAX_CLIENTS && timeLeft(deadline) > 0) {
+        WiFiClient client = server.available();
+        if (!client) {
+            break;
+        }
+        respond(client, timeLeft(deadline));
+        client.stop();
+        ++served;
+    }
+    return served;
+}
+
+/**
+ * Read one HTTP request from given client within given milliseconds and write the response
+ *
+ * "GET /metrics" and "GET /" get the page, other requests 404. Header fields still missing at the timeout are not
+ * waited for. The response is written in one piece, the connection is left open for the caller.
+ *
+ * @return TRUE if the page was sent
+ */
+bool MetricsServer::respond(Stream& client, unsigned long timeout)
+{
+    unsigned long deadline = millis() + timeout;
+    char          line[METRICS_LINE_SIZE];
+    client.setTimeout(timeout);
+    size_t read = client.readBytesUntil('\n', line, sizeof(line) - 1);
+    if (read == 0) {
+        ++stats.timeouts;
+        return false;
+    }
+    line[read] = '\0';
+
+    // skip the header fields up to the empty line
+    char    field[METRICS_LINE_SIZE];
+    uint8_t lines = 0;
+    while (lines++ < METRICS_MAX_HEADER_LINES && timeLeft(deadline) > 0) {
+        client.setTimeout(timeLeft(deadline));
+        if (client.readBytesUntil('\n', field, sizeof(field)) <= 1) {
+            break;
+        }
+    }
+
+    bool found = false;
+    if (strncmp(line, "GET /", 5) == 0) {
+        // path up to blank, query or line end
+        const char* path   = line + 4;
+        size_t      length = strcspn(path, " ?\r");
+        found              = (length == 1) || (length == 8 && strncmp(path, "/metrics", 8) == 0);
+    }
+    if (!found) {
+        ++stats.notFound;
+        client.write((const uint8_t*)notFoundResponse, sizeof(notFoundResponse) - 1);
+        return false;
+    }
+
+    ++stats.requests;
+    client.write((const uint8_t*)page.response(), page.responseLength());
+    return true;
+}
+
+/**
+ * In-memory client for the tests and the benchmark: reads a given request, counts and keeps the response
+ */
+class MemoryStream : public Stream
+{
+public:
+    MemoryStream(const char* request) :
+        request(request),
+        position(0),
+        written(0)
+    {
+        response[0] = '\0';
+    }
+
+    virtual int available() { return strlen(request + position); }
+    virtual int read() { return request[position] ? (uint8_t)request[position++] : -1; }
+    virtual int peek() { return request[position] ? (uint8_t)request[position] : -1; }
+
+    virtual size_t write(uint8_t value) { return write(&value, 1); }
+    virtual size_t write(const uint8_t* data, size_t length)
+    {
+        size_t kept = written < sizeof(response) - 1 ? sizeof(response) - 1 - written : 0;
+        memcpy(response + written, data, length < kept ? length : kept);
+        written += length;
+        response[written < sizeof(response) - 1 ? written : sizeof(response) - 1] = '\0';
+        return length;
+    }
+
+    const char* request;
+    size_t      position;
+    size_t      written;
+    char        response[512];
+};
+
+/**
+ * Unit tests for page layout, fixed-width updates, escaping, overflow and request handling
+ */
+bool TestMetricsServer::runTests()
+{
+    MetricsPage page;
+    assert(page.textLength() == 0 && page.size() == 0);
+    assert(strncmp(page.response(), "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+    assert(page.addFamily("room_sensor_temperature_celsius", "gauge", "Temperature"));
+    int16_t dht   = page.addMetric("room_sensor_temperature_celsius", "sensor", "dht22");
+    int16_t probe = page.addMetric("room_sensor_temperature_celsius", "probe", "a\"b\\c");
+    assert(page.addFamily("room_sensor_mqtt_published_total", "counter", "Messages"));
+    int16_t published = page.addMetric("room_sensor_mqtt_published_total");
+    assert(dht == 0 && probe == 1 && published == 2 && page.size() == 3);
+
+    const char* expected = "# HELP room_sensor_temperature_celsius Temperature\n"
+                           "# TYPE room_sensor_temperature_celsius gauge\n"
+                           "room_sensor_temperature_celsius{sensor=\"dht22\"}          NaN\n"
+                           "room_sensor_temperature_celsius{probe=\"a\\\"b\\\\c\"}          NaN\n"
+                           "# HELP room_sensor_mqtt_published_total Messages\n"
+                           "# TYPE room_sensor_mqtt_published_total counter\n"
+                           "room_sensor_mqtt_published_total          NaN\n";
+    assert(page.textLength() == strlen(expected) && strncmp(page.text(), expected, page.textLength()) == 0);
+
+    // values are updated in place, the length stays the same
+    size_t length = page.responseLength();
+    page.set(dht, 21.456f);
+    page.set(probe, -5.0f, 1);
+    page.set(published, (uint32_t)4294967295UL);
+    assert(page.responseLength() == length);
+    assert(strstr(page.text(), "{sensor=\"dht22\"}        21.46\n"));
+    assert(strstr(page.text(), "c\"}         -5.0\n"));
+    assert(strstr(page.text(), "published_total   4294967295\n"));
+    page.set(dht, (float)NAN);
+    page.set(probe, 1e9f, 2); // too wide for the slot
+    page.set(METRICS_NONE, 1.0f);
+    page.set(7, (uint32_t)1);
+    assert(strstr(page.text(), "{sensor=\"dht22\"}          NaN\n"));
+    assert(strstr(page.text(), "c\"}          NaN\n"));
+    assert(page.textLength() == strlen(expected));
+
+    char contentLength[32];
+    snprintf(contentLength, sizeof(contentLength), "Content-Length: %u\r\n", (unsigned int)page.textLength());
+    assert(strstr(page.response(), contentLength) && strstr(page.response(), "\r\n\r\n# HELP"));
+
+    // full page: no partial lines
+    MetricsPage full;
+    int16_t     slot = 0;
+    while (slot != METRICS_NONE) {
+        slot = full.addMetric("room_sensor_metric_with_a_long_name", "label", "with a long value as well");
+    }
+    assert(full.overflowed() && full.size() <= METRICS_MAX_VALUES);
+    assert(full.text()[full.textLength() - 1] == '\n');
+    full.clear();
+    assert(!full.overflowed() && full.textLength() == 0);
+
+    // requests
+    MetricsServer server(page, 9100);
+    MemoryStream  metrics("GET /metrics HTTP/1.1\r\nHost: node\r\nAccept: */*\r\n\r\n");
+    assert(server.respond(metrics));
+    assert(metrics.written == page.responseLength() && strncmp(metrics.response, page.response(), 100) == 0);
+
+    MemoryStream root("GET / HTTP/1.0\r\n\r\n");
+    MemoryStream query("GET /metrics?name[]=x HTTP/1.1\r\n\r\n");
+    assert(server.respond(root) && server.respond(query));
+
+    MemoryStream other("GET /metricsfoo HTTP/1.1\r\n\r\n");
+    MemoryStream post("POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    assert(!server.respond(other) && !server.respond(post));
+    assert(strncmp(other.response, "HTTP/1.1 404", 12) == 0);
+
+    MemoryStream empty("");
+    assert(!server.respond(empty) && empty.written == 0);
+
+    const MetricsServer::Statistics& stats = server.statistics();
+    assert(stats.requests == 3 && stats.notFound == 2 && stats.timeouts == 1);
+    return true;
+}
+
+/**
+ * Log time to update the values of a page like the sketch's one and request rate of the response path
+ *
+ * The requests are read from and answered to memory, so the rate is the upper bound given by this code - on the
+ * device the TCP connection setup of lwIP dominates.
+ */
+void TestMetricsServer::runBenchmark(uint32_t requests)
+{
+    static MetricsPage page;
+    char               probe[16];
+    page.clear();
+    page.addFamily("room_sensor_temperature_celsius", "gauge", "Temperature of each sensor");
+    for (uint8_t i = 0; i < 32; ++i) {
+        snprintf(probe, sizeof(probe), "sensor%u", (unsigned int)i);
+        page.addMetric("room_sensor_temperature_celsius", "probe", probe);
+    }
+    page.addFamily("room_sensor_mqtt_published_total", "counter", "Messages published");
+    while (page.addMetric("room_sensor_mqtt_published_total", "instance", "node") != METRICS_NONE) {
+    }
+
+    const uint32_t updates = requests * 10;
+    unsigned long  start   = micros();
+    for (uint32_t i = 0; i < updates; ++i) {
+        int16_t slot = i % page.size();
+        if (slot < 32) {
+            page.set(slot, (float)(i % 4000) * 0.01f - 5.0f);
+        } else {
+            page.set(slot, i);
+        }
+    }
+    unsigned long updateTime = micros() - start;
+    LOG_INFO(BENCH, "metrics update: %lu ns/value (%u values, %u slots)",
+             (unsigned long)((uint64_t)updateTime * 1000 / updates), (unsigned int)updates, (unsigned int)page.size());
+
+    MetricsServer server(page, 9100);
+    start = micros();
+    for (uint32_t i = 0; i < requests; ++i) {
+        MemoryStream client("GET /metrics HTTP/1.1\r\nHost: node:9100\r\nUser-Agent: Prometheus/2.0\r\n\r\n");
+        server.respond(client);
+    }
+    unsigned long requestTime = micros() - start;
+    LOG_INFO(BENCH, "metrics request: %lu us/op (%u ops), %lu requests/s, %u bytes",
+             (unsigned long)(requestTime / requests), (unsigned int)requests,
+             (unsigned long)(requestTime > 0 ? (uint64_t)requests * 1000000 / requestTime : 0),
+             (unsigned int)page.responseLength());
+}
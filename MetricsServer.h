@@ -0,0 +1,113 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+/**
+ * HTTP endpoint serving sensor and node statistics in Prometheus text format
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP32)
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+
+#ifndef METRICS_PAGE_SIZE
+#define METRICS_PAGE_SIZE 5120 // bytes of the metrics text without HTTP header, enough for 16 DS18B20 sensors
+#endif
+#define METRICS_HEADER_SIZE 128     // bytes reserved for the HTTP header in front of the metrics text
+#define METRICS_MAX_VALUES 64       // max value slots of a page
+#define METRICS_VALUE_WIDTH 12      // characters of each value slot, values are right-aligned
+#define METRICS_REQUEST_TIMEOUT 200 // milliseconds to wait for the request headers of one handle() call
+#define METRICS_MAX_CLIENTS 4       // max requests served per handle() call
+#define METRICS_NONE -1             // no value slot, e.g. of a full page - ignored by set()
+
+/**
+ * Prometheus text page with fixed-width value slots, prebuilt together with its HTTP response header
+ *
+ * The layout of metric families, names and labels is written once by addFamily() and addMetric(), e.g. after each
+ * configuration change. Each metric line ends with a slot of METRICS_VALUE_WIDTH characters, which set() overwrites
+ * in place, so updating a value formats one number and serving the page copies the buffer as is - no string building
+ * per request and no heap allocation. Values not set yet and values too wide for their slot are written as NaN.
+ */
+class MetricsPage
+{
+public:
+    MetricsPage();
+
+    void    clear(void);
+    bool    addFamily(const char* name, const char* type, const char* help);
+    int16_t addMetric(const char* name, const char* label = nullptr, const char* labelValue = nullptr);
+
+    void set(int16_t slot, float value, uint8_t decimals = 2);
+    void set(int16_t slot, uint32_t value);
+
+    const char* response(void) const { return buffer + header; }
+    size_t      responseLength(void) const { return METRICS_HEADER_SIZE - header + used; }
+    const char* text(void) const { return buffer + METRICS_HEADER_SIZE; }
+    size_t      textLength(void) const { return used; }
+    uint8_t     size(void) const { return count; }
+    bool        overflowed(void) const { return overflow; }
+
+private:
+    bool append(const char* text, size_t length);
+    bool appendEscaped(const char* text);
+    void writeSlot(int16_t slot, const char* value, size_t length);
+    void updateHeader(void);
+
+    char     buffer[METRICS_HEADER_SIZE + METRICS_PAGE_SIZE];
+    uint16_t header;                     // offset of the HTTP header, which ends right in front of the text
+    uint16_t used;                       // length of the text
+    uint16_t values[METRICS_MAX_VALUES]; // offsets of the value slots within the text
+    uint8_t  count;                      // used value slots
+    bool     overflow;                   // something did not fit since clear()
+};
+
+/**
+ * Minimal HTTP server answering "GET /metrics" with the prebuilt response of a MetricsPage
+ *
+ * handle() is called from the idle parts of loop(). Each connection gets one response and is closed; other paths
+ * get 404. The request headers of all connections served by one handle() call are read within
+ * METRICS_REQUEST_TIMEOUT, so stalled clients delay loop() by at most this time per call.
+ */
+class MetricsServer
+{
+public:
+    /**
+     * Counters of the server since start
+     */
+    struct Statistics
+    {
+        uint32_t requests; // requests answered with the metrics page
+        uint32_t notFound; // requests of other paths or methods
+        uint32_t timeouts; // connections without complete request line
+    };
+
+    MetricsServer(const MetricsPage& page, uint16_t port);
+
+    void    begin(void);
+    uint8_t handle(void);
+    bool    respond(Stream& client, unsigned long timeout = METRICS_REQUEST_TIMEOUT);
+
+    const Statistics& statistics(void) const { return stats; }
+
+private:
+    const MetricsPage& page;
+    WiFiServer         server;
+    Statistics         stats;
+};
+
+/**
+ * Unit test and benchmark for MetricsPage and MetricsServer classes
+ */
+class TestMetricsServer
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint32_t requests = 1000);
+};
+
+#endif // METRICSSERVER_H
@@ -1,7 +1,18 @@
 #include "MqttClient.h"
+#include "Logger.h"
+#include "NumberFormat.h"
+#include "Profiler.h"
 #include <Adafruit_MQTT.h>
 #include <Adafruit_MQTT_Client.h>
+#if defined(ESP32)
+#include <WiFi.h>
+#else
 #include <ESP8266WiFi.h>
+#endif
+#include <assert.h>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
 
 /**
  * Replace all occurrences of given searchStr with replaceText and return the new string
@@ -18,12 +29,119 @@ std::string stringReplaceAll(const std::string& text, const std::string searchSt
     return data;
 }
 
+/**
+ * Read the next packet and return TRUE if it is a PUBLISH packet
+ *
+ * Packets longer than MAXBUFFERSIZE are read completely, but their payload is truncated. QoS 1 messages are
+ * acknowledged. Subscriptions are made with QoS 0, so QoS 2 messages, which need the PUBREC/PUBREL/PUBCOMP flow, are
+ * not sent by the broker and not acknowledged.
+ *
+ * @param topic     buffer for the topic the message was published to
+ * @param payload   buffer for the message, terminated and truncated to payloadSize - 1
+ * @param timeout   milliseconds to wait for each part of the packet
+ * @param truncated set to TRUE if the payload did not fit into payloadSize - 1 or MAXBUFFERSIZE
+ */
+bool RawMqttClient::readMessage(char* topic, size_t topicSize, char* payload, size_t payloadSize, int16_t timeout,
+                                bool& truncated)
+{
+    // fixed header: packet type and flags, remaining length in 1 to 4 bytes of 7 bits
+    if (readPacket(buffer, 1, timeout) != 1) {
+        return false;
+    }
+    uint32_t remaining = 0;
+    uint16_t length    = 1;
+    do {
+        if (length > 4 || readPacket(buffer + length, 1, timeout) != 1) {
+            return false;
+        }
+        remaining |= (uint32_t)(buffer[length] & 0x7F) << (7 * (length - 1));
+    } while (buffer[length++] & 0x80);
+
+    uint16_t size = (remaining < (uint32_t)(MAXBUFFERSIZE - length)) ? remaining : MAXBUFFERSIZE - length;
+    if (readPacket(buffer + length, size, timeout) != size) {
+        return false;
+    }
+    // the skip loop below reuses the buffer, so keep the QoS of the fixed header
+    uint8_t  qos      = (buffer[0] >> 1) & 0x03;
+    uint16_t packetId = 0;
+    bool message = parsePublish(buffer, length + size, topic, topicSize, payload, payloadSize, packetId, truncated);
+    truncated |= (size < remaining);
+
+    // skip the rest of oversized packets to stay in sync with the stream
+    for (remaining -= size; remaining > 0;) {
+        uint16_t chunk = (remaining < MAXBUFFERSIZE) ? remaining : MAXBUFFERSIZE;
+        if (readPacket(buffer, chunk, timeout) != chunk) {
+            return false;
+        }
+        remaining -= chunk;
+    }
+
+    if (message && qos == MQTT_QOS_1) {
+        uint8_t ack[4] = {MQTT_CTRL_PUBACK << 4, 2, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+        sendPacket(ack, sizeof(ack));
+    }
+    return message;
+}
+
+/**
+ * Split given PUBLISH packet into topic and payload
+ *
+ * @param packet    packet including fixed header, may be truncated within the payload
+ * @param length    bytes of packet
+ * @param packetId  set to the packet identifier of QoS 1 and 2 messages, otherwise 0
+ * @param truncated set to TRUE if the payload was cut to payloadSize - 1
+ * @return FALSE for other packet types, malformed packets and topics not fitting into topicSize
+ */
+bool RawMqttClient::parsePublish(const uint8_t* packet, uint16_t length, char* topic, size_t topicSize, char* payload,
+                                 size_t payloadSize, uint16_t& packetId, bool& truncated)
+{
+    truncated = false;
+    if (length < 2 || (packet[0] >> 4) != MQTT_CTRL_PUBLISH) {
+        return false;
+    }
+    uint16_t position = 1;
+    while (position < length && position < 4 && (packet[position] & 0x80)) {
+        ++position;
+    }
+    ++position;
+    if (position + 2 > length) {
+        return false;
+    }
+    uint16_t topicLength = (packet[position] << 8) | packet[position + 1];
+    position += 2;
+    if (position + topicLength > length || topicLength >= topicSize) {
+        return false;
+    }
+    memcpy(topic, packet + position, topicLength);
+    topic[topicLength] = '\0';
+    position += topicLength;
+
+    packetId = 0;
+    if ((packet[0] >> 1) & 0x03) {
+        if (position + 2 > length) {
+            return false;
+        }
+        packetId = (packet[position] << 8) | packet[position + 1];
+        position += 2;
+    }
+
+    size_t payloadLength = length - position;
+    if (payloadLength >= payloadSize) {
+        payloadLength = payloadSize - 1;
+        truncated     = true;
+    }
+    memcpy(payload, packet + position, payloadLength);
+    payload[payloadLength] = '\0';
+    return true;
+}
+
 /**
  * Constructor to prepare connection to MQTT Broker
  */
 MqttClient::MqttClient(WiFiClient* client, const char* serverHost, int serverPort, const char* userName, const char* password) :
-    mqttClient(new Adafruit_MQTT_Client(client, serverHost, serverPort, userName, password))
+    mqttClient(client, serverHost, serverPort, userName, password)
 {
+    memset(&stats, 0, sizeof(stats));
 }
 
 /**
@@ -31,46 +149,107 @@ MqttClient::MqttClient(WiFiClient* client, const char* serverHost, int serverPor
  */
 bool MqttClient::connected()
 {
-    return mqttClient->connected();
+    return mqttClient.connected();
 }
 
 /**
  * Connect and reconnect as necessary to the MQTT server.
  * Should be called in the loop function and it will take care if connecting.
+ *
+ * After a failed connect further attempts are skipped for an exponentially growing delay up to
+ * MQTT_MAX_RECONNECT_DELAY, so publish() and waitForMessages() fail fast while the broker is down.
+ * MQTT_RECONNECT_JITTER percent of each delay are randomized, see reconnectWait().
+ *
+ * The retry loop drains the log, so the error sink may publish and call connect() again: nested calls fail at once
+ * instead of starting their own retry loop.
  */
 bool MqttClient::connect(void)
 {
-    if (mqttClient->connected()) // Stop if already connected.
+    if (mqttClient.connected()) // Stop if already connected.
         return true;
+    if (connecting) {
+        return false;
+    }
 
-    Serial.print("[mqtt] connecting to MQTT server... ");
+    if (wasConnected) {
+        wasConnected = false;
+        ++stats.connectionLosses;
+        LOG_WARN(MQTT, "connection to MQTT server lost");
+    }
+    if (reconnectWaitTime > 0 && millis() - lastConnectAttempt < reconnectWaitTime) {
+        ++stats.skippedReconnects;
+        return false;
+    }
+
+    LOG_INFO(MQTT, "connecting to MQTT server...");
 
     int8_t  ret;
     uint8_t retries = MQTT_RECONNECT_RETRIES;
-    while ((ret = mqttClient->connect()) != 0) // connect will return 0 for connected
+    connecting      = true;
+    while ((ret = mqttClient.connect()) != 0) // connect will return 0 for connected
     {
-        Serial.println(mqttClient->connectErrorString(ret));
-        Serial.println("[mqtt] retrying client connection...");
-        mqttClient->disconnect();
+        LOG_WARN(MQTT, "client connection failed: %s", mqttClient.connectErrorString(ret));
+        mqttClient.disconnect();
         if (--retries == 0) {
             break;
         }
-        delay(MQTT_TIMEOUT);
+        LOG_INFO(MQTT, "retrying client connection...");
+        logger.idle(MQTT_TIMEOUT);
     }
+    connecting  = false;
     bool online = connected();
-    Serial.println(online ? "[mqtt] client connected successfully" : "[mqtt] client connection failed!");
+    if (online) {
+        ++stats.connects;
+        wasConnected      = true;
+        reconnectDelay    = 0;
+        reconnectWaitTime = 0;
+        LOG_INFO(MQTT, "client connected successfully");
+    } else {
+        ++stats.connectFailures;
+        lastConnectAttempt = millis();
+        reconnectDelay     = nextReconnectDelay(reconnectDelay);
+        reconnectWaitTime  = reconnectWait(reconnectDelay, (uint32_t)random(0x7FFFFFFF));
+        LOG_ERROR(MQTT, "client connection failed! next attempt in %lu ms", reconnectWaitTime);
+    }
     return online;
 }
 
+/**
+ * Return the reconnect backoff following given delay: MQTT_TIMEOUT after the first failure, then doubled up to
+ * MQTT_MAX_RECONNECT_DELAY
+ */
+unsigned long MqttClient::nextReconnectDelay(unsigned long delay)
+{
+    delay = (delay == 0) ? MQTT_TIMEOUT : delay * 2;
+    return (delay > MQTT_MAX_RECONNECT_DELAY) ? MQTT_MAX_RECONNECT_DELAY : delay;
+}
+
+/**
+ * Return milliseconds to wait for given reconnect delay with jitter
+ *
+ * Nodes losing the broker at the same time would otherwise retry at the same times until it is back and then
+ * connect all at once. The wait is spread uniformly between delay - jitter % and delay.
+ *
+ * @param delay     backoff delay in milliseconds
+ * @param random    random number, e.g. from random()
+ * @param jitter    percent of delay to randomize, 0 for none
+ */
+unsigned long MqttClient::reconnectWait(unsigned long delay, uint32_t random, uint8_t jitter)
+{
+    unsigned long spread = delay * jitter / 100;
+    return delay - spread + (spread > 0 ? random % (spread + 1) : 0);
+}
+
 /**
  * Disconnect from the MQTT server.
  */
 bool MqttClient::disconnect(void)
 {
-    if (!mqttClient->connected()) {
+    wasConnected = false;
+    if (!mqttClient.connected()) {
         return true;
     }
-    return mqttClient->disconnect();
+    return mqttClient.disconnect();
 }
 
 /**
@@ -81,21 +260,23 @@ bool MqttClient::disconnect(void)
  * 
  * @return false when topic already exists and on any error
  */
-bool MqttClient::createPublishTopic(const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType)
+bool MqttClient::createPublishTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType)
 {
-    return createMqttTopic(publishTopics, topicName, mqttPath, topicType, false);
+    return createMqttTopic(topicName, mqttPath, topicType, false);
 }
 
 /**
  * Removes given publish topic
  */
-bool MqttClient::removePublishTopic(const std::string& topicName)
+bool MqttClient::removePublishTopic(const char* topicName)
 {
-    if (publishTopics.find(topicName) == publishTopics.end()) {
-        Serial.printf("[mqtt] error: removePublishTopic failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    MqttTopicData* data = findPublishTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "removePublishTopic failed for topic '%s' - given topic name is unknown!", topicName);
         return false;
     }
-    publishTopics.erase(topicName);
+    publishHandlers.destroy(data->publishHandler);
+    publishTopics.destroy(data);
     return true;
 }
 
@@ -107,46 +288,132 @@ bool MqttClient::removePublishTopic(const std::string& topicName)
  * 
  * @return false when topic already exists and on any error
  */
-bool MqttClient::createSubscribeTopic(const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType)
+bool MqttClient::createSubscribeTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType)
 {
-    return createMqttTopic(subscribeTopics, topicName, mqttPath, topicType, true);
+    return createMqttTopic(topicName, mqttPath, topicType, true);
 }
 
 /**
  * Removes given subscription topic
  */
-bool MqttClient::removeSubscribeTopic(const std::string& topicName)
+bool MqttClient::removeSubscribeTopic(const char* topicName)
 {
-    if (publishTopics.find(topicName) == publishTopics.end()) {
-        Serial.printf("[mqtt] error: removePublishTopic failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    MqttTopicData* data = findSubscribeTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "removeSubscribeTopic failed for topic '%s' - given topic name is unknown!", topicName);
         return false;
     }
-    if (mqttClient && publishTopics.at(topicName).subscribeHandler) {
-        mqttClient->unsubscribe(publishTopics.at(topicName).subscribeHandler.get());
+    if (data->subscribeHandler) {
+        mqttClient.unsubscribe(data->subscribeHandler);
+        subscribeHandlers.destroy(data->subscribeHandler);
     }
-    subscribeTopics.erase(topicName);
+    subscribeTopics.destroy(data);
+    updateSubscriptions();
     return true;
 }
 
+/**
+ * Subscribe at the broker to all wildcard topics and all topics not covered by one, unsubscribe the others and
+ * rebuild the trie to dispatch incoming messages
+ *
+ * Subscriptions of covered topics are released first, then wildcard topics are subscribed before the others,
+ * so the MQTT_MAX_SUBSCRIPTIONS handlers are used by wildcard topics first.
+ *
+ * @param topic    topic to report about, nullptr for all topics
+ * @return FALSE if given topic - or any topic, if none is given - would not receive messages, because there are too
+ *         many subscriptions or topic levels
+ */
+bool MqttClient::updateSubscriptions(const MqttTopicData* topic)
+{
+    for (size_t i = 0; i < subscribeTopics.capacity(); ++i) {
+        MqttTopicData* data = subscribeTopics.at(i);
+        if (data && data->subscribeHandler && !TopicTrie::isWildcard(data->pathName) && coveredByWildcard(*data, false)) {
+            mqttClient.unsubscribe(data->subscribeHandler);
+            subscribeHandlers.destroy(data->subscribeHandler);
+            data->subscribeHandler = nullptr;
+        }
+    }
+
+    bool complete = true;
+    for (uint8_t pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < subscribeTopics.capacity(); ++i) {
+            MqttTopicData* data = subscribeTopics.at(i);
+            if (!data || data->subscribeHandler || TopicTrie::isWildcard(data->pathName) != (pass == 0) ||
+                (pass == 1 && coveredByWildcard(*data, true))) {
+                continue;
+            }
+            data->subscribeHandler = subscribeHandlers.create(&mqttClient, data->pathName);
+            if (!data->subscribeHandler || !mqttClient.subscribe(data->subscribeHandler)) {
+                LOG_ERROR(MQTT, "subscribe failed for topic '%s' - too many subscriptions!", data->topicName);
+                subscribeHandlers.destroy(data->subscribeHandler);
+                data->subscribeHandler = nullptr;
+                complete &= (topic != nullptr && topic != data);
+            }
+        }
+    }
+
+    subscribeTrie.clear();
+    for (size_t i = 0; i < subscribeTopics.capacity(); ++i) {
+        MqttTopicData* data = subscribeTopics.at(i);
+        if (data && !subscribeTrie.insert(data->pathName, i)) {
+            LOG_ERROR(MQTT, "dispatch failed for topic '%s' - MQTT path already used or too many levels!", data->topicName);
+            complete &= (topic != nullptr && topic != data);
+        }
+    }
+    return complete;
+}
+
+/**
+ * Return TRUE if messages of given topic are received by a wildcard subscription
+ *
+ * @param subscribed only count wildcard topics subscribed at the broker
+ */
+bool MqttClient::coveredByWildcard(const MqttTopicData& data, bool subscribed)
+{
+    return subscribeTopics.find([&data, subscribed](const MqttTopicData& topic) {
+        return &topic != &data && (topic.subscribeHandler || !subscribed) && TopicTrie::isWildcard(topic.pathName) &&
+               TopicTrie::matches(topic.pathName, data.pathName);
+    }) != nullptr;
+}
+
+/**
+ * Return publish topic of given short name or nullptr
+ */
+MqttClient::MqttTopicData* MqttClient::findPublishTopic(const char* topicName)
+{
+    return publishTopics.find([topicName](const MqttTopicData& data) { return strcmp(data.topicName, topicName) == 0; });
+}
+
+/**
+ * Return subscribe topic of given short name or nullptr
+ */
+MqttClient::MqttTopicData* MqttClient::findSubscribeTopic(const char* topicName)
+{
+    return subscribeTopics.find([topicName](const MqttTopicData& data) { return strcmp(data.topicName, topicName) == 0; });
+}
+
 /**
  * Register given MQTT topic (the MQTT publish path name) with given short name
  *
- * @param topicList - target list of publish or subscribe topics to store results
  * @param topicName - string with short name for given MQTT publish topic
  * @param mqttPath  - string with full MQTT publish topic name in format "maintopic/topic/subtopic"
  * @param subscribe - toggles between publish and subscribe topics
  * 
- * @return false when topic already exists and on any error
+ * @return false when topic already exists, a pool is exhausted and on any error
  */
-bool MqttClient::createMqttTopic(std::map<std::string, MqttTopicData>& topicList, const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType, bool subscribe)
+bool MqttClient::createMqttTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType, bool subscribe)
 {
-    std::string mode = subscribe ? "subscribe" : "publish";
-    if (topicList.find(topicName) != topicList.end() || topicName.length() < 1) {
-        Serial.printf("[mqtt] error: create %s topic failed for topic '%s' - given topic name is already registered!\n", mode.c_str(), topicName.c_str());
+    const char* mode = subscribe ? "subscribe" : "publish";
+    if (topicName[0] == '\0' || (subscribe ? findSubscribeTopic(topicName) : findPublishTopic(topicName))) {
+        LOG_ERROR(MQTT, "create %s topic failed for topic '%s' - given topic name is already registered!", mode, topicName);
+        return false;
+    }
+    if (strlen(topicName) >= MQTT_TOPIC_NAME_LENGTH) {
+        LOG_ERROR(MQTT, "create %s topic failed for topic '%s' - topic name too long!", mode, topicName);
         return false;
     }
 
-    std::string prefix;
+    const char* prefix;
 
     switch (topicType) {
     case SENSOR:
@@ -155,143 +422,566 @@ bool MqttClient::createMqttTopic(std::map<std::string, MqttTopicData>& topicList
     case SWITCH:
         prefix = "/switch/";
         break;
+    case COMMAND:
+        prefix = "/command/";
+        break;
+    case STATUS:
+        prefix = "/status/";
+        break;
     default:
-        Serial.printf("[mqtt] error: invalid MqttTopicType given to create %s topic for topic '%s'!", mode.c_str(), topicName.c_str());
+        LOG_ERROR(MQTT, "invalid MqttTopicType given to create %s topic for topic '%s'!", mode, topicName);
         return false;
     }
 
-    MqttTopicData data;
-    data.topicName = topicName;
-    data.pathName  = stringReplaceAll(std::string("/" + prefix + "/" + mqttPath), "//", "/");
-    data.topicType = topicType;
+    // build path in place and collapse double slashes, same as stringReplaceAll(path, "//", "/")
+    char path[MQTT_PATH_LENGTH];
+    int  length = snprintf(path, sizeof(path), "/%s/%s", prefix, mqttPath);
+    if (length < 0 || length >= (int)sizeof(path)) {
+        LOG_ERROR(MQTT, "create %s topic failed for topic '%s' - MQTT path too long!", mode, topicName);
+        return false;
+    }
+    char* out = path;
+    for (const char* in = path; *in; ++in) {
+        if (!(in[0] == '/' && in[1] == '/')) {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+
+    MqttTopicData* data = subscribe ? subscribeTopics.create() : publishTopics.create();
+    if (!data) {
+        LOG_ERROR(MQTT, "create %s topic failed for topic '%s' - too many topics!", mode, topicName);
+        return false;
+    }
+    strcpy(data->topicName, topicName);
+    strcpy(data->pathName, path);
+    data->topicType = topicType;
     if (subscribe) {
-        data.subscribeHandler = std::shared_ptr<Adafruit_MQTT_Subscribe>(new Adafruit_MQTT_Subscribe(mqttClient.get(), data.pathName.c_str()));
-        mqttClient->subscribe(data.subscribeHandler.get());
+        // topics without subscription since an earlier change do not fail this one
+        if (!updateSubscriptions(data)) {
+            LOG_ERROR(MQTT, "create %s topic failed for topic '%s' - too many subscriptions!", mode, topicName);
+            if (data->subscribeHandler) {
+                mqttClient.unsubscribe(data->subscribeHandler);
+                subscribeHandlers.destroy(data->subscribeHandler);
+            }
+            subscribeTopics.destroy(data);
+            updateSubscriptions();
+            return false;
+        }
     } else {
-        data.publishHandler = std::shared_ptr<Adafruit_MQTT_Publish>(new Adafruit_MQTT_Publish(mqttClient.get(), data.pathName.c_str()));
+        data->publishHandler = publishHandlers.create(&mqttClient, data->pathName);
     }
 
-    topicList[topicName] = data;
-
-    Serial.printf("[mqtt] created %s topic '%s' with MQTT path '%s'\n", mode.c_str(), data.topicName.c_str(), data.pathName.c_str());
+    LOG_INFO(MQTT, "created %s topic '%s' with MQTT path '%s'", mode, data->topicName, data->pathName);
+    return true;
 }
 
 /**
- * Assign the given callback function to the given topic, so it gets called on each publish() call
+ * Assign the given callback function to the given topic, so it gets called with given context on each incoming message
  * 
  * There is only one callback per topic possible. Any existing callback will be removed before setting the new one.
  */
-bool MqttClient::addNotifyCallback(const std::string& topicName, NotifyCallbackFunction callback)
+bool MqttClient::addNotifyCallback(const char* topicName, NotifyCallbackFunction callback, void* context)
 {
-    if (subscribeTopics.find(topicName) == subscribeTopics.end()) {
-        Serial.printf("[mqtt] error: addNotifyCallback failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    MqttTopicData* data = findSubscribeTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "addNotifyCallback failed for topic '%s' - given topic name is unknown!", topicName);
         return false;
     }
-    subscribeTopics.at(topicName).notifyCallback = callback;
+    data->notifyCallback = callback;
+    data->notifyContext  = context;
     return true;
 }
 
 /**
  * Remove the callback function of givem topic
  */
-bool MqttClient::removeNotifyCallback(const std::string& topicName)
+bool MqttClient::removeNotifyCallback(const char* topicName)
 {
-    if (subscribeTopics.find(topicName) == subscribeTopics.end()) {
-        Serial.printf("[mqtt] error: removeNotifyCallback failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    MqttTopicData* data = findSubscribeTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "removeNotifyCallback failed for topic '%s' - given topic name is unknown!", topicName);
         return false;
     }
-    subscribeTopics.at(topicName).notifyCallback = nullptr;
+    data->notifyCallback = nullptr;
+    data->notifyContext  = nullptr;
     return true;
 }
 
 /**
  * Return notify callback function for given topic or nullptr, if missing or on errors
  */
-MqttClient::NotifyCallbackFunction MqttClient::notifyCallback(const std::string& topicName)
+MqttClient::NotifyCallbackFunction MqttClient::notifyCallback(const char* topicName)
 {
-    if (subscribeTopics.find(topicName) == subscribeTopics.end()) {
-        Serial.printf("[mqtt] error: notifyCallback failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    MqttTopicData* data = findSubscribeTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "notifyCallback failed for topic '%s' - given topic name is unknown!", topicName);
         return nullptr;
     }
-    if (!subscribeTopics.at(topicName).notifyCallback) {
-        Serial.printf("[mqtt] error: notifyCallback failed for topic '%s' - invalid callback function!\n", topicName.c_str());
+    if (!data->notifyCallback) {
+        LOG_ERROR(MQTT, "notifyCallback failed for topic '%s' - invalid callback function!", topicName);
         return nullptr;
     }
-    return subscribeTopics.at(topicName).notifyCallback;
+    return data->notifyCallback;
 }
 
 /**
  * Publish given message using the short name for the topic (not the full MQTT publish topic path name)
  */
-bool MqttClient::publish(const std::string& topicName, const std::string& message)
+bool MqttClient::publish(const char* topicName, const char* message)
 {
-    if (!connect()) {
-        Serial.printf("[mqtt] error: publish failed for topic '%s' - connection failed!\n", topicName.c_str());
+    MqttTopicData* data = findPublishTopic(topicName);
+    if (!data) {
+        LOG_ERROR(MQTT, "publish failed for topic '%s' - given topic name is unknown!", topicName);
         return false;
     }
-    if (publishTopics.find(topicName) == publishTopics.end()) {
-        Serial.printf("[mqtt] error: publish failed for topic '%s' - given topic name is unknown!\n", topicName.c_str());
+    if (!data->publishHandler) {
+        LOG_ERROR(MQTT, "publish failed for topic '%s' - invalid publish handler object!", topicName);
         return false;
     }
-    if (!publishTopics.at(topicName).publishHandler) {
-        Serial.printf("[mqtt] error: publish failed for topic '%s' - invalid publish handler object!\n", topicName.c_str());
+    if (!connect()) {
+        ++stats.publishFailures;
+        LOG_ERROR(MQTT, "publish failed for topic '%s' - connection failed!", topicName);
         return false;
     }
-    if (!publishTopics.at(topicName).publishHandler->publish(message.c_str())) {
-        Serial.printf("[mqtt] error: publish failed for topic '%s' - error on sending message '%s'\n", topicName.c_str(), message.c_str());
+
+    unsigned long start = micros();
+    if (!data->publishHandler->publish(message)) {
+        ++stats.publishFailures;
+        LOG_ERROR(MQTT, "publish failed for topic '%s' - error on sending message '%s'", topicName, message);
         return false;
     }
+    uint32_t duration = micros() - start;
+
+    ++stats.published;
+    stats.publishMicrosSum += duration;
+    if (duration > stats.publishMicrosMax) {
+        stats.publishMicrosMax = duration;
+    }
     return true;
 }
 
+/**
+ * Publish given sensor value formatted as decimal number with given count of decimals
+ */
+bool MqttClient::publish(const char* topicName, float value, uint8_t decimals)
+{
+    char message[NUMBER_FORMAT_BUFFER_SIZE];
+    if (formatDecimal(message, sizeof(message), value, decimals) < 0) {
+        LOG_ERROR(MQTT, "publish failed for topic '%s' - value can not be formatted!", topicName);
+        return false;
+    }
+    return publish(topicName, message);
+}
+
 /**
  * Wait for incoming messages and check if they are for subscribed topics 
  * 
+ * After the first message all further messages of a burst are dispatched as long as they arrive
+ * within MQTT_BURST_TIMEOUT. Messages longer than SUBSCRIPTIONDATALEN - 1 are dropped and counted, a cut value
+ * would be applied as a different one.
+ *
  * @param timeout  - polling timeout in milliseconds
  * @return  true for received messages, false for wait without incoming packets
  */
 bool MqttClient::waitForMessages(int timeout)
 {
     if (!connect()) {
-        Serial.printf("[mqtt] error: wait for messages failed - client not connected!\n");
+        LOG_ERROR(MQTT, "wait for messages failed - client not connected!");
         return false;
     }
 
-    Adafruit_MQTT_Subscribe* subscription;
-    while ((subscription = mqttClient->readSubscription(timeout))) {
-        Serial.printf("[mqtt] received incoming messages\n");
+    bool dispatched = false;
+    bool truncated  = false;
+    char topic[MQTT_PATH_LENGTH];
+    char message[SUBSCRIPTIONDATALEN];
+    while (mqttClient.readMessage(topic, sizeof(topic), message, sizeof(message),
+                                  dispatched ? MQTT_BURST_TIMEOUT : timeout, truncated)) {
+        LOG_DEBUG(MQTT, "received message for MQTT path %s", topic);
+        ++stats.received;
+        if (truncated) {
+            ++stats.truncated;
+            LOG_WARN(MQTT, "message for MQTT path %s longer than %d bytes dropped", topic, SUBSCRIPTIONDATALEN - 1);
+            continue;
+        }
+        dispatched |= dispatchMessage(topic, message);
+    }
+    return dispatched;
+}
 
-        for (auto& pair : subscribeTopics) {
-            if (pair.second.subscribeHandler == nullptr) {
-                break;
-            }
-            std::shared_ptr<Adafruit_MQTT_Subscribe> handler = pair.second.subscribeHandler;
-            if (handler.get() == subscription) {
-                Serial.printf("[mqtt] received message for topic %s\n", pair.first.c_str());
-                incomingMessageCallback(pair.second, (const char*)handler->lastread);
-                return true;
-            }
+/**
+ * Notify all subscribe topics matching the MQTT path of given message
+ *
+ * @return FALSE if no subscribe topic matches
+ */
+bool MqttClient::dispatchMessage(const char* topic, const char* message)
+{
+    uint16_t matches[MQTT_MAX_MATCHES];
+    uint8_t  count = subscribeTrie.match(topic, matches, MQTT_MAX_MATCHES);
+    for (uint8_t i = 0; i < count; ++i) {
+        MqttTopicData* data = subscribeTopics.at(matches[i]);
+        if (data) {
+            incomingMessageCallback(*data, topic, message);
         }
     }
-    return false;
+    if (count == 0) {
+        return false;
+    }
+    ++stats.dispatched;
+    return true;
 }
 
 /**
  * Handle incoming MQTT messages
  */
-void MqttClient::incomingMessageCallback(MqttTopicData& data, const char* lastRead)
+void MqttClient::incomingMessageCallback(MqttTopicData& data, const char* topic, const char* lastRead)
 {
-    bool enabledState = (std::string(lastRead) == "true");
+    bool enabledState = (strcmp(lastRead, "true") == 0);
 
-    Serial.printf("[mqtt] message for topic '%s' arrived: '%s'\n", data.topicName.c_str(), lastRead);
+    LOG_INFO(MQTT, "message for topic '%s' arrived: '%s'", data.topicName, lastRead);
 
     if (data.publishHandler) {
-        std::string newMsg = std::string(enabledState ? "true" : "false");
-        data.publishHandler->publish(newMsg.c_str()); // send answer
+        data.publishHandler->publish(enabledState ? "true" : "false"); // send answer
     }
 
     if (data.notifyCallback) {
-        Serial.printf("[mqtt] calling notity function for topic '%s'\n", data.topicName.c_str());
-        data.notifyCallback(data.topicName, lastRead);
+        LOG_DEBUG(MQTT, "calling notify function for topic '%s'", data.topicName);
+        data.notifyCallback(TopicTrie::isWildcard(data.pathName) ? topic : data.topicName, lastRead, data.notifyContext);
+    }
+}
+
+/**
+ * Notify callback of the tests: remember the topic and count the calls in the TestNotification given as context
+ */
+struct TestNotification
+{
+    const char* topic;
+    int         calls;
+};
+
+static bool testNotify(const char* topic, const char*, void* context)
+{
+    TestNotification* notification = static_cast<TestNotification*>(context);
+    notification->topic            = topic;
+    ++notification->calls;
+    return true;
+}
+
+#if !defined(ESP8266) && !defined(ESP32)
+/**
+ * Host only: client reading from a prepared byte stream and recording the packets written to it
+ */
+class ScriptedClient : public Client
+{
+public:
+    ScriptedClient(const uint8_t* input, size_t inputLength) :
+        input(input),
+        inputLength(inputLength)
+    {}
+
+    virtual int     connect(const char*, uint16_t) { return 1; }
+    virtual uint8_t connected(void) { return 1; }
+    virtual void    stop(void) {}
+    virtual int     available(void) { return inputLength - position; }
+    virtual int     read(void) { return position < inputLength ? input[position++] : -1; }
+    virtual int     peek(void) { return position < inputLength ? input[position] : -1; }
+    virtual int     read(uint8_t* buffer, size_t size)
+    {
+        size_t length = (size < inputLength - position) ? size : inputLength - position;
+        memcpy(buffer, input + position, length);
+        position += length;
+        return length;
+    }
+    virtual size_t write(uint8_t value) { return write(&value, 1); }
+    virtual size_t write(const uint8_t* data, size_t length)
+    {
+        size_t fitting = (length < sizeof(output) - outputLength) ? length : sizeof(output) - outputLength;
+        memcpy(output + outputLength, data, fitting);
+        outputLength += fitting;
+        return length;
+    }
+
+    uint8_t output[16];
+    size_t  outputLength = 0;
+
+private:
+    const uint8_t* input;
+    size_t         inputLength;
+    size_t         position = 0;
+};
+#endif
+
+/**
+ * Unit tests for topic handling - no broker connection needed
+ */
+bool TestMqttClient::runTests()
+{
+    assert(stringReplaceAll("//sensor///room//", "//", "/") == "/sensor/room/");
+    assert(stringReplaceAll("/sensor/room", "//", "/") == "/sensor/room");
+
+    bool result = client.createPublishTopic("", "/test", MqttClient::STATUS);
+    assert(!result);
+    result = client.createPublishTopic("test***", "/test", MqttClient::UNKNOWN);
+    assert(!result);
+    result = client.createPublishTopic("test***", "/test", MqttClient::STATUS);
+    assert(result);
+    result = client.createPublishTopic("test***", "/test", MqttClient::STATUS);
+    assert(!result);
+    result = client.removePublishTopic("test***");
+    assert(result);
+    result = client.removePublishTopic("test***");
+    assert(!result);
+    result = client.publish("test***", "message");
+    assert(!result);
+
+    TestNotification single = {nullptr, 0};
+    result                  = client.createSubscribeTopic("test***", "/test/set", MqttClient::SWITCH);
+    assert(result);
+    result = client.addNotifyCallback("test***", &testNotify, &single);
+    assert(result);
+    MqttClient::NotifyCallbackFunction callback = client.notifyCallback("test***");
+    assert(callback == &testNotify);
+    result = client.removeNotifyCallback("test***");
+    assert(result);
+    result = client.removeSubscribeTopic("test***");
+    assert(result);
+    result = client.removeSubscribeTopic("test***");
+    assert(!result);
+    result = client.addNotifyCallback("test***", nullptr);
+    assert(!result);
+
+    // topics covered by a wildcard topic need no own subscription, so there may be more than MAXSUBSCRIPTIONS
+    char             name[MQTT_TOPIC_NAME_LENGTH];
+    char             path[MQTT_PATH_LENGTH];
+    TestNotification wildcard = {nullptr, 0};
+    result                    = client.createSubscribeTopic("test+", "+/set", MqttClient::SWITCH);
+    assert(result);
+    for (int i = 0; i <= MAXSUBSCRIPTIONS; ++i) {
+        snprintf(name, sizeof(name), "test%d", i);
+        snprintf(path, sizeof(path), "test%d/set", i);
+        result = client.createSubscribeTopic(name, path, MqttClient::SWITCH);
+        assert(result);
+        result = client.addNotifyCallback(name, &testNotify, &single);
+        assert(result);
     }
-}
\ No newline at end of file
+    result = client.addNotifyCallback("test+", &testNotify, &wildcard);
+    assert(result);
+    bool dispatched = client.dispatchMessage("/switch/test1/set", "true");
+    assert(dispatched && single.calls == 1 && strcmp(single.topic, "test1") == 0);
+    assert(wildcard.calls == 1 && strcmp(wildcard.topic, "/switch/test1/set") == 0);
+    dispatched = client.dispatchMessage("/switch/test1", "true");
+    assert(!dispatched && single.calls == 1 && wildcard.calls == 1);
+    result = client.removeSubscribeTopic("test+");
+    assert(result);
+    for (int i = 0; i <= MAXSUBSCRIPTIONS; ++i) {
+        snprintf(name, sizeof(name), "test%d", i);
+        result = client.removeSubscribeTopic(name);
+        assert(result);
+    }
+
+    // removing a wildcard topic leaves more covered topics than subscriptions - creating another topic fails only if
+    // the new topic itself gets no subscription
+    TestNotification command = {nullptr, 0};
+    result                   = client.createSubscribeTopic("test+", "+/set", MqttClient::SWITCH);
+    assert(result);
+    result = client.createSubscribeTopic("testcmd+", "testcmd/+", MqttClient::COMMAND);
+    assert(result);
+    for (int i = 0; i <= MAXSUBSCRIPTIONS; ++i) {
+        snprintf(name, sizeof(name), "test%d", i);
+        snprintf(path, sizeof(path), "test%d/set", i);
+        result = client.createSubscribeTopic(name, path, MqttClient::SWITCH);
+        assert(result);
+    }
+    result = client.removeSubscribeTopic("test+");
+    assert(result);
+    result = client.createSubscribeTopic("testcmd", "testcmd/rules", MqttClient::COMMAND);
+    assert(result);
+    result = client.addNotifyCallback("testcmd", &testNotify, &command);
+    assert(result);
+    dispatched = client.dispatchMessage("/command/testcmd/rules", "R0=T0<20");
+    assert(dispatched && command.calls == 1 && strcmp(command.topic, "testcmd") == 0);
+    result = client.createSubscribeTopic("testextra", "testextra/state", MqttClient::SWITCH);
+    assert(!result);
+    result = client.removeSubscribeTopic("testcmd") && client.removeSubscribeTopic("testcmd+");
+    assert(result);
+    for (int i = 0; i <= MAXSUBSCRIPTIONS; ++i) {
+        snprintf(name, sizeof(name), "test%d", i);
+        result = client.removeSubscribeTopic(name);
+        assert(result);
+    }
+
+    // raw PUBLISH packets: QoS 0, QoS 1 with packet identifier, truncated payload, other packet types
+    const uint8_t publish[] = {0x30, 9, 0, 5, 'a', '/', 'b', '/', 'c', 'o', 'n'};
+    const uint8_t qos1[]    = {0x32, 10, 0, 3, 'a', '/', 'b', 0x12, 0x34, 'o', 'f', 'f'};
+    const uint8_t ping[]    = {0xD0, 0};
+    char          topic[8];
+    char          payload[4];
+    uint16_t      packetId;
+    bool          truncated;
+    bool parsed = RawMqttClient::parsePublish(publish, 11, topic, sizeof(topic), payload, sizeof(payload), packetId,
+                                              truncated);
+    assert(parsed && strcmp(topic, "a/b/c") == 0 && strcmp(payload, "on") == 0 && packetId == 0 && !truncated);
+    parsed = RawMqttClient::parsePublish(qos1, 12, topic, sizeof(topic), payload, sizeof(payload), packetId, truncated);
+    assert(parsed && strcmp(topic, "a/b") == 0 && strcmp(payload, "off") == 0 && packetId == 0x1234 && !truncated);
+    parsed = RawMqttClient::parsePublish(qos1, 12, topic, sizeof(topic), payload, 3, packetId, truncated);
+    assert(parsed && strcmp(payload, "of") == 0 && truncated);
+    parsed = RawMqttClient::parsePublish(publish, 11, topic, 5, payload, sizeof(payload), packetId, truncated);
+    assert(!parsed);
+    parsed = RawMqttClient::parsePublish(publish, 6, topic, sizeof(topic), payload, sizeof(payload), packetId,
+                                         truncated);
+    assert(!parsed);
+    parsed = RawMqttClient::parsePublish(ping, 2, topic, sizeof(topic), payload, sizeof(payload), packetId, truncated);
+    assert(!parsed);
+
+    assert(MqttClient::nextReconnectDelay(0) == MQTT_TIMEOUT);
+    assert(MqttClient::nextReconnectDelay(MQTT_MAX_RECONNECT_DELAY - 1) == MQTT_MAX_RECONNECT_DELAY);
+    assert(MqttClient::reconnectWait(1000, 12345, 0) == 1000);
+    assert(MqttClient::reconnectWait(1000, 0, 50) == 500);
+    assert(MqttClient::reconnectWait(1000, 500, 50) == 1000);
+    assert(MqttClient::reconnectWait(1000, 501, 50) == 500);
+
+#if !defined(ESP8266) && !defined(ESP32)
+    // oversized PUBLISH packets: the payload skipped behind MAXBUFFERSIZE must not be taken for the fixed header -
+    // payload bytes 0x02 look like QoS 1 flags, only the QoS 1 packet 0x1234 is acknowledged and the small packet
+    // after both is read in sync
+    const uint16_t oversized = 200;
+    const uint8_t  header[]  = {0x30, 0xCD, 0x01, 0, 3, 'a', '/', 'b'}; // remaining length 205 = 2 + 3 + 200
+    uint8_t        stream[2 * (sizeof(header) + 2 + oversized) + sizeof(publish)];
+    size_t         streamLength = 0;
+    memcpy(stream, header, sizeof(header));
+    memset(stream + sizeof(header), 0x02, oversized);
+    streamLength += sizeof(header) + oversized;
+    memcpy(stream + streamLength, header, sizeof(header));
+    stream[streamLength] = 0x32;
+    stream[streamLength + 1] += 2; // packet identifier
+    streamLength += sizeof(header);
+    stream[streamLength++] = 0x12;
+    stream[streamLength++] = 0x34;
+    memset(stream + streamLength, 0x00, oversized);
+    streamLength += oversized;
+    memcpy(stream + streamLength, publish, sizeof(publish));
+    streamLength += sizeof(publish);
+
+    ScriptedClient scripted(stream, streamLength);
+    RawMqttClient  raw(&scripted, "127.0.0.1", 1883, "", "");
+    bool read = raw.readMessage(topic, sizeof(topic), payload, sizeof(payload), 100, truncated);
+    assert(read && strcmp(topic, "a/b") == 0 && truncated && scripted.outputLength == 0);
+    read = raw.readMessage(topic, sizeof(topic), payload, sizeof(payload), 100, truncated);
+    assert(read && strcmp(topic, "a/b") == 0 && truncated && scripted.outputLength == 4);
+    assert(scripted.output[0] == (MQTT_CTRL_PUBACK << 4) && scripted.output[1] == 2);
+    assert(scripted.output[2] == 0x12 && scripted.output[3] == 0x34);
+    read = raw.readMessage(topic, sizeof(topic), payload, sizeof(payload), 100, truncated);
+    assert(read && strcmp(topic, "a/b/c") == 0 && strcmp(payload, "on") == 0 && !truncated);
+    assert(scripted.outputLength == 4 && scripted.available() == 0);
+
+    // the error sink publishing while connect() drains the log in its retry loop must not nest connects - the host
+    // refuses loopback connects to port 1 at once
+    WiFiClient refusedClient;
+    MqttClient refused(&refusedClient, "127.0.0.1", 1, "", "");
+    int        sinkCalls    = 0;
+    bool       nestedOnline = true;
+    logger.flush(); // errors of the tests above
+    logger.setErrorSink([&](const char*) {
+        ++sinkCalls;
+        nestedOnline = refused.connect();
+    });
+    LOG_ERROR(MQTT, "test error forwarded while connecting");
+    bool online = refused.connect();
+    logger.setErrorSink(nullptr);
+    assert(!online && sinkCalls == 1 && !nestedOnline);
+    assert(refused.statistics().connectFailures == 1);
+#endif
+
+    return true;
+}
+
+/**
+ * Round trips of the load test, context of loadTestNotify()
+ */
+struct LoadTestState
+{
+    Profiler* latencies;
+    uint8_t   roundTrip; // profiler phase
+    int       received;
+    int       malformed; // messages without the "<index>:<micros>" format
+};
+
+static bool loadTestNotify(const char*, const char* message, void* context)
+{
+    LoadTestState* state     = static_cast<LoadTestState*>(context);
+    const char*    separator = strchr(message, ':');
+    if (separator == nullptr) {
+        ++state->malformed;
+        return true;
+    }
+    unsigned long sent = strtoul(separator + 1, nullptr, 10);
+    state->latencies->record(state->roundTrip, micros() - sent);
+    ++state->received;
+    return true;
+}
+
+/**
+ * Publish given count of messages to a topic subscribed by the client itself and log throughput and
+ * round-trip latency percentiles
+ *
+ * @return FALSE if the broker is not reachable or not all messages were received within timeout milliseconds
+ */
+bool TestMqttClient::runLoadTest(int messages, int timeout)
+{
+    const char* topic = "loadtest";
+
+    if (!client.createPublishTopic(topic, "/loadtest/echo", MqttClient::STATUS) ||
+        !client.createSubscribeTopic(topic, "/loadtest/echo", MqttClient::STATUS)) {
+        LOG_WARN(MQTT, "load test skipped - no free publish or subscribe topic");
+        client.removePublishTopic(topic);
+        return false;
+    }
+
+    // subscriptions are sent to the broker on connect
+    client.disconnect();
+    if (!client.connect()) {
+        LOG_WARN(MQTT, "load test skipped - MQTT client not connected");
+        client.removeSubscribeTopic(topic);
+        client.removePublishTopic(topic);
+        return false;
+    }
+
+    std::unique_ptr<Profiler> latencies(new Profiler());
+    LoadTestState             state     = {latencies.get(), latencies->addPhase("round trip"), 0, 0};
+    uint8_t                   roundTrip = state.roundTrip;
+    const int&                received  = state.received;
+    const int&                malformed = state.malformed;
+
+    client.addNotifyCallback(topic, &loadTestNotify, &state);
+
+    MqttClient::Statistics before = client.statistics();
+    unsigned long          start  = micros();
+
+    for (int i = 0; i < messages; ++i) {
+        char message[SUBSCRIPTIONDATALEN];
+        snprintf(message, sizeof(message), "%d:%lu", i, micros());
+        client.publish(topic, message);
+    }
+    unsigned long publishTime = micros() - start;
+
+    unsigned long waitStart = millis();
+    while (received < messages && millis() - waitStart < (unsigned long)timeout) {
+        client.waitForMessages(100);
+    }
+    unsigned long elapsed = micros() - start;
+
+    const MqttClient::Statistics& after     = client.statistics();
+    uint32_t                      published = after.published - before.published;
+
+    LOG_INFO(BENCH, "load test: %d of %d messages received in %lu ms - %lu msg/s, %d malformed", received, messages,
+             elapsed / 1000, elapsed > 0 ? (unsigned long)((uint64_t)received * 1000000 / elapsed) : 0, malformed);
+    LOG_INFO(BENCH, "load test: %u published in %lu ms, avg publish %lu us", (unsigned int)published, publishTime / 1000,
+             published > 0 ? (unsigned long)((after.publishMicrosSum - before.publishMicrosSum) / published) : 0);
+    LOG_INFO(BENCH, "load test round trip: p50<=%u p90<=%u p99<=%u max=%u us", (unsigned int)latencies->percentile(roundTrip, 50),
+             (unsigned int)latencies->percentile(roundTrip, 90), (unsigned int)latencies->percentile(roundTrip, 99),
+             latencies->phaseStats(roundTrip) ? (unsigned int)latencies->phaseStats(roundTrip)->max : 0);
+
+    client.removeSubscribeTopic(topic);
+    client.removePublishTopic(topic);
+    return received == messages;
+}
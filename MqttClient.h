@@ -2,21 +2,60 @@
 #define MQTTCLIENT_H
 
 class WiFiClient;
-class Adafruit_MQTT_Publish;
-class Adafruit_MQTT_Subscribe;
-class Adafruit_MQTT_Client;
 
 // WLAN + MQTT settings
 #include "secrets.h"
 
+#include "StaticPool.h"
+#include "TopicTrie.h"
+#include <Adafruit_MQTT.h>
+#include <Adafruit_MQTT_Client.h>
 #include <Arduino.h>
-#include <functional>
-#include <map>
-#include <memory>
 #include <string>
 
+#ifndef MQTT_MAX_RECONNECT_DELAY
+#define MQTT_MAX_RECONNECT_DELAY 60000 // max milliseconds between reconnect attempts while the broker is unreachable
+#endif
+#ifndef MQTT_RECONNECT_JITTER
+#define MQTT_RECONNECT_JITTER 50 // percent of the reconnect delay randomized, so a fleet of nodes does not reconnect in lockstep
+#endif
+#define MQTT_BURST_TIMEOUT 10 // milliseconds to wait for further messages of a burst
+
+#ifndef MQTT_MAX_PUBLISH_TOPICS
+#define MQTT_MAX_PUBLISH_TOPICS 8 // capacity of the static publish topic pool
+#endif
+#ifndef MQTT_MAX_SUBSCRIBE_TOPICS
+#define MQTT_MAX_SUBSCRIBE_TOPICS 16 // capacity of the static subscribe topic pool
+#endif
+#define MQTT_MAX_SUBSCRIPTIONS MAXSUBSCRIPTIONS // Adafruit_MQTT supports no more subscriptions at the broker
+#define MQTT_TOPIC_TRIE_NODES 64                // levels of all subscribe topics, shared leading levels count once
+#define MQTT_MAX_MATCHES 4                      // max subscribe topics notified of one message
+#define MQTT_TOPIC_NAME_LENGTH 24               // max short topic name length including terminating zero
+#define MQTT_PATH_LENGTH 64                     // max MQTT topic path length including prefix and terminating zero
+
 std::string stringReplaceAll(const std::string& str, const std::string searchText, const std::string replaceText);
 
+/**
+ * Adafruit MQTT client reading incoming PUBLISH packets with their topic
+ *
+ * Adafruit_MQTT::readSubscription() only returns messages of topics equal to a subscription, so messages of wildcard
+ * subscriptions are dropped. readMessage() returns each message with the topic it was published to instead.
+ */
+class RawMqttClient : public Adafruit_MQTT_Client
+{
+public:
+    RawMqttClient(Client* client, const char* serverHost, uint16_t serverPort, const char* userName,
+                  const char* password) :
+        Adafruit_MQTT_Client(client, serverHost, serverPort, userName, password)
+    {}
+
+    bool readMessage(char* topic, size_t topicSize, char* payload, size_t payloadSize, int16_t timeout,
+                     bool& truncated);
+
+    static bool parsePublish(const uint8_t* packet, uint16_t length, char* topic, size_t topicSize, char* payload,
+                             size_t payloadSize, uint16_t& packetId, bool& truncated);
+};
+
 /**
  * MQTT client class
  * 
@@ -30,6 +69,17 @@ std::string stringReplaceAll(const std::string& str, const std::string searchTex
  *      The topic name holds the status "true" for switch enabled or "false" for disabled.
  *      The availability of the switch is sent to MQTT Broker with topic: /switch/[building]/[room]/[switchname]/available.
  *      The switch can be toggled by receiving a MQTT message of format: /switch/[building]/[room]/[switchname]/set
+ * @li COMMAND: Topic gets prefix "/command/" and should be created as followed:  /command/[building]/[room]/[commandname]
+ * @li STATUS: Topic gets prefix "/status/" and should be created as followed:  /status/[building]/[room]/[statusname]
+ *
+ * Topics and their Adafruit publish/subscribe handlers are placement-constructed in static pools of
+ * MQTT_MAX_PUBLISH_TOPICS and MQTT_MAX_SUBSCRIBE_TOPICS entries and all names are passed as C strings,
+ * so publishing and dispatching messages does not allocate heap memory.
+ *
+ * Subscribe topics may hold the MQTT wildcards '+' and '#', e.g. "+/set" of type SWITCH. Each wildcard topic is
+ * subscribed at the broker, topics covered by a wildcard topic are not, so more topics than the MAXSUBSCRIPTIONS of
+ * Adafruit_MQTT can be handled. Incoming messages are dispatched to all matching subscribe topics by a TopicTrie;
+ * callbacks of wildcard topics get the MQTT path of the message instead of the short topic name.
  */
 class MqttClient
 {
@@ -40,6 +90,29 @@ public:
     bool connect(void);
     bool disconnect(void);
 
+    /**
+     * Counters of the MQTT client since start
+     */
+    struct Statistics
+    {
+        uint32_t published;         // messages sent successfully
+        uint32_t publishFailures;   // messages failed to send
+        uint64_t publishMicrosSum;  // time spent in successful publish calls
+        uint32_t publishMicrosMax;  // longest successful publish call
+        uint32_t received;          // incoming messages
+        uint32_t dispatched;        // incoming messages of subscribed topics
+        uint32_t truncated;         // incoming messages dropped for a payload longer than SUBSCRIPTIONDATALEN - 1
+        uint32_t connects;          // successful connects
+        uint32_t connectFailures;   // failed connect attempts
+        uint32_t connectionLosses;  // connections lost after successful connect
+        uint32_t skippedReconnects; // connect() calls skipped by reconnect backoff
+    };
+
+    const Statistics& statistics(void) const { return stats; }
+
+    static unsigned long nextReconnectDelay(unsigned long delay);
+    static unsigned long reconnectWait(unsigned long delay, uint32_t random, uint8_t jitter = MQTT_RECONNECT_JITTER);
+
     enum MqttTopicTypes
     {
         UNKNOWN = 0,
@@ -50,22 +123,29 @@ public:
         HEARTBEAT = 50
     };
 
-    typedef std::function<bool(std::string topic, std::string message)> NotifyCallbackFunction;
+    /**
+     * Notify callback of a subscribe topic, called with the context given to addNotifyCallback()
+     *
+     * A plain function pointer, so notifications neither allocate nor copy captured state.
+     */
+    typedef bool (*NotifyCallbackFunction)(const char* topic, const char* message, void* context);
 
-    bool createPublishTopic(const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType = MqttTopicTypes::SENSOR);
-    bool removePublishTopic(const std::string& topicName);
+    bool createPublishTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType = MqttTopicTypes::SENSOR);
+    bool removePublishTopic(const char* topicName);
 
-    bool createSubscribeTopic(const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType = MqttTopicTypes::SENSOR);
-    bool removeSubscribeTopic(const std::string& topicName);
+    bool createSubscribeTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType = MqttTopicTypes::SENSOR);
+    bool removeSubscribeTopic(const char* topicName);
 
-    bool addNotifyCallback(const std::string& topicName, NotifyCallbackFunction callback);
-    bool removeNotifyCallback(const std::string& topicName);
+    bool addNotifyCallback(const char* topicName, NotifyCallbackFunction callback, void* context = nullptr);
+    bool removeNotifyCallback(const char* topicName);
 
-    NotifyCallbackFunction notifyCallback(const std::string& topicName);
+    NotifyCallbackFunction notifyCallback(const char* topicName);
 
-    bool publish(const std::string& topicName, const std::string& message);
+    bool publish(const char* topicName, const char* message);
+    bool publish(const char* topicName, float value, uint8_t decimals = 1);
 
     bool waitForMessages(int timeout = 200);
+    bool dispatchMessage(const char* topic, const char* message);
 
 protected:
     /**
@@ -73,33 +153,71 @@ protected:
      */
     struct MqttTopicData
     {
-        MqttTopicData() {}
-        MqttTopicData(const MqttTopicData& ref) :
-            topicName(ref.topicName),
-            pathName(ref.pathName),
-            topicType(ref.topicType),
-            publishHandler(ref.publishHandler),
-            subscribeHandler(ref.subscribeHandler),
-            notifyCallback(ref.notifyCallback)
+        MqttTopicData(void) :
+            topicType(UNKNOWN),
+            publishHandler(nullptr),
+            subscribeHandler(nullptr),
+            notifyCallback(nullptr),
+            notifyContext(nullptr)
         {
+            topicName[0] = '\0';
+            pathName[0]  = '\0';
         }
 
-        std::string                              topicName;
-        std::string                              pathName;
-        MqttTopicTypes                           topicType;
-        std::shared_ptr<Adafruit_MQTT_Publish>   publishHandler;
-        std::shared_ptr<Adafruit_MQTT_Subscribe> subscribeHandler;
-        NotifyCallbackFunction                   notifyCallback; // used to notify about incoming MQTT messages and/or state changes
+        char                     topicName[MQTT_TOPIC_NAME_LENGTH];
+        char                     pathName[MQTT_PATH_LENGTH]; // referenced by the Adafruit handler, so the topic must not move
+        MqttTopicTypes           topicType;
+        Adafruit_MQTT_Publish*   publishHandler;
+        Adafruit_MQTT_Subscribe* subscribeHandler;
+        NotifyCallbackFunction   notifyCallback; // used to notify about incoming MQTT messages and/or state changes
+        void*                    notifyContext;  // passed to notifyCallback
     };
 
-    bool createMqttTopic(std::map<std::string, MqttTopicData>& topicList, const std::string& topicName, const std::string& mqttPath, MqttTopicTypes topicType, bool subscribe);
+    typedef StaticPool<MqttTopicData, MQTT_MAX_PUBLISH_TOPICS>   PublishTopicPool;
+    typedef StaticPool<MqttTopicData, MQTT_MAX_SUBSCRIBE_TOPICS> SubscribeTopicPool;
+
+    MqttTopicData* findPublishTopic(const char* topicName);
+    MqttTopicData* findSubscribeTopic(const char* topicName);
+
+    bool createMqttTopic(const char* topicName, const char* mqttPath, MqttTopicTypes topicType, bool subscribe);
+    bool updateSubscriptions(const MqttTopicData* topic = nullptr);
+    bool coveredByWildcard(const MqttTopicData& data, bool subscribed);
+
+    void incomingMessageCallback(MqttTopicData& data, const char* topic, const char* lastRead);
+
+private:
+    RawMqttClient                                                  mqttClient;
+    Statistics                                                     stats;
+    bool                                                           wasConnected       = false; // connection state of last check
+    bool                                                           connecting         = false; // TRUE within the retry loop of connect()
+    unsigned long                                                  reconnectDelay     = 0;     // current backoff in milliseconds
+    unsigned long                                                  reconnectWaitTime  = 0;     // backoff with jitter until next attempt
+    unsigned long                                                  lastConnectAttempt = 0;     // millis() of last failed connect
+    PublishTopicPool                                               publishTopics;
+    SubscribeTopicPool                                             subscribeTopics;
+    StaticPool<Adafruit_MQTT_Publish, MQTT_MAX_PUBLISH_TOPICS>     publishHandlers;
+    StaticPool<Adafruit_MQTT_Subscribe, MQTT_MAX_SUBSCRIPTIONS>    subscribeHandlers;
+    StaticTopicTrie<MQTT_TOPIC_TRIE_NODES>                         subscribeTrie; // values are subscribeTopics slots
+};
+
+/**
+ * Unit test and load test for MqttClient class
+ *
+ * The load test needs a broker connection: it publishes messages to a topic subscribed by the same client
+ * and reports throughput and round-trip latency percentiles.
+ */
+class TestMqttClient
+{
+public:
+    TestMqttClient(MqttClient& client) :
+        client(client)
+    {}
 
-    void incomingMessageCallback(MqttTopicData& data, const char* lastRead);
+    virtual bool runTests();
+    virtual bool runLoadTest(int messages = 100, int timeout = 10000);
 
 private:
-    std::shared_ptr<Adafruit_MQTT_Client> mqttClient;
-    std::map<std::string, MqttTopicData>  publishTopics;
-    std::map<std::string, MqttTopicData>  subscribeTopics;
+    MqttClient& client;
 };
 
 #endif // MQTTCLIENT_H
\ No newline at end of file
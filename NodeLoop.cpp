@@ -0,0 +1,173 @@
+/**
+ * Steps of one loop() run of a room sensor node, shared by the sketch and the host fleet simulator
+ */
+
+#include "NodeLoop.h"
+#include "AllocationGuard.h"
+#include "Logger.h"
+#include "NumberFormat.h"
+#include "Profiler.h"
+#include <time.h>
+
+/**
+ * Constructor, the parts are used from the first run() on
+ */
+NodeLoop::NodeLoop(MqttClient& mqttClient, SensorDHT& sensorDHT, TemperatureSensor& sensorHeater, RuleEngine& rules,
+                   RelayPorts& relays) :
+    mqttClient(mqttClient),
+    sensorDHT(sensorDHT),
+    sensorHeater(sensorHeater),
+    rules(rules),
+    relays(relays),
+    pollInterval(0)
+{}
+
+/**
+ * One loop() run
+ *
+ * The steps in order, each a hook of subclasses:
+ * @li applyChanges(): e.g. configuration changes received meanwhile
+ * @li readSensors() and applyRules(), also without valid DHT values and without broker connection
+ * @li update(): values of this run, valid or not, e.g. for metrics
+ * @li show(): valid values only, e.g. history and display - on invalid values the run ends by idle(retryDelay)
+ * @li send(): publish the values
+ * @li wait(): MQTT messages until loopDelay is over, or the reconnect delay
+ *
+ * @param retryDelay milliseconds to wait after invalid DHT values
+ * @param loopDelay milliseconds to wait after the values were sent
+ */
+void NodeLoop::run(unsigned long retryDelay, unsigned long loopDelay)
+{
+    // the steady state must not allocate heap memory, see AllocationGuard
+    AllocationGuard::check();
+    applyChanges();
+
+    SensorSample sample;
+    bool         valid;
+    {
+        PROFILE_PHASE("sensors");
+        valid = readSensors(sample);
+    }
+    {
+        // switch relays locally, also without broker connection
+        PROFILE_PHASE("rules");
+        applyRules();
+    }
+
+    profiler.sampleHeap();
+    update(sample);
+    profiler.reportIfDue();
+
+    if (!valid) {
+        idle(retryDelay);
+        return;
+    }
+    show(sample);
+
+    {
+        PROFILE_PHASE("publish");
+        send(sample);
+    }
+
+    // write log lines while idle
+    logger.drain();
+
+    // all lazy initializations are done after the first complete run
+    AllocationGuard::arm();
+
+    // waits displayUpdateDelay plus reconnect jitter, longer than the cycle counter wraps on ESP32
+    PROFILE_LONG_PHASE("wait");
+    wait(loopDelay);
+}
+
+/**
+ * Publish given sensor values
+ *
+ * @return TRUE if the temperature was published
+ */
+bool NodeLoop::publish(const SensorSample& sample)
+{
+    char temperatureStr[NUMBER_FORMAT_BUFFER_SIZE];
+    char humidityStr[NUMBER_FORMAT_BUFFER_SIZE];
+    formatDecimal(temperatureStr, sizeof(temperatureStr), sample.temperature, 1);
+    formatDecimal(humidityStr, sizeof(humidityStr), sample.humidity, 1);
+
+    mqttClient.publish("temperature_heater", sample.temperatureHeater, 1);
+
+    bool published = mqttClient.publish("temperature", temperatureStr);
+    LOG_INFO(MAIN, "sending temp val %s... %s", temperatureStr, published ? "OK!" : "Failed");
+
+    bool humidityPublished = mqttClient.publish("humidity", humidityStr);
+    LOG_INFO(MAIN, "sending humidity val %s... %s", humidityStr, humidityPublished ? "OK!" : "Failed");
+    return published;
+}
+
+/**
+ * Return current minute of day or RULE_TIME_UNKNOWN, if clock was not set by NTP yet
+ */
+int NodeLoop::minuteOfDay(void)
+{
+    time_t now = time(nullptr);
+    if (now < 1500000000) {
+        return RULE_TIME_UNKNOWN;
+    }
+    struct tm* local = localtime(&now);
+    return local->tm_hour * 60 + local->tm_min;
+}
+
+/**
+ * Read all sensors of the node
+ *
+ * @return TRUE if temperature and humidity of the DHT are valid
+ */
+bool NodeLoop::readSensors(SensorSample& sample)
+{
+    sample.temperature       = sensorDHT.temperature();
+    sample.humidity          = sensorDHT.humidity();
+    sample.temperatureHeater = sensorHeater.temperature();
+    return sensorDHT.isTemperatureValid() && sensorDHT.isHumidityValid();
+}
+
+/**
+ * Switch relays by the local rules
+ */
+void NodeLoop::applyRules(void)
+{
+    rules.apply(relays, minuteOfDay());
+}
+
+/**
+ * Wait given time for MQTT messages - with a poll interval set, poll() is called in between
+ *
+ * Without broker connection the node idles until its next reconnect attempt instead.
+ */
+void NodeLoop::wait(unsigned long milliseconds)
+{
+    if (!mqttClient.connected()) {
+        // jitter lets the loops of nodes booted by the same power failure drift apart until the broker is back
+        idle(MqttClient::reconnectWait(milliseconds, (uint32_t)random(0x7FFFFFFF)));
+        return;
+    }
+    if (pollInterval == 0) {
+        if (!mqttClient.waitForMessages(milliseconds)) {
+            LOG_DEBUG(MQTT, "wait for messages aborted");
+        } else {
+            LOG_DEBUG(MQTT, "wait for messages successful");
+        }
+        return;
+    }
+
+    unsigned long start = millis();
+    while (millis() - start < milliseconds && mqttClient.connected()) {
+        mqttClient.waitForMessages(pollInterval);
+        poll();
+    }
+}
+
+/**
+ * Wait given time without MQTT, log lines are written meanwhile
+ */
+void NodeLoop::idle(unsigned long milliseconds)
+{
+    logger.idle(milliseconds);
+}
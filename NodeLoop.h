@@ -0,0 +1,67 @@
+#ifndef NODELOOP_H
+#define NODELOOP_H
+
+/**
+ * Steps of one loop() run of a room sensor node, shared by the sketch and the host fleet simulator
+ */
+
+#include "MqttClient.h"
+#include "Relays.h"
+#include "RuleEngine.h"
+#include "SensorDHT.h"
+#include "TemperatureSensor.h"
+#include <Arduino.h>
+
+/**
+ * Sensor values of one loop() run
+ */
+struct SensorSample
+{
+    float temperature;
+    float humidity;
+    float temperatureHeater;
+};
+
+/**
+ * loop() of a node: read sensors, switch relays by the local rules, publish and wait for MQTT messages or the next
+ * reconnect
+ *
+ * run() is the whole loop() body. The sketch adds display, history, metrics and the network task of dual-core
+ * boards by overriding the steps; the fleet simulator runs the steps as they are, one NodeLoop per simulated node.
+ */
+class NodeLoop
+{
+public:
+    NodeLoop(MqttClient& mqttClient, SensorDHT& sensorDHT, TemperatureSensor& sensorHeater, RuleEngine& rules,
+             RelayPorts& relays);
+    virtual ~NodeLoop() {}
+
+    void run(unsigned long retryDelay, unsigned long loopDelay);
+
+    bool publish(const SensorSample& sample);
+    void setPollInterval(unsigned long milliseconds) { pollInterval = milliseconds; }
+
+    static int minuteOfDay(void);
+
+protected:
+    virtual void applyChanges(void) {}
+    virtual bool readSensors(SensorSample& sample);
+    virtual void applyRules(void);
+    virtual void update(const SensorSample&) {}
+    virtual void show(const SensorSample&) {}
+    virtual void send(const SensorSample& sample) { publish(sample); }
+    virtual void wait(unsigned long milliseconds);
+    virtual void poll(void) {}
+    virtual void idle(unsigned long milliseconds);
+
+    MqttClient&        mqttClient;
+    SensorDHT&         sensorDHT;
+    TemperatureSensor& sensorHeater;
+    RuleEngine&        rules;
+    RelayPorts&        relays;
+
+private:
+    unsigned long pollInterval; // milliseconds between poll() calls while waiting for messages, 0 for none
+};
+
+#endif // NODELOOP_H
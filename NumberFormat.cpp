@@ -0,0 +1,156 @@
+/**
+ * Allocation-free decimal formatting of sensor values without printf
+ */
+
+#include "NumberFormat.h"
+#include "Logger.h"
+#include <Arduino.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+static const uint32_t powersOfTen[NUMBER_FORMAT_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/**
+ * Copy given string into buffer, if it fits, and return its length - otherwise return -1
+ */
+static int copyIfFits(char* buffer, size_t bufferSize, const char* text)
+{
+    size_t length = strlen(text);
+    if (length + 1 > bufferSize) {
+        return -1;
+    }
+    memcpy(buffer, text, length + 1);
+    return length;
+}
+
+/**
+ * Format given value as decimal number with given count of decimals, e.g. -10.5 for 1 decimal
+ *
+ * Values are rounded half away from zero, values rounded to zero are written without sign.
+ * NaN and infinite values are written as "nan", "inf" and "-inf" like printf does.
+ *
+ * @param buffer     - target buffer, always terminated if bufferSize > 0
+ * @param bufferSize - size of target buffer including terminator
+ * @param value      - value to format
+ * @param decimals   - count of decimals from 0 to NUMBER_FORMAT_MAX_DECIMALS
+ *
+ * @return length of written string without terminator or -1, if the buffer is too small or the value out of range
+ */
+int formatDecimal(char* buffer, size_t bufferSize, float value, uint8_t decimals)
+{
+    if (buffer == nullptr || bufferSize == 0) {
+        return -1;
+    }
+    buffer[0] = '\0';
+
+    if (decimals > NUMBER_FORMAT_MAX_DECIMALS) {
+        return -1;
+    }
+    if (isnan(value)) {
+        return copyIfFits(buffer, bufferSize, "nan");
+    }
+    if (isinf(value)) {
+        return copyIfFits(buffer, bufferSize, value < 0 ? "-inf" : "inf");
+    }
+
+    bool  negative = value < 0;
+    float scaled   = fabsf(value) * powersOfTen[decimals] + 0.5f;
+    if (scaled >= 4294967295.0f) {
+        return -1;
+    }
+    uint32_t number  = (uint32_t)scaled;
+    bool     nonZero = number > 0;
+
+    // write digits backwards into a scratch buffer, then copy them in order
+    char  digits[NUMBER_FORMAT_BUFFER_SIZE];
+    char* pos = digits + sizeof(digits);
+
+    for (uint8_t i = 0; i < decimals; ++i) {
+        *--pos = '0' + number % 10;
+        number /= 10;
+    }
+    if (decimals > 0) {
+        *--pos = '.';
+    }
+    do {
+        *--pos = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    size_t length = digits + sizeof(digits) - pos;
+    if (negative && nonZero) {
+        *--pos = '-';
+        ++length;
+    }
+
+    if (length + 1 > bufferSize) {
+        return -1;
+    }
+    memcpy(buffer, pos, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+/**
+ * Exhaustive test of all tenths from -999.9 to 999.9 plus rounding and bounds checks
+ */
+bool TestNumberFormat::runTests()
+{
+    char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+    char expected[NUMBER_FORMAT_BUFFER_SIZE];
+
+    for (int tenths = -9999; tenths <= 9999; ++tenths) {
+        int absolute = tenths < 0 ? -tenths : tenths;
+        snprintf(expected, sizeof(expected), "%s%d.%d", tenths < 0 ? "-" : "", absolute / 10, absolute % 10);
+
+        int length = formatDecimal(buffer, sizeof(buffer), tenths / 10.0f, 1);
+        assert(length == (int)strlen(expected));
+        assert(strcmp(buffer, expected) == 0);
+
+        if (tenths % 1000 == 0) {
+            yield(); // keep the watchdog happy
+        }
+    }
+
+    assert(formatDecimal(buffer, sizeof(buffer), 21.96f, 1) == 4 && strcmp(buffer, "22.0") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), -0.04f, 1) == 3 && strcmp(buffer, "0.0") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), 7.5f, 0) == 1 && strcmp(buffer, "8") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), 3.14159f, 3) == 5 && strcmp(buffer, "3.142") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), 0.05f, 2) == 4 && strcmp(buffer, "0.05") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), NAN, 1) == 3 && strcmp(buffer, "nan") == 0);
+    assert(formatDecimal(buffer, sizeof(buffer), -INFINITY, 1) == 4 && strcmp(buffer, "-inf") == 0);
+
+    // bounds checks: "-10.5" needs 6 bytes
+    assert(formatDecimal(buffer, 5, -10.5f, 1) == -1 && buffer[0] == '\0');
+    assert(formatDecimal(buffer, 6, -10.5f, 1) == 5 && strcmp(buffer, "-10.5") == 0);
+    assert(formatDecimal(buffer, 4, 100.0f, 1) == -1 && buffer[0] == '\0');
+    assert(formatDecimal(buffer, 0, 1.0f, 1) == -1);
+    assert(formatDecimal(nullptr, 8, 1.0f, 1) == -1);
+    assert(formatDecimal(buffer, sizeof(buffer), 1.0f, NUMBER_FORMAT_MAX_DECIMALS + 1) == -1);
+    assert(formatDecimal(buffer, sizeof(buffer), 1e10f, 1) == -1);
+
+    return true;
+}
+
+/**
+ * Compare throughput of formatDecimal() with sprintf("%02.1f")
+ */
+void TestNumberFormat::runBenchmark(int iterations)
+{
+    char          buffer[NUMBER_FORMAT_BUFFER_SIZE];
+    float         value = -20.0f;
+    unsigned long start = micros();
+    for (int i = 0; i < iterations; ++i) {
+        sprintf(buffer, "%02.1f", value + i * 0.1f);
+    }
+    unsigned long sprintfTime = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < iterations; ++i) {
+        formatDecimal(buffer, sizeof(buffer), value + i * 0.1f, 1);
+    }
+    unsigned long formatTime = micros() - start;
+
+    LOG_INFO(FORMAT, "benchmark: sprintf %lu us, formatDecimal %lu us for %d values", sprintfTime, formatTime, iterations);
+}
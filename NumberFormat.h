@@ -0,0 +1,26 @@
+#ifndef NUMBERFORMAT_H
+#define NUMBERFORMAT_H
+
+/**
+ * Allocation-free decimal formatting of sensor values without printf
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NUMBER_FORMAT_MAX_DECIMALS 6
+#define NUMBER_FORMAT_BUFFER_SIZE 16 // enough for any value accepted by formatDecimal() incl. sign and terminator
+
+int formatDecimal(char* buffer, size_t bufferSize, float value, uint8_t decimals = 1);
+
+/**
+ * Unit test and benchmark for formatDecimal()
+ */
+class TestNumberFormat
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(int iterations = 1000);
+};
+
+#endif // NUMBERFORMAT_H
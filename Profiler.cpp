@@ -0,0 +1,292 @@
+/**
+ * Per-phase timing of loop() and heap fragmentation tracking
+ */
+
+#include "Profiler.h"
+#include "Logger.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(ESP32)
+#include <esp_timer.h>
+#elif !defined(ESP8266)
+#include <chrono>
+#endif
+
+Profiler profiler;
+
+Profiler::Profiler() :
+    phaseCount(0),
+    lastReport(0)
+{
+    reset();
+}
+
+/**
+ * Return index of phase with given name, registering new names - returns the last phase if all are used
+ */
+uint8_t Profiler::addPhase(const char* name)
+{
+    for (uint8_t i = 0; i < phaseCount; ++i) {
+        if (strcmp(phases[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (phaseCount == PROFILER_MAX_PHASES) {
+        LOG_ERROR(PROFILE, "too many phases - '%s' is counted as '%s'", name, phases[phaseCount - 1].name);
+        return phaseCount - 1;
+    }
+    phases[phaseCount].name = name;
+    return phaseCount++;
+}
+
+/**
+ * Add duration in microseconds to given phase
+ */
+void Profiler::record(uint8_t phase, uint32_t micros)
+{
+    if (phase >= phaseCount) {
+        return;
+    }
+    PhaseStats& stats = phases[phase];
+    if (stats.count == 0 || micros < stats.min) {
+        stats.min = micros;
+    }
+    if (micros > stats.max) {
+        stats.max = micros;
+    }
+    ++stats.count;
+    stats.sum += micros;
+
+    uint16_t& bucket = stats.buckets[bucketIndex(micros)];
+    if (bucket < UINT16_MAX) {
+        ++bucket;
+    }
+}
+
+/**
+ * Take a sample of free heap, largest free block and fragmentation
+ */
+void Profiler::sampleHeap(void)
+{
+#if defined(ESP8266)
+    uint32_t freeHeap     = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+    uint32_t freeHeap     = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+#else
+    uint32_t freeHeap     = 0;
+    uint32_t largestBlock = 0;
+#endif
+    uint8_t fragmentation = freeHeap > 0 ? 100 - (uint64_t)largestBlock * 100 / freeHeap : 0;
+
+    heap.freeHeap      = freeHeap;
+    heap.largestBlock  = largestBlock;
+    heap.fragmentation = fragmentation;
+    if (freeHeap < heap.minFreeHeap) {
+        heap.minFreeHeap = freeHeap;
+    }
+    if (largestBlock < heap.minLargestBlock) {
+        heap.minLargestBlock = largestBlock;
+    }
+    if (fragmentation > heap.maxFragmentation) {
+        heap.maxFragmentation = fragmentation;
+    }
+}
+
+/**
+ * Clear all statistics but keep the registered phases
+ */
+void Profiler::reset(void)
+{
+    for (uint8_t i = 0; i < PROFILER_MAX_PHASES; ++i) {
+        const char* name = (i < phaseCount) ? phases[i].name : nullptr;
+        memset(&phases[i], 0, sizeof(PhaseStats));
+        phases[i].name = name;
+    }
+    memset(&heap, 0, sizeof(heap));
+    heap.minFreeHeap     = UINT32_MAX;
+    heap.minLargestBlock = UINT32_MAX;
+}
+
+const Profiler::PhaseStats* Profiler::phaseStats(uint8_t phase) const
+{
+    return (phase < phaseCount) ? &phases[phase] : nullptr;
+}
+
+/**
+ * Return upper bound of given percentile of durations of given phase in microseconds
+ */
+uint32_t Profiler::percentile(uint8_t phase, uint8_t percent) const
+{
+    if (phase >= phaseCount || phases[phase].count == 0) {
+        return 0;
+    }
+    const PhaseStats& stats  = phases[phase];
+    uint32_t          target = ((uint64_t)stats.count * percent + 99) / 100;
+    uint32_t          sum    = 0;
+
+    for (uint8_t i = 0; i < PROFILER_BUCKETS; ++i) {
+        sum += stats.buckets[i];
+        if (sum >= target) {
+            uint32_t bound = bucketUpperBound(i);
+            return bound < stats.max ? bound : stats.max;
+        }
+    }
+    return stats.max;
+}
+
+/**
+ * Log statistics of all phases and heap, then start a new period
+ */
+void Profiler::report(void)
+{
+    for (uint8_t i = 0; i < phaseCount; ++i) {
+        const PhaseStats& stats = phases[i];
+        if (stats.count == 0) {
+            continue;
+        }
+        LOG_INFO(PROFILE, "%s: n=%u min=%u avg=%u max=%u p99<=%u us", stats.name, (unsigned int)stats.count,
+                 (unsigned int)stats.min, (unsigned int)(stats.sum / stats.count), (unsigned int)stats.max, (unsigned int)percentile(i, 99));
+    }
+    if (heap.minFreeHeap != UINT32_MAX) {
+        LOG_INFO(PROFILE, "heap: free=%u (min %u) largest block=%u (min %u) fragmentation=%u%% (max %u%%)",
+                 (unsigned int)heap.freeHeap, (unsigned int)heap.minFreeHeap, (unsigned int)heap.largestBlock,
+                 (unsigned int)heap.minLargestBlock, heap.fragmentation, heap.maxFragmentation);
+    }
+    reset();
+}
+
+/**
+ * Report, if given interval in milliseconds passed since the last report
+ */
+bool Profiler::reportIfDue(unsigned long interval)
+{
+    if (millis() - lastReport < interval) {
+        return false;
+    }
+    lastReport = millis();
+    report();
+    return true;
+}
+
+/**
+ * Return current time in ticks: CPU cycles on ESP8266/ESP32, microseconds of a steady clock otherwise
+ */
+uint32_t Profiler::ticks(void)
+{
+#if defined(ESP8266) || defined(ESP32)
+    return ESP.getCycleCount();
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * Convert tick difference to microseconds - cycle counts wrap after 53 s at 80 MHz and 17.9 s at 240 MHz, see
+ * longTicks() for longer phases
+ */
+uint32_t Profiler::ticksToMicros(uint32_t ticks)
+{
+#if defined(ESP8266) || defined(ESP32)
+    return ticks / ESP.getCpuFreqMHz();
+#else
+    return ticks;
+#endif
+}
+
+/**
+ * Return current time in microseconds of a 64 bit clock, which does not wrap like the cycle counter
+ */
+uint64_t Profiler::longTicks(void)
+{
+#if defined(ESP32)
+    return esp_timer_get_time();
+#elif defined(ESP8266)
+    return micros64();
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * Convert long tick difference to microseconds, saturated at 71 minutes
+ */
+uint32_t Profiler::longTicksToMicros(uint64_t ticks)
+{
+    return ticks < UINT32_MAX ? (uint32_t)ticks : UINT32_MAX;
+}
+
+/**
+ * Return histogram bucket of given duration: 2 buckets per power of two
+ */
+uint8_t Profiler::bucketIndex(uint32_t micros)
+{
+    if (micros < 2) {
+        return micros;
+    }
+    uint8_t msb = 31 - __builtin_clz(micros);
+    return msb * 2 + ((micros >> (msb - 1)) & 1);
+}
+
+/**
+ * Return highest duration counted in given histogram bucket
+ */
+uint32_t Profiler::bucketUpperBound(uint8_t bucket)
+{
+    if (bucket < 2) {
+        return bucket;
+    }
+    uint8_t  msb   = bucket / 2;
+    uint64_t lower = (1ULL << msb) + (bucket & 1) * (1ULL << (msb - 1));
+    return lower + (1ULL << (msb - 1)) - 1;
+}
+
+/**
+ * Unit tests for histogram buckets and statistics
+ */
+bool TestProfiler::runTests()
+{
+    const uint32_t values[] = {0, 1, 2, 3, 5, 100, 1000, 65535, 1000000, 0xFFFFFFFF};
+    for (uint32_t value : values) {
+        uint8_t bucket = Profiler::bucketIndex(value);
+        assert(bucket < PROFILER_BUCKETS);
+        assert(Profiler::bucketUpperBound(bucket) >= value);
+        assert(bucket == 0 || Profiler::bucketUpperBound(bucket - 1) < value);
+    }
+
+    uint8_t phase = testProfiler.addPhase("test");
+    assert(testProfiler.addPhase("test") == phase);
+    assert(testProfiler.percentile(phase, 99) == 0);
+
+    for (uint32_t i = 1; i <= 100; ++i) {
+        testProfiler.record(phase, i == 100 ? 5000 : 100);
+    }
+    const Profiler::PhaseStats* stats = testProfiler.phaseStats(phase);
+    assert(stats->count == 100 && stats->min == 100 && stats->max == 5000);
+    assert(stats->sum == 99 * 100 + 5000);
+    assert(testProfiler.percentile(phase, 99) >= 100 && testProfiler.percentile(phase, 99) < 150);
+    assert(testProfiler.percentile(phase, 100) == 5000);
+
+    {
+        ProfileScope scope(testProfiler, phase);
+        delayMicroseconds(100);
+    }
+    assert(stats->count == 101);
+    {
+        LongProfileScope scope(testProfiler, phase);
+        delayMicroseconds(100);
+    }
+    assert(stats->count == 102);
+
+    // long phases are not cut to the wrap of a 32 bit counter
+    assert(Profiler::longTicksToMicros(20000000ULL) == 20000000);
+    assert(Profiler::longTicksToMicros(0x100000000ULL) == UINT32_MAX);
+
+    testProfiler.reset();
+    assert(testProfiler.phaseStats(phase)->count == 0);
+    assert(testProfiler.addPhase("test") == phase);
+
+    return true;
+}
@@ -0,0 +1,155 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/**
+ * Per-phase timing of loop() and heap fragmentation tracking
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#define PROFILER_MAX_PHASES 8
+#define PROFILER_BUCKETS 64                    // 2 buckets per power of two of microseconds
+#define PROFILER_REPORT_INTERVAL (5 * 60000UL) // milliseconds between reports
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+/**
+ * Measure the time until the end of the current scope as given phase name
+ */
+#define PROFILE_PHASE(name)                                                                        \
+    static uint8_t PROFILER_CONCAT(profilePhase, __LINE__) = profiler.addPhase(name);              \
+    ProfileScope   PROFILER_CONCAT(profileScope, __LINE__)(profiler, PROFILER_CONCAT(profilePhase, __LINE__))
+
+/**
+ * Measure the time until the end of the current scope as given phase name, for phases which may last longer than
+ * the cycle counter wraps, e.g. waiting for the next loop() run
+ */
+#define PROFILE_LONG_PHASE(name)                                                                   \
+    static uint8_t   PROFILER_CONCAT(profilePhase, __LINE__) = profiler.addPhase(name);            \
+    LongProfileScope PROFILER_CONCAT(profileScope, __LINE__)(profiler, PROFILER_CONCAT(profilePhase, __LINE__))
+
+/**
+ * Profiler aggregating durations per phase and heap statistics between reports
+ *
+ * Durations are taken from the CPU cycle counter on ESP8266/ESP32 and from a steady clock on other platforms.
+ * The cycle counter wraps after 17.9 s at 240 MHz, so phases which may last longer are timed in microseconds of a
+ * 64 bit clock by PROFILE_LONG_PHASE() instead.
+ * Each phase keeps count, min, max and sum and a fixed size histogram with 2 buckets per power of two, so the
+ * p99 value is reported as upper bound of its bucket (within 50 %) without storing single samples.
+ * Heap fragmentation is computed as 100 - largest free block * 100 / free heap.
+ */
+class Profiler
+{
+public:
+    /**
+     * Aggregated durations of one phase in microseconds
+     */
+    struct PhaseStats
+    {
+        const char* name;
+        uint32_t    count;
+        uint32_t    min;
+        uint32_t    max;
+        uint64_t    sum;
+        uint16_t    buckets[PROFILER_BUCKETS];
+    };
+
+    /**
+     * Heap statistics since last report
+     */
+    struct HeapStats
+    {
+        uint32_t freeHeap;         // current free heap in bytes
+        uint32_t minFreeHeap;      // lowest free heap
+        uint32_t largestBlock;     // current largest free block
+        uint32_t minLargestBlock;  // lowest largest free block
+        uint8_t  fragmentation;    // current fragmentation in percent
+        uint8_t  maxFragmentation; // highest fragmentation
+    };
+
+    Profiler();
+
+    uint8_t addPhase(const char* name);
+    void    record(uint8_t phase, uint32_t micros);
+    void    sampleHeap(void);
+    void    reset(void);
+
+    const PhaseStats* phaseStats(uint8_t phase) const;
+    const HeapStats&  heapStats(void) const { return heap; }
+    uint32_t          percentile(uint8_t phase, uint8_t percent) const;
+
+    void report(void);
+    bool reportIfDue(unsigned long interval = PROFILER_REPORT_INTERVAL);
+
+    static uint32_t ticks(void);
+    static uint32_t ticksToMicros(uint32_t ticks);
+    static uint64_t longTicks(void);
+    static uint32_t longTicksToMicros(uint64_t ticks);
+
+    static uint8_t  bucketIndex(uint32_t micros);
+    static uint32_t bucketUpperBound(uint8_t bucket);
+
+private:
+    PhaseStats    phases[PROFILER_MAX_PHASES];
+    uint8_t       phaseCount;
+    HeapStats     heap;
+    unsigned long lastReport; // millis() of last report
+};
+
+extern Profiler profiler;
+
+/**
+ * Scoped timer recording its lifetime as duration of given phase
+ */
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler& profiler, uint8_t phase) :
+        profiler(profiler),
+        phase(phase),
+        start(Profiler::ticks())
+    {}
+
+    ~ProfileScope() { profiler.record(phase, Profiler::ticksToMicros(Profiler::ticks() - start)); }
+
+private:
+    Profiler& profiler;
+    uint8_t   phase;
+    uint32_t  start;
+};
+
+/**
+ * Scoped timer like ProfileScope, but by a clock which does not wrap within hours
+ */
+class LongProfileScope
+{
+public:
+    LongProfileScope(Profiler& profiler, uint8_t phase) :
+        profiler(profiler),
+        phase(phase),
+        start(Profiler::longTicks())
+    {}
+
+    ~LongProfileScope() { profiler.record(phase, Profiler::longTicksToMicros(Profiler::longTicks() - start)); }
+
+private:
+    Profiler& profiler;
+    uint8_t   phase;
+    uint64_t  start;
+};
+
+/**
+ * Unit test for Profiler class
+ */
+class TestProfiler
+{
+public:
+    virtual bool runTests();
+
+private:
+    Profiler testProfiler;
+};
+
+#endif // PROFILER_H
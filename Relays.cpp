@@ -1,18 +1,46 @@
 #include "Relays.h"
+#include <assert.h>
 
+/**
+ * Initialize given output pins with all relays switched off
+ */
 RelayPorts::RelayPorts(const std::vector<int> ports) :
     outputPorts(ports),
-    currentPortNumber(-1)
+    currentPortNumber(-1),
+    stateImage(0)
 {
-    for (int i = 0; i < outputPorts.size(); ++i) {
+    if (outputPorts.size() > RELAY_MAX_PORTS) {
+        outputPorts.resize(RELAY_MAX_PORTS);
+    }
+    for (size_t i = 0; i < outputPorts.size(); ++i) {
+        pinMode(outputPorts[i], OUTPUT);
+        digitalWrite(outputPorts[i], HIGH);
+    }
+}
+
+/**
+ * Replace the output pins, e.g. after a configuration change - all relays are switched off before
+ */
+void RelayPorts::setOutputPorts(const std::vector<int>& ports)
+{
+    setPorts(stateImage, 0);
+
+    outputPorts = ports;
+    if (outputPorts.size() > RELAY_MAX_PORTS) {
+        outputPorts.resize(RELAY_MAX_PORTS);
+    }
+    for (size_t i = 0; i < outputPorts.size(); ++i) {
         pinMode(outputPorts[i], OUTPUT);
         digitalWrite(outputPorts[i], HIGH);
     }
+    if (!isValidPort(currentPortNumber)) {
+        currentPortNumber = -1;
+    }
 }
 
-bool RelayPorts::isValidPort(int port)
+bool RelayPorts::isValidPort(int port) const
 {
-    if (port < 0 || port >= outputPorts.size()) {
+    if (port < 0 || port >= (int)outputPorts.size()) {
         return false;
     }
     return true;
@@ -28,15 +56,217 @@ int RelayPorts::setCurrentPort(int port)
     return currentPortNumber;
 }
 
+/**
+ * Return TRUE if given relay is switched on
+ */
+bool RelayPorts::portState(int port) const
+{
+    return isValidPort(port) && (stateImage & (1UL << port));
+}
+
 int RelayPorts::togglePort(bool state)
 {
     return togglePort(currentPortNumber, state);
 }
 
+/**
+ * Switch given relay on or off
+ *
+ * @return 1 if the relay changed its state, 0 if it already had the given state, -1 for invalid ports
+ */
 int RelayPorts::togglePort(int port, bool state)
 {
     if (!isValidPort(port)) {
         return -1;
     }
-    digitalWrite(outputPorts[port], state ? LOW : HIGH);
+    uint32_t bit = 1UL << port;
+    return setPorts(bit, state ? bit : 0);
+}
+
+/**
+ * Switch all relays selected by mask to the state of the matching bit in states at once
+ *
+ * @return count of relays which changed their state, -1 if mask selects invalid ports
+ */
+int RelayPorts::setPorts(uint32_t mask, uint32_t states)
+{
+    uint32_t validPorts = outputPorts.size() < RELAY_MAX_PORTS ? (1UL << outputPorts.size()) - 1 : 0xFFFFFFFF;
+    if (mask & ~validPorts) {
+        return -1;
+    }
+
+    uint32_t newImage = (stateImage & ~mask) | (states & mask);
+    uint32_t changed  = stateImage ^ newImage;
+    if (changed == 0) {
+        return 0;
+    }
+
+    writeOutputs(changed, newImage);
+    stateImage = newImage;
+
+    int count = 0;
+    for (size_t port = 0; port < outputPorts.size(); ++port) {
+        if (changed & (1UL << port)) {
+            ++count;
+            for (StateCallbackFunction& callback : stateCallbacks) {
+                callback(port, newImage & (1UL << port));
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Register callback which is called for each relay changing its state
+ */
+void RelayPorts::addStateCallback(StateCallbackFunction callback)
+{
+    if (callback) {
+        stateCallbacks.push_back(callback);
+    }
+}
+
+/**
+ * Write outputs of changed relays - on ESP8266 all GPIO 0..15 outputs are set by one write to the GPIO set and
+ * one write to the GPIO clear register, GPIO 16 and other platforms fall back to digitalWrite()
+ */
+void RelayPorts::writeOutputs(uint32_t changed, uint32_t states)
+{
+#if defined(ESP8266)
+    uint32_t gpioSet   = 0;
+    uint32_t gpioClear = 0;
+#endif
+
+    for (size_t port = 0; port < outputPorts.size(); ++port) {
+        uint32_t bit = 1UL << port;
+        if (!(changed & bit)) {
+            continue;
+        }
+        bool on  = states & bit;
+        int  pin = outputPorts[port];
+#if defined(ESP8266)
+        if (pin < 16) {
+            if (on) {
+                gpioClear |= 1UL << pin; // relays are switched on by LOW
+            } else {
+                gpioSet |= 1UL << pin;
+            }
+            continue;
+        }
+#endif
+        digitalWrite(pin, on ? LOW : HIGH);
+    }
+
+#if defined(ESP8266)
+    if (gpioSet) {
+        GPOS = gpioSet;
+    }
+    if (gpioClear) {
+        GPOC = gpioClear;
+    }
+#endif
+}
+
+/**
+ * Relays remembering the outputs written by each writeOutputs() call, test context of TestRelayPorts
+ */
+class RecordingRelayPorts : public RelayPorts
+{
+public:
+    RecordingRelayPorts(const std::vector<int>& ports) :
+        RelayPorts(ports)
+    {}
+
+    int      writes  = 0;
+    uint32_t changed = 0; // of the last write
+    uint32_t states  = 0; // of the last write
+
+protected:
+    virtual void writeOutputs(uint32_t changedPorts, uint32_t portStates)
+    {
+        ++writes;
+        changed = changedPorts;
+        states  = portStates;
+#if !defined(ESP8266) && !defined(ESP32)
+        RelayPorts::writeOutputs(changedPorts, portStates);
+#endif
+    }
+};
+
+/**
+ * Return TRUE if the output of given pin switches its relay to given state - checked on the host only
+ */
+static bool outputIs(int pin, bool on)
+{
+#if !defined(ESP8266) && !defined(ESP32)
+    return digitalRead(pin) == (on ? LOW : HIGH);
+#else
+    (void)pin;
+    (void)on;
+    return true;
+#endif
+}
+
+/**
+ * Unit tests for switching several relays at once and the state callbacks
+ */
+bool TestRelayPorts::runTests()
+{
+    assert(pins.size() >= 3);
+    RecordingRelayPorts relays(std::vector<int>(pins.begin(), pins.begin() + 3));
+    uint32_t            notified = 0; // bit n set = relay n notified
+    uint32_t            switched = 0; // bit n set = relay n notified as switched on
+    int                 calls    = 0;
+    relays.addStateCallback([&](int port, bool state) {
+        ++calls;
+        notified |= 1UL << port;
+        if (state) {
+            switched |= 1UL << port;
+        }
+    });
+    assert(relays.availableRelays() == 3 && relays.portStates() == 0);
+
+    // several relays switched by one write
+    int changed = relays.setPorts(0x5, 0x5);
+    assert(changed == 2 && relays.portStates() == 0x5);
+    assert(relays.writes == 1 && relays.changed == 0x5 && relays.states == 0x5);
+    assert(calls == 2 && notified == 0x5 && switched == 0x5);
+    assert(outputIs(pins[0], true) && outputIs(pins[1], false) && outputIs(pins[2], true));
+
+    // relays already in the given state are neither written nor notified
+    calls    = 0;
+    notified = 0;
+    switched = 0;
+    changed  = relays.setPorts(0x7, 0x5);
+    assert(changed == 0 && relays.writes == 1 && calls == 0);
+    changed = relays.togglePort(0, true);
+    assert(changed == 0 && relays.writes == 1 && calls == 0);
+
+    // only relays changing their state are written and notified
+    changed = relays.setPorts(0x7, 0x6);
+    assert(changed == 2 && relays.portStates() == 0x6);
+    assert(relays.writes == 2 && relays.changed == 0x3 && relays.states == 0x6);
+    assert(calls == 2 && notified == 0x3 && switched == 0x2);
+    assert(relays.portState(1) && relays.portState(2) && !relays.portState(0));
+    assert(outputIs(pins[0], false) && outputIs(pins[1], true) && outputIs(pins[2], true));
+
+    // masks beyond the available relays are rejected without switching any relay
+    changed = relays.setPorts(0xF, 0);
+    assert(changed == -1 && relays.portStates() == 0x6 && relays.writes == 2);
+    changed = relays.togglePort(3, true);
+    assert(changed == -1 && relays.writes == 2);
+
+    // replacing the outputs switches off the relays of the old outputs
+    calls    = 0;
+    notified = 0;
+    switched = 0;
+    relays.setOutputPorts(std::vector<int>(pins.begin(), pins.begin() + 1));
+    assert(relays.availableRelays() == 1 && relays.portStates() == 0);
+    assert(relays.writes == 3 && relays.changed == 0x6 && relays.states == 0);
+    assert(calls == 2 && notified == 0x6 && switched == 0);
+    assert(outputIs(pins[1], false) && outputIs(pins[2], false));
+    changed = relays.setPorts(0x2, 0x2);
+    assert(changed == -1);
+
+    return true;
 }
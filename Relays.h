@@ -2,27 +2,70 @@
 #define RELAYS_H
 
 #include <Arduino.h>
+#include <functional>
+#include <stdint.h>
 #include <vector>
 
+#define RELAY_MAX_PORTS 32 // one bit per relay in the state image
+
 /**
  * Toggle digital outputs for digital relays
+ *
+ * Relays are switched on by LOW output. The current state of all relays is kept as a bitmask (bit n = relay n on),
+ * so unchanged relays are not written again and several relays can be switched at once by setPorts().
+ * State callbacks are called only for relays that really changed their state.
  */
 class RelayPorts
 {
 public:
+    typedef std::function<void(int port, bool state)> StateCallbackFunction;
+
     RelayPorts(const std::vector<int> outputPorts = std::vector<int>());
+    virtual ~RelayPorts() {}
 
-    bool isValidPort(int port);
+    void setOutputPorts(const std::vector<int>& ports);
+
+    bool isValidPort(int port) const;
     int  setCurrentPort(int port);
     int  currentPort(void) const { return currentPortNumber; }
-    int  availableRelays(void) const { outputPorts.size(); }
+    int  availableRelays(void) const { return outputPorts.size(); }
+
+    bool     portState(int port) const;
+    uint32_t portStates(void) const { return stateImage; }
 
     int togglePort(bool state);
     int togglePort(int port, bool state);
+    int setPorts(uint32_t mask, uint32_t states);
+
+    void addStateCallback(StateCallbackFunction callback);
+
+protected:
+    virtual void writeOutputs(uint32_t changed, uint32_t states);
+
+private:
+    std::vector<int>                   outputPorts;
+    int                                currentPortNumber;
+    uint32_t                           stateImage;     // bit n set = relay n switched on
+    std::vector<StateCallbackFunction> stateCallbacks; // notified about real state changes
+};
+
+/**
+ * Unit test for RelayPorts class
+ *
+ * The outputs are written on the host only, where the pin levels are checked - on the device the relays given are
+ * just initialized off, so the test can run with the pin of a connected relay.
+ */
+class TestRelayPorts
+{
+public:
+    TestRelayPorts(const std::vector<int>& pins) :
+        pins(pins)
+    {}
+
+    virtual bool runTests();
 
 private:
-    std::vector<int> outputPorts;
-    int              currentPortNumber;
+    std::vector<int> pins; // at least 3 relays
 };
 
-#endif // RELAYS_H
\ No newline at end of file
+#endif // RELAYS_H
@@ -0,0 +1,396 @@
+/**
+ * Local thermostat rules switching relays by sensor readings without MQTT round-trip
+ */
+
+#include "RuleEngine.h"
+#include "Logger.h"
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
+/**
+ * Parse unsigned integer with at most maxDigits digits
+ */
+static bool parseUnsigned(const char*& pos, int maxDigits, int& value)
+{
+    if (!isdigit(*pos)) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < maxDigits && isdigit(*pos); ++i) {
+        value = value * 10 + (*pos++ - '0');
+    }
+    return !isdigit(*pos);
+}
+
+/**
+ * Parse decimal number with up to 2 decimals into hundredths, e.g. "-20.5" to -2050 - values beyond +/-327.67 do
+ * not fit and are rejected
+ */
+static bool parseHundredths(const char*& pos, int16_t& value)
+{
+    bool negative = (*pos == '-');
+    if (negative) {
+        ++pos;
+    }
+
+    int integer = 0;
+    if (!parseUnsigned(pos, 3, integer)) {
+        return false;
+    }
+
+    int fraction = 0;
+    if (*pos == '.') {
+        ++pos;
+        int digits = 0;
+        while (isdigit(*pos) && digits < 2) {
+            fraction = fraction * 10 + (*pos++ - '0');
+            ++digits;
+        }
+        if (digits == 0 || isdigit(*pos)) {
+            return false;
+        }
+        if (digits == 1) {
+            fraction *= 10;
+        }
+    }
+
+    int result = integer * 100 + fraction;
+    if (result > INT16_MAX) {
+        return false;
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+/**
+ * Parse time of day "hh:mm" into minute of day
+ */
+static bool parseTime(const char*& pos, int16_t& minuteOfDay)
+{
+    int hours   = 0;
+    int minutes = 0;
+    if (!parseUnsigned(pos, 2, hours) || *pos++ != ':' || !parseUnsigned(pos, 2, minutes)) {
+        return false;
+    }
+    if (hours > 23 || minutes > 59) {
+        return false;
+    }
+    minuteOfDay = hours * 60 + minutes;
+    return true;
+}
+
+static void emitInt16(uint8_t* code, int& length, int16_t value)
+{
+    code[length++] = value & 0xFF;
+    code[length++] = (value >> 8) & 0xFF;
+}
+
+static int16_t readInt16(const uint8_t* code)
+{
+    return (int16_t)(code[0] | (code[1] << 8));
+}
+
+RuleEngine::RuleEngine() :
+    rules(0),
+    errorPos(-1)
+{
+    for (int i = 0; i < RULE_MAX_SENSORS; ++i) {
+        sensors[i] = nullptr;
+    }
+    code[0] = OP_END;
+}
+
+/**
+ * Assign sensor to given index used as sensor number in rules
+ */
+bool RuleEngine::registerSensor(uint8_t index, TemperatureSensor* sensor)
+{
+    if (index >= RULE_MAX_SENSORS) {
+        return false;
+    }
+    sensors[index] = sensor;
+    return true;
+}
+
+/**
+ * Remove all rules
+ */
+void RuleEngine::clear(void)
+{
+    code[0]  = OP_END;
+    rules    = 0;
+    errorPos = -1;
+}
+
+/**
+ * Compile given rules text and replace the current rules
+ *
+ * @return FALSE on syntax errors or too many rules - the current rules are kept then and errorPosition() is set
+ */
+bool RuleEngine::compile(const char* text)
+{
+    uint8_t     newCode[RULE_CODE_SIZE];
+    int         length   = 0;
+    int         newRules = 0;
+    const char* pos      = text;
+    const char* rule     = nullptr; // start of the rule being compiled, nullptr after each complete rule
+
+    while (*pos != '\0') {
+        while (isspace(*pos) || *pos == ';') {
+            ++pos;
+        }
+        if (*pos == '\0') {
+            break;
+        }
+        rule = pos;
+
+        // longest rule: relay, load, compare and window
+        if (length + 2 + 2 + 5 + 5 + 1 > RULE_CODE_SIZE) {
+            break;
+        }
+
+        int     relay      = 0;
+        int     sensor     = 0;
+        int16_t threshold  = 0;
+        int16_t hysteresis = 0;
+
+        if (*pos++ != 'R' || !parseUnsigned(pos, 2, relay) || relay >= RELAY_MAX_PORTS || *pos++ != '=') {
+            break;
+        }
+        newCode[length++] = OP_RELAY;
+        newCode[length++] = relay;
+
+        char source = *pos++;
+        if ((source != 'T' && source != 'H') || !parseUnsigned(pos, 1, sensor) || sensor >= RULE_MAX_SENSORS) {
+            break;
+        }
+        newCode[length++] = (source == 'T') ? OP_TEMPERATURE : OP_HUMIDITY;
+        newCode[length++] = sensor;
+
+        char compare = *pos++;
+        if ((compare != '<' && compare != '>') || !parseHundredths(pos, threshold)) {
+            break;
+        }
+        if (*pos == '~' && (!parseHundredths(++pos, hysteresis) || hysteresis < 0)) {
+            break;
+        }
+        newCode[length++] = (compare == '<') ? OP_BELOW : OP_ABOVE;
+        emitInt16(newCode, length, threshold);
+        emitInt16(newCode, length, hysteresis);
+
+        if (*pos == '@') {
+            int16_t from = 0;
+            int16_t to   = 0;
+            if (!parseTime(++pos, from) || *pos++ != '-' || !parseTime(pos, to)) {
+                break;
+            }
+            newCode[length++] = OP_WINDOW;
+            emitInt16(newCode, length, from);
+            emitInt16(newCode, length, to);
+        }
+
+        while (isspace(*pos)) {
+            ++pos;
+        }
+        if (*pos != ';' && *pos != '\0') {
+            break;
+        }
+        ++newRules;
+        rule = nullptr;
+    }
+
+    // a rule may also fail at the end of the text, e.g. by an out of range number
+    if (rule != nullptr) {
+        errorPos = rule - text;
+        LOG_ERROR(RULES, "compile failed for rule at position %d of rules '%s'", errorPos, text);
+        return false;
+    }
+
+    newCode[length++] = OP_END;
+    memcpy(code, newCode, length);
+    rules    = newRules;
+    errorPos = -1;
+    LOG_INFO(RULES, "compiled %d rules into %d bytes", rules, length);
+    return true;
+}
+
+/**
+ * Evaluate all rules against the last sensor readings
+ *
+ * @param currentStates - current relay states, needed for hysteresis
+ * @param mask          - returns relays controlled by rules
+ * @param states        - returns new relay states
+ * @param minuteOfDay   - current time of day or RULE_TIME_UNKNOWN to ignore time windows
+ *
+ * @return FALSE if there are no rules
+ */
+bool RuleEngine::run(uint32_t currentStates, uint32_t& mask, uint32_t& states, int minuteOfDay) const
+{
+    mask   = 0;
+    states = 0;
+
+    uint32_t       relayBit  = 0;
+    bool           condition = false;
+    bool           valid     = false;
+    int32_t        value     = 0;
+    const uint8_t* pc        = code;
+
+    while (true) {
+        uint8_t op = *pc++;
+
+        // each new rule or the end commits the previous rule
+        if ((op == OP_RELAY || op == OP_END) && relayBit != 0) {
+            mask |= relayBit;
+            if (condition && valid) {
+                states |= relayBit;
+            }
+        }
+
+        switch (op) {
+        case OP_END:
+            return mask != 0;
+
+        case OP_RELAY:
+            relayBit  = 1UL << *pc++;
+            condition = true;
+            valid     = false;
+            break;
+
+        case OP_TEMPERATURE:
+        case OP_HUMIDITY: {
+            // read the last sampled values, TemperatureSensor subclasses would read the hardware again
+            TemperatureSensor* sensor = sensors[*pc++];
+            if (sensor == nullptr) {
+                valid = false;
+            } else if (op == OP_TEMPERATURE) {
+                valid = sensor->isTemperatureValid();
+                value = valid ? lroundf(sensor->TemperatureSensor::temperature() * 100) : 0;
+            } else {
+                valid = sensor->isHumidityValid();
+                value = valid ? lroundf(sensor->TemperatureSensor::humidity() * 100) : 0;
+            }
+            break;
+        }
+
+        case OP_BELOW:
+        case OP_ABOVE: {
+            int32_t threshold  = readInt16(pc);
+            int32_t hysteresis = readInt16(pc + 2);
+            bool    isOn       = currentStates & relayBit;
+            pc += 4;
+
+            if (op == OP_BELOW) {
+                condition = condition && (value < (isOn ? threshold + hysteresis : threshold));
+            } else {
+                condition = condition && (value > (isOn ? threshold - hysteresis : threshold));
+            }
+            break;
+        }
+
+        case OP_WINDOW: {
+            int from = readInt16(pc);
+            int to   = readInt16(pc + 2);
+            pc += 4;
+
+            if (minuteOfDay != RULE_TIME_UNKNOWN) {
+                bool inWindow = (from <= to) ? (minuteOfDay >= from && minuteOfDay < to)
+                                             : (minuteOfDay >= from || minuteOfDay < to); // window over midnight
+                condition = condition && inWindow;
+            }
+            break;
+        }
+
+        default:
+            return false; // corrupt code
+        }
+    }
+}
+
+/**
+ * Evaluate all rules and switch the relays at once
+ *
+ * @return count of relays which changed their state
+ */
+int RuleEngine::apply(RelayPorts& relays, int minuteOfDay) const
+{
+    uint32_t mask   = 0;
+    uint32_t states = 0;
+    if (!run(relays.portStates(), mask, states, minuteOfDay)) {
+        return 0;
+    }
+
+    // ignore rules for relays not connected
+    int relayCount = relays.availableRelays();
+    if (relayCount < RELAY_MAX_PORTS) {
+        mask &= (1UL << relayCount) - 1;
+    }
+
+    int changed = relays.setPorts(mask, states);
+    if (changed > 0) {
+        LOG_INFO(RULES, "rules switched %d relays, states: 0x%08X", changed, (unsigned int)relays.portStates());
+    }
+    return changed;
+}
+
+/**
+ * Unit tests for compiler and evaluation of rules
+ */
+bool TestRuleEngine::runTests()
+{
+    uint32_t mask   = 0;
+    uint32_t states = 0;
+
+    assert(engine.ruleCount() == 0);
+    assert(!engine.run(0, mask, states));
+
+    // syntax errors keep the current rules
+    assert(engine.compile("R0=T0<20.5~0.5"));
+    assert(!engine.compile("R0=T0<20.5;X1=T0>1"));
+    assert(engine.errorPosition() == 11);
+    assert(!engine.compile("R0=T9<20"));
+    assert(!engine.compile("R0=T0<20.123"));
+    assert(!engine.compile("R0=T0<20@25:00-06:00"));
+    assert(engine.ruleCount() == 1);
+
+    // thresholds and hysteresis are int16_t hundredths
+    bool compiled = engine.compile("R0=T0>-327.67~327.67");
+    assert(compiled);
+    compiled = engine.compile("R0=T0<327.68");
+    assert(!compiled);
+    compiled = engine.compile("R0=H0>999.99");
+    assert(!compiled);
+    compiled = engine.compile("R0=T0<20~400");
+    assert(!compiled);
+    compiled = engine.compile("R0=T0<");
+    assert(!compiled);
+    compiled = engine.compile("R0=T0<20.5~0.5");
+    assert(compiled);
+
+    // invalid sensor value switches off
+    assert(engine.registerSensor(0, &sensor));
+    assert(engine.run(0, mask, states) && mask == 1 && states == 0);
+
+    // hysteresis
+    sensor.setTemperature(20.0);
+    assert(engine.run(0, mask, states) && states == 1);
+    sensor.setTemperature(20.7);
+    assert(engine.run(0, mask, states) && states == 0); // off: stays off above 20.5
+    assert(engine.run(1, mask, states) && states == 1); // on: stays on below 21.0
+    sensor.setTemperature(21.0);
+    assert(engine.run(1, mask, states) && states == 0);
+
+    // time window over midnight and multiple rules
+    assert(engine.compile(" R0=T0>-5@22:00-06:00 ; R2=H0>65.5"));
+    assert(engine.ruleCount() == 2);
+    assert(engine.run(0, mask, states, 23 * 60) && mask == 5 && states == 1); // humidity invalid
+    sensor.setHumidity(70);
+    assert(engine.run(0, mask, states, 23 * 60) && states == 5);
+    assert(engine.run(0, mask, states, 12 * 60) && states == 4);
+    assert(engine.run(0, mask, states, RULE_TIME_UNKNOWN) && states == 5);
+
+    engine.clear();
+    assert(engine.ruleCount() == 0);
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef RULEENGINE_H
+#define RULEENGINE_H
+
+/**
+ * Local thermostat rules switching relays by sensor readings without MQTT round-trip
+ */
+
+#include "Relays.h"
+#include "TemperatureSensor.h"
+#include <stdint.h>
+
+#define RULE_MAX_SENSORS 4
+#define RULE_CODE_SIZE 96      // bytes of compiled rules
+#define RULE_TIME_UNKNOWN -1   // minute of day if clock is not set - time windows are ignored then
+
+/**
+ * Rule engine evaluating compiled threshold, hysteresis and time window rules on every sample
+ *
+ * Rules are compiled from a compact text, separated by ';', each in the format:
+ *
+ *      R<relay>=<T|H><sensor><'<'|'>'><threshold>[~<hysteresis>][@<hh:mm>-<hh:mm>]
+ *
+ * @li R0=T0<20.5~0.5            - relay 0 on below 20.5 °C of sensor 0, off again above 21.0 °C
+ * @li R1=H0>65@08:00-20:00     - relay 1 on above 65 % humidity of sensor 0, only between 8:00 and 20:00
+ *
+ * The text is compiled into a flat bytecode, so evaluation needs neither parsing nor heap. A relay is switched on
+ * if any of its rules matches, otherwise off - also if the sensor value is invalid. All relays are switched by one
+ * RelayPorts::setPorts() call.
+ */
+class RuleEngine
+{
+public:
+    RuleEngine();
+
+    bool registerSensor(uint8_t index, TemperatureSensor* sensor);
+
+    bool compile(const char* text);
+    void clear(void);
+    int  ruleCount(void) const { return rules; }
+    int  errorPosition(void) const { return errorPos; }
+
+    bool run(uint32_t currentStates, uint32_t& mask, uint32_t& states, int minuteOfDay = RULE_TIME_UNKNOWN) const;
+    int  apply(RelayPorts& relays, int minuteOfDay = RULE_TIME_UNKNOWN) const;
+
+protected:
+    enum OpCodes
+    {
+        OP_END         = 0, //                               - end of rules
+        OP_RELAY       = 1, // <relay>                       - start of rule for relay
+        OP_TEMPERATURE = 2, // <sensor>                      - load temperature of sensor in 1/100 °C
+        OP_HUMIDITY    = 3, // <sensor>                      - load humidity of sensor in 1/100 %
+        OP_BELOW       = 4, // <threshold:2> <hysteresis:2>  - condition: value below threshold
+        OP_ABOVE       = 5, // <threshold:2> <hysteresis:2>  - condition: value above threshold
+        OP_WINDOW      = 6  // <from:2> <to:2>               - condition: minute of day in window
+    };
+
+private:
+    TemperatureSensor* sensors[RULE_MAX_SENSORS];
+    uint8_t            code[RULE_CODE_SIZE]; // compiled rules terminated by OP_END
+    int                rules;                // count of compiled rules
+    int                errorPos;             // position of the rule failing to compile in text or -1
+};
+
+/**
+ * Unit test for RuleEngine class
+ */
+class TestRuleEngine
+{
+public:
+    virtual bool runTests();
+
+private:
+    RuleEngine        engine;
+    TemperatureSensor sensor;
+};
+
+#endif // RULEENGINE_H
@@ -0,0 +1,506 @@
+#include "SampleHistory.h"
+#include "Logger.h"
+#include <Arduino.h>
+#include <assert.h>
+#include <math.h>
+#include <memory>
+#include <string.h>
+
+/**
+ * Append the lowest count bits of value to the block, most significant bit first
+ */
+static void writeBits(SampleHistory::Block& block, uint32_t value, uint8_t count)
+{
+    while (count > 0) {
+        --count;
+        if ((value >> count) & 1) {
+            block.data[block.bits >> 3] |= 0x80 >> (block.bits & 7);
+        }
+        ++block.bits;
+    }
+}
+
+/**
+ * Read count bits from given bit position of the block and advance the position
+ */
+static uint32_t readBits(const SampleHistory::Block& block, uint16_t& position, uint8_t count)
+{
+    uint32_t value = 0;
+    while (count > 0) {
+        --count;
+        value = (value << 1) | ((block.data[position >> 3] >> (7 - (position & 7))) & 1);
+        ++position;
+    }
+    return value;
+}
+
+/**
+ * Return the lowest count bits of value as signed number
+ */
+static int32_t signExtend(uint32_t value, uint8_t count)
+{
+    uint32_t sign = 1UL << (count - 1);
+    return (int32_t)((value ^ sign) - sign);
+}
+
+/**
+ * Bits of the delta-of-delta code of a timestamp, see SampleHistory
+ */
+static uint8_t timeCodeBits(int32_t deltaOfDelta)
+{
+    if (deltaOfDelta == 0) {
+        return 1;
+    }
+    if (deltaOfDelta >= -64 && deltaOfDelta < 64) {
+        return 2 + 7;
+    }
+    if (deltaOfDelta >= -2048 && deltaOfDelta < 2048) {
+        return 3 + 12;
+    }
+    return 3 + 32;
+}
+
+/**
+ * Bits of the delta code of a quantized value, see SampleHistory
+ */
+static uint8_t valueCodeBits(int32_t delta)
+{
+    if (delta == 0) {
+        return 1;
+    }
+    if (delta >= -4 && delta < 4) {
+        return 2 + 3;
+    }
+    if (delta >= -128 && delta < 128) {
+        return 3 + 8;
+    }
+    return 3 + 16;
+}
+
+SampleHistory::SampleHistory(Block* blocks, uint8_t blockCount, float resolution) :
+    blocks(blocks),
+    blockCount(blockCount),
+    step(resolution)
+{
+    clear();
+}
+
+/**
+ * Remove all samples
+ */
+void SampleHistory::clear(void)
+{
+    first        = 0;
+    used         = 0;
+    encodedTime  = 0;
+    encodedDelta = 0;
+    encodedValue = 0;
+}
+
+/**
+ * Start a new block with given first sample, dropping the oldest block if all blocks are used
+ */
+void SampleHistory::startBlock(uint32_t time, int16_t value)
+{
+    if (used == blockCount) {
+        first = (first + 1) % blockCount;
+    } else {
+        ++used;
+    }
+
+    Block& current = currentBlock();
+    memset(&current, 0, sizeof(current));
+    current.firstTime  = time;
+    current.lastTime   = time;
+    current.firstValue = value;
+    current.count      = 1;
+    encodedDelta       = 0;
+}
+
+/**
+ * Append a sample
+ *
+ * @param time      e.g. seconds since boot, not less than the time of the previous sample
+ * @param value     sensor value, rounded to resolution()
+ * @return FALSE for invalid values (NaN or out of range after quantization) and times before the last sample
+ */
+bool SampleHistory::add(uint32_t time, float value)
+{
+    if (std::isnan(value) || blockCount == 0) {
+        return false;
+    }
+    long quantized = lroundf(value / step);
+    if (quantized < INT16_MIN || quantized > INT16_MAX || (used > 0 && time < encodedTime)) {
+        return false;
+    }
+
+    int32_t delta = (int32_t)(time - encodedTime);
+    if (used == 0 || currentBlock().count == UINT16_MAX ||
+        currentBlock().bits + timeCodeBits((int32_t)((uint32_t)delta - (uint32_t)encodedDelta)) + valueCodeBits(quantized - encodedValue) > HISTORY_BLOCK_SIZE * 8) {
+        startBlock(time, quantized);
+        encodedTime  = time;
+        encodedValue = quantized;
+        return true;
+    }
+
+    Block&  current      = currentBlock();
+    int32_t deltaOfDelta = (int32_t)((uint32_t)delta - (uint32_t)encodedDelta);
+    switch (timeCodeBits(deltaOfDelta)) {
+    case 1:
+        writeBits(current, 0, 1);
+        break;
+    case 2 + 7:
+        writeBits(current, 0x2, 2);
+        writeBits(current, deltaOfDelta, 7);
+        break;
+    case 3 + 12:
+        writeBits(current, 0x6, 3);
+        writeBits(current, deltaOfDelta, 12);
+        break;
+    default:
+        writeBits(current, 0x7, 3);
+        writeBits(current, delta, 32);
+        break;
+    }
+
+    int32_t valueDelta = quantized - encodedValue;
+    switch (valueCodeBits(valueDelta)) {
+    case 1:
+        writeBits(current, 0, 1);
+        break;
+    case 2 + 3:
+        writeBits(current, 0x2, 2);
+        writeBits(current, valueDelta, 3);
+        break;
+    case 3 + 8:
+        writeBits(current, 0x6, 3);
+        writeBits(current, valueDelta, 8);
+        break;
+    default:
+        writeBits(current, 0x7, 3);
+        writeBits(current, (uint16_t)quantized, 16);
+        break;
+    }
+
+    ++current.count;
+    current.lastTime = time;
+    encodedTime      = time;
+    encodedDelta     = delta;
+    encodedValue     = quantized;
+    return true;
+}
+
+/**
+ * Return count of stored samples
+ */
+uint32_t SampleHistory::size(void) const
+{
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < used; ++i) {
+        count += block(i).count;
+    }
+    return count;
+}
+
+/**
+ * Return bytes of encoded samples including the uncompressed first samples of each block
+ */
+size_t SampleHistory::encodedBytes(void) const
+{
+    size_t bytes = 0;
+    for (uint8_t i = 0; i < used; ++i) {
+        bytes += (block(i).bits + 7) / 8 + sizeof(uint32_t) + sizeof(int16_t);
+    }
+    return bytes;
+}
+
+/**
+ * Average the samples from time from to to in equal time buckets, e.g. for a graph or a MQTT history request
+ *
+ * @param averages  array of given count of buckets, set to NaN for buckets without samples
+ * @return count of samples within the time range
+ */
+size_t SampleHistory::query(uint32_t from, uint32_t to, float* averages, size_t buckets) const
+{
+    int32_t  sums[HISTORY_MAX_QUERY_BUCKETS];
+    uint16_t counts[HISTORY_MAX_QUERY_BUCKETS];
+    if (buckets == 0 || buckets > HISTORY_MAX_QUERY_BUCKETS || to < from) {
+        return 0;
+    }
+    memset(sums, 0, buckets * sizeof(sums[0]));
+    memset(counts, 0, buckets * sizeof(counts[0]));
+
+    Reader   reader(*this, from);
+    uint32_t time;
+    int16_t  value;
+    size_t   count = 0;
+    uint64_t range = (uint64_t)to - from + 1;
+    while (reader.nextRaw(time, value) && time <= to) {
+        size_t bucket = (uint64_t)(time - from) * buckets / range;
+        sums[bucket] += value;
+        if (counts[bucket] < UINT16_MAX) {
+            ++counts[bucket];
+        }
+        ++count;
+    }
+
+    for (size_t i = 0; i < buckets; ++i) {
+        averages[i] = counts[i] > 0 ? sums[i] * step / counts[i] : NAN;
+    }
+    return count;
+}
+
+/**
+ * Start reading at the first block holding samples since given time
+ */
+SampleHistory::Reader::Reader(const SampleHistory& history, uint32_t from) :
+    history(history),
+    from(from),
+    block(0)
+{
+    while (block < history.used && history.block(block).lastTime < from) {
+        ++block;
+    }
+    startBlock(block);
+}
+
+bool SampleHistory::Reader::startBlock(uint8_t index)
+{
+    block    = index;
+    position = 0;
+    sample   = 0;
+    return block < history.used;
+}
+
+/**
+ * Decode the next sample
+ *
+ * @return FALSE after the last sample
+ */
+bool SampleHistory::Reader::next(uint32_t& time, float& value)
+{
+    int16_t quantized;
+    if (!nextRaw(time, quantized)) {
+        return false;
+    }
+    value = quantized * history.step;
+    return true;
+}
+
+bool SampleHistory::Reader::nextRaw(uint32_t& time, int16_t& value)
+{
+    while (decode(time, value)) {
+        if (time >= from) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SampleHistory::Reader::decode(uint32_t& time, int16_t& value)
+{
+    if (block < history.used && sample >= history.block(block).count) {
+        startBlock(block + 1);
+    }
+    if (block >= history.used) {
+        return false;
+    }
+
+    const Block& current = history.block(block);
+    if (sample++ == 0) {
+        lastTime  = current.firstTime;
+        lastDelta = 0;
+        lastValue = current.firstValue;
+        time      = lastTime;
+        value     = lastValue;
+        return true;
+    }
+
+    if (readBits(current, position, 1) == 0) {
+        // same interval
+    } else if (readBits(current, position, 1) == 0) {
+        lastDelta += signExtend(readBits(current, position, 7), 7);
+    } else if (readBits(current, position, 1) == 0) {
+        lastDelta += signExtend(readBits(current, position, 12), 12);
+    } else {
+        lastDelta = readBits(current, position, 32);
+    }
+    lastTime += lastDelta;
+
+    if (readBits(current, position, 1) == 0) {
+        // same value
+    } else if (readBits(current, position, 1) == 0) {
+        lastValue += signExtend(readBits(current, position, 3), 3);
+    } else if (readBits(current, position, 1) == 0) {
+        lastValue += signExtend(readBits(current, position, 8), 8);
+    } else {
+        lastValue = (int16_t)readBits(current, position, 16);
+    }
+
+    time  = lastTime;
+    value = lastValue;
+    return true;
+}
+
+/**
+ * Return seconds since boot by millis()
+ */
+uint32_t SecondsClock::now(void)
+{
+    return now(millis());
+}
+
+/**
+ * Return seconds of given millis() value, counting a wrap if it is below the last value
+ */
+uint32_t SecondsClock::now(uint32_t milliseconds)
+{
+    if (milliseconds < lastMillis) {
+        ++wraps;
+    }
+    lastMillis = milliseconds;
+    return (uint32_t)((((uint64_t)wraps << 32) | milliseconds) / 1000);
+}
+
+/**
+ * Test temperature of 10 second samples with daily cycle and sensor noise of one resolution step
+ */
+static float testTemperature(int index)
+{
+    return 21.0 + 1.5 * sin(index * 2 * M_PI / 8640) + ((index * 7919) % 5 == 0 ? 0.1 : 0.0);
+}
+
+/**
+ * Unit tests for encoding, decoding, ring overflow and range queries
+ */
+bool TestSampleHistory::runTests()
+{
+    std::unique_ptr<StaticSampleHistory<HISTORY_BLOCKS>> storage(new StaticSampleHistory<HISTORY_BLOCKS>());
+    SampleHistory&                                       history = *storage;
+    uint32_t                                             time;
+    float                                                value;
+    float                                                averages[4];
+
+    assert(history.size() == 0);
+    assert(history.query(0, 100, averages, 4) == 0);
+    assert(std::isnan(averages[0]));
+    assert(!SampleHistory::Reader(history).next(time, value));
+
+    // 12 hours of 10 second samples with slightly irregular intervals
+    for (int i = 0; i < 4320; ++i) {
+        assert(history.add(i * 10 + (i % 50 == 0 ? 1 : 0), testTemperature(i)));
+    }
+    assert(history.size() == 4320);
+    assert(history.firstTime() == 1);
+    assert(history.encodedBytes() < 4320 * 8 / 10);
+
+    SampleHistory::Reader reader(history);
+    for (int i = 0; i < 4320; ++i) {
+        assert(reader.next(time, value));
+        assert(time == (uint32_t)(i * 10 + (i % 50 == 0 ? 1 : 0)));
+        assert(fabs(value - testTemperature(i)) <= 0.05 + 1e-4);
+    }
+    assert(!reader.next(time, value));
+
+    // invalid samples
+    assert(!history.add(43200, NAN));
+    assert(!history.add(0, 20.0));
+    assert(!history.add(43200, 4000.0));
+
+    // large gaps and jumps keep exact values
+    StaticSampleHistory<2> small;
+    assert(small.add(100, -10.0));
+    assert(small.add(100, 80.0));
+    assert(small.add(90000, 79.9));
+    assert(small.add(4000000000UL, -3000.0));
+    SampleHistory::Reader jumps(small);
+    assert(jumps.next(time, value) && time == 100 && fabs(value + 10.0) < 1e-3);
+    assert(jumps.next(time, value) && time == 100 && fabs(value - 80.0) < 1e-3);
+    assert(jumps.next(time, value) && time == 90000 && fabs(value - 79.9) < 1e-3);
+    assert(jumps.next(time, value) && time == 4000000000UL && fabs(value + 3000.0) < 1e-2);
+
+    // the oldest block is dropped when full
+    small.clear();
+    for (int i = 0; i < 2000; ++i) {
+        assert(small.add(i, i % 100 ? 20.0 : 30.0));
+    }
+    assert(small.size() < 2000);
+    assert(small.firstTime() > 0);
+    assert(small.lastTime() == 1999);
+    SampleHistory::Reader ring(small);
+    uint32_t              count = 0;
+    while (ring.next(time, value)) {
+        assert(time == small.firstTime() + count);
+        ++count;
+    }
+    assert(count == small.size());
+
+    // averages of four hours in four buckets
+    assert(history.query(3600, 4 * 3600 + 3599, averages, 4) == 4 * 360);
+    SampleHistory::Reader hour(history, 3600);
+    for (int i = 0; i < 4; ++i) {
+        float sum = 0;
+        for (int j = 0; j < 360; ++j) {
+            hour.next(time, value);
+            sum += value;
+        }
+        assert(fabs(averages[i] - sum / 360) < 0.01);
+    }
+    assert(history.query(100000, 200000, averages, 4) == 0);
+
+    // sample times keep increasing across the wrap of millis() after 49.7 days
+    SecondsClock clock;
+    uint32_t     before = clock.now(0xFFFFFFFFUL - 5000);
+    uint32_t     after  = clock.now(5000);
+    assert(before == 4294962 && after == 4294972);
+    small.clear();
+    assert(small.add(before, 20.0));
+    assert(small.add(after, 20.1));
+    assert(small.add(clock.now(15000), 20.2));
+    assert(small.lastTime() == 4294982);
+    assert(small.query(before, before + 30, averages, 1) == 3);
+    assert(fabs(averages[0] - 20.1) < 1e-3);
+
+    // later values within the same period count no further wrap
+    after = clock.now(0x80000000UL);
+    assert(after == (uint32_t)((0x100000000ULL + 0x80000000ULL) / 1000));
+
+    return true;
+}
+
+/**
+ * Log compression ratio and encode/decode time of given count of 10 second temperature samples
+ */
+void TestSampleHistory::runBenchmark(int samples)
+{
+    std::unique_ptr<StaticSampleHistory<HISTORY_BLOCKS * 2>> history(new StaticSampleHistory<HISTORY_BLOCKS * 2>());
+
+    unsigned long start = micros();
+    for (int i = 0; i < samples; ++i) {
+        history->add(i * 10, testTemperature(i));
+    }
+    unsigned long encodeTime = micros() - start;
+
+    SampleHistory::Reader reader(*history);
+    uint32_t              time;
+    float                 value;
+    start = micros();
+    while (reader.next(time, value)) {
+    }
+    unsigned long decodeTime = micros() - start;
+
+    uint32_t stored = history->size();
+    size_t   bytes  = history->encodedBytes();
+    LOG_INFO(HISTORY, "%u samples in %u bytes: %u.%02u bits/sample, ratio %u:1 to time+float",
+             (unsigned int)stored, (unsigned int)bytes, (unsigned int)(bytes * 8 / stored),
+             (unsigned int)(bytes * 800 / stored % 100), (unsigned int)(stored * 8 / bytes));
+    LOG_INFO(HISTORY, "encode %lu ns/sample, decode %lu ns/sample", encodeTime * 1000 / samples,
+             decodeTime * 1000 / stored);
+
+    // the history request of the sketch: averages of the whole time range in 12 buckets
+    float averages[12];
+    start = micros();
+    size_t queried = history->query(0, samples * 10, averages, 12);
+    unsigned long queryTime = micros() - start;
+    LOG_INFO(HISTORY, "query %u samples into 12 buckets: %lu us", (unsigned int)queried, queryTime);
+}
@@ -0,0 +1,145 @@
+#ifndef SAMPLEHISTORY_H
+#define SAMPLEHISTORY_H
+
+/**
+ * Compressed in-RAM history of sensor samples
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_BLOCK_SIZE 64         // bytes of encoded samples per block
+#define HISTORY_BLOCKS 64             // default blocks per sensor, 5 KB for about a day of 10 second samples
+#define HISTORY_MAX_QUERY_BUCKETS 128 // max averages per query(), e.g. one per display column
+
+/**
+ * Time series of one sensor in a ring of fixed-size blocks, the oldest block is dropped when all are full
+ *
+ * Each block holds the first sample uncompressed and all following samples as variable-length bit codes:
+ *
+ * @li timestamp as delta-of-delta: '0' for same interval as before, '10' + 7 bits, '110' + 12 bits or '111' + 32
+ *     bits interval
+ * @li value quantized to given resolution as delta: '0' for same value, '10' + 3 bits, '110' + 8 bits or '111' + 16
+ *     bits value
+ *
+ * So a steady 10 second interval and slowly changing temperatures take 2 to 7 bits per sample instead of 8 bytes
+ * for time and float value.
+ * Samples are encoded by add() and decoded in order by Reader, neither allocates memory. The storage is given by
+ * StaticSampleHistory.
+ */
+class SampleHistory
+{
+public:
+    /**
+     * Encoded samples with uncompressed first sample
+     */
+    struct Block
+    {
+        uint32_t firstTime;
+        uint32_t lastTime;
+        int16_t  firstValue; // quantized
+        uint16_t count;      // samples including the first one
+        uint16_t bits;       // used bits of data
+        uint8_t  data[HISTORY_BLOCK_SIZE];
+    };
+
+    /**
+     * Streaming decoder of the samples since given time in order
+     */
+    class Reader
+    {
+    public:
+        Reader(const SampleHistory& history, uint32_t from = 0);
+
+        bool next(uint32_t& time, float& value);
+
+    private:
+        friend class SampleHistory;
+
+        bool nextRaw(uint32_t& time, int16_t& value);
+        bool decode(uint32_t& time, int16_t& value);
+        bool startBlock(uint8_t index);
+
+        const SampleHistory& history;
+        uint32_t             from;
+        uint8_t              block;    // blocks read since the oldest one
+        uint16_t             position; // bit position in current block
+        uint16_t             sample;   // samples read from current block
+        uint32_t             lastTime;
+        int32_t              lastDelta;
+        int16_t              lastValue;
+    };
+
+    SampleHistory(Block* blocks, uint8_t blockCount, float resolution = 0.1);
+
+    bool add(uint32_t time, float value);
+    void clear(void);
+
+    size_t query(uint32_t from, uint32_t to, float* averages, size_t buckets) const;
+
+    uint32_t size(void) const;
+    uint32_t firstTime(void) const { return used > 0 ? blocks[first].firstTime : 0; }
+    uint32_t lastTime(void) const { return used > 0 ? encodedTime : 0; }
+    size_t   encodedBytes(void) const;
+    size_t   memoryUsage(void) const { return blockCount * sizeof(Block); }
+    float    resolution(void) const { return step; }
+
+private:
+    Block& block(uint8_t index) const { return blocks[(first + index) % blockCount]; }
+    Block& currentBlock(void) const { return block(used - 1); }
+    void   startBlock(uint32_t time, int16_t value);
+
+    Block*   blocks;
+    uint8_t  blockCount;
+    uint8_t  first;        // index of the oldest block
+    uint8_t  used;         // blocks in use, the last one is encoded to
+    float    step;         // resolution of the quantized values
+    uint32_t encodedTime;  // encoder state: last sample time
+    int32_t  encodedDelta; // last sample interval
+    int16_t  encodedValue; // last quantized value
+};
+
+/**
+ * SampleHistory with storage for given count of blocks, e.g. as global object
+ */
+template <uint8_t Blocks>
+class StaticSampleHistory : public SampleHistory
+{
+public:
+    StaticSampleHistory(float resolution = 0.1) :
+        SampleHistory(storage, Blocks, resolution)
+    {}
+
+private:
+    Block storage[Blocks];
+};
+
+/**
+ * Seconds since boot continued across the wrap of millis() after 49.7 days
+ *
+ * millis() / 1000 jumps back from 4294967 to 0 at the wrap, so history times would go backwards. The clock counts
+ * the wraps of the millisecond values it is given, its seconds wrap after 136 years. It must be called at least once
+ * per wrap period, e.g. by each loop() run.
+ */
+class SecondsClock
+{
+public:
+    uint32_t now(void);
+    uint32_t now(uint32_t milliseconds);
+
+private:
+    uint32_t lastMillis = 0;
+    uint32_t wraps      = 0; // of the millisecond counter
+};
+
+/**
+ * Unit test and benchmark for SampleHistory class
+ */
+class TestSampleHistory
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(int samples = 8640);
+};
+
+#endif // SAMPLEHISTORY_H
@@ -3,17 +3,35 @@
  */
 
 #include "SensorDHT.h"
+#include "Logger.h"
 
 /**
  * Constructor with default pin setting
  */
 SensorDHT::SensorDHT(int pin, int model, float temperatureOffset) :
     sensor(pin, model),
+    sensorPin(pin),
+    sensorModel(model),
     temperatureOffsetValue(temperatureOffset)
 {
     setTemperatureUnit(CELSIUS_DEGREES); // sensor data are in celsius degrees by default
 }
 
+/**
+ * Move the sensor to given pin, e.g. after a configuration change
+ */
+void SensorDHT::setPin(int pin)
+{
+    if (pin == sensorPin) {
+        return;
+    }
+    sensor.setPin(pin);
+    sensorPin = pin;
+    clearTemperature();
+    clearHumidity();
+    LOG_INFO(DHT, "sensor moved to pin %d", pin);
+}
+
 /**
  * Read current sensor value and return its current value on success, otherwise return last value
  */
@@ -51,21 +69,16 @@ float SensorDHT::humidity(void)
      */
 bool SensorDHT::readSensorTemperature(float& temperature, float offset)
 {
-    float sensorValue = sensor.readTemperature();
-
-    if (isnan(sensorValue)) {
-        Serial.println("Failed to read from DHT sensor!");
+    DhtReceiver::Status status = sensor.read();
+    if (status != DhtReceiver::OK) {
+        LOG_ERROR(DHT, "failed to read temperature from DHT sensor: %s", DhtReceiver::statusText(status));
         return false;
     }
-    Serial.print("Temperature: ");
-    Serial.print(sensorValue);
-    Serial.print(" °C (raw)");
+    float sensorValue = sensor.temperature();
+    float corrected   = calibratedTemperature(sensorValue) + offset;
+    LOG_DEBUG(DHT, "temperature: %.1f °C (raw) %.1f °C (corrected)", sensorValue, corrected);
 
-    sensorValue += offset;
-    Serial.print(sensorValue);
-    Serial.println(" °C (corrected)");
-
-    temperature = sensorValue;
+    temperature = corrected;
     return true;
 }
 
@@ -74,15 +87,13 @@ bool SensorDHT::readSensorTemperature(float& temperature, float offset)
     */
 bool SensorDHT::readSensorHumidity(float& humidity)
 {
-    float sensorValue = sensor.readHumidity();
-
-    if (isnan(sensorValue)) {
-        Serial.println("Failed to read from DHT sensor!");
+    DhtReceiver::Status status = sensor.read();
+    if (status != DhtReceiver::OK) {
+        LOG_ERROR(DHT, "failed to read humidity from DHT sensor: %s", DhtReceiver::statusText(status));
         return false;
     }
-    Serial.print("Humidity: ");
-    Serial.print(sensorValue);
-    Serial.println(" %");
+    float sensorValue = sensor.humidity();
+    LOG_DEBUG(DHT, "humidity: %.1f %%", sensorValue);
 
     humidity = sensorValue;
     return true;
@@ -5,15 +5,22 @@
  * Temperature and humidity sensor DHT11/DHT22/AM2302 based on base class TemperatureSensor
  */
 
+#include "DhtReceiver.h"
 #include "TemperatureSensor.h"
 #include <Arduino.h>
 #include <DHT.h>
 
-#define DHT_IN D5 // what pin the DHT is connected to
+#if defined(ESP32)
+#define DHT_IN 14 // what pin the DHT is connected to
+#else
+#define DHT_IN D5
+#endif
 #define DHT_TEMP_OFFSET -2.7
 
 /**
  * Read and display temperature via DHT11 or DHT22/AM2302 sensor
+ *
+ * Temperature and humidity are taken from the same frame, which is received by DhtReceiver with interrupts enabled.
  */
 class SensorDHT : public TemperatureSensor
 {
@@ -23,13 +30,18 @@ public:
     virtual float temperature(void);
     virtual float humidity(void);
 
+    void setPin(int pin);
+    void setTemperatureOffset(float offset) { temperatureOffsetValue = offset; }
+
 protected:
     bool readSensorTemperature(float& temperature, float offset = 0.0);
     bool readSensorHumidity(float& humidity);
 
 private:
-    DHT   sensor;                 // API for AM23xx and DHTxx sensors
-    float temperatureOffsetValue; // offset to normalize temperature values i.e. in cause of shifted sensor values
+    DhtReceiver sensor;                 // frame receiver for AM23xx and DHTxx sensors
+    int         sensorPin;              // pin of the sensor data line
+    int         sensorModel;            // DHT11, DHT22, ...
+    float       temperatureOffsetValue; // offset to normalize temperature values i.e. in cause of shifted sensor values
 };
 
 #endif // SENSORDHT_H
\ No newline at end of file
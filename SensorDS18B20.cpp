@@ -2,6 +2,7 @@
  * Temperature sensor DS18b20 based on base class TemperatureSensor
  */
 #include "SensorDS18B20.h"
+#include "Logger.h"
 
 #define TEMPERATURE_PRECISION 9
 
@@ -9,13 +10,30 @@
 OneWire oneWire(ONEWIRE_IN);
 
 /**
- * Initialize Dallas sensor API and temperature offset in Celsius degrees
+ * Initialize Dallas sensor API on given pin and temperature offset in Celsius degrees
  */
 SensorDS18B20::SensorDS18B20(int pin, float temperatureOffset) :
-    sensors(&oneWire),
+    dallasBus(&oneWire),
+    sensors(&dallasBus),
+    pin(pin),
     sensorsInitialized(false),
     temperatureOffset(temperatureOffset)
 {
+    currentSensorName[0] = '\0';
+    clearCalibrations();
+}
+
+/**
+ * Initialize with given 1wire bus, e.g. a SimulatedTemperatureBus, and temperature offset in Celsius degrees
+ */
+SensorDS18B20::SensorDS18B20(TemperatureBus* bus, float temperatureOffset) :
+    dallasBus(&oneWire),
+    sensors(bus),
+    sensorsInitialized(false),
+    temperatureOffset(temperatureOffset)
+{
+    currentSensorName[0] = '\0';
+    clearCalibrations();
 }
 
 /**
@@ -25,17 +43,23 @@ SensorDS18B20::SensorDS18B20(int pin, float temperatureOffset) :
  */
 float SensorDS18B20::temperature(void)
 {
-    if (registeredSensors.empty()) {
+    // try to find current sensor name otherwise take first registered sensor
+    SensorData* data = findSensor(currentSensorName);
+    if (!data) {
+        data = registeredSensors.find([](const SensorData&) { return true; });
+    }
+    if (!data) {
         return NAN;
     }
 
-    // try to find current sensor name otherwise take first registered sensor
-    std::map<std::string, SensorData>::iterator it = registeredSensors.find(currentSensorName);
-    if (it == registeredSensors.end()) {
-        it = registeredSensors.begin();
+    // keep value of current sensor in base class, e.g. for isTemperatureValid()
+    float value = readSensorTemperature(*data, temperatureOffset) ? data->lastTemperature : NAN;
+    if (std::isnan(value)) {
+        clearTemperature();
+    } else {
+        setTemperature(value);
     }
-
-    return temperature(it->first);
+    return value;
 }
 
 /**
@@ -43,19 +67,14 @@ float SensorDS18B20::temperature(void)
  * 
  * @return NAN on any error, otherwise last temperature value read form given sensor
  */
-float SensorDS18B20::temperature(const std::string& name)
+float SensorDS18B20::temperature(const char* name)
 {
-    std::map<std::string, SensorData>::iterator it = registeredSensors.find(name);
-    if (it == registeredSensors.end()) {
+    SensorData* data = findSensor(name);
+    if (!data || !readSensorTemperature(*data, temperatureOffset)) {
         return NAN;
     }
 
-    SensorData& data = it->second;
-    if (!readSensorTemperature(data)) {
-        return NAN;
-    }
-
-    return data.lastTemperature;
+    return data->lastTemperature;
 }
 
 /**
@@ -63,21 +82,77 @@ float SensorDS18B20::temperature(const std::string& name)
  * 
  * @return FALSE on any error, e.g. if no sensor of given name was found
  */
-bool SensorDS18B20::setCurrentSensor(const std::string& name)
+bool SensorDS18B20::setCurrentSensor(const char* name)
 {
-    std::map<std::string, SensorData>::iterator it = registeredSensors.find(name);
-    if (it == registeredSensors.end()) {
+    if (!findSensor(name)) {
         return false;
     }
 
-    currentSensorName = name;
+    strncpy(currentSensorName, name, sizeof(currentSensorName) - 1);
+    currentSensorName[sizeof(currentSensorName) - 1] = '\0';
     return true;
 }
 
+/**
+ * Set calibration curve of the sensor of given name, which replaces the curve of all sensors for it - an empty
+ * curve removes it
+ *
+ * @return FALSE for invalid curves, names too long or more than DS18B20_MAX_CURVES curves
+ */
+bool SensorDS18B20::setCalibration(const char* name, const CalibrationTable& table)
+{
+    if (!name || name[0] == '\0' || strlen(name) >= DS18B20_NAME_LENGTH) {
+        return false;
+    }
+    SensorCurve* entry = nullptr;
+    for (SensorCurve& curve : sensorCurves) {
+        if (strcmp(curve.name, name) == 0) {
+            entry = &curve;
+            break;
+        }
+        if (!entry && curve.name[0] == '\0') {
+            entry = &curve;
+        }
+    }
+    Calibration prepared;
+    if (!prepared.set(table)) {
+        return false;
+    }
+    if (!entry) {
+        return table.count == 0; // nothing to remove
+    }
+
+    if (table.count == 0) {
+        entry->name[0] = '\0';
+    } else {
+        strcpy(entry->name, name);
+        entry->table = table;
+    }
+    if (SensorData* data = findSensor(name)) {
+        data->calibration = prepared;
+    }
+    return true;
+}
+
+/**
+ * Remove the calibration curves of all single sensors
+ */
+void SensorDS18B20::clearCalibrations(void)
+{
+    for (SensorCurve& curve : sensorCurves) {
+        curve.name[0] = '\0';
+    }
+    for (size_t i = 0; i < registeredSensors.capacity(); ++i) {
+        if (SensorData* data = registeredSensors.at(i)) {
+            data->calibration.clear();
+        }
+    }
+}
+
 /**
  * Return name of current default sensor or empty string, if none was set
  */
-std::string SensorDS18B20::currentSensor(void) const
+const char* SensorDS18B20::currentSensor(void) const
 {
     return currentSensorName;
 }
@@ -85,80 +160,106 @@ std::string SensorDS18B20::currentSensor(void) const
 /**
  * Assign given name to given sensor hardware address - works for 
  */
-bool SensorDS18B20::registerSensor(DeviceAddress address, std::string name)
+bool SensorDS18B20::registerSensor(DeviceAddress address, const char* name)
 {
-    if (name.empty()) {
+    if (!name || name[0] == '\0') {
         return false;
     }
 
-    std::map<std::string, SensorData>::iterator it = registeredSensors.begin();
-    while (it != registeredSensors.end()) {
-        if (it->second.isEqual(address)) {
-            SensorData data = it->second;
-            registeredSensors.erase(it);
-            registeredSensors[name] = data;
-            return true;
-        }
-        ++it;
+    SensorData* data = findSensor(address);
+    if (data) {
+        data->setName(name);
+        updateCalibration(*data);
+        return true;
     }
 
-    registeredSensors[name] = SensorData(0, address, name);
+    data = registeredSensors.create(0, address, name);
+    if (!data) {
+        LOG_ERROR(DS18B20, "failed to register sensor '%s' - more than %d sensors", name, DS18B20_MAX_SENSORS);
+        return false;
+    }
+    updateCalibration(*data);
     return true;
 }
 
 /**
  * Remove given sensor assignment, if the sensor is still online it gets a generic name "sensor[index]"
  */
-bool SensorDS18B20::unregisterSensor(DeviceAddress address, std::string name)
+bool SensorDS18B20::unregisterSensor(const char* name)
 {
-    std::map<std::string, SensorData>::iterator it = registeredSensors.find(name);
-    if (it == registeredSensors.end()) {
-        return false;
-    }
-    registeredSensors.erase(it);
-    return true;
+    return registeredSensors.destroy(findSensor(name));
 }
 
 /**
- * Search and return currently available DS18B20 devices on the one-wire bus
+ * Register the device of given address as found at given index without bus search, e.g. from a cache of the
+ * last boot - only its scratchpad is read to check the device and its resolution
+ *
+ * @return FALSE if the device does not respond - a sensorsAvailable() call is needed then
  */
-std::list<SensorDS18B20::SensorData> SensorDS18B20::sensorsAvailable(void)
+bool SensorDS18B20::restoreSensor(const uint8_t* address, int index)
 {
-    searchSensors();
-
-    std::list<SensorData>           sensorList = sensorsRegistered();
-    std::list<SensorData>::iterator it         = sensorList.begin();
-
-    while (it != sensorList.end()) {
-        DeviceScratchPad tmp;
-        bool             connected = sensors.isConnected(it->address, tmp);
+    DeviceAddress deviceAddress;
+    memcpy(deviceAddress, address, sizeof(deviceAddress));
 
-        Serial.printf("[ds18b20] device: %s address: %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X state: %s\n", it->name.c_str(),
-                      it->address[0], it->address[1], it->address[2], it->address[3], it->address[4], it->address[5], it->address[6], it->address[7],
-                      connected ? "ONLINE" : "OFFLINE. Skipping this sensor.");
+    if (!sensors->setResolution(deviceAddress, TEMPERATURE_PRECISION)) {
+        LOG_WARN(DS18B20, "restored device %d does not respond", index);
+        return false;
+    }
 
-        if (connected) {
-            it->connected = connected;
-        } else {
-            sensorList.erase(it);
+    SensorData* data = findSensor(deviceAddress);
+    if (!data) {
+        data = registeredSensors.create(index, deviceAddress);
+        if (!data) {
+            return false;
         }
-        ++it;
     }
-    return sensorList;
+    data->index     = index;
+    data->connected = true;
+    updateCalibration(*data);
+    return true;
+}
+
+/**
+ * Move the 1wire bus to given pin, e.g. after a configuration change - the next sensorsAvailable() call searches
+ * the bus again
+ */
+void SensorDS18B20::setPin(int pin)
+{
+    if (sensors != &dallasBus) {
+        return;
+    }
+    this->pin = pin;
+    oneWire.begin(pin);
+    sensorsInitialized = false;
 }
 
 /**
- * Return a list of all registered sensors (which were online before but without checking if they are still connected)
+ * Search the one-wire bus and check which registered sensors are connected
+ *
+ * @return count of connected sensors, see registeredSensor() for each of them
  */
-std::list<SensorDS18B20::SensorData> SensorDS18B20::sensorsRegistered(void)
+int SensorDS18B20::sensorsAvailable(void)
 {
-    std::list<SensorData>                             sensorList;
-    std::map<std::string, SensorData>::const_iterator it = registeredSensors.begin();
-    while (it != registeredSensors.end()) {
-        sensorList.push_back(it->second);
-        ++it;
+    searchSensors();
+
+    int available = 0;
+    for (size_t i = 0; i < registeredSensors.capacity(); ++i) {
+        SensorData* data = registeredSensors.at(i);
+        if (!data) {
+            continue;
+        }
+        DeviceScratchPad tmp;
+        data->connected = sensors->isConnected(data->address, tmp);
+
+        LOG_INFO(DS18B20, "device: %s address: %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X state: %s", data->name,
+                 data->address[0], data->address[1], data->address[2], data->address[3], data->address[4], data->address[5], data->address[6], data->address[7],
+                 data->connected ? "ONLINE" : "OFFLINE. Skipping this sensor.");
+
+        if (data->connected) {
+            ++available;
+        }
     }
-    return sensorList;
+    return available;
 }
 
 /**
@@ -167,83 +268,112 @@ std::list<SensorDS18B20::SensorData> SensorDS18B20::sensorsRegistered(void)
 bool SensorDS18B20::searchSensors(void)
 {
     if (!sensorsInitialized) {
-        sensors.begin();
+        if (sensors == &dallasBus) {
+            oneWire.begin(pin); // the global OneWire is constructed for ONEWIRE_IN
+        }
+        sensors->begin();
         sensorsInitialized = true;
 
-        Serial.printf("[ds18b20] parasite power is: %s\n", sensors.isParasitePowerMode() ? "ON" : "OFF");
+        LOG_INFO(DS18B20, "parasite power is: %s", sensors->isParasitePowerMode() ? "ON" : "OFF");
     }
 
-    Serial.printf("[ds18b20] searching available devices (current count: %d)...\n", sensors.getDeviceCount());
+    LOG_INFO(DS18B20, "searching available devices (current count: %d)...", sensors->getDeviceCount());
 
-    std::map<std::string, SensorData>::iterator it = registeredSensors.begin();
-    std::list<SensorData>                       newSensorList;
-    SensorData                                  newDevice;
-    DeviceAddress                               newAddress;
-    int                                         newIndex = -1;
+    DeviceAddress newAddress;
+    int           newIndex = -1;
+    int           skipped  = 0;
 
     // first mark all previously registered sensors as offline
-    while (it != registeredSensors.end()) {
-        it->second.index     = -1;
-        it->second.connected = false;
-        ++it;
+    for (size_t i = 0; i < registeredSensors.capacity(); ++i) {
+        if (SensorData* data = registeredSensors.at(i)) {
+            data->index     = -1;
+            data->connected = false;
+        }
     }
 
     // search for new devices and check each address against registered sensors
-    while (sensors.getAddress(newAddress, ++newIndex)) {
-        newDevice = SensorData(newIndex, newAddress);
-        newSensorList.push_back(newDevice);
-
-        sensors.setResolution(newAddress, TEMPERATURE_PRECISION);
-
-        it                            = registeredSensors.begin();
-        bool addressAlreadyRegistered = false;
-
-        while (it != registeredSensors.end()) {
-            // mark each matching registered sensor as "connected"
-            if (it->second.isEqual(newAddress)) {
-                addressAlreadyRegistered = true;
-                it->second.index         = newIndex; // update the index
-                it->second.connected     = true;
-                if (it->second.name.find("sensor") != std::string::npos) {
-                    char tmp[255];
-                    it->second.name = std::string("sensor") + std::string(itoa(newIndex, tmp, 10));
-                } else {
-                    newDevice.name = it->second.name;
-                }
-                break;
+    while (sensors->getAddress(newAddress, ++newIndex)) {
+        sensors->setResolution(newAddress, TEMPERATURE_PRECISION);
+
+        // mark each matching registered sensor as "connected"
+        SensorData* data                     = findSensor(newAddress);
+        bool        addressAlreadyRegistered = (data != nullptr);
+        if (data) {
+            data->index     = newIndex; // update the index
+            data->connected = true;
+            if (data->hasGenericName()) {
+                data->setGenericName();
+            }
+        } else {
+            // add new sensor missing in previously registered sensors list
+            data = registeredSensors.create(newIndex, newAddress);
+            if (!data) {
+                ++skipped;
+                continue;
             }
-            ++it;
-        }
-        // add new sensor missing in previously registered sensors list
-        if (!addressAlreadyRegistered) {
-            registeredSensors[newDevice.name] = newDevice;
         }
+        updateCalibration(*data); // generic names follow the index
 
-        Serial.printf("[ds18b20] device: %s address: %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X state: %s\n", newDevice.name.c_str(),
-                      newAddress[0], newAddress[1], newAddress[2], newAddress[3], newAddress[4], newAddress[5], newAddress[6], newAddress[7],
-                      addressAlreadyRegistered ? "already registered" : "new device");
+        LOG_INFO(DS18B20, "device: %s address: %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X state: %s", data->name,
+                 newAddress[0], newAddress[1], newAddress[2], newAddress[3], newAddress[4], newAddress[5], newAddress[6], newAddress[7],
+                 addressAlreadyRegistered ? "already registered" : "new device");
     }
 
+    if (skipped > 0) {
+        LOG_ERROR(DS18B20, "%d devices skipped - more than %d sensors", skipped, DS18B20_MAX_SENSORS);
+    }
     return true;
 }
 
 /**
- * Read current temperature value from given sensor, corrected by given offset
+ * Return registered sensor of given name or nullptr
+ */
+SensorDS18B20::SensorData* SensorDS18B20::findSensor(const char* name)
+{
+    return registeredSensors.find([name](const SensorData& data) { return strcmp(data.name, name) == 0; });
+}
+
+/**
+ * Return registered sensor of given hardware address or nullptr
+ */
+SensorDS18B20::SensorData* SensorDS18B20::findSensor(DeviceAddress address)
+{
+    return registeredSensors.find([address](SensorData& data) { return data.isEqual(address); });
+}
+
+/**
+ * Prepare the calibration curve set for the current name of given sensor, or none
+ */
+void SensorDS18B20::updateCalibration(SensorData& data)
+{
+    data.calibration.clear();
+    for (const SensorCurve& curve : sensorCurves) {
+        if (curve.name[0] != '\0' && strcmp(curve.name, data.name) == 0) {
+            data.calibration.set(curve.table);
+            return;
+        }
+    }
+}
+
+/**
+ * Read current temperature value from given sensor, corrected by its own or the common calibration curve and
+ * given offset
  * 
  * @return FALSE on any error, otherwise TRUE
  */
 bool SensorDS18B20::readSensorTemperature(SensorData& data, float offset)
 {
-    sensors.requestTemperatures();
+    sensors->requestTemperatures();
 
-    float temperature = sensors.getTempC(data.address);
+    float temperature = sensors->getTempC(data.address);
     if (temperature == DEVICE_DISCONNECTED_C) {
-        Serial.printf("[ds18b20] failed to read temperature value of device: %s\n", data.name.c_str());
+        LOG_ERROR(DS18B20, "failed to read temperature value of device: %s", data.name);
         return false;
     }
 
-    data.lastTemperature = temperature;
-    Serial.printf("[ds18b20] device: %s  current temperature: %02.1f °C\n", data.name.c_str(), temperature);
+    float calibrated     = data.calibration.size() > 0 ? data.calibration.apply(temperature) : calibratedTemperature(temperature);
+    data.lastTemperature = calibrated + offset;
+    LOG_DEBUG(DS18B20, "device: %s  current temperature: %02.1f °C", data.name, data.lastTemperature);
 
     return true;
 }
@@ -253,10 +383,14 @@ bool SensorDS18B20::readSensorTemperature(SensorData& data, float offset)
  */
 bool TestSensorDS18B20::runTests(void)
 {
-    assert(sensor.currentSensor().empty());
-    assert(std::isnan(sensor.temperature()));
-    assert(std::isnan(sensor.humidity()));
-    assert(std::isnan(sensor.temperature("sensorXYZ***Just*a*test!")));
+    // reads change the sensor state, so they are not done inside assert()
+    assert(sensor.currentSensor()[0] == '\0');
+    float temperature = sensor.temperature();
+    assert(std::isnan(temperature));
+    float humidity = sensor.humidity();
+    assert(std::isnan(humidity));
+    temperature = sensor.temperature("sensorXYZ***Just*a*test!");
+    assert(std::isnan(temperature));
 
     return TestTemperatureSensor::runTests();
 }
@@ -4,6 +4,8 @@
 #ifndef SENSORDS18B20_H
 #define SENSORDS18B20_H
 
+#include "StaticPool.h"
+#include "TemperatureBus.h"
 #include "TemperatureSensor.h"
 
 #include <Arduino.h>
@@ -14,12 +16,24 @@
 #include <DallasTemperature.h>
 #include <OneWire.h>
 #include <assert.h>
-#include <list>
-#include <map>
+#include <stdint.h>
 #include <stdlib.h>
-#include <string>
+#include <string.h>
 
-#define ONEWIRE_IN D4 // what pin the DS18b20 is connected to
+#if defined(ESP32)
+#define ONEWIRE_IN 4 // what pin the DS18b20 is connected to
+#else
+#define ONEWIRE_IN D4
+#endif
+
+#ifndef DS18B20_MAX_SENSORS
+#define DS18B20_MAX_SENSORS 16 // capacity of the static sensor registry
+#endif
+#define DS18B20_NAME_LENGTH 16 // max sensor name length including terminating zero
+#define DS18B20_MAX_CURVES 4   // max calibration curves of single sensors
+
+// generic names "sensor[index]" are built from a 16 bit index, which is -1 or a slot of the registry
+static_assert(DS18B20_MAX_SENSORS <= INT16_MAX, "sensor index must fit into generic names");
 
 
 /**
@@ -31,14 +45,22 @@ class SensorDS18B20 : public TemperatureSensor
 {
 public:
     SensorDS18B20(int pin = ONEWIRE_IN, float temperatureOffset = 0.0);
+    SensorDS18B20(TemperatureBus* bus, float temperatureOffset = 0.0);
 
     virtual float temperature(void);
-    virtual float temperature(const std::string& name);
+    virtual float temperature(const char* name);
+
+    bool        setCurrentSensor(const char* name);
+    const char* currentSensor(void) const;
+    bool        registerSensor(DeviceAddress address, const char* name);
+    bool        unregisterSensor(const char* name);
+    bool        restoreSensor(const uint8_t* address, int index);
+    void        setPin(int pin);
+    void        setTemperatureOffset(float offset) { temperatureOffset = offset; }
 
-    bool        setCurrentSensor(const std::string& name);
-    std::string currentSensor(void) const;
-    bool        registerSensor(DeviceAddress address, std::string name);
-    bool        unregisterSensor(DeviceAddress address, std::string name);
+    using TemperatureSensor::setCalibration; // curve of all sensors without own curve
+    bool setCalibration(const char* name, const CalibrationTable& table);
+    void clearCalibrations(void);
 
     /**
      * Attributes of a single DS18b20 one-wire sensor device
@@ -46,6 +68,7 @@ public:
      * @c index  - a numerical increment showing the order the sensors are found on the one wire bus and can be arbitrary
      * @c addess - the unique hardware sensor address of a DS18B20 device
      * @c name   - a user defined name to identify the sensor - by default constructed as "sensor[index]", e.g. "sensor0"
+     * @c calibration - curve set for the name of the sensor, each probe drifts differently
      */
     struct SensorData
     {
@@ -53,11 +76,12 @@ public:
             index(-1),
             connected(false),
             lastTemperature(NAN)
-        {}
+        {
+            name[0] = '\0';
+        }
 
-        SensorData(int deviceIndex, DeviceAddress deviceAddress, const std::string deviceName = "") :
+        SensorData(int deviceIndex, DeviceAddress deviceAddress, const char* deviceName = "") :
             index(deviceIndex),
-            name(deviceName),
             connected(true),
             lastTemperature(NAN)
         {
@@ -65,24 +89,42 @@ public:
                 this->address[i] = deviceAddress[i];
             }
 
-            if (deviceName.empty()) {
-                char tmp[255];
-                name = std::string("sensor") + std::string(itoa(index, tmp, 10));
+            if (deviceName[0] == '\0') {
+                setGenericName();
+            } else {
+                setName(deviceName);
             }
         }
 
         SensorData(const SensorData& right) :
             index(right.index),
-            name(right.name),
             connected(right.connected),
-            lastTemperature(right.lastTemperature)
+            lastTemperature(right.lastTemperature),
+            calibration(right.calibration)
         {
             for (int i = 0; i < 8; ++i) {
                 this->address[i] = right.address[i];
             }
+            setName(right.name);
+        }
+
+        void setName(const char* newName)
+        {
+            strncpy(name, newName, sizeof(name) - 1);
+            name[sizeof(name) - 1] = '\0';
+        }
+
+        void setGenericName(void)
+        {
+            snprintf(name, sizeof(name), "sensor%d", (int)(int16_t)index);
+        }
+
+        bool hasGenericName(void) const
+        {
+            return strncmp(name, "sensor", 6) == 0;
         }
 
-        bool isEqual(DeviceAddress deviceAddress)
+        bool isEqual(const DeviceAddress deviceAddress) const
         {
             for (int i = 0; i < 8; ++i) {
                 if (this->address[i] != deviceAddress[i]) {
@@ -104,25 +146,47 @@ public:
 
         int           index;
         DeviceAddress address;
-        std::string   name;
+        char          name[DS18B20_NAME_LENGTH];
         bool          connected;
         float         lastTemperature;
+        Calibration   calibration; // empty for the curve of all sensors
     };
 
-    std::list<SensorData> sensorsAvailable(void);
-    std::list<SensorData> sensorsRegistered(void);
+    int    sensorsAvailable(void);
+    size_t sensorsRegistered(void) const { return registeredSensors.size(); }
+
+    /**
+     * Return registered sensor in given slot below DS18B20_MAX_SENSORS or nullptr - iterates without copies, e.g.
+     * the connected sensors after sensorsAvailable()
+     */
+    const SensorData* registeredSensor(size_t slot) const { return registeredSensors.at(slot); }
 
 protected:
-    bool searchSensors(void);
-    bool readSensorTemperature(SensorData& data, float offset = 0.0);
+    bool        searchSensors(void);
+    bool        readSensorTemperature(SensorData& data, float offset = 0.0);
+    SensorData* findSensor(const char* name);
+    SensorData* findSensor(DeviceAddress address);
+    void        updateCalibration(SensorData& data);
 
 private:
-    typedef uint8_t                   DeviceScratchPad[9]; // 9 data bytes of one-wire device
-    DallasTemperature                 sensors;             // API for 1wire bus
-    bool                              sensorsInitialized = false; // was sensors.begin() called already?
-    std::map<std::string, SensorData> registeredSensors;   // list of registered sensors
-    std::string                       currentSensorName;   // name of registered default sensor
-    float                             temperatureOffset;   // offset to normalize temperature values i.e. in cause of shifted sensor values
+    typedef uint8_t                             DeviceScratchPad[9]; // 9 data bytes of one-wire device
+    DallasTemperatureBus                        dallasBus;           // API for 1wire bus
+    TemperatureBus*                             sensors;             // used bus: dallasBus or a simulated bus
+    int                                         pin = ONEWIRE_IN;    // pin of dallasBus
+    bool                                        sensorsInitialized = false; // was sensors.begin() called already?
+    StaticPool<SensorData, DS18B20_MAX_SENSORS> registeredSensors;   // list of registered sensors
+    char                                        currentSensorName[DS18B20_NAME_LENGTH]; // name of registered default sensor
+    float                                       temperatureOffset;   // offset to normalize temperature values i.e. in cause of shifted sensor values
+
+    /**
+     * Calibration curve of the sensor of given name, applied to the sensor whenever it gets this name
+     */
+    struct SensorCurve
+    {
+        char             name[DS18B20_NAME_LENGTH]; // empty for unused entries
+        CalibrationTable table;
+    };
+    SensorCurve sensorCurves[DS18B20_MAX_CURVES];
 };
 
 /**
@@ -0,0 +1,522 @@
+/**@file
+ * Simulated 1-wire bus with virtual DS18B20 devices and bus timing model
+ */
+#include "SimulatedTemperatureBus.h"
+#include "Logger.h"
+#include "SensorDS18B20.h"
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define DS18B20_FAMILY 0x28
+#define DS18B20_POWER_ON_TEMPERATURE 85.0
+#define DS18B20_SCRATCHPAD_SIZE 9 // temperature, alarm limits, configuration, 3 reserved bytes and CRC
+#define DS18B20_ALARM_HIGH 75     // factory default of the alarm limit bytes in Celsius degrees
+#define DS18B20_ALARM_LOW 70
+
+// durations of bus transactions in microseconds
+#define SEARCH_PASS_TIME (ONEWIRE_RESET_TIME + ONEWIRE_BYTE_TIME + 64 * 3 * ONEWIRE_SLOT_TIME)
+#define SELECT_TIME (ONEWIRE_RESET_TIME + 9 * ONEWIRE_BYTE_TIME) // reset, MATCH ROM and address
+#define READ_SCRATCHPAD_TIME (SELECT_TIME + ONEWIRE_BYTE_TIME + 9 * ONEWIRE_BYTE_TIME)
+#define WRITE_SCRATCHPAD_TIME (SELECT_TIME + ONEWIRE_BYTE_TIME + 3 * ONEWIRE_BYTE_TIME)
+#define COPY_SCRATCHPAD_TIME (SELECT_TIME + ONEWIRE_BYTE_TIME + ONEWIRE_EEPROM_COPY_TIME + ONEWIRE_RESET_TIME)
+#define READ_POWER_SUPPLY_TIME (ONEWIRE_RESET_TIME + 2 * ONEWIRE_BYTE_TIME + ONEWIRE_SLOT_TIME)
+#define CONVERT_COMMAND_TIME (ONEWIRE_RESET_TIME + 2 * ONEWIRE_BYTE_TIME) // reset, SKIP ROM and CONVERT T
+
+/**
+ * Dallas/Maxim CRC8 of 1-wire ROM codes and scratchpads
+ */
+static uint8_t crc8(const uint8_t* data, uint8_t length)
+{
+    uint8_t crc = 0;
+    while (length--) {
+        uint8_t inbyte = *data++;
+        for (uint8_t i = 0; i < 8; ++i) {
+            uint8_t mix = (crc ^ inbyte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            inbyte >>= 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * Return TRUE if ROM search finds address a before b - the search takes the 0 branch first, starting at bit 0
+ */
+static bool searchesBefore(const uint8_t* a, const uint8_t* b)
+{
+    for (int bit = 0; bit < 64; ++bit) {
+        bool bitA = a[bit / 8] & (1 << (bit % 8));
+        bool bitB = b[bit / 8] & (1 << (bit % 8));
+        if (bitA != bitB) {
+            return !bitA;
+        }
+    }
+    return false;
+}
+
+/**
+ * Conversion time of DS18B20 for given resolution in microseconds: 93.75 ms for 9 bit up to 750 ms for 12 bit
+ */
+static uint32_t conversionTime(uint8_t resolution)
+{
+    return 750000UL >> (12 - resolution);
+}
+
+/**
+ * Create bus with given count of connected devices of given temperature
+ */
+SimulatedTemperatureBus::SimulatedTemperatureBus(int deviceCount, bool parasitePower, float temperature) :
+    nextEvent(0),
+    now(0),
+    parasite(parasitePower),
+    devicesFound(0),
+    crcErrorRate(0),
+    crcErrorCount(0),
+    randomState(1)
+{
+    for (int i = 0; i < deviceCount; ++i) {
+        addDevice(temperature);
+    }
+}
+
+/**
+ * Add a connected device with unique ROM code and return its device number
+ */
+int SimulatedTemperatureBus::addDevice(float temperature)
+{
+    Device   device;
+    uint32_t serial = (devices.size() + 1) * 0x9E3779B1UL; // spread serial numbers over the search tree
+
+    device.address[0] = DS18B20_FAMILY;
+    for (int i = 1; i < 7; ++i) {
+        device.address[i] = (serial >> ((i - 1) * 5)) & 0xFF;
+    }
+    device.address[7]           = crc8(device.address, 7);
+    device.temperature          = temperature;
+    device.convertedTemperature = DS18B20_POWER_ON_TEMPERATURE;
+    device.resolution           = 12; // factory default
+    device.connected            = true;
+
+    devices.push_back(device);
+    updateSearchOrder();
+    return devices.size() - 1;
+}
+
+/**
+ * Copy ROM code of given device number into address
+ */
+bool SimulatedTemperatureBus::deviceAddress(int device, uint8_t* address) const
+{
+    if (device < 0 || device >= (int)devices.size()) {
+        return false;
+    }
+    memcpy(address, devices[device].address, 8);
+    return true;
+}
+
+bool SimulatedTemperatureBus::setDeviceTemperature(int device, float temperature)
+{
+    if (device < 0 || device >= (int)devices.size()) {
+        return false;
+    }
+    devices[device].temperature = temperature;
+    return true;
+}
+
+/**
+ * Plug in or remove given device
+ */
+bool SimulatedTemperatureBus::setDeviceConnected(int device, bool connected)
+{
+    if (device < 0 || device >= (int)devices.size()) {
+        return false;
+    }
+    devices[device].connected = connected;
+    if (!connected) {
+        devices[device].convertedTemperature = DS18B20_POWER_ON_TEMPERATURE;
+    }
+    return true;
+}
+
+/**
+ * Schedule change of given device at given simulated time in microseconds
+ */
+void SimulatedTemperatureBus::addEvent(uint64_t time, int device, EventTypes type, float temperature)
+{
+    Event event;
+    event.time        = time;
+    event.device      = device;
+    event.type        = type;
+    event.temperature = temperature;
+
+    std::vector<Event>::iterator it = events.begin() + nextEvent;
+    while (it != events.end() && it->time <= time) {
+        ++it;
+    }
+    events.insert(it, event);
+}
+
+/**
+ * Advance simulated time and apply all events due until then
+ */
+void SimulatedTemperatureBus::spend(uint32_t micros)
+{
+    now += micros;
+    while (nextEvent < events.size() && events[nextEvent].time <= now) {
+        const Event& event = events[nextEvent++];
+        switch (event.type) {
+        case SET_TEMPERATURE:
+            setDeviceTemperature(event.device, event.temperature);
+            break;
+        case CONNECT:
+            setDeviceConnected(event.device, true);
+            break;
+        case DISCONNECT:
+            setDeviceConnected(event.device, false);
+            break;
+        }
+    }
+}
+
+/**
+ * Return device number of given connected ROM code or -1
+ */
+int SimulatedTemperatureBus::findDevice(const uint8_t* address) const
+{
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (devices[i].connected && memcmp(devices[i].address, address, 8) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Return device number found by the ROM search at given index or -1
+ */
+int SimulatedTemperatureBus::searchDevice(uint8_t index) const
+{
+    int found = 0;
+    for (size_t i = 0; i < searchOrder.size(); ++i) {
+        if (devices[searchOrder[i]].connected && found++ == index) {
+            return searchOrder[i];
+        }
+    }
+    return -1;
+}
+
+void SimulatedTemperatureBus::updateSearchOrder(void)
+{
+    searchOrder.clear();
+    for (size_t i = 0; i < devices.size(); ++i) {
+        searchOrder.push_back(i);
+    }
+    std::sort(searchOrder.begin(), searchOrder.end(), [this](int a, int b) {
+        return searchesBefore(devices[a].address, devices[b].address);
+    });
+}
+
+/**
+ * Spend time of a scratchpad read of given device and return FALSE for missing devices and CRC errors
+ *
+ * @param scratchPad optional buffer of DS18B20_SCRATCHPAD_SIZE bytes for the scratchpad of the device - the
+ *                   temperature of the last conversion in 1/16 degrees, the resolution in the configuration byte and
+ *                   the CRC, which does not match on CRC errors
+ */
+bool SimulatedTemperatureBus::readScratchPad(int device, uint8_t* scratchPad)
+{
+    spend(READ_SCRATCHPAD_TIME);
+    if (device < 0) {
+        return false;
+    }
+
+    if (scratchPad) {
+        const Device& data = devices[device];
+        int16_t       raw  = (int16_t)lroundf(data.convertedTemperature * 16);
+        scratchPad[0]      = raw & 0xFF;
+        scratchPad[1]      = (raw >> 8) & 0xFF;
+        scratchPad[2]      = DS18B20_ALARM_HIGH;
+        scratchPad[3]      = DS18B20_ALARM_LOW;
+        scratchPad[4]      = 0x1F | ((data.resolution - 9) << 5);
+        scratchPad[5]      = 0xFF;
+        scratchPad[6]      = 0x0C;
+        scratchPad[7]      = 0x10;
+        scratchPad[8]      = crc8(scratchPad, DS18B20_SCRATCHPAD_SIZE - 1);
+    }
+
+    randomState = randomState * 1103515245UL + 12345UL;
+    if (crcErrorRate > 0 && (randomState >> 16) % 1000 < crcErrorRate) {
+        ++crcErrorCount;
+        if (scratchPad) {
+            scratchPad[DS18B20_SCRATCHPAD_SIZE - 1] ^= 0xFF;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Search all devices, read the power supply mode and the resolution of each device
+ */
+void SimulatedTemperatureBus::begin(void)
+{
+    devicesFound = 0;
+    while (searchDevice(devicesFound) >= 0) {
+        spend(SEARCH_PASS_TIME);
+        readScratchPad(searchDevice(devicesFound));
+        ++devicesFound;
+    }
+    spend(devicesFound > 0 ? SEARCH_PASS_TIME : ONEWIRE_RESET_TIME); // last pass without result
+    spend(READ_POWER_SUPPLY_TIME);
+}
+
+/**
+ * Return ROM code found at given search index - DallasTemperature restarts the search for each call
+ */
+bool SimulatedTemperatureBus::getAddress(uint8_t* address, uint8_t index)
+{
+    for (uint8_t pass = 0; pass <= index; ++pass) {
+        if (searchDevice(pass) < 0) {
+            spend(pass > 0 ? SEARCH_PASS_TIME : ONEWIRE_RESET_TIME);
+            return false;
+        }
+        spend(SEARCH_PASS_TIME);
+    }
+    return deviceAddress(searchDevice(index), address);
+}
+
+/**
+ * Set resolution of given device, the scratchpad is only written and copied to EEPROM on changes
+ */
+bool SimulatedTemperatureBus::setResolution(const uint8_t* address, uint8_t resolution)
+{
+    int device = findDevice(address);
+    if (!readScratchPad(device) || resolution < 9 || resolution > 12) {
+        return false;
+    }
+    if (devices[device].resolution != resolution) {
+        spend(WRITE_SCRATCHPAD_TIME);
+        spend(COPY_SCRATCHPAD_TIME);
+        devices[device].resolution = resolution;
+    }
+    return true;
+}
+
+/**
+ * Read the scratchpad of given device like DallasTemperature does, FALSE for missing devices and CRC errors
+ */
+bool SimulatedTemperatureBus::isConnected(const uint8_t* address, uint8_t* scratchPad)
+{
+    return readScratchPad(findDevice(address), scratchPad);
+}
+
+/**
+ * Start conversion on all devices and wait for the slowest one
+ */
+void SimulatedTemperatureBus::requestTemperatures(void)
+{
+    spend(CONVERT_COMMAND_TIME);
+
+    uint8_t resolution = 9;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (devices[i].connected && devices[i].resolution > resolution) {
+            resolution = devices[i].resolution;
+        }
+    }
+
+    uint32_t duration = conversionTime(resolution);
+    if (!parasite) {
+        // conversion end is polled by read slots
+        duration = (duration + ONEWIRE_SLOT_TIME - 1) / ONEWIRE_SLOT_TIME * ONEWIRE_SLOT_TIME;
+    }
+    spend(duration);
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+        Device& device = devices[i];
+        if (device.connected) {
+            float step                  = 0.5f / (1 << (device.resolution - 9));
+            device.convertedTemperature = roundf(device.temperature / step) * step;
+        }
+    }
+}
+
+/**
+ * Read converted temperature of given device
+ */
+float SimulatedTemperatureBus::getTempC(const uint8_t* address)
+{
+    int device = findDevice(address);
+    if (!readScratchPad(device)) {
+        return DEVICE_DISCONNECTED_C;
+    }
+    return devices[device].convertedTemperature;
+}
+
+/**
+ * Unit tests of SensorDS18B20 with a simulated bus
+ */
+bool TestSimulatedTemperatureBus::runTests()
+{
+    SimulatedTemperatureBus bus(3);
+    SensorDS18B20           sensor(&bus);
+
+    bus.setDeviceTemperature(1, 21.3);
+    bus.setDeviceTemperature(2, -5.0);
+
+    // searching changes the bus and sensor state, so it is not done inside assert()
+    int available = sensor.sensorsAvailable();
+    assert(available == 3);
+    assert(bus.getDeviceCount() == 3);
+
+    // each sensor reads the temperature of its device, rounded to 9 bit resolution
+    float expected[] = {20.0, 21.5, -5.0};
+    for (int device = 0; device < 3; ++device) {
+        DeviceAddress address;
+        bool          known = bus.deviceAddress(device, address);
+        assert(known);
+        for (size_t slot = 0; slot < DS18B20_MAX_SENSORS; ++slot) {
+            const SensorDS18B20::SensorData* data = sensor.registeredSensor(slot);
+            if (data && data->isEqual(address)) {
+                float temperature = sensor.temperature(data->name);
+                assert(temperature == expected[device]);
+            }
+        }
+    }
+
+    // curves of single sensors replace the common curve, they follow the name of the sensor
+    CalibrationTable        common = {1, {{20.0, 21.0}}};
+    CalibrationTable        probe  = {1, {{20.0, 19.5}}};
+    SimulatedTemperatureBus calibratedBus(2);
+    SensorDS18B20           calibrated(&calibratedBus);
+    bool                    set    = calibrated.setCalibration(common) && calibrated.setCalibration("sensor1", probe);
+    assert(set);
+    available = calibrated.sensorsAvailable();
+    assert(available == 2);
+    float reading = calibrated.temperature("sensor0");
+    assert(reading == 21.0);
+    reading = calibrated.temperature("sensor1");
+    assert(reading == 19.5);
+    DeviceAddress probeAddress;
+    for (size_t slot = 0; slot < DS18B20_MAX_SENSORS; ++slot) {
+        const SensorDS18B20::SensorData* data = calibrated.registeredSensor(slot);
+        if (data && strcmp(data->name, "sensor1") == 0) {
+            memcpy(probeAddress, data->address, sizeof(probeAddress));
+        }
+    }
+    bool registered = calibrated.registerSensor(probeAddress, "heater");
+    assert(registered);
+    reading = calibrated.temperature("heater");
+    assert(reading == 21.0);
+    set = calibrated.setCalibration("heater", probe);
+    assert(set);
+    reading = calibrated.temperature("heater");
+    assert(reading == 19.5);
+    calibrated.clearCalibrations();
+    reading = calibrated.temperature("heater");
+    assert(reading == 21.0);
+
+    // scratchpad of the last conversion in 1/16 degrees with 9 bit configuration and valid CRC
+    uint8_t       scratchPad[DS18B20_SCRATCHPAD_SIZE];
+    DeviceAddress coldAddress;
+    bus.deviceAddress(2, coldAddress);
+    bool connected = bus.isConnected(coldAddress, scratchPad);
+    assert(connected);
+    assert(scratchPad[0] == 0xB0 && scratchPad[1] == 0xFF && scratchPad[4] == 0x1F);
+    assert(crc8(scratchPad, DS18B20_SCRATCHPAD_SIZE - 1) == scratchPad[DS18B20_SCRATCHPAD_SIZE - 1]);
+
+    uint64_t start = bus.busTime();
+    bus.requestTemperatures();
+    assert(bus.busTime() - start >= 93750);
+
+    // scripted temperature change during conversion
+    const SensorDS18B20::SensorData* front = sensor.registeredSensor(0);
+    assert(front != nullptr);
+    const char* firstName = front->name;
+    int         first     = -1;
+    for (int device = 0; device < 3; ++device) {
+        DeviceAddress address;
+        bus.deviceAddress(device, address);
+        if (front->isEqual(address)) {
+            first = device;
+        }
+    }
+    bus.addEvent(bus.busTime() + 1000, first, SimulatedTemperatureBus::SET_TEMPERATURE, 30.0);
+    float temperature = sensor.temperature(firstName);
+    assert(temperature == 30.0);
+
+    // hot unplug
+    bus.addEvent(bus.busTime() + 1, first, SimulatedTemperatureBus::DISCONNECT);
+    temperature = sensor.temperature(firstName);
+    assert(std::isnan(temperature));
+    available = sensor.sensorsAvailable();
+    assert(available == 2 && !front->connected);
+    bus.setDeviceConnected(first, true);
+    available = sensor.sensorsAvailable();
+    assert(available == 3 && front->connected);
+
+    // CRC errors
+    bus.setCrcErrorRate(1000);
+    temperature = sensor.temperature(firstName);
+    assert(std::isnan(temperature));
+    assert(bus.crcErrors() > 0);
+    connected = bus.isConnected(coldAddress, scratchPad);
+    assert(!connected);
+    assert(crc8(scratchPad, DS18B20_SCRATCHPAD_SIZE - 1) != scratchPad[DS18B20_SCRATCHPAD_SIZE - 1]);
+
+    // devices beyond the static registry are skipped
+    SimulatedTemperatureBus crowdedBus(DS18B20_MAX_SENSORS + 1);
+    SensorDS18B20           crowded(&crowdedBus);
+    available = crowded.sensorsAvailable();
+    assert(available == DS18B20_MAX_SENSORS && crowded.sensorsRegistered() == DS18B20_MAX_SENSORS);
+
+    return true;
+}
+
+/**
+ * Measure bus time of search and reads of SensorDS18B20 for growing count of devices up to the registry capacity
+ */
+void TestSimulatedTemperatureBus::runBenchmark(int maxDevices)
+{
+    const int deviceCounts[] = {1, 10, 25, 50, 100};
+
+    for (int count : deviceCounts) {
+        if (count > maxDevices) {
+            break;
+        }
+
+        SimulatedTemperatureBus bus(count);
+        SensorDS18B20           sensor(&bus);
+
+        uint64_t      busStart  = bus.busTime();
+        unsigned long wallStart = micros();
+        int           found     = sensor.sensorsAvailable();
+        uint32_t      searchBus = (bus.busTime() - busStart) / 1000;
+        unsigned long search    = micros() - wallStart;
+
+        busStart  = bus.busTime();
+        wallStart = micros();
+        sensor.temperature();
+        uint32_t      readBus = (bus.busTime() - busStart) / 1000;
+        unsigned long read    = micros() - wallStart;
+
+        busStart = bus.busTime();
+        for (size_t slot = 0; slot < DS18B20_MAX_SENSORS; ++slot) {
+            if (const SensorDS18B20::SensorData* data = sensor.registeredSensor(slot)) {
+                sensor.temperature(data->name);
+            }
+        }
+        uint32_t readAllBus = (bus.busTime() - busStart) / 1000;
+
+        logger.flush(); // the device log lines may have filled the log buffer
+        LOG_INFO(BENCH, "simulated %d devices (%d found): sensorsAvailable %u ms bus, %lu us cpu",
+                 count, found, (unsigned int)searchBus, search);
+        LOG_INFO(BENCH, "simulated %d devices: temperature %u ms bus, %lu us cpu, all temperatures %u ms bus",
+                 count, (unsigned int)readBus, read, (unsigned int)readAllBus);
+        logger.flush();
+    }
+}
@@ -0,0 +1,118 @@
+/**@file
+ * Simulated 1-wire bus with virtual DS18B20 devices and bus timing model
+ */
+#ifndef SIMULATEDTEMPERATUREBUS_H
+#define SIMULATEDTEMPERATUREBUS_H
+
+#include "SensorDS18B20.h"
+#include "TemperatureBus.h"
+#include <stdint.h>
+#include <vector>
+
+// 1-wire standard speed timings in microseconds
+#define ONEWIRE_RESET_TIME 960              // reset pulse and presence detect
+#define ONEWIRE_SLOT_TIME 65                // one read or write time slot
+#define ONEWIRE_BYTE_TIME (8 * ONEWIRE_SLOT_TIME)
+#define ONEWIRE_EEPROM_COPY_TIME 20000      // copy scratchpad to EEPROM as waited by DallasTemperature
+
+/**
+ * Simulated 1-wire bus with virtual DS18B20 devices
+ *
+ * Implements the TemperatureBus functions like the DallasTemperature library does on a real bus, but instead of
+ * waiting it adds the modelled bus time to a simulated clock:
+ *
+ * @li ROM search - one search pass per getAddress() index like DallasTemperature, devices in real search order
+ * @li time slots - reset, ROM and function commands and scratchpad reads/writes by standard speed timings
+ * @li conversion - 93.75 ms (9 bit) up to 750 ms (12 bit) of the highest resolution on the bus, fixed delay in
+ *                  parasite power mode, polled read slots otherwise
+ * @li CRC errors - scratchpad reads fail by given probability
+ *
+ * Temperatures and hot-plug events can be scripted by simulated time, so read latencies of SensorDS18B20 can be
+ * measured without physical probes for any count of devices.
+ */
+class SimulatedTemperatureBus : public TemperatureBus
+{
+public:
+    enum EventTypes
+    {
+        SET_TEMPERATURE = 1,
+        CONNECT         = 2,
+        DISCONNECT      = 3
+    };
+
+    SimulatedTemperatureBus(int deviceCount = 0, bool parasitePower = false, float temperature = 20.0);
+
+    int  addDevice(float temperature = 20.0);
+    int  deviceCount(void) const { return devices.size(); }
+    bool deviceAddress(int device, uint8_t* address) const;
+    bool setDeviceTemperature(int device, float temperature);
+    bool setDeviceConnected(int device, bool connected);
+    void addEvent(uint64_t time, int device, EventTypes type, float temperature = 0.0);
+    void setCrcErrorRate(uint16_t perMille) { crcErrorRate = perMille; }
+
+    uint64_t busTime(void) const { return now; }
+    uint32_t crcErrors(void) const { return crcErrorCount; }
+
+    virtual void    begin(void);
+    virtual uint8_t getDeviceCount(void) { return devicesFound; }
+    virtual bool    isParasitePowerMode(void) { return parasite; }
+    virtual bool    getAddress(uint8_t* address, uint8_t index);
+    virtual bool    setResolution(const uint8_t* address, uint8_t resolution);
+    virtual bool    isConnected(const uint8_t* address, uint8_t* scratchPad);
+    virtual void    requestTemperatures(void);
+    virtual float   getTempC(const uint8_t* address);
+
+protected:
+    /**
+     * Virtual DS18B20 device
+     */
+    struct Device
+    {
+        uint8_t address[8];
+        float   temperature;
+        float   convertedTemperature; // result of last conversion, 85 °C power-on value before
+        uint8_t resolution;
+        bool    connected;
+    };
+
+    /**
+     * Scripted change of a device at given simulated time
+     */
+    struct Event
+    {
+        uint64_t   time;
+        int        device;
+        EventTypes type;
+        float      temperature;
+    };
+
+    void spend(uint32_t micros);
+    int  findDevice(const uint8_t* address) const;
+    int  searchDevice(uint8_t index) const;
+    bool readScratchPad(int device, uint8_t* scratchPad = nullptr);
+    void updateSearchOrder(void);
+
+private:
+    std::vector<Device> devices;
+    std::vector<int>    searchOrder;  // device indexes sorted like the 1-wire ROM search finds them
+    std::vector<Event>  events;       // sorted by time
+    size_t              nextEvent;    // index of next event to apply
+    uint64_t            now;          // simulated time in microseconds
+    bool                parasite;     // parasite power mode
+    uint8_t             devicesFound; // device count found by begin()
+    uint16_t            crcErrorRate; // probability of CRC errors in 1/1000
+    uint32_t            crcErrorCount;
+    uint32_t            randomState;
+};
+
+/**
+ * Unit test and scaling benchmark of SensorDS18B20 on a SimulatedTemperatureBus
+ */
+class TestSimulatedTemperatureBus
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(int maxDevices = DS18B20_MAX_SENSORS);
+};
+
+#endif // SIMULATEDTEMPERATUREBUS_H
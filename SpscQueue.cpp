@@ -0,0 +1,184 @@
+#include "SpscQueue.h"
+#include "Logger.h"
+#include <Arduino.h>
+#include <assert.h>
+#if !defined(ESP8266)
+#include <thread>
+#endif
+
+/**
+ * Queue between threads large enough to make them wait on each other now and then
+ */
+typedef SpscQueue<uint32_t, 64> TestQueue;
+
+/**
+ * Item of the stress test: a sensor sample of the sketch with sequence number
+ */
+struct StressItem
+{
+    uint32_t sequence;
+    float    temperature;
+    float    humidity;
+    float    temperatureHeater;
+};
+
+/**
+ * Queue of the stress test with the capacity of the sample queue of the sketch, so it is full most of the time
+ */
+typedef SpscQueue<StressItem, 4> StressQueue;
+
+static void makeItem(uint32_t sequence, uint32_t& item)
+{
+    item = sequence;
+}
+
+static bool isItem(const uint32_t& item, uint32_t sequence)
+{
+    return item == sequence;
+}
+
+static void makeItem(uint32_t sequence, StressItem& item)
+{
+    item.sequence          = sequence;
+    item.temperature       = (sequence % 400) * 0.1f;
+    item.humidity          = (sequence % 1000) * 0.1f;
+    item.temperatureHeater = -(float)(sequence % 700);
+}
+
+/**
+ * Return TRUE if all fields of given item are those of given sequence number, a torn copy fails
+ */
+static bool isItem(const StressItem& item, uint32_t sequence)
+{
+    StressItem expected;
+    makeItem(sequence, expected);
+    return item.sequence == expected.sequence && item.temperature == expected.temperature &&
+           item.humidity == expected.humidity && item.temperatureHeater == expected.temperatureHeater;
+}
+
+/**
+ * Pass given count of numbered items from a producer to a consumer thread
+ *
+ * @param emptyPolls    set to the count of pop() calls of the consumer on an empty queue
+ * @return count of items received out of order or torn, 0 if the queue works
+ */
+template <typename T, uint32_t Capacity>
+static uint32_t transferItems(SpscQueue<T, Capacity>& queue, uint32_t items, uint32_t& emptyPolls)
+{
+    uint32_t errors = 0;
+    T        item;
+    emptyPolls = 0;
+#if defined(ESP8266)
+    // no threads: alternate producer and consumer in bursts
+    uint32_t next = 0;
+    for (uint32_t sent = 0; sent < items;) {
+        makeItem(sent, item);
+        while (sent < items && queue.push(item)) {
+            makeItem(++sent, item);
+        }
+        while (queue.pop(item)) {
+            errors += !isItem(item, next++);
+        }
+        ++emptyPolls;
+    }
+#else
+    std::thread producer([&queue, items]() {
+        T item;
+        makeItem(0, item);
+        for (uint32_t sent = 0; sent < items;) {
+            if (queue.push(item)) {
+                makeItem(++sent, item);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (uint32_t next = 0; next < items;) {
+        if (queue.pop(item)) {
+            errors += !isItem(item, next++);
+        } else {
+            ++emptyPolls;
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+#endif
+    return errors;
+}
+
+/**
+ * Unit tests for full, empty and wrapping queue and ordered transfer between threads
+ */
+bool TestSpscQueue::runTests()
+{
+    SpscQueue<uint8_t, 4> queue;
+    uint8_t               item;
+
+    assert(queue.empty());
+    assert(!queue.pop(item));
+
+    for (uint8_t i = 0; i < 4; ++i) {
+        assert(queue.push(i));
+    }
+    assert(queue.size() == 4);
+    assert(!queue.push(4));
+    assert(queue.dropped() == 1);
+
+    // wrap around several times
+    for (uint8_t i = 0; i < 20; ++i) {
+        assert(queue.pop(item) && item == i);
+        assert(queue.push(i + 4));
+    }
+    for (uint8_t i = 20; i < 24; ++i) {
+        assert(queue.pop(item) && item == i);
+    }
+    assert(queue.empty());
+
+    TestQueue transfer;
+    uint32_t  emptyPolls;
+    uint32_t  errors = transferItems(transfer, 10000, emptyPolls);
+    assert(errors == 0);
+    assert(transfer.empty());
+
+    return true;
+}
+
+/**
+ * Log throughput of given count of items passed from producer to consumer
+ */
+void TestSpscQueue::runBenchmark(uint32_t items)
+{
+    TestQueue queue;
+    uint32_t  emptyPolls;
+
+    unsigned long start   = micros();
+    uint32_t      errors  = transferItems(queue, items, emptyPolls);
+    unsigned long elapsed = micros() - start;
+
+    LOG_INFO(BENCH, "spsc queue: %lu ns/op (%u ops, %u errors)", (unsigned long)((uint64_t)elapsed * 1000 / items),
+             (unsigned int)items, (unsigned int)errors);
+}
+
+/**
+ * Pass given count of sensor samples through a queue of 4 items and log the rate and how often the producer found
+ * the queue full and the consumer found it empty
+ *
+ * @return FALSE if a sample was lost, reordered or torn
+ */
+bool TestSpscQueue::runStressTest(uint32_t items)
+{
+    StressQueue queue;
+    uint32_t    emptyPolls;
+
+    unsigned long start   = micros();
+    uint32_t      errors  = transferItems(queue, items, emptyPolls);
+    unsigned long elapsed = micros() - start;
+
+    logger.flush();
+    LOG_INFO(BENCH, "spsc stress: %u samples in %lu ms - %lu ns/sample, %u errors, %u full, %u empty",
+             (unsigned int)items, elapsed / 1000, (unsigned long)((uint64_t)elapsed * 1000 / (items ? items : 1)),
+             (unsigned int)errors, (unsigned int)queue.dropped(), (unsigned int)emptyPolls);
+    logger.flush();
+    return errors == 0 && queue.empty();
+}
@@ -0,0 +1,95 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+/**
+ * Lock-free single producer/single consumer queue, e.g. between the two cores of an ESP32
+ */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Ring buffer of Capacity items for exactly one producer and one consumer task
+ *
+ * push() and pop() never block and never allocate. Head and tail count up without wrapping at Capacity, so a full
+ * queue is told from an empty one without a spare slot. The producer publishes an item by a release store of head
+ * after copying it, the consumer frees it by a release store of tail, so no lock is needed on multi-core CPUs.
+ * Only 32 bit atomic loads and stores are used, which need no library support on ESP8266 and ESP32.
+ */
+template <typename T, uint32_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscQueue() :
+        head(0),
+        tail(0),
+        droppedCount(0)
+    {}
+
+    /**
+     * Append a copy of item - producer only
+     *
+     * @return FALSE if the queue is full, the item is dropped and counted
+     */
+    bool push(const T& item)
+    {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) == Capacity) {
+            ++droppedCount;
+            return false;
+        }
+        items[position & (Capacity - 1)] = item;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the oldest item - consumer only
+     *
+     * @return FALSE if the queue is empty
+     */
+    bool pop(T& item)
+    {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == position) {
+            return false;
+        }
+        item = items[position & (Capacity - 1)];
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size(void) const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    bool     empty(void) const { return size() == 0; }
+    uint32_t capacity(void) const { return Capacity; }
+    uint32_t dropped(void) const { return droppedCount; }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    T                     items[Capacity];
+    std::atomic<uint32_t> head;         // items pushed, only written by the producer
+    std::atomic<uint32_t> tail;         // items popped, only written by the consumer
+    uint32_t              droppedCount; // items not pushed on full queue, only written by the producer
+};
+
+/**
+ * Unit test and benchmark for SpscQueue
+ *
+ * Where threads are available (not on ESP8266) producer and consumer run as separate std::thread, on ESP32 the
+ * scheduler places them on both cores. runStressTest() passes sensor samples through a queue of the capacity used
+ * by the sketch and checks each of them, on the host also built with thread sanitizer (spsc_stress).
+ */
+class TestSpscQueue
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint32_t items = 100000);
+    virtual bool runStressTest(uint32_t items = 1000000);
+};
+
+#endif // SPSCQUEUE_H
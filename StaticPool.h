@@ -0,0 +1,114 @@
+#ifndef STATICPOOL_H
+#define STATICPOOL_H
+
+/**
+ * Fixed capacity object pool without heap allocation
+ */
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Pool of up to Capacity objects of type T in static storage
+ *
+ * Objects are placement-constructed into free slots by create() and destroyed by destroy(), so long-lived objects
+ * need no heap allocation and no copies. Iterate all objects by slot index: at() returns nullptr for free slots.
+ */
+template <typename T, size_t Capacity>
+class StaticPool
+{
+public:
+    StaticPool()
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            used[i] = false;
+        }
+    }
+
+    ~StaticPool()
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            if (used[i]) {
+                slot(i)->~T();
+            }
+        }
+    }
+
+    /**
+     * Construct new object with given constructor arguments and return it or nullptr, if the pool is full
+     */
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            if (!used[i]) {
+                T* object = new (&storage[i]) T(std::forward<Args>(args)...);
+                used[i]   = true;
+                return object;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Destroy given object of this pool and free its slot
+     */
+    bool destroy(T* object)
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            if (used[i] && slot(i) == object) {
+                object->~T();
+                used[i] = false;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Return object in given slot or nullptr, if the slot is free
+     */
+    T* at(size_t index) { return (index < Capacity && used[index]) ? slot(index) : nullptr; }
+
+    const T* at(size_t index) const { return (index < Capacity && used[index]) ? slot(index) : nullptr; }
+
+    /**
+     * Return first object matching given predicate or nullptr
+     */
+    template <typename Predicate>
+    T* find(Predicate predicate)
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            if (used[i] && predicate(*slot(i))) {
+                return slot(i);
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size(void) const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < Capacity; ++i) {
+            count += used[i] ? 1 : 0;
+        }
+        return count;
+    }
+
+    bool   empty(void) const { return size() == 0; }
+    size_t capacity(void) const { return Capacity; }
+
+private:
+    T*       slot(size_t index) { return reinterpret_cast<T*>(&storage[index]); }
+    const T* slot(size_t index) const { return reinterpret_cast<const T*>(&storage[index]); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[Capacity];
+    bool                                                       used[Capacity];
+
+    StaticPool(const StaticPool&);            // not copyable
+    StaticPool& operator=(const StaticPool&); // not copyable
+};
+
+#endif // STATICPOOL_H
@@ -0,0 +1,58 @@
+/**@file
+ * Interface of the 1-wire bus functions used by SensorDS18B20
+ */
+#ifndef TEMPERATUREBUS_H
+#define TEMPERATUREBUS_H
+
+#include <Arduino.h>
+#ifndef ARDUINO
+#define ARDUINO 150
+#endif
+
+#include <DallasTemperature.h>
+#include <OneWire.h>
+
+/**
+ * Subset of the DallasTemperature API used by SensorDS18B20
+ *
+ * Allows to run SensorDS18B20 on a simulated bus, see SimulatedTemperatureBus.
+ */
+class TemperatureBus
+{
+public:
+    virtual ~TemperatureBus() {}
+
+    virtual void    begin(void)                                               = 0;
+    virtual uint8_t getDeviceCount(void)                                      = 0;
+    virtual bool    isParasitePowerMode(void)                                 = 0;
+    virtual bool    getAddress(uint8_t* address, uint8_t index)               = 0;
+    virtual bool    setResolution(const uint8_t* address, uint8_t resolution) = 0;
+    virtual bool    isConnected(const uint8_t* address, uint8_t* scratchPad)  = 0;
+    virtual void    requestTemperatures(void)                                 = 0;
+    virtual float   getTempC(const uint8_t* address)                          = 0;
+};
+
+/**
+ * TemperatureBus of the real DS18B20 devices via DallasTemperature library
+ */
+class DallasTemperatureBus : public TemperatureBus
+{
+public:
+    DallasTemperatureBus(OneWire* oneWire) :
+        sensors(oneWire)
+    {}
+
+    virtual void    begin(void) { sensors.begin(); }
+    virtual uint8_t getDeviceCount(void) { return sensors.getDeviceCount(); }
+    virtual bool    isParasitePowerMode(void) { return sensors.isParasitePowerMode(); }
+    virtual bool    getAddress(uint8_t* address, uint8_t index) { return sensors.getAddress(address, index); }
+    virtual bool    setResolution(const uint8_t* address, uint8_t resolution) { return sensors.setResolution(address, resolution); }
+    virtual bool    isConnected(const uint8_t* address, uint8_t* scratchPad) { return sensors.isConnected(address, scratchPad); }
+    virtual void    requestTemperatures(void) { sensors.requestTemperatures(); }
+    virtual float   getTempC(const uint8_t* address) { return sensors.getTempC(address); }
+
+private:
+    DallasTemperature sensors; // API for 1wire bus
+};
+
+#endif // TEMPERATUREBUS_H
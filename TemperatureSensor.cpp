@@ -58,4 +58,6 @@ bool TestTemperatureSensor::runTests()
     sensor.setHumidity(60.0);
     assert(sensor.isHumidityValid() == true);
     assert(sensor.humidity() == 60.0);
+
+    return true;
 }
\ No newline at end of file
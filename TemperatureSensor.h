@@ -1,6 +1,7 @@
 #ifndef TEMPERATURESENSOR_H
 #define TEMPERATURESENSOR_H
 
+#include "Calibration.h"
 #include <cmath>
 
 /**
@@ -36,7 +37,13 @@ public:
     virtual float fahrenheitToCelsius(float fahrenheit) const { return (fahrenheit - 32) * 5 / 9; }
     virtual float celsiusToFahrenheit(float celsius) const { return (celsius * 9) / 5 + 32; }
 
+    bool setCalibration(const CalibrationTable& table) { return temperatureCalibration.set(table); }
+
+protected:
+    float calibratedTemperature(float celsius) const { return temperatureCalibration.apply(celsius); }
+
 private:
+    Calibration      temperatureCalibration;                   // curve from raw to actual Celsius degrees
     TemperatureUnits temperatureUnitValue   = CELSIUS_DEGREES; // can be set to CELSIUS_DEGREES or FAHRENHEIT_DEGREES
     float            temperatureValue       = NAN;             // last temperature value in degrees of unit temperatureUnit
     float            humidityValue          = NAN;             // last humidity in percent
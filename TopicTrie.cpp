@@ -0,0 +1,342 @@
+/**
+ * Matching of MQTT topics against subscription patterns with wildcards
+ */
+
+#include "TopicTrie.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <Arduino.h>
+#include <assert.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Constructor with node storage of given capacity, at least one node is used by the root
+ */
+TopicTrie::TopicTrie(Node* nodes, uint16_t capacity) :
+    nodes(nodes),
+    capacity(capacity)
+{
+    clear();
+}
+
+/**
+ * Remove all patterns
+ */
+void TopicTrie::clear(void)
+{
+    used     = 0;
+    patterns = 0;
+    if (capacity > 0) {
+        nodes[0].level   = "";
+        nodes[0].length  = 0;
+        nodes[0].child   = TOPIC_TRIE_NONE;
+        nodes[0].sibling = TOPIC_TRIE_NONE;
+        nodes[0].value   = TOPIC_TRIE_NONE;
+        used             = 1;
+    }
+}
+
+/**
+ * Add given pattern, referenced by the trie until clear()
+ *
+ * On failure nodes created for leading levels are kept without value, they never match.
+ *
+ * @param pattern MQTT topic with optional wildcards
+ * @param value returned by match() for topics matching the pattern
+ * @return FALSE if the pattern is already inserted, a wildcard is misplaced or all nodes are used
+ */
+bool TopicTrie::insert(const char* pattern, uint16_t value)
+{
+    if (used == 0 || value == TOPIC_TRIE_NONE) {
+        return false;
+    }
+
+    uint16_t    node  = 0;
+    const char* level = pattern;
+    for (;;) {
+        const char* end    = strchr(level, '/');
+        size_t      length = end ? (size_t)(end - level) : strlen(level);
+        if (length > UINT8_MAX) {
+            return false;
+        }
+        // wildcards fill a whole level, '#' only the last one
+        if ((memchr(level, '+', length) || memchr(level, '#', length)) &&
+            (length != 1 || (level[0] == '#' && end != nullptr))) {
+            return false;
+        }
+
+        uint16_t child = nodes[node].child;
+        while (child != TOPIC_TRIE_NONE &&
+               !(nodes[child].length == length && memcmp(nodes[child].level, level, length) == 0)) {
+            child = nodes[child].sibling;
+        }
+        if (child == TOPIC_TRIE_NONE) {
+            if (used == capacity) {
+                return false;
+            }
+            child                = used++;
+            nodes[child].level   = level;
+            nodes[child].length  = length;
+            nodes[child].child   = TOPIC_TRIE_NONE;
+            nodes[child].sibling = nodes[node].child;
+            nodes[child].value   = TOPIC_TRIE_NONE;
+            nodes[node].child    = child;
+        }
+        node = child;
+
+        if (end == nullptr) {
+            break;
+        }
+        level = end + 1;
+    }
+
+    if (nodes[node].value != TOPIC_TRIE_NONE) {
+        return false;
+    }
+    nodes[node].value = value;
+    ++patterns;
+    return true;
+}
+
+/**
+ * Find all patterns matching given topic
+ *
+ * @param topic MQTT topic without wildcards, e.g. of a received message
+ * @param values buffer for the values of the matching patterns
+ * @param maxValues size of values, further matches are not returned
+ * @return count of values returned
+ */
+uint8_t TopicTrie::match(const char* topic, uint16_t* values, uint8_t maxValues) const
+{
+    uint8_t count = 0;
+    if (used > 0) {
+        collect(0, topic, true, values, maxValues, count);
+    }
+    return count;
+}
+
+/**
+ * Add values of the patterns below given node matching the topic from given level on
+ *
+ * @param level start of the next topic level, nullptr after the last level
+ * @param first level is the first one of the topic
+ */
+void TopicTrie::collect(uint16_t node, const char* level, bool first, uint16_t* values, uint8_t maxValues,
+                        uint8_t& count) const
+{
+    if (level == nullptr) {
+        // topic ends here, "a/#" matches "a" as well
+        if (nodes[node].value != TOPIC_TRIE_NONE && count < maxValues) {
+            values[count++] = nodes[node].value;
+        }
+        for (uint16_t child = nodes[node].child; child != TOPIC_TRIE_NONE; child = nodes[child].sibling) {
+            if (nodes[child].length == 1 && nodes[child].level[0] == '#' && nodes[child].value != TOPIC_TRIE_NONE &&
+                count < maxValues) {
+                values[count++] = nodes[child].value;
+            }
+        }
+        return;
+    }
+
+    const char* end      = strchr(level, '/');
+    size_t      length   = end ? (size_t)(end - level) : strlen(level);
+    const char* next     = end ? end + 1 : nullptr;
+    bool        wildcard = !(first && level[0] == '$');
+
+    for (uint16_t child = nodes[node].child; child != TOPIC_TRIE_NONE; child = nodes[child].sibling) {
+        const Node& candidate = nodes[child];
+        if (candidate.length == 1 && candidate.level[0] == '#') {
+            if (wildcard && candidate.value != TOPIC_TRIE_NONE && count < maxValues) {
+                values[count++] = candidate.value;
+            }
+        } else if ((candidate.length == 1 && candidate.level[0] == '+' && wildcard) ||
+                   (candidate.length == length && memcmp(candidate.level, level, length) == 0)) {
+            collect(child, next, false, values, maxValues, count);
+        }
+    }
+}
+
+/**
+ * Return TRUE if given pattern holds a wildcard
+ */
+bool TopicTrie::isWildcard(const char* pattern)
+{
+    return strpbrk(pattern, "+#") != nullptr;
+}
+
+/**
+ * Return TRUE if given topic matches given pattern, without trie as reference and for single checks
+ */
+bool TopicTrie::matches(const char* pattern, const char* topic)
+{
+    bool first = true;
+    for (;;) {
+        const char* patternEnd = strchr(pattern, '/');
+        const char* topicEnd   = topic ? strchr(topic, '/') : nullptr;
+        size_t      length     = patternEnd ? (size_t)(patternEnd - pattern) : strlen(pattern);
+        bool        wildcard   = !(first && topic && topic[0] == '$');
+
+        if (length == 1 && pattern[0] == '#') {
+            return wildcard;
+        }
+        if (topic == nullptr) {
+            return false;
+        }
+        size_t topicLength = topicEnd ? (size_t)(topicEnd - topic) : strlen(topic);
+        if (!(length == 1 && pattern[0] == '+' && wildcard) &&
+            !(length == topicLength && memcmp(pattern, topic, length) == 0)) {
+            return false;
+        }
+        if (patternEnd == nullptr) {
+            return topicEnd == nullptr;
+        }
+        pattern = patternEnd + 1;
+        topic   = topicEnd ? topicEnd + 1 : nullptr;
+        first   = false;
+    }
+}
+
+/**
+ * Unit tests for wildcards, shared levels and capacity limits
+ */
+bool TestTopicTrie::runTests()
+{
+    StaticTopicTrie<16> trie;
+    uint16_t            values[4];
+    uint8_t             count;
+
+    // insert() and match() change the trie and the values, so they are not called inside assert()
+    bool inserted = trie.insert("/switch/room/lights/set", 0) && trie.insert("/switch/room/+/set", 1) &&
+                    trie.insert("/command/room/#", 2) && trie.insert("/command/room/config", 3);
+    assert(inserted);
+    inserted = trie.insert("/command/room/config", 4);
+    assert(!inserted);
+    inserted = trie.insert("/command/#/config", 4);
+    assert(!inserted);
+    inserted = trie.insert("/command/ro+m", 4);
+    assert(!inserted);
+    assert(trie.size() == 4);
+
+    count = trie.match("/switch/room/lights/set", values, 4);
+    assert(count == 2);
+    assert((values[0] == 0 && values[1] == 1) || (values[0] == 1 && values[1] == 0));
+    count = trie.match("/switch/room/heater/set", values, 4);
+    assert(count == 1 && values[0] == 1);
+    count = trie.match("/switch/room/heater", values, 4);
+    assert(count == 0);
+    count = trie.match("/switch/room/lights/set/x", values, 4);
+    assert(count == 0);
+    count = trie.match("/command/room", values, 4);
+    assert(count == 1 && values[0] == 2);
+    count = trie.match("/command/room/config", values, 4);
+    assert(count == 2);
+    count = trie.match("/command/room/rules/x/y", values, 4);
+    assert(count == 1 && values[0] == 2);
+    count = trie.match("/command/kitchen/config", values, 4);
+    assert(count == 0);
+    count = trie.match("/switch/room/lights/set", values, 1);
+    assert(count == 1);
+
+    // '+' matches empty levels, but no '$' topics on the first level
+    inserted = trie.insert("+/+", 5);
+    assert(inserted);
+    count = trie.match("/x", values, 4);
+    assert(count == 1 && values[0] == 5);
+    count = trie.match("$SYS/x", values, 4);
+    assert(count == 0);
+
+    // capacity: the root and 4 levels of a new pattern exceed 16 nodes
+    inserted = trie.insert("/a/b/c/d/e/f/g", 6);
+    assert(!inserted);
+    assert(trie.nodesUsed() == 16);
+    trie.clear();
+    count = trie.match("/switch/room/lights/set", values, 4);
+    assert(trie.size() == 0 && count == 0);
+    inserted = trie.insert("/switch/room/lights/set", 0);
+    assert(inserted);
+
+    assert(TopicTrie::matches("/switch/room/+/set", "/switch/room/lights/set"));
+    assert(!TopicTrie::matches("/switch/room/+/set", "/switch/room/lights"));
+    assert(TopicTrie::matches("/switch/#", "/switch"));
+    assert(TopicTrie::matches("#", "/switch/room"));
+    assert(!TopicTrie::matches("#", "$SYS/broker"));
+    assert(!TopicTrie::matches("/switch/room", "/switch/room/lights"));
+    assert(TopicTrie::isWildcard("/switch/+/set") && !TopicTrie::isWildcard("/switch/room"));
+
+    return true;
+}
+
+/**
+ * Log match time of the trie and of matching all patterns one by one for 10 up to given count of topics
+ *
+ * Each 16th pattern is a '#' wildcard of a room, the others are switch topics of 8 rooms each.
+ */
+void TestTopicTrie::runBenchmark(uint16_t maxTopics)
+{
+    const size_t   patternLength = sizeof("/switch/room8191/relay65535/state"); // longest topic of 16-bit relays
+    const uint16_t queries       = 64;
+    const uint16_t rounds        = 20;
+
+    for (uint32_t topics = 10; topics <= maxTopics; topics *= 10) {
+        uint16_t nodeCount = 2 * topics + topics / 8 + 4;
+        size_t   needed    = (topics + queries) * patternLength + nodeCount * sizeof(TopicTrie::Node);
+        profiler.sampleHeap();
+        uint32_t largestBlock = profiler.heapStats().largestBlock;
+        if (largestBlock > 0 && needed > largestBlock) {
+            LOG_WARN(BENCH, "topic trie %u topics skipped - %u bytes heap needed", (unsigned int)topics,
+                     (unsigned int)needed);
+            break;
+        }
+
+        std::unique_ptr<char[]>            patterns(new char[topics * patternLength]);
+        std::unique_ptr<char[]>            queryTopics(new char[queries * patternLength]);
+        std::unique_ptr<TopicTrie::Node[]> nodes(new TopicTrie::Node[nodeCount]);
+        TopicTrie                          trie(nodes.get(), nodeCount);
+
+        for (uint16_t i = 0; i < topics; ++i) {
+            char* pattern = patterns.get() + i * patternLength;
+            if (i % 16 == 15) {
+                snprintf(pattern, patternLength, "/switch/room%u/#", (unsigned int)(i / 8));
+            } else {
+                snprintf(pattern, patternLength, "/switch/room%u/relay%u/set", (unsigned int)(i / 8), (unsigned int)i);
+            }
+            trie.insert(pattern, i);
+        }
+        uint32_t seed = 1;
+        for (uint16_t i = 0; i < queries; ++i) {
+            seed           = seed * 1103515245UL + 12345UL;
+            uint16_t relay = (seed >> 16) % topics;
+            snprintf(queryTopics.get() + i * patternLength, patternLength, "/switch/room%u/relay%u/%s",
+                     (unsigned int)(relay / 8), (unsigned int)relay, (i % 4 == 3) ? "state" : "set");
+        }
+
+        uint16_t      values[4];
+        uint32_t      trieMatches = 0;
+        unsigned long start       = micros();
+        for (uint16_t round = 0; round < rounds; ++round) {
+            for (uint16_t i = 0; i < queries; ++i) {
+                trieMatches += trie.match(queryTopics.get() + i * patternLength, values, 4);
+            }
+        }
+        unsigned long trieTime = micros() - start;
+
+        uint32_t linearMatches = 0;
+        start                  = micros();
+        for (uint16_t round = 0; round < rounds; ++round) {
+            for (uint16_t i = 0; i < queries; ++i) {
+                for (uint16_t p = 0; p < topics; ++p) {
+                    linearMatches +=
+                        TopicTrie::matches(patterns.get() + p * patternLength, queryTopics.get() + i * patternLength);
+                }
+            }
+        }
+        unsigned long linearTime = micros() - start;
+
+        LOG_INFO(BENCH, "topic trie %u topics: %lu ns/match, linear %lu ns/match, %u nodes%s", (unsigned int)topics,
+                 (unsigned long)((uint64_t)trieTime * 1000 / (rounds * queries)),
+                 (unsigned long)((uint64_t)linearTime * 1000 / (rounds * queries)), (unsigned int)trie.nodesUsed(),
+                 trieMatches == linearMatches ? "" : " - MISMATCH");
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef TOPICTRIE_H
+#define TOPICTRIE_H
+
+/**
+ * Matching of MQTT topics against subscription patterns with wildcards
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TOPIC_TRIE_NONE 0xFFFF // no node, no value
+
+/**
+ * Prebuilt trie of MQTT topic patterns split at '/' into levels
+ *
+ * Patterns may hold the MQTT wildcards '+' for exactly one level and '#' as last level for any count of levels,
+ * including none: "/switch/room/+/set" and "/switch/#" both match "/switch/room/lights/set". Topics starting with '$'
+ * are not matched by wildcards on the first level.
+ * Patterns sharing leading levels share nodes, so match() compares each topic level once per distinct pattern
+ * level, instead of the whole topic with each pattern.
+ *
+ * Nodes reference the level text of the inserted patterns, which must stay valid and unchanged. There is no removal
+ * of single patterns: clear() the trie and insert all remaining ones. Neither allocates memory, the node storage is
+ * given by StaticTopicTrie.
+ */
+class TopicTrie
+{
+public:
+    /**
+     * Level of one or more patterns
+     */
+    struct Node
+    {
+        const char* level;   // level text within an inserted pattern, not terminated
+        uint8_t     length;  // of level text
+        uint16_t    child;   // first node of the next level
+        uint16_t    sibling; // next node of the same level
+        uint16_t    value;   // of the pattern ending here
+    };
+
+    TopicTrie(Node* nodes, uint16_t capacity);
+
+    bool    insert(const char* pattern, uint16_t value);
+    void    clear(void);
+    uint8_t match(const char* topic, uint16_t* values, uint8_t maxValues) const;
+
+    uint16_t size(void) const { return patterns; }
+    uint16_t nodesUsed(void) const { return used; }
+    size_t   memoryUsage(void) const { return capacity * sizeof(Node); }
+
+    static bool isWildcard(const char* pattern);
+    static bool matches(const char* pattern, const char* topic);
+
+private:
+    void collect(uint16_t node, const char* level, bool first, uint16_t* values, uint8_t maxValues,
+                 uint8_t& count) const;
+
+    Node*    nodes;
+    uint16_t capacity;
+    uint16_t used;     // nodes including the root
+    uint16_t patterns; // inserted patterns
+};
+
+/**
+ * TopicTrie with storage for given count of nodes, e.g. as member
+ */
+template <uint16_t Nodes>
+class StaticTopicTrie : public TopicTrie
+{
+public:
+    StaticTopicTrie() :
+        TopicTrie(storage, Nodes)
+    {}
+
+private:
+    Node storage[Nodes];
+};
+
+/**
+ * Unit test and benchmark for TopicTrie class
+ */
+class TestTopicTrie
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint16_t maxTopics = 1000);
+};
+
+#endif // TOPICTRIE_H
@@ -0,0 +1,577 @@
+/**
+ * In-process MQTT 3.1.1 broker stand-in on loopback TCP with fault injection
+ */
+
+#include "BrokerStandIn.h"
+#include "TopicTrie.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BROKER_REQUEST_DISCONNECT 0x01 // close all connections
+#define BROKER_REQUEST_LISTENER 0x02   // open or close the listening socket for accepting
+#define BROKER_REQUEST_STOP 0x04
+
+#define BROKER_MAX_OUTPUT (1 << 20) // bytes queued for a connection not reading, it is closed beyond
+
+/**
+ * Return the value of the remaining length field at given position of a packet, 0 if it is not complete yet and
+ * -1 if it is malformed
+ *
+ * @param headerLength set to the length of type byte and remaining length field
+ */
+static long remainingLength(const std::string& data, size_t& headerLength)
+{
+    long value = 0;
+    for (size_t i = 1; i <= 4; ++i) {
+        if (i >= data.size()) {
+            return 0;
+        }
+        value |= (long)(data[i] & 0x7F) << (7 * (i - 1));
+        if (!(data[i] & 0x80)) {
+            headerLength = i + 1;
+            return value;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Read a string with 16 bit length prefix at given position, advancing it
+ */
+static bool readString(const std::string& packet, size_t& position, std::string& text)
+{
+    if (position + 2 > packet.size()) {
+        return false;
+    }
+    size_t length = ((uint8_t)packet[position] << 8) | (uint8_t)packet[position + 1];
+    if (position + 2 + length > packet.size()) {
+        return false;
+    }
+    text.assign(packet, position + 2, length);
+    position += 2 + length;
+    return true;
+}
+
+static void appendString(std::string& body, const std::string& text)
+{
+    body += (char)(text.size() >> 8);
+    body += (char)(text.size() & 0xFF);
+    body += text;
+}
+
+BrokerStandIn::BrokerStandIn()
+{
+    resetStatistics();
+}
+
+BrokerStandIn::~BrokerStandIn()
+{
+    stop();
+}
+
+/**
+ * Listen on given loopback port, 0 for any free port, and start the broker thread
+ *
+ * @return FALSE if the port could not be opened
+ */
+bool BrokerStandIn::start(uint16_t port)
+{
+    if (running) {
+        return true;
+    }
+    listenPort = port;
+    if (!openListener() || pipe(wakeFds) != 0) {
+        closeListener();
+        return false;
+    }
+    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+    running = true;
+    thread  = std::thread(&BrokerStandIn::run, this);
+    return true;
+}
+
+/**
+ * Close all connections and stop the broker thread
+ */
+void BrokerStandIn::stop(void)
+{
+    if (!running) {
+        return;
+    }
+    request(BROKER_REQUEST_STOP);
+    thread.join();
+    running = false;
+
+    for (auto& entry : connections) {
+        close(entry.second.fd);
+    }
+    connections.clear();
+    queue.clear();
+    closeListener();
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+}
+
+void BrokerStandIn::setFaults(const Faults& newFaults)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    faults = newFaults;
+    wake();
+}
+
+/**
+ * Process at most given count of packets per second, 0 for no limit
+ */
+void BrokerStandIn::setRateLimit(uint32_t packetsPerSecond)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    rateLimit = packetsPerSecond;
+    nextSlot  = 0;
+    wake();
+}
+
+/**
+ * Close (FALSE) or reopen (TRUE) the listening socket - connects are refused while closed
+ *
+ * Returns when the broker thread applied the change.
+ */
+void BrokerStandIn::setAccepting(bool accept)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        accepting = accept;
+    }
+    request(BROKER_REQUEST_LISTENER);
+}
+
+/**
+ * Close all connections, returns when they are closed
+ */
+void BrokerStandIn::disconnectAll(void)
+{
+    request(BROKER_REQUEST_DISCONNECT);
+}
+
+BrokerStandIn::Statistics BrokerStandIn::statistics(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Statistics                  result = stats;
+
+    result.connections = connections.size();
+    result.queued      = queue.size();
+    if (!latencies.empty()) {
+        std::vector<uint32_t> sorted(latencies);
+        std::sort(sorted.begin(), sorted.end());
+        result.latencyP50 = sorted[(sorted.size() - 1) * 50 / 100];
+        result.latencyP99 = sorted[(sorted.size() - 1) * 99 / 100];
+        result.latencyMax = sorted.back();
+    }
+    return result;
+}
+
+void BrokerStandIn::resetStatistics(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    memset(&stats, 0, sizeof(stats));
+    latencies.clear();
+}
+
+/**
+ * Pass given command to the broker thread and wait until it is handled
+ */
+void BrokerStandIn::request(uint8_t command)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running) {
+        return;
+    }
+    requested |= command;
+    uint32_t ticket = ++requestCount;
+    wake();
+    handled.wait(lock, [&] { return handledRequests >= ticket; });
+}
+
+void BrokerStandIn::wake(void)
+{
+    char signal = 1;
+    if (wakeFds[1] >= 0 && write(wakeFds[1], &signal, 1) < 0) {
+        // pipe full, the broker thread wakes anyway
+    }
+}
+
+bool BrokerStandIn::openListener(void)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+
+    struct sockaddr_in address;
+    socklen_t          length = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port        = htons(listenPort);
+    if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0 ||
+        getsockname(listenFd, (struct sockaddr*)&address, &length) != 0) {
+        closeListener();
+        return false;
+    }
+    listenPort = ntohs(address.sin_port);
+    return true;
+}
+
+void BrokerStandIn::closeListener(void)
+{
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+/**
+ * Broker thread: poll all sockets, queue the packets read, process them when due and send the answers
+ */
+void BrokerStandIn::run(void)
+{
+    std::vector<struct pollfd> fds;
+    std::vector<uint32_t>      ids;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (requested) {
+            uint32_t commands = requested;
+            requested         = 0;
+            if (commands & BROKER_REQUEST_DISCONNECT) {
+                while (!connections.empty()) {
+                    closeConnection(connections.begin()->first);
+                }
+            }
+            if (commands & BROKER_REQUEST_LISTENER) {
+                if (accepting && listenFd < 0) {
+                    openListener();
+                } else if (!accepting) {
+                    closeListener();
+                }
+            }
+            handledRequests = requestCount;
+            handled.notify_all();
+            if (commands & BROKER_REQUEST_STOP) {
+                return;
+            }
+        }
+
+        uint64_t now = host::microsSinceStart();
+        if (!faults.halfOpen) {
+            processPackets(now);
+        }
+
+        // wait for sockets or the next packet due
+        fds.clear();
+        ids.clear();
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        if (!faults.halfOpen) {
+            for (auto& entry : connections) {
+                short events = POLLIN | (entry.second.output.empty() ? 0 : POLLOUT);
+                fds.push_back({entry.second.fd, events, 0});
+                ids.push_back(entry.first);
+            }
+        }
+        int timeout = -1;
+        if (!queue.empty() && !faults.halfOpen) {
+            uint64_t due = std::max(queue.front().arrival + faults.delayMicros, nextSlot);
+            timeout      = due > now ? (int)((due - now + 999) / 1000) : 0;
+        }
+
+        lock.unlock();
+        int ready = poll(fds.data(), fds.size(), timeout);
+        lock.lock();
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (listenFd >= 0 && fds[1].fd == listenFd && (fds[1].revents & POLLIN)) {
+            acceptConnections();
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            auto entry = connections.find(ids[i]);
+            if (entry == connections.end() || fds[i + 2].revents == 0) {
+                continue;
+            }
+            if (fds[i + 2].revents & (POLLIN | POLLERR | POLLHUP)) {
+                readConnection(ids[i], entry->second);
+            }
+            entry = connections.find(ids[i]);
+            if (entry != connections.end() && (fds[i + 2].revents & POLLOUT)) {
+                writeConnection(entry->second);
+            }
+        }
+    }
+}
+
+void BrokerStandIn::acceptConnections(void)
+{
+    for (;;) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        int enable = 1;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        Connection connection;
+        connection.fd = fd;
+        connections.insert(std::make_pair(nextConnection++, connection));
+    }
+}
+
+/**
+ * Read available bytes and queue each complete packet
+ */
+void BrokerStandIn::readConnection(uint32_t id, Connection& connection)
+{
+    char buffer[4096];
+    for (;;) {
+        ssize_t received = recv(connection.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received > 0) {
+            connection.input.append(buffer, received);
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeConnection(id);
+            return;
+        }
+        break;
+    }
+
+    uint64_t now = host::microsSinceStart();
+    for (;;) {
+        size_t headerLength = 0;
+        long   length       = remainingLength(connection.input, headerLength);
+        if (length < 0) {
+            ++stats.malformed;
+            closeConnection(id);
+            return;
+        }
+        if (headerLength == 0 || connection.input.size() < headerLength + length) {
+            return;
+        }
+        Packet packet = {id, now, connection.input.substr(0, headerLength + length)};
+        connection.input.erase(0, headerLength + length);
+        queue.push_back(packet);
+    }
+}
+
+/**
+ * Process the queued packets that are due by the delay and rate limit
+ */
+void BrokerStandIn::processPackets(uint64_t now)
+{
+    while (!queue.empty()) {
+        Packet&  packet = queue.front();
+        uint64_t due    = std::max(packet.arrival + faults.delayMicros, nextSlot);
+        if (due > now) {
+            return;
+        }
+        if (rateLimit > 0) {
+            nextSlot = std::max(nextSlot, due) + 1000000 / rateLimit;
+        }
+
+        auto entry = connections.find(packet.connection);
+        if (entry != connections.end()) {
+            if ((uint8_t)packet.bytes[0] >> 4 == 3) {
+                latencies.push_back((uint32_t)(host::microsSinceStart() - packet.arrival));
+            }
+            process(packet.connection, entry->second, packet.bytes);
+        }
+        queue.pop_front();
+    }
+}
+
+/**
+ * Handle one packet of given connection
+ */
+void BrokerStandIn::process(uint32_t id, Connection& connection, const std::string& packet)
+{
+    uint8_t     type         = (uint8_t)packet[0] >> 4;
+    uint8_t     flags        = packet[0] & 0x0F;
+    size_t      position     = 0;
+    std::string text;
+    remainingLength(packet, position);
+
+    if (!connection.connected && type != 1) {
+        ++stats.malformed;
+        closeConnection(id);
+        return;
+    }
+
+    switch (type) {
+    case 1: // CONNECT
+        if (!readString(packet, position, text) || text != "MQTT") {
+            ++stats.malformed;
+            closeConnection(id);
+            return;
+        }
+        connection.connected = true;
+        ++stats.connects;
+        send(connection, 0x20, std::string("\x00\x00", 2));
+        break;
+
+    case 3: { // PUBLISH
+        std::string topic;
+        uint8_t     qos      = (flags >> 1) & 0x03;
+        uint16_t    packetId = 0;
+        if (!readString(packet, position, topic) || (qos > 0 && position + 2 > packet.size())) {
+            ++stats.malformed;
+            closeConnection(id);
+            return;
+        }
+        if (qos > 0) {
+            packetId = ((uint8_t)packet[position] << 8) | (uint8_t)packet[position + 1];
+            position += 2;
+        }
+        randomState = randomState * 1103515245UL + 12345UL;
+        if (faults.dropPerMille > 0 && (randomState >> 16) % 1000 < faults.dropPerMille) {
+            ++stats.dropped;
+            break;
+        }
+        ++stats.published;
+        if (qos > 0) {
+            send(connection, 0x40, std::string{(char)(packetId >> 8), (char)(packetId & 0xFF)});
+        }
+        forward(topic, packet.substr(position));
+        break;
+    }
+
+    case 8: { // SUBSCRIBE
+        if (position + 2 > packet.size()) {
+            ++stats.malformed;
+            closeConnection(id);
+            return;
+        }
+        std::string body = packet.substr(position, 2);
+        position += 2;
+        while (position < packet.size()) {
+            if (!readString(packet, position, text) || position >= packet.size()) {
+                ++stats.malformed;
+                closeConnection(id);
+                return;
+            }
+            ++position; // requested QoS, granted is 0
+            if (std::find(connection.subscriptions.begin(), connection.subscriptions.end(), text) ==
+                connection.subscriptions.end()) {
+                connection.subscriptions.push_back(text);
+            }
+            body += '\0';
+        }
+        send(connection, 0x90, body);
+        break;
+    }
+
+    case 10: { // UNSUBSCRIBE
+        std::string body = packet.substr(position, 2);
+        position += 2;
+        while (readString(packet, position, text)) {
+            connection.subscriptions.erase(
+                std::remove(connection.subscriptions.begin(), connection.subscriptions.end(), text),
+                connection.subscriptions.end());
+        }
+        send(connection, 0xB0, body);
+        break;
+    }
+
+    case 12: // PINGREQ
+        send(connection, 0xD0, std::string());
+        break;
+
+    case 14: // DISCONNECT
+        closeConnection(id);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Send given message with QoS 0 to each connection with a matching subscription
+ */
+void BrokerStandIn::forward(const std::string& topic, const std::string& payload)
+{
+    std::string body;
+    appendString(body, topic);
+    body += payload;
+
+    for (auto& entry : connections) {
+        for (const std::string& subscription : entry.second.subscriptions) {
+            if (TopicTrie::matches(subscription.c_str(), topic.c_str())) {
+                send(entry.second, 0x30, body);
+                ++stats.forwarded;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Queue a packet of given fixed header type byte and body and send as much as possible at once
+ */
+void BrokerStandIn::send(Connection& connection, uint8_t type, const std::string& body)
+{
+    std::string packet(1, (char)type);
+    size_t      remaining = body.size();
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        packet += (char)(digit | (remaining > 0 ? 0x80 : 0));
+    } while (remaining > 0);
+    packet += body;
+
+    if (connection.output.size() + packet.size() > BROKER_MAX_OUTPUT) {
+        return; // connection does not read, its messages are lost like on a broker with limited queues
+    }
+    connection.output += packet;
+    writeConnection(connection);
+}
+
+void BrokerStandIn::writeConnection(Connection& connection)
+{
+    while (!connection.output.empty()) {
+        ssize_t sent = ::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent <= 0) {
+            return; // closed connections are detected by the next read
+        }
+        connection.output.erase(0, sent);
+    }
+}
+
+void BrokerStandIn::closeConnection(uint32_t id)
+{
+    auto entry = connections.find(id);
+    if (entry == connections.end()) {
+        return;
+    }
+    close(entry->second.fd);
+    connections.erase(entry);
+    ++stats.disconnects;
+}
@@ -0,0 +1,131 @@
+#ifndef BROKERSTANDIN_H
+#define BROKERSTANDIN_H
+
+/**
+ * In-process MQTT 3.1.1 broker stand-in on loopback TCP with fault injection
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Minimal MQTT broker for the host tests, the load harness and the fleet simulator
+ *
+ * Runs its own thread polling all connections. Supported are CONNECT, PUBLISH with QoS 0 and 1, SUBSCRIBE with
+ * wildcards, UNSUBSCRIBE, PINGREQ and DISCONNECT. Messages are forwarded with QoS 0 to all connections with a
+ * matching subscription, including the sender. There are no sessions, retained messages or wills.
+ *
+ * Each packet read is queued with its arrival time and processed in order. Faults and limits apply to the queue:
+ *
+ * @li delay     - each packet is processed the given time after its arrival, so answers and forwards are late
+ * @li drop      - the given share of PUBLISH packets is dropped without PUBACK and forwarding
+ * @li half-open - connections are neither read nor answered but stay open, like a broker host that went away
+ *                 without closing its sockets
+ * @li rate      - at most the given count of packets per second is processed, the rest waits in the queue
+ *
+ * The queueing latency of PUBLISH packets - arrival until processing - is the broker-side latency reported by
+ * statistics(). disconnectAll() and setAccepting(false) model a broker restart and a broker outage.
+ */
+class BrokerStandIn
+{
+public:
+    struct Faults
+    {
+        uint32_t delayMicros  = 0;     // added to the processing time of each packet
+        uint16_t dropPerMille = 0;     // PUBLISH packets dropped
+        bool     halfOpen     = false; // connections are neither read nor answered
+    };
+
+    struct Statistics
+    {
+        uint32_t connections;  // currently open
+        uint32_t connects;     // CONNECT packets accepted
+        uint32_t disconnects;  // connections closed by either side
+        uint32_t published;    // PUBLISH packets processed
+        uint32_t forwarded;    // messages sent to subscribers
+        uint32_t dropped;      // PUBLISH packets dropped by fault injection
+        uint32_t malformed;    // connections closed for protocol errors
+        uint32_t queued;       // packets waiting for processing
+        uint32_t latencyP50;   // broker-side latency of PUBLISH packets in microseconds
+        uint32_t latencyP99;   // ...
+        uint32_t latencyMax;   // ...
+    };
+
+    BrokerStandIn();
+    ~BrokerStandIn();
+
+    bool     start(uint16_t port = 0);
+    void     stop(void);
+    uint16_t port(void) const { return listenPort; }
+
+    void setFaults(const Faults& faults);
+    void setRateLimit(uint32_t packetsPerSecond);
+    void setAccepting(bool accepting);
+    void disconnectAll(void);
+
+    Statistics statistics(void);
+    void       resetStatistics(void);
+
+private:
+    struct Connection
+    {
+        int                      fd;
+        bool                     connected = false; // CONNECT received
+        std::string              input;             // bytes of incomplete packets
+        std::string              output;            // bytes not sent yet
+        std::vector<std::string> subscriptions;
+    };
+
+    struct Packet
+    {
+        uint32_t    connection;
+        uint64_t    arrival; // microseconds
+        std::string bytes;
+    };
+
+    void run(void);
+    bool openListener(void);
+    void closeListener(void);
+    void acceptConnections(void);
+    void readConnection(uint32_t id, Connection& connection);
+    void processPackets(uint64_t now);
+    void process(uint32_t id, Connection& connection, const std::string& packet);
+    void forward(const std::string& topic, const std::string& payload);
+    void writeConnection(Connection& connection);
+    void closeConnection(uint32_t id);
+    void send(Connection& connection, uint8_t type, const std::string& body);
+    void wake(void);
+    void request(uint8_t command);
+
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable handled;
+    int                     listenFd   = -1;
+    uint16_t                listenPort = 0;
+    int                     wakeFds[2] = {-1, -1};
+    bool                    running    = false;
+
+    // shared with the broker thread, guarded by mutex
+    Faults   faults;
+    uint32_t rateLimit       = 0;
+    uint64_t nextSlot        = 0;
+    bool     accepting       = true;
+    uint32_t requested       = 0; // commands for the broker thread, see request()
+    uint32_t requestCount    = 0;
+    uint32_t handledRequests = 0;
+    uint32_t randomState     = 1;
+
+    std::map<uint32_t, Connection> connections;
+    uint32_t                       nextConnection = 1;
+    std::deque<Packet>             queue;
+    Statistics                     stats;
+    std::vector<uint32_t>          latencies;
+};
+
+#endif // BROKERSTANDIN_H
@@ -0,0 +1,133 @@
+#include "DhtPinDevice.h"
+#include "SensorDHT.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define TEST_DHT_PIN 5
+
+DhtPinDevice::DhtPinDevice(void) :
+    jitter(0),
+    releaseEdge(false),
+    seed(1),
+    offsetCount(0),
+    replaying(false),
+    responseCount(0)
+{
+    memset(frame, 0, sizeof(frame));
+}
+
+/**
+ * Answer with a frame of given data from now on
+ */
+void DhtPinDevice::setFrame(const uint8_t data[5], uint8_t jitter, bool releaseEdge)
+{
+    memcpy(frame, data, sizeof(frame));
+    this->jitter      = jitter;
+    this->releaseEdge = releaseEdge;
+    replaying         = false;
+}
+
+/**
+ * Answer with given edges from now on, each in us after the release of the line - no edges for a missing sensor
+ */
+void DhtPinDevice::setEdges(const uint32_t* offsets, uint8_t count)
+{
+    offsetCount = count < DHT_MAX_EDGES ? count : DHT_MAX_EDGES;
+    memcpy(this->offsets, offsets, offsetCount * sizeof(uint32_t));
+    replaying = true;
+}
+
+uint8_t DhtPinDevice::respond(uint32_t released, uint32_t* edges, uint8_t size)
+{
+    ++responseCount;
+    if (replaying) {
+        uint8_t count = offsetCount < size ? offsetCount : size;
+        for (uint8_t i = 0; i < count; ++i) {
+            edges[i] = released + offsets[i];
+        }
+        return count;
+    }
+    return size < DHT_MAX_EDGES ? 0 : TestDhtReceiver::synthesize(edges, frame, released, jitter, seed, releaseEdge);
+}
+
+/**
+ * Encode given values as DHT22 frame with checksum
+ */
+void DhtPinDevice::encode(float temperature, float humidity, uint8_t data[5])
+{
+    uint16_t humidityValue    = (uint16_t)(humidity * 10 + 0.5);
+    uint16_t temperatureValue = (uint16_t)(fabs(temperature) * 10 + 0.5) | (temperature < 0 ? 0x8000 : 0);
+    data[0]                   = humidityValue >> 8;
+    data[1]                   = humidityValue & 0xFF;
+    data[2]                   = temperatureValue >> 8;
+    data[3]                   = temperatureValue & 0xFF;
+    data[4]                   = data[0] + data[1] + data[2] + data[3];
+}
+
+/**
+ * Replay valid, jittered, cut off and broken edge streams to DhtReceiver::read() and SensorDHT
+ */
+bool TestDhtPinDevice::runTests()
+{
+    DhtPinDevice device;
+    DhtReceiver  receiver(TEST_DHT_PIN, DHT22);
+    host::attachDevice(TEST_DHT_PIN, &device);
+
+    // 65.2 %, 35.1 °C
+    uint8_t warm[5];
+    DhtPinDevice::encode(35.1, 65.2, warm);
+    device.setFrame(warm);
+    DhtReceiver::Status status = receiver.read();
+    assert(status == DhtReceiver::OK && device.responses() == 1);
+    assert(fabs(receiver.temperature() - 35.1) < 0.01 && fabs(receiver.humidity() - 65.2) < 0.01);
+    assert(receiver.statistics().captureTime >= DHT_FRAME_TIME * 1000UL);
+
+    // within DHT_MIN_INTERVAL the last frame is returned without start signal
+    status = receiver.read();
+    assert(status == DhtReceiver::OK && device.responses() == 1);
+
+    // -10.1 °C with interrupt latency and the release edge of the host
+    uint8_t cold[5];
+    DhtPinDevice::encode(-10.1, 40.0, cold);
+    device.setFrame(cold, 10, true);
+    status = receiver.read(true);
+    assert(status == DhtReceiver::OK);
+    assert(fabs(receiver.temperature() + 10.1) < 0.01 && fabs(receiver.humidity() - 40.0) < 0.01);
+
+    // a missed edge with the release edge in front: rejected, the last valid values stay
+    uint32_t edges[DHT_MAX_EDGES];
+    uint32_t seed  = 1;
+    uint8_t  count = TestDhtReceiver::synthesize(edges, warm, 0, 0, seed, true);
+    memmove(edges + 40, edges + 41, (count - 41) * sizeof(uint32_t));
+    device.setEdges(edges, count - 1);
+    status = receiver.read(true);
+    assert(status == DhtReceiver::BAD_TIMING);
+    assert(fabs(receiver.temperature() + 10.1) < 0.01);
+
+    // a frame cut off by the end of the capture
+    count = TestDhtReceiver::synthesize(edges, warm, 0, 0, seed);
+    device.setEdges(edges, count / 2);
+    status = receiver.read(true);
+    assert(status == DhtReceiver::NO_RESPONSE);
+
+    // a missing sensor
+    device.setEdges(edges, 0);
+    status = receiver.read(true);
+    assert(status == DhtReceiver::NO_RESPONSE);
+
+    const DhtReceiver::Statistics& stats = receiver.statistics();
+    assert(stats.frames == 5 && stats.status[DhtReceiver::OK] == 2);
+    assert(stats.status[DhtReceiver::BAD_TIMING] == 1 && stats.status[DhtReceiver::NO_RESPONSE] == 2);
+
+    // the sensor class takes temperature and humidity from the same frame
+    device.setFrame(warm);
+    SensorDHT sensor(TEST_DHT_PIN, DHT22);
+    float     temperature = sensor.temperature();
+    float     humidity    = sensor.humidity();
+    assert(fabs(temperature - 35.1) < 0.01 && fabs(humidity - 65.2) < 0.01);
+    assert(device.responses() == 6);
+
+    host::attachDevice(TEST_DHT_PIN, nullptr);
+    return true;
+}
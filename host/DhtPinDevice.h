@@ -0,0 +1,53 @@
+#ifndef DHTPINDEVICE_H
+#define DHTPINDEVICE_H
+
+/**
+ * DHT22 on a pin of the simulated board of the host
+ */
+
+#include "DhtReceiver.h"
+#include <Arduino.h>
+
+/**
+ * Pin device answering each start signal of a DhtReceiver with an edge stream
+ *
+ * The stream is either a frame synthesized from given data with optional timing jitter and release edge, or given
+ * edge offsets replayed as they are, e.g. a frame with a missing or glitch edge. Edges are timed relative to the
+ * release of the line and delivered to the interrupt handler of the pin by delay(), so read() runs its real capture
+ * path including start signal, interrupt handler and DHT_FRAME_TIME.
+ */
+class DhtPinDevice : public host::PinDevice
+{
+public:
+    DhtPinDevice(void);
+
+    void setFrame(const uint8_t data[5], uint8_t jitter = 0, bool releaseEdge = false);
+    void setEdges(const uint32_t* offsets, uint8_t count);
+
+    uint32_t responses(void) const { return responseCount; }
+
+    virtual uint8_t respond(uint32_t released, uint32_t* edges, uint8_t size);
+
+    static void encode(float temperature, float humidity, uint8_t data[5]);
+
+private:
+    uint8_t  frame[5];
+    uint8_t  jitter;      // max deviation of synthesized pulse widths in us
+    bool     releaseEdge; // synthesized with the rising edge of the host releasing the line
+    uint32_t seed;        // of the jitter
+    uint32_t offsets[DHT_MAX_EDGES];
+    uint8_t  offsetCount; // edges to replay
+    bool     replaying;   // replay the offsets instead of synthesizing the frame
+    uint32_t responseCount;
+};
+
+/**
+ * Unit test of DhtReceiver::read() by edge streams replayed on a pin of the simulated board
+ */
+class TestDhtPinDevice
+{
+public:
+    virtual bool runTests();
+};
+
+#endif // DHTPINDEVICE_H
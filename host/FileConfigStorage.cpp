@@ -0,0 +1,106 @@
+#include "FileConfigStorage.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Open or create the file of given path and read both sectors
+ */
+FileConfigStorage::FileConfigStorage(const char* path)
+{
+    memset(data, 0xFF, sizeof(data));
+    file = fopen(path, "r+b");
+    if (!file) {
+        file = fopen(path, "w+b");
+    }
+    if (file) {
+        size_t length = fread(data, 1, sizeof(data), file);
+        (void)length; // a shorter file reads as erased flash
+    }
+}
+
+FileConfigStorage::~FileConfigStorage()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+const uint8_t* FileConfigStorage::sector(uint8_t index)
+{
+    return (!file || index > 1) ? nullptr : (const uint8_t*)data[index];
+}
+
+bool FileConfigStorage::erase(uint8_t index)
+{
+    if (!file || index > 1) {
+        return false;
+    }
+    memset(data[index], 0xFF, sizeof(data[index]));
+    return writeThrough(index);
+}
+
+/**
+ * Write given data like flash, which can only clear bits
+ */
+bool FileConfigStorage::write(uint8_t index, const void* source, size_t size)
+{
+    if (!file || index > 1 || size > sizeof(data[index])) {
+        return false;
+    }
+    uint8_t*       target = (uint8_t*)data[index];
+    const uint8_t* bytes  = (const uint8_t*)source;
+    for (size_t i = 0; i < size; ++i) {
+        target[i] &= bytes[i];
+    }
+    return writeThrough(index);
+}
+
+bool FileConfigStorage::writeThrough(uint8_t index)
+{
+    return fseek(file, index * sizeof(data[index]), SEEK_SET) == 0 &&
+           fwrite(data[index], sizeof(data[index]), 1, file) == 1 && fflush(file) == 0;
+}
+
+/**
+ * Run the DeviceConfig tests on a temporary file and load the result from a new storage of the same file
+ */
+bool TestFileConfigStorage::runTests()
+{
+    char path[] = "/tmp/room-sensor-config-XXXXXX";
+    int  fd     = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    ConfigRecord defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    strcpy(defaults.room, "/test");
+    defaults.displayUpdateDelay = 10000;
+    defaults.dhtPin             = 14;
+
+    {
+        FileConfigStorage storage(path);
+        assert(storage.isOpen());
+        DeviceConfig config(storage);
+        TestDeviceConfig::runTests(config, storage, defaults);
+    }
+
+    // the records survive a restart
+    FileConfigStorage storage(path);
+    DeviceConfig      config(storage);
+    bool              loaded = config.load(defaults);
+    assert(loaded && config.record().sequence == 9);
+    assert(strcmp(config.record().room, "/kueche") == 0 && config.record().relayPin == 12);
+
+    // an erased sector stays erased after a restart as well
+    bool erased = storage.erase(0) && storage.erase(1);
+    assert(erased);
+    FileConfigStorage erasedStorage(path);
+    DeviceConfig      erasedConfig(erasedStorage);
+    loaded = erasedConfig.load(defaults);
+    assert(!loaded && strcmp(erasedConfig.record().room, "/test") == 0);
+
+    unlink(path);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef FILECONFIGSTORAGE_H
+#define FILECONFIGSTORAGE_H
+
+/**
+ * Configuration sectors in a file of the host with flash semantics
+ */
+
+#include "DeviceConfig.h"
+#include <stdio.h>
+
+/**
+ * Both configuration sectors in one file, so a configuration survives restarts of host executables like the
+ * flash area survives resets of the device
+ *
+ * The file holds the record area of sector 0 followed by sector 1. It is read once by the constructor, missing or
+ * short files read as erased flash. erase() and write() change the buffer with flash semantics and write the
+ * sector through to the file.
+ */
+class FileConfigStorage : public ConfigStorage
+{
+public:
+    FileConfigStorage(const char* path);
+    ~FileConfigStorage();
+
+    virtual const uint8_t* sector(uint8_t index);
+    virtual bool           erase(uint8_t index);
+    virtual bool           write(uint8_t index, const void* data, size_t size);
+
+    bool isOpen(void) const { return file != nullptr; }
+
+private:
+    bool writeThrough(uint8_t index);
+
+    FILE*    file;
+    uint32_t data[2][(sizeof(ConfigRecord) + 3) / 4];
+};
+
+/**
+ * Unit test for FileConfigStorage: the DeviceConfig tests on a temporary file and a reload from it
+ */
+class TestFileConfigStorage
+{
+public:
+    virtual bool runTests();
+};
+
+#endif // FILECONFIGSTORAGE_H
@@ -0,0 +1,378 @@
+/**
+ * Fleet of sketch nodes against the broker stand-in
+ *
+ *   fleet [maxNodes] [seconds]
+ *
+ * Runs 10, 25, 50, ... up to maxNodes nodes for the given time each. Every node has its own simulated board, a
+ * MqttClient on its own WiFiClient, a DHT22 answering on its pin, a DS18B20 on a simulated 1-Wire bus, relays and
+ * rules, and runs the NodeLoop of the sketch loop() in a coroutine of its own. The broker processes a limited packet
+ * rate and is down for the second quarter of the run. Logs message rate, connect attempts per FLEET_TICK after the
+ * outage, recovery time and broker-side latency per fleet size, next to the FleetSimulator model of the same
+ * scenario. Returns nonzero if a fleet did not recover from the outage, while the model did.
+ */
+
+#include "BrokerStandIn.h"
+#include "DhtPinDevice.h"
+#include "FleetSimulator.h"
+#include "Logger.h"
+#include "MqttClient.h"
+#include "NodeLoop.h"
+#include "Relays.h"
+#include "RuleEngine.h"
+#include "SensorDHT.h"
+#include "SensorDS18B20.h"
+#include "SimulatedTemperatureBus.h"
+#include <ESP8266WiFi.h>
+#include <memory>
+#include <poll.h>
+#include <time.h>
+#include <ucontext.h>
+#include <vector>
+
+#define FLEET_STACK_SIZE 65536   // bytes of each node coroutine stack
+#define FLEET_LOOP_INTERVAL 5000 // milliseconds between loop() runs of a node, displayUpdateDelay of the sketch
+#define FLEET_BROKER_RATE 500    // packets per second processed by the broker
+#define FLEET_STOP_WAIT 10000    // microseconds, shorter waits without socket are still waited for at the end of a run
+#define FLEET_RELAY_PIN 26
+
+/**
+ * One room sensor node: the parts of the sketch used by loop() without display, metrics and history
+ */
+class FleetNode
+{
+public:
+    FleetNode(int index, uint16_t port) :
+        mqttClient(&wifiClient, MQTT_SERVER, port, MQTT_USERNAME, MQTT_KEY),
+        sensorDHT(DHT_IN, DHT22),
+        bus(1, false, 45.0),
+        sensorDS18B20(&bus),
+        relays(std::vector<int>{FLEET_RELAY_PIN}),
+        nodeLoop(mqttClient, sensorDHT, sensorDS18B20, rules, relays),
+        index(index)
+    {
+        uint8_t frame[5];
+        DhtPinDevice::encode(20.0 + index % 10 * 0.3, 40.0 + index % 20, frame);
+        dht.setFrame(frame, 5);
+    }
+
+    /**
+     * Setup of the node - runs in the coroutine of the node, so the board is set
+     */
+    void setup(void)
+    {
+        host::attachDevice(DHT_IN, &dht);
+        sensorDS18B20.sensorsAvailable();
+        rules.registerSensor(0, &sensorDHT);
+        rules.registerSensor(1, &sensorDS18B20);
+        rules.compile("R0=T0<18~0.5");
+
+        char path[MQTT_PATH_LENGTH];
+        snprintf(path, sizeof(path), "/fleet%d/temperature", index);
+        mqttClient.createPublishTopic("temperature", path, MqttClient::SENSOR);
+        snprintf(path, sizeof(path), "/fleet%d/temperature_heater", index);
+        mqttClient.createPublishTopic("temperature_heater", path, MqttClient::SENSOR);
+        snprintf(path, sizeof(path), "/fleet%d/humidity", index);
+        mqttClient.createPublishTopic("humidity", path, MqttClient::SENSOR);
+        snprintf(path, sizeof(path), "/fleet%d/lights", index);
+        mqttClient.createPublishTopic("lights", path, MqttClient::SWITCH);
+        snprintf(path, sizeof(path), "/fleet%d/+/set", index);
+        mqttClient.createSubscribeTopic("switches", path, MqttClient::SWITCH);
+        snprintf(path, sizeof(path), "/fleet%d/+", index);
+        mqttClient.createSubscribeTopic("commands", path, MqttClient::COMMAND);
+        snprintf(path, sizeof(path), "/fleet%d/lights/set", index);
+        mqttClient.createSubscribeTopic("lights", path, MqttClient::SWITCH);
+        mqttClient.addNotifyCallback("lights", &handleSwitch, this);
+        relays.addStateCallback([this](int port, bool state) {
+            if (port == 0) {
+                mqttClient.publish("lights", state ? "true" : "false");
+            }
+        });
+    }
+
+    /**
+     * loop() of the sketch without display, history and metrics
+     */
+    void loop(void) { nodeLoop.run(FLEET_LOOP_INTERVAL, FLEET_LOOP_INTERVAL); }
+
+    const MqttClient::Statistics& statistics(void) const { return mqttClient.statistics(); }
+
+    host::Board board;
+
+private:
+    static bool handleSwitch(const char*, const char* message, void* node)
+    {
+        static_cast<FleetNode*>(node)->relays.togglePort(0, strcmp(message, "true") == 0);
+        return true;
+    }
+
+    WiFiClient              wifiClient;
+    MqttClient              mqttClient;
+    DhtPinDevice            dht;
+    SensorDHT               sensorDHT;
+    SimulatedTemperatureBus bus;
+    SensorDS18B20           sensorDS18B20;
+    RelayPorts              relays;
+    RuleEngine              rules;
+    NodeLoop                nodeLoop;
+    int                     index;
+};
+
+/**
+ * Node with its coroutine and the wait it is suspended in
+ */
+struct Coroutine
+{
+    std::unique_ptr<FleetNode> node;
+    ucontext_t                 context;
+    std::vector<char>          stack;
+    int                        fd       = -1; // waited for, -1 for none
+    short                      events   = 0;
+    uint64_t                   deadline = 0;  // microSinceStart() the wait ends
+    bool                       ready    = false;
+    bool                       finished = false;
+};
+
+static ucontext_t scheduler;
+static Coroutine* running  = nullptr; // coroutine of the node running, nullptr in the scheduler
+static bool       stopping = false;   // run is over, waits return at once until each node left its loop()
+
+/**
+ * Wait in place like the default of host::wait()
+ */
+static bool waitInPlace(int fd, short events, uint64_t deadline)
+{
+    uint64_t now = host::microsSinceStart();
+    if (fd < 0) {
+        if (deadline > now) {
+            struct timespec time = {(time_t)((deadline - now) / 1000000), (long)((deadline - now) % 1000000 * 1000)};
+            nanosleep(&time, nullptr);
+        }
+        return false;
+    }
+    struct pollfd request = {fd, events, 0};
+    return poll(&request, 1, now < deadline ? (int)((deadline - now + 999) / 1000) : 0) > 0;
+}
+
+/**
+ * Wait function of the nodes: suspend the running node and let the scheduler run other nodes until the wait ends
+ *
+ * Waits already due stay in place. The edge capture of DhtReceiver is switched as well: the edges of the DHT of a
+ * node are stored on its own board and delivered to its receiver when the node is resumed. At the end of a run
+ * only captures and other short waits without socket are still waited for, in place.
+ */
+static bool fleetWait(int fd, short events, uint64_t deadline)
+{
+    uint64_t now = host::microsSinceStart();
+    if (stopping) {
+        return (fd < 0 && deadline < now + FLEET_STOP_WAIT) ? waitInPlace(fd, events, deadline) : false;
+    }
+    if (!running || deadline <= now) {
+        return waitInPlace(fd, events, deadline);
+    }
+    Coroutine* self = running;
+    self->fd        = fd;
+    self->events    = events;
+    self->deadline  = deadline;
+    self->ready     = false;
+    swapcontext(&self->context, &scheduler);
+    return self->ready;
+}
+
+static void runNode(void)
+{
+    Coroutine* self = running;
+    self->node->setup();
+    while (!stopping) {
+        self->node->loop();
+    }
+    self->finished = true;
+}
+
+static void resume(Coroutine& coroutine)
+{
+    host::setBoard(&coroutine.node->board);
+    running = &coroutine;
+    swapcontext(&scheduler, &coroutine.context);
+    running = nullptr;
+    host::setBoard(nullptr);
+}
+
+/**
+ * Sum of connect() calls of all nodes not skipped by the backoff
+ */
+static uint32_t connectAttempts(const std::vector<Coroutine>& fleet)
+{
+    uint32_t attempts = 0;
+    for (const Coroutine& coroutine : fleet) {
+        attempts += coroutine.node->statistics().connects + coroutine.node->statistics().connectFailures;
+    }
+    return attempts;
+}
+
+/**
+ * Run given scenario with real nodes - the fields of the result are those of the model, latencies in microseconds
+ */
+static FleetSimulator::Result runFleet(const FleetSimulator::Scenario& scenario, BrokerStandIn& broker)
+{
+    std::vector<Coroutine> fleet(scenario.nodes);
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        Coroutine& coroutine = fleet[i];
+        coroutine.node.reset(new FleetNode(i, broker.port()));
+        coroutine.stack.resize(FLEET_STACK_SIZE);
+        getcontext(&coroutine.context);
+        coroutine.context.uc_stack.ss_sp   = coroutine.stack.data();
+        coroutine.context.uc_stack.ss_size = coroutine.stack.size();
+        coroutine.context.uc_link          = &scheduler;
+        makecontext(&coroutine.context, runNode, 0);
+    }
+
+    FleetSimulator::Result result;
+    memset(&result, 0, sizeof(result));
+    std::vector<uint32_t> connectsBefore(fleet.size());
+    std::vector<pollfd>   requests;
+    std::vector<size_t>   waiting; // coroutine of each request
+    bool                  outage      = false;
+    bool                  recovered   = false;
+    uint32_t              attempts    = 0;
+    uint64_t              start       = host::microsSinceStart();
+    uint64_t              nextTick    = start + FLEET_TICK * 1000;
+    uint64_t              outageStart = start + scenario.outageStart * 1000ULL;
+    uint64_t              outageEnd   = start + scenario.outageEnd * 1000ULL;
+    uint64_t              end         = start + scenario.duration * 1000ULL;
+
+    broker.setRateLimit(scenario.brokerRate);
+    broker.resetStatistics();
+    stopping = false;
+    host::setWaitFunction(&fleetWait);
+
+    size_t finished = 0;
+    while (finished < fleet.size()) {
+        uint64_t now = host::microsSinceStart();
+        if (!outage && now >= outageStart && now < outageEnd) {
+            outage = true;
+            broker.setAccepting(false);
+            broker.disconnectAll();
+            for (size_t i = 0; i < fleet.size(); ++i) {
+                connectsBefore[i] = fleet[i].node->statistics().connects;
+            }
+        } else if (outage && now >= outageEnd) {
+            outage = false;
+            broker.setAccepting(true);
+            attempts = connectAttempts(fleet);
+        }
+        if (now >= nextTick) {
+            nextTick += FLEET_TICK * 1000;
+            if (now >= outageEnd && !recovered) {
+                uint32_t total = connectAttempts(fleet);
+                if (total - attempts > result.peakReconnects) {
+                    result.peakReconnects = total - attempts;
+                }
+                attempts  = total;
+                recovered = true;
+                for (size_t i = 0; i < fleet.size() && recovered; ++i) {
+                    recovered = fleet[i].node->statistics().connects != connectsBefore[i];
+                }
+                if (recovered) {
+                    result.recoveryTime = (now - outageEnd) / 1000;
+                }
+            }
+        }
+        stopping = now >= end;
+
+        // wait for the next socket or deadline of a node, or the next tick
+        requests.clear();
+        waiting.clear();
+        uint64_t deadline = stopping ? now : nextTick;
+        for (size_t i = 0; i < fleet.size(); ++i) {
+            const Coroutine& coroutine = fleet[i];
+            if (coroutine.finished) {
+                continue;
+            }
+            if (coroutine.deadline < deadline) {
+                deadline = coroutine.deadline;
+            }
+            if (coroutine.fd >= 0) {
+                requests.push_back(pollfd{coroutine.fd, coroutine.events, 0});
+                waiting.push_back(i);
+            }
+        }
+        int timeout = deadline > now ? (int)((deadline - now + 999) / 1000) : 0;
+        if (poll(requests.data(), requests.size(), timeout) < 0) {
+            requests.clear();
+        }
+        for (size_t i = 0; i < requests.size(); ++i) {
+            fleet[waiting[i]].ready = requests[i].revents != 0;
+        }
+
+        now = host::microsSinceStart();
+        for (Coroutine& coroutine : fleet) {
+            if (!coroutine.finished && (coroutine.ready || coroutine.deadline <= now || stopping)) {
+                resume(coroutine);
+                finished += coroutine.finished ? 1 : 0;
+            }
+        }
+    }
+    host::setWaitFunction(nullptr);
+
+    BrokerStandIn::Statistics stats = broker.statistics();
+    for (const Coroutine& coroutine : fleet) {
+        result.connects += coroutine.node->statistics().connects;
+        result.connectFailures += coroutine.node->statistics().connectFailures;
+    }
+    result.messages     = stats.published;
+    result.messageRate  = (uint64_t)stats.published * 1000 / scenario.duration;
+    result.recoveryTime = recovered ? result.recoveryTime : (uint32_t)-1;
+    result.latencyP50   = stats.latencyP50;
+    result.latencyP99   = stats.latencyP99;
+    result.latencyMax   = stats.latencyMax;
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    int      maxNodes = argc > 1 ? atoi(argv[1]) : 100;
+    uint32_t duration = argc > 2 ? atoi(argv[2]) * 1000 : 60000;
+    int      failures = 0;
+
+    BrokerStandIn broker;
+    if (!broker.start()) {
+        fprintf(stderr, "broker stand-in failed to listen\n");
+        return 1;
+    }
+
+    static const uint16_t sizes[] = {10, 25, 50, 100, 200, 500, 1000};
+    for (uint16_t nodes : sizes) {
+        if (nodes > maxNodes) {
+            break;
+        }
+        FleetSimulator::Scenario scenario;
+        scenario.nodes        = nodes;
+        scenario.duration     = duration;
+        scenario.outageStart  = duration / 4;
+        scenario.outageEnd    = duration / 2;
+        scenario.loopInterval = FLEET_LOOP_INTERVAL;
+        scenario.brokerRate   = FLEET_BROKER_RATE;
+
+        FleetSimulator::Result real = runFleet(scenario, broker);
+        logger.flush();
+        LOG_INFO(BENCH, "fleet %u nodes: %u msg/s, %u connects, %u failed, peak %u conn/tick, recovery %ld ms",
+                 nodes, (unsigned int)real.messageRate, (unsigned int)real.connects,
+                 (unsigned int)real.connectFailures, real.peakReconnects, (long)(int32_t)real.recoveryTime);
+        LOG_INFO(BENCH, "fleet %u nodes: broker latency p50 %u p99 %u max %u us", nodes, (unsigned int)real.latencyP50,
+                 (unsigned int)real.latencyP99, (unsigned int)real.latencyMax);
+
+        FleetSimulator         simulator;
+        FleetSimulator::Result model = simulator.run(scenario);
+        LOG_INFO(BENCH, "model %u nodes: %u msg/s, %u connects, %u failed, peak %u conn/tick, recovery %ld ms",
+                 nodes, (unsigned int)model.messageRate, (unsigned int)model.connects,
+                 (unsigned int)model.connectFailures, model.peakReconnects, (long)(int32_t)model.recoveryTime);
+        // an overloaded broker keeps the model from recovering as well
+        bool unrecovered = real.recoveryTime == (uint32_t)-1 && model.recoveryTime != (uint32_t)-1;
+        failures += (unrecovered || real.messages == 0) ? 1 : 0;
+        logger.flush();
+        broker.disconnectAll();
+    }
+
+    broker.stop();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+/**
+ * Benchmarks of the sketch classes on the host, the same set as RUN_BENCHMARKS in setup() of the sketch
+ *
+ * Built optimized and without sanitizers.
+ *
+ *   host_benchmarks [baselines]
+ *
+ * With a baselines file the BenchmarkSuite results are checked against it and the exit code is 1 on regressions. A
+ * missing file is written with the results, so the first run on a machine records its baselines.
+ */
+
+#include "Benchmarks.h"
+#include "BrokerStandIn.h"
+#include "Calibration.h"
+#include "DeviceConfig.h"
+#include "DhtReceiver.h"
+#include "DisplayFont.h"
+#include "FleetSimulator.h"
+#include "Logger.h"
+#include "MetricsLoopback.h"
+#include "MetricsServer.h"
+#include "NumberFormat.h"
+#include "SampleHistory.h"
+#include "SimulatedTemperatureBus.h"
+#include "SpscQueue.h"
+#include "TopicTrie.h"
+#include <Adafruit_SSD1306.h>
+#include <ESP8266WiFi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Set the baselines of given file, lines of "<ns> <name>", and return FALSE if it cannot be read
+ */
+static bool readBaselines(const char* path, BenchmarkSuite& benchmarks)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[BENCHMARK_NAME_LENGTH + 16];
+    while (fgets(line, sizeof(line), file)) {
+        char*         name  = nullptr;
+        unsigned long nanos = strtoul(line, &name, 10);
+        if (name == line || *name != ' ') {
+            continue;
+        }
+        ++name;
+        name[strcspn(name, "\r\n")] = '\0';
+        if (!benchmarks.setBaseline(name, (uint32_t)nanos)) {
+            LOG_WARN(BENCH, "%s: baseline of %s not set", path, name);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Write the results of given benchmarks as baselines to given file
+ */
+static bool writeBaselines(const char* path, const BenchmarkSuite& benchmarks)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    for (uint8_t i = 0; i < benchmarks.resultCount(); ++i) {
+        fprintf(file, "%u %s\n", (unsigned int)benchmarks.result(i).nanos, benchmarks.result(i).name);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    TestNumberFormat().runBenchmark();
+    TestSimulatedTemperatureBus().runBenchmark();
+    TestDeviceConfig().runBenchmark();
+    TestFleetSimulator().runBenchmark();
+    TestSampleHistory().runBenchmark();
+    TestSpscQueue().runBenchmark();
+    TestSpscQueue().runStressTest();
+    TestDhtReceiver().runBenchmark();
+    TestTopicTrie().runBenchmark();
+    logger.flush(); // the lines above fill the log buffer
+    TestCalibration().runBenchmark();
+    TestMetricsServer().runBenchmark();
+    TestMetricsLoopback().runBenchmark();
+
+    Adafruit_SSD1306 display(128, 64);
+    display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
+    TestDisplayFont(display).runBenchmark();
+    logger.flush();
+
+    BrokerStandIn broker;
+    broker.start();
+    WiFiClient client;
+    MqttClient mqttClient(&client, MQTT_SERVER, broker.port(), MQTT_USERNAME, MQTT_KEY);
+    mqttClient.connect();
+    SimulatedTemperatureBus bus(3); // the fake Dallas bus has no devices
+    SensorDS18B20           sensorDS18B20(&bus);
+    BenchmarkSuite          benchmarks(mqttClient, sensorDS18B20, display);
+
+    const char* baselines   = argc > 1 ? argv[1] : nullptr;
+    bool        compare     = baselines && readBaselines(baselines, benchmarks);
+    int         regressions = benchmarks.runAll(10000);
+    if (baselines && !compare) {
+        bool written = writeBaselines(baselines, benchmarks);
+        LOG_INFO(BENCH, "%s: %s", baselines, written ? "baselines written" : "baselines not written");
+        logger.flush();
+    }
+    return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/**
+ * Unit tests of the sketch classes on the host, in the same order as setup() of the sketch runs them
+ *
+ * Each test object lives in its own scope like in setup(), a failed assert aborts with the failing expression.
+ */
+
+#include "AllocationGuard.h"
+#include "BrokerStandIn.h"
+#include "Calibration.h"
+#include "DeviceConfig.h"
+#include "DhtPinDevice.h"
+#include "DhtReceiver.h"
+#include "DisplayFont.h"
+#include "FastBoot.h"
+#include "FileConfigStorage.h"
+#include "FleetSimulator.h"
+#include "Logger.h"
+#include "MetricsLoopback.h"
+#include "MetricsServer.h"
+#include "MqttClient.h"
+#include "NumberFormat.h"
+#include "Profiler.h"
+#include "Relays.h"
+#include "RuleEngine.h"
+#include "SampleHistory.h"
+#include "SensorDS18B20.h"
+#include "SimulatedTemperatureBus.h"
+#include "SpscQueue.h"
+#include "TemperatureSensor.h"
+#include "TopicTrie.h"
+#include <Adafruit_SSD1306.h>
+#include <ESP8266WiFi.h>
+
+/**
+ * Run the tests of given class and log its name, so a failing assert can be attributed in the ctest output
+ */
+template <class Test> static void run(const char* name, Test&& test)
+{
+    printf("%s\n", name);
+    fflush(stdout);
+    test.runTests();
+}
+
+int main()
+{
+    run("TestLogger", TestLogger());
+    run("TestProfiler", TestProfiler());
+    run("TestTemperatureSensor", TestTemperatureSensor());
+    run("TestNumberFormat", TestNumberFormat());
+    run("TestRuleEngine", TestRuleEngine());
+    run("TestRelayPorts", TestRelayPorts(std::vector<int>{20, 21, 22}));
+    run("TestSimulatedTemperatureBus", TestSimulatedTemperatureBus());
+    run("TestDeviceConfig", TestDeviceConfig());
+    run("TestFileConfigStorage", TestFileConfigStorage());
+    run("TestFastBoot", TestFastBoot());
+    run("TestFleetSimulator", TestFleetSimulator());
+    run("TestSampleHistory", TestSampleHistory());
+    run("TestSpscQueue", TestSpscQueue());
+    bool stressed = TestSpscQueue().runStressTest(100000);
+    assert(stressed);
+    run("TestDhtReceiver", TestDhtReceiver());
+    run("TestDhtPinDevice", TestDhtPinDevice());
+    run("TestTopicTrie", TestTopicTrie());
+    run("TestCalibration", TestCalibration());
+    run("TestMetricsServer", TestMetricsServer());
+    run("TestMetricsLoopback", TestMetricsLoopback());
+    run("TestSensorDS18B20", TestSensorDS18B20());
+
+    Adafruit_SSD1306 display(128, 64);
+    display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
+    run("TestDisplayFont", TestDisplayFont(display));
+
+    BrokerStandIn broker;
+    bool          started = broker.start();
+    assert(started);
+    WiFiClient client;
+    MqttClient mqttClient(&client, MQTT_SERVER, broker.port(), MQTT_USERNAME, MQTT_KEY);
+    run("TestMqttClient", TestMqttClient(mqttClient));
+    run("TestAllocationGuard", TestAllocationGuard(mqttClient));
+
+    // round trips through the broker stand-in
+    bool loaded = TestMqttClient(mqttClient).runLoadTest(100);
+    assert(loaded);
+    BrokerStandIn::Statistics brokerStatistics = broker.statistics();
+    assert(brokerStatistics.published >= 100 && brokerStatistics.malformed == 0);
+
+    logger.flush();
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "MetricsLoopback.h"
+#include "Logger.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LOOPBACK_HOST "127.0.0.1"
+#define LOOPBACK_RESPONSE_TIMEOUT 1000 // milliseconds to wait for each part of a response
+
+/**
+ * Return a loopback port nobody listens on right now, 0 on error
+ */
+static uint16_t freePort(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct sockaddr_in address;
+    socklen_t          length = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port        = 0;
+    uint16_t port           = 0;
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+        getsockname(fd, (struct sockaddr*)&address, &length) == 0) {
+        port = ntohs(address.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+/**
+ * Connect given client to the server and send given request without waiting for the response
+ */
+static bool sendRequest(WiFiClient& client, uint16_t port, const char* request)
+{
+    if (!client.connect(LOOPBACK_HOST, port)) {
+        return false;
+    }
+    size_t length = strlen(request);
+    return client.write((const uint8_t*)request, length) == length;
+}
+
+/**
+ * Read the response of given client until the server closes the connection
+ *
+ * @return bytes read, the response is terminated in given buffer
+ */
+static size_t readResponse(WiFiClient& client, char* response, size_t size)
+{
+    size_t length = 0;
+    while (length < size - 1 && client.waitAvailable(LOOPBACK_RESPONSE_TIMEOUT)) {
+        int received = client.read((uint8_t*)response + length, size - 1 - length);
+        if (received < 0) {
+            break;
+        }
+        length += received;
+    }
+    response[length] = '\0';
+    client.stop();
+    return length;
+}
+
+/**
+ * Requests of the metrics page, other paths, more clients than one handle() call serves and stalled clients
+ */
+bool TestMetricsLoopback::runTests()
+{
+    static MetricsPage page;
+    page.clear();
+    page.addFamily("room_sensor_temperature_celsius", "gauge", "Temperature");
+    int16_t dht = page.addMetric("room_sensor_temperature_celsius", "sensor", "dht22");
+    page.addFamily("room_sensor_mqtt_published_total", "counter", "Messages");
+    int16_t published = page.addMetric("room_sensor_mqtt_published_total");
+    page.set(dht, 21.3f);
+    page.set(published, (uint32_t)1234);
+
+    uint16_t port = freePort();
+    assert(port != 0);
+    MetricsServer server(page, port);
+    server.begin();
+    uint8_t served = server.handle();
+    assert(served == 0);
+
+    // the page with HTTP header, the body is the page text as is
+    static char response[METRICS_HEADER_SIZE + METRICS_PAGE_SIZE + 1];
+    WiFiClient  client;
+    bool        sent = sendRequest(client, port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n");
+    assert(sent);
+    served = server.handle();
+    assert(served == 1);
+    size_t length = readResponse(client, response, sizeof(response));
+    assert(length == page.responseLength());
+    assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(response, "Content-Type: text/plain; version=0.0.4"));
+
+    const char* contentLength = strstr(response, "Content-Length: ");
+    const char* body          = strstr(response, "\r\n\r\n");
+    assert(contentLength && body);
+    body += 4;
+    assert((size_t)atoi(contentLength + 16) == length - (body - response));
+    assert(strcmp(body, page.text()) == 0);
+    assert(strstr(body, "room_sensor_temperature_celsius{sensor=\"dht22\"}        21.30\n"));
+    assert(strstr(body, "room_sensor_mqtt_published_total         1234\n"));
+
+    // values set after the start are served with the next request
+    page.set(dht, -4.5f, 1);
+    sent = sendRequest(client, port, "GET / HTTP/1.0\r\n\r\n");
+    assert(sent);
+    served = server.handle();
+    assert(served == 1);
+    length = readResponse(client, response, sizeof(response));
+    assert(length == page.responseLength() && strstr(response, "{sensor=\"dht22\"}         -4.5\n"));
+
+    sent = sendRequest(client, port, "GET /favicon.ico HTTP/1.1\r\n\r\n");
+    assert(sent);
+    served = server.handle();
+    assert(served == 1);
+    length = readResponse(client, response, sizeof(response));
+    assert(length > 0 && strncmp(response, "HTTP/1.1 404", 12) == 0 && !strstr(response, "room_sensor"));
+
+    // one handle() call serves METRICS_MAX_CLIENTS, the next one the rest
+    WiFiClient clients[METRICS_MAX_CLIENTS + 1];
+    for (WiFiClient& pending : clients) {
+        sent = sendRequest(pending, port, "GET /metrics HTTP/1.1\r\n\r\n");
+        assert(sent);
+    }
+    served = server.handle();
+    assert(served == METRICS_MAX_CLIENTS);
+    served = server.handle();
+    assert(served == 1);
+    for (WiFiClient& pending : clients) {
+        length = readResponse(pending, response, sizeof(response));
+        assert(length == page.responseLength());
+    }
+
+    // a client without request delays handle() by METRICS_REQUEST_TIMEOUT and gets no response, the time is used up
+    // for the clients behind it, which are served by the next call
+    bool connected = client.connect(LOOPBACK_HOST, port);
+    assert(connected);
+    for (uint8_t i = 0; i < 2; ++i) {
+        sent = sendRequest(clients[i], port, "GET /metrics HTTP/1.1\r\n\r\n");
+        assert(sent);
+    }
+    unsigned long start   = millis();
+    served                = server.handle();
+    unsigned long elapsed = millis() - start;
+    assert(served == 1 && elapsed >= METRICS_REQUEST_TIMEOUT && elapsed < METRICS_REQUEST_TIMEOUT + 100);
+    length = readResponse(client, response, sizeof(response));
+    assert(length == 0);
+    served = server.handle();
+    assert(served == 2);
+    for (uint8_t i = 0; i < 2; ++i) {
+        length = readResponse(clients[i], response, sizeof(response));
+        assert(length == page.responseLength());
+    }
+
+    // a request without the end of its header is answered at the timeout, not after a timeout per missing line
+    sent = sendRequest(client, port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n");
+    assert(sent);
+    start   = millis();
+    served  = server.handle();
+    elapsed = millis() - start;
+    assert(served == 1 && elapsed >= METRICS_REQUEST_TIMEOUT && elapsed < METRICS_REQUEST_TIMEOUT + 100);
+    length = readResponse(client, response, sizeof(response));
+    assert(length == page.responseLength());
+
+    const MetricsServer::Statistics& stats = server.statistics();
+    assert(stats.requests == 2 + METRICS_MAX_CLIENTS + 1 + 2 + 1 && stats.notFound == 1 && stats.timeouts == 1);
+    return true;
+}
+
+/**
+ * Log the request rate over loopback connections: connect, request, handle() and read the response until close
+ */
+void TestMetricsLoopback::runBenchmark(uint32_t requests)
+{
+    static MetricsPage page;
+    char               probe[16];
+    page.clear();
+    page.addFamily("room_sensor_temperature_celsius", "gauge", "Temperature of each sensor");
+    for (uint8_t i = 0; i < 32; ++i) {
+        snprintf(probe, sizeof(probe), "sensor%u", (unsigned int)i);
+        page.set(page.addMetric("room_sensor_temperature_celsius", "probe", probe), 20.0f + i * 0.1f);
+    }
+
+    uint16_t      port = freePort();
+    MetricsServer server(page, port);
+    server.begin();
+    static char   response[METRICS_HEADER_SIZE + METRICS_PAGE_SIZE + 1];
+    uint32_t      failed = 0;
+    unsigned long start  = micros();
+    for (uint32_t i = 0; i < requests; ++i) {
+        WiFiClient client;
+        bool       sent = sendRequest(client, port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        if (!sent || server.handle() != 1 || readResponse(client, response, sizeof(response)) != page.responseLength()) {
+            ++failed;
+        }
+    }
+    unsigned long requestTime = micros() - start;
+    LOG_INFO(BENCH, "metrics loopback: %lu us/request (%u requests, %u failed), %u bytes",
+             (unsigned long)(requestTime / requests), (unsigned int)requests, (unsigned int)failed,
+             (unsigned int)page.responseLength());
+}
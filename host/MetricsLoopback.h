@@ -0,0 +1,24 @@
+#ifndef METRICSLOOPBACK_H
+#define METRICSLOOPBACK_H
+
+/**
+ * MetricsServer over real loopback connections of the host
+ */
+
+#include "MetricsServer.h"
+
+/**
+ * Unit test and benchmark of MetricsServer::handle() with clients connected through the WiFi fake's sockets
+ *
+ * The server listens on a free port, each client connects to 127.0.0.1 and sends its request before handle() is
+ * called, so the test runs in one thread like loop() on the device. Responses are read until the server closes
+ * the connection.
+ */
+class TestMetricsLoopback
+{
+public:
+    virtual bool runTests();
+    virtual void runBenchmark(uint32_t requests = 1000);
+};
+
+#endif // METRICSLOOPBACK_H
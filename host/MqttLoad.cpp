@@ -0,0 +1,209 @@
+/**
+ * Load and fault injection harness of MqttClient against the broker stand-in
+ *
+ *   mqtt_load [messages]
+ *
+ * Runs the load test of TestMqttClient without faults, with a delaying and a dropping broker, measures the dispatch
+ * rate of commands published by a second client and the recovery from a half-open connection and a broker outage.
+ * Returns nonzero if a scenario without message loss lost messages or the client did not recover.
+ */
+
+#include "BrokerStandIn.h"
+#include "Logger.h"
+#include "MqttClient.h"
+#include <ESP8266WiFi.h>
+
+#define LOAD_RECOVERY_TIMEOUT 30000 // milliseconds until the client must be back online after a fault ends
+
+/**
+ * Log the broker side of the last scenario and reset the broker statistics
+ */
+static void logBroker(BrokerStandIn& broker, const char* scenario)
+{
+    BrokerStandIn::Statistics stats = broker.statistics();
+    logger.flush();
+    LOG_INFO(BENCH, "%s broker: %u published, %u forwarded, %u dropped, %u connects, latency p50=%u p99=%u max=%u us",
+             scenario, (unsigned int)stats.published, (unsigned int)stats.forwarded, (unsigned int)stats.dropped,
+             (unsigned int)stats.connects, (unsigned int)stats.latencyP50, (unsigned int)stats.latencyP99,
+             (unsigned int)stats.latencyMax);
+    logger.flush();
+    broker.resetStatistics();
+}
+
+/**
+ * Wait for messages like the sketch loop does until the client reconnected after a connection loss
+ *
+ * The connection counts as open as long as unread packets are buffered, so it is noticed as lost only after reading.
+ *
+ * @return milliseconds until online, -1 on timeout
+ */
+static long waitForRecovery(MqttClient& client)
+{
+    uint32_t      connects = client.statistics().connects;
+    unsigned long start    = millis();
+    while (millis() - start < LOAD_RECOVERY_TIMEOUT) {
+        client.waitForMessages(10);
+        if (client.statistics().connects != connects && client.connected()) {
+            return millis() - start;
+        }
+        logger.idle(10);
+    }
+    return -1;
+}
+
+static bool countMessage(const char*, const char*, void* counter)
+{
+    ++*static_cast<int*>(counter);
+    return true;
+}
+
+/**
+ * Publish commands by a second client to a wildcard topic of the client and measure the dispatch rate
+ *
+ * @return count of messages dispatched
+ */
+static int runDispatch(MqttClient& client, MqttClient& sender, int messages)
+{
+    int dispatched = 0;
+    client.createSubscribeTopic("load+", "/switch/+/set", MqttClient::SWITCH);
+    client.addNotifyCallback("load+", &countMessage, &dispatched);
+    sender.createPublishTopic("load1", "/switch/load1/set", MqttClient::SWITCH);
+    client.disconnect(); // subscriptions are sent to the broker on connect
+    client.connect();
+    sender.connect();
+
+    unsigned long start = micros();
+    for (int i = 0; i < messages; ++i) {
+        sender.publish("load1", i % 2 ? "true" : "false");
+    }
+    unsigned long waitStart = millis();
+    while (dispatched < messages && millis() - waitStart < 5000) {
+        client.waitForMessages(100);
+    }
+    unsigned long elapsed = micros() - start;
+
+    logger.flush();
+    LOG_INFO(BENCH, "dispatch: %d of %d commands dispatched in %lu ms - %lu msg/s", dispatched, messages,
+             elapsed / 1000, elapsed > 0 ? (unsigned long)((uint64_t)dispatched * 1000000 / elapsed) : 0);
+    client.removeSubscribeTopic("load+");
+    sender.removePublishTopic("load1");
+    return dispatched;
+}
+
+/**
+ * Publish a command longer than SUBSCRIPTIONDATALEN - 1 by a second client, e.g. "update_timeout=20000" cut to
+ * "update_timeout=2000"
+ *
+ * @return TRUE if the client dropped and counted it instead of dispatching the cut command
+ */
+static bool runTruncated(MqttClient& client, MqttClient& sender)
+{
+    int dispatched = 0;
+    client.createSubscribeTopic("long", "long/config", MqttClient::COMMAND);
+    client.addNotifyCallback("long", &countMessage, &dispatched);
+    sender.createPublishTopic("long", "long/config", MqttClient::COMMAND);
+    client.disconnect(); // subscriptions are sent to the broker on connect
+    client.connect();
+    sender.connect();
+
+    char message[SUBSCRIPTIONDATALEN + 8];
+    memset(message, 'x', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+    uint32_t truncated           = client.statistics().truncated;
+    sender.publish("long", message);
+    sender.publish("long", "short");
+    unsigned long waitStart = millis();
+    while (dispatched == 0 && millis() - waitStart < 5000) {
+        client.waitForMessages(100);
+    }
+
+    logger.flush();
+    LOG_INFO(BENCH, "truncated: %u dropped, %d dispatched", (unsigned int)(client.statistics().truncated - truncated),
+             dispatched);
+    client.removeSubscribeTopic("long");
+    sender.removePublishTopic("long");
+    return client.statistics().truncated == truncated + 1 && dispatched == 1;
+}
+
+int main(int argc, char* argv[])
+{
+    int messages = argc > 1 ? atoi(argv[1]) : 1000;
+    int failures = 0;
+
+    BrokerStandIn broker;
+    if (!broker.start()) {
+        fprintf(stderr, "broker stand-in failed to listen\n");
+        return 1;
+    }
+    WiFiClient            wifiClient;
+    WiFiClient            senderWifiClient;
+    MqttClient            client(&wifiClient, MQTT_SERVER, broker.port(), MQTT_USERNAME, MQTT_KEY);
+    MqttClient            sender(&senderWifiClient, MQTT_SERVER, broker.port(), MQTT_USERNAME, MQTT_KEY);
+    TestMqttClient        test(client);
+    BrokerStandIn::Faults faults;
+
+    // reference without faults
+    failures += test.runLoadTest(messages) ? 0 : 1;
+    logBroker(broker, "baseline");
+
+    failures += runDispatch(client, sender, messages) == messages ? 0 : 1;
+    logBroker(broker, "dispatch");
+    failures += runTruncated(client, sender) ? 0 : 1;
+    broker.resetStatistics();
+
+    // a slow broker delays round trips, QoS 0 publishes do not wait for it
+    faults.delayMicros = 5000;
+    broker.setFaults(faults);
+    failures += test.runLoadTest(messages) ? 0 : 1;
+    logBroker(broker, "delay 5 ms");
+    faults.delayMicros = 0;
+
+    // lost messages are not noticed by the publisher, the load test waits its timeout for them
+    faults.dropPerMille = 100;
+    broker.setFaults(faults);
+    test.runLoadTest(messages, 1000);
+    logBroker(broker, "drop 10%");
+    faults.dropPerMille = 0;
+
+    // publishes into a half-open connection succeed until the broker restart closes it
+    faults.halfOpen = true;
+    broker.setFaults(faults);
+    client.createPublishTopic("halfopen", "/status/halfopen", MqttClient::STATUS);
+    int accepted = 0;
+    for (int i = 0; i < 10; ++i) {
+        accepted += client.publish("halfopen", "lost") ? 1 : 0;
+    }
+    bool stillConnected = client.connected();
+    faults.halfOpen     = false;
+    broker.setFaults(faults);
+    broker.disconnectAll();
+    long recovery = waitForRecovery(client);
+    logger.flush();
+    LOG_INFO(BENCH, "half-open: %d of 10 publishes accepted, connected %d, online %ld ms after broker restart",
+             accepted, stillConnected, recovery);
+    failures += recovery >= 0 ? 0 : 1;
+    client.removePublishTopic("halfopen");
+    logBroker(broker, "half-open");
+
+    // outage: connects are refused, the reconnect backoff grows until the broker is back
+    broker.setAccepting(false);
+    broker.disconnectAll();
+    MqttClient::Statistics before = client.statistics();
+    unsigned long          start  = millis();
+    while (millis() - start < 5000) {
+        client.waitForMessages(10);
+        logger.idle(10);
+    }
+    broker.setAccepting(true);
+    recovery                      = waitForRecovery(client);
+    const MqttClient::Statistics& after = client.statistics();
+    logger.flush();
+    LOG_INFO(BENCH, "outage 5 s: %u connect failures, %u skipped reconnects, online %ld ms after broker is back",
+             (unsigned int)(after.connectFailures - before.connectFailures),
+             (unsigned int)(after.skippedReconnects - before.skippedReconnects), recovery);
+    failures += recovery >= 0 ? 0 : 1;
+    logBroker(broker, "outage");
+
+    broker.stop();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+/**
+ * Stress test of SpscQueue between two threads, built with thread sanitizer
+ *
+ *   spsc_stress [samples]
+ *
+ * Returns nonzero if a sample was lost, reordered or torn; the sanitizer aborts on a data race.
+ */
+
+#include "Logger.h"
+#include "SpscQueue.h"
+#include <stdlib.h>
+
+int main(int argc, char* argv[])
+{
+    uint32_t samples = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    bool     passed  = TestSpscQueue().runStressTest(samples);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * Host (Linux) fake of the Adafruit GFX library
+ */
+
+#include "Adafruit_GFX.h"
+#include <string.h>
+
+#define GLYPH_CHARS "0123456789.%-"
+#define GLYPH_DEGREE 248 // 247 shifted by one like the library does for the classic font without cp437()
+
+// classic glcdfont columns of the readout chars in order of GLYPH_CHARS followed by the degree sign
+static const uint8_t glyphs[][5] = {
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x72, 0x49, 0x49, 0x49, 0x46},
+    {0x21, 0x41, 0x49, 0x4D, 0x33}, {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+    {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07}, {0x36, 0x49, 0x49, 0x49, 0x36},
+    {0x46, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x60, 0x60, 0x00, 0x00}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x06, 0x09, 0x09, 0x06},
+};
+
+static const uint8_t blank[5] = {0, 0, 0, 0, 0};
+
+/**
+ * Return the font columns of given char code, blank for chars not included
+ */
+static const uint8_t* glyphColumns(unsigned char c)
+{
+    if (c == GLYPH_DEGREE) {
+        return glyphs[sizeof(GLYPH_CHARS) - 1];
+    }
+    const char* pos = c != '\0' ? strchr(GLYPH_CHARS, c) : nullptr;
+    return pos != nullptr ? glyphs[pos - GLYPH_CHARS] : blank;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    for (int16_t i = x; i < x + w; ++i) {
+        for (int16_t j = y; j < y + h; ++j) {
+            drawPixel(i, j, color);
+        }
+    }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+    if (x >= _width || y >= _height || x + 6 * size - 1 < 0 || y + 8 * size - 1 < 0) {
+        return;
+    }
+    if (!_cp437 && c >= 176) {
+        c++;
+    }
+
+    const uint8_t* columns = glyphColumns(c);
+    for (int8_t i = 0; i < 5; ++i) {
+        uint8_t line = columns[i];
+        for (int8_t j = 0; j < 8; ++j, line >>= 1) {
+            if (line & 1) {
+                if (size == 1) {
+                    drawPixel(x + i, y + j, color);
+                } else {
+                    fillRect(x + i * size, y + j * size, size, size, color);
+                }
+            } else if (bg != color) {
+                if (size == 1) {
+                    drawPixel(x + i, y + j, bg);
+                } else {
+                    fillRect(x + i * size, y + j * size, size, size, bg);
+                }
+            }
+        }
+    }
+    if (bg != color) {
+        if (size == 1) {
+            for (int8_t j = 0; j < 8; ++j) {
+                drawPixel(x + 5, y + j, bg);
+            }
+        } else {
+            fillRect(x + 5 * size, y, size, 8 * size, bg);
+        }
+    }
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+    if (c == '\n') {
+        cursor_x = 0;
+        cursor_y += textsize * 8;
+    } else if (c != '\r') {
+        if (wrap && cursor_x + textsize * 6 > _width) {
+            cursor_x = 0;
+            cursor_y += textsize * 8;
+        }
+        drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+        cursor_x += textsize * 6;
+    }
+    return 1;
+}
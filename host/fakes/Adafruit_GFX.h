@@ -0,0 +1,62 @@
+#ifndef ADAFRUIT_GFX_H
+#define ADAFRUIT_GFX_H
+
+/**
+ * Host (Linux) fake of the Adafruit GFX library: text output with the classic 5x7 font, drawn the same way as
+ * Adafruit_GFX::drawChar() - one pixel or size x size rectangle per font pixel
+ *
+ * Only the glyphs of the readout chars (digits, '.', '%', '-' and the degree sign) are included, other chars are
+ * drawn blank.
+ */
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print
+{
+public:
+    Adafruit_GFX(int16_t w, int16_t h) :
+        _width(w),
+        _height(h)
+    {}
+    virtual ~Adafruit_GFX() {}
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void         drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+    virtual size_t write(uint8_t c);
+    using Print::write;
+
+    void setCursor(int16_t x, int16_t y)
+    {
+        cursor_x = x;
+        cursor_y = y;
+    }
+    void setTextSize(uint8_t s) { textsize = s > 0 ? s : 1; }
+    void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+    void setTextColor(uint16_t c, uint16_t bg)
+    {
+        textcolor   = c;
+        textbgcolor = bg;
+    }
+    void setTextWrap(bool w) { wrap = w; }
+    void cp437(bool x = true) { _cp437 = x; }
+
+    int16_t width(void) const { return _width; }
+    int16_t height(void) const { return _height; }
+    int16_t getCursorX(void) const { return cursor_x; }
+    int16_t getCursorY(void) const { return cursor_y; }
+
+protected:
+    int16_t  _width;
+    int16_t  _height;
+    int16_t  cursor_x    = 0;
+    int16_t  cursor_y    = 0;
+    uint16_t textcolor   = 0xFFFF;
+    uint16_t textbgcolor = 0xFFFF;
+    uint8_t  textsize    = 1;
+    bool     wrap        = true;
+    bool     _cp437      = false;
+};
+
+#endif // ADAFRUIT_GFX_H
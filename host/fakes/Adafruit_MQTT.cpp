@@ -0,0 +1,405 @@
+/**
+ * Host (Linux) fake of the Adafruit MQTT library
+ */
+
+#include "Adafruit_MQTT.h"
+#include "Adafruit_MQTT_Client.h"
+
+/**
+ * Append a string with 16 bit length prefix and return the position after it
+ */
+static uint8_t* stringprint(uint8_t* position, const char* text, uint16_t length)
+{
+    position[0] = length >> 8;
+    position[1] = length & 0xFF;
+    memcpy(position + 2, text, length);
+    return position + 2 + length;
+}
+
+/**
+ * Put the fixed header of given type and flags in front of the body of given length at packet + 5 and move the
+ * packet to the buffer start
+ *
+ * @return length of the complete packet
+ */
+static uint16_t finishPacket(uint8_t* packet, uint8_t type, uint16_t bodyLength)
+{
+    uint8_t  digits[4];
+    uint8_t  count     = 0;
+    uint32_t remaining = bodyLength;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        digits[count++] = digit | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+
+    uint8_t* start = packet + 4 - count;
+    start[0]       = type;
+    memcpy(start + 1, digits, count);
+    uint16_t length = 1 + count + bodyLength;
+    memmove(packet, start, length);
+    return length;
+}
+
+Adafruit_MQTT_Publish::Adafruit_MQTT_Publish(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos) :
+    mqtt(mqtt),
+    topic(feed),
+    qos(qos)
+{
+}
+
+bool Adafruit_MQTT_Publish::publish(const char* payload)
+{
+    return mqtt->publish(topic, payload, qos);
+}
+
+bool Adafruit_MQTT_Publish::publish(uint8_t* payload, uint16_t length)
+{
+    return mqtt->publish(topic, payload, length, qos);
+}
+
+Adafruit_MQTT_Subscribe::Adafruit_MQTT_Subscribe(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos) :
+    topic(feed),
+    qos(qos),
+    datalen(0),
+    mqtt(mqtt)
+{
+    memset(lastread, 0, sizeof(lastread));
+}
+
+Adafruit_MQTT::Adafruit_MQTT(const char* server, uint16_t port, const char* clientId, const char* user,
+                             const char* password) :
+    servername(server),
+    portnum(port),
+    clientid(clientId),
+    username(user),
+    password(password),
+    packetIdCounter(0)
+{
+    memset(subscriptions, 0, sizeof(subscriptions));
+    memset(buffer, 0, sizeof(buffer));
+}
+
+/**
+ * Connect to the broker and subscribe all subscriptions
+ *
+ * @return 0 if connected, -1 on network errors, -2 if a subscription failed, 1 to 5 for CONNACK error codes
+ */
+int8_t Adafruit_MQTT::connect(void)
+{
+    if (!connectServer()) {
+        return -1;
+    }
+    uint16_t length = connectPacket(buffer);
+    if (!sendPacket(buffer, length)) {
+        return -1;
+    }
+    length = readFullPacket(buffer, MAXBUFFERSIZE, CONNECT_TIMEOUT_MS);
+    if (length != 4) {
+        return -1;
+    }
+    if (buffer[0] != (MQTT_CTRL_CONNECTACK << 4) || buffer[1] != 2) {
+        return -1;
+    }
+    if (buffer[3] != 0) {
+        return buffer[3];
+    }
+
+    for (uint8_t i = 0; i < MAXSUBSCRIPTIONS; ++i) {
+        if (subscriptions[i] == nullptr) {
+            continue;
+        }
+        bool success = false;
+        for (uint8_t retry = 0; retry < 3 && !success; ++retry) {
+            length = subscribePacket(buffer, subscriptions[i]->topic, subscriptions[i]->qos);
+            if (!sendPacket(buffer, length)) {
+                return -1;
+            }
+            success = processPacketsUntil(buffer, MQTT_CTRL_SUBACK, SUBACK_TIMEOUT_MS) != 0;
+        }
+        if (!success) {
+            return -2;
+        }
+    }
+    return 0;
+}
+
+const char* Adafruit_MQTT::connectErrorString(int8_t code)
+{
+    switch (code) {
+    case 1:
+        return "The Server does not support the level of the MQTT protocol requested";
+    case 2:
+        return "The Client identifier is correct UTF-8 but not allowed by the Server";
+    case 3:
+        return "The MQTT service is unavailable";
+    case 4:
+        return "The data in the user name or password is malformed";
+    case 5:
+        return "Not authorized to connect";
+    case 6:
+        return "Exceeded reconnect rate limit. Please try again later.";
+    case 7:
+        return "You have been banned from connecting. Please contact the MQTT server administrator for more details.";
+    case -1:
+        return "Connection failed";
+    case -2:
+        return "Failed to subscribe";
+    default:
+        return "Unknown error";
+    }
+}
+
+bool Adafruit_MQTT::disconnect(void)
+{
+    uint8_t packet[2] = {MQTT_CTRL_DISCONNECT << 4, 0};
+    sendPacket(packet, sizeof(packet));
+    return disconnectServer();
+}
+
+bool Adafruit_MQTT::publish(const char* topic, const char* payload, uint8_t qos)
+{
+    return publish(topic, (uint8_t*)payload, strlen(payload), qos);
+}
+
+/**
+ * Send a PUBLISH packet, QoS 1 waits for the PUBACK
+ *
+ * @return FALSE if the packet does not fit into MAXBUFFERSIZE, on send errors and missing PUBACK
+ */
+bool Adafruit_MQTT::publish(const char* topic, uint8_t* payload, uint16_t length, uint8_t qos)
+{
+    uint16_t packetLength = publishPacket(buffer, topic, payload, length, qos);
+    if (packetLength == 0 || !sendPacket(buffer, packetLength)) {
+        return false;
+    }
+    if (qos > 0) {
+        uint16_t packetId = packetIdCounter;
+        if (processPacketsUntil(buffer, MQTT_CTRL_PUBACK, PUBLISH_TIMEOUT_MS) != 4) {
+            return false;
+        }
+        return ((buffer[2] << 8) | buffer[3]) == packetId;
+    }
+    return true;
+}
+
+/**
+ * Add given subscription, it is subscribed at the broker by the next connect()
+ */
+bool Adafruit_MQTT::subscribe(Adafruit_MQTT_Subscribe* subscription)
+{
+    for (uint8_t i = 0; i < MAXSUBSCRIPTIONS; ++i) {
+        if (subscriptions[i] == subscription) {
+            return true;
+        }
+    }
+    for (uint8_t i = 0; i < MAXSUBSCRIPTIONS; ++i) {
+        if (subscriptions[i] == nullptr) {
+            subscriptions[i] = subscription;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Remove given subscription and unsubscribe at the broker while connected
+ */
+bool Adafruit_MQTT::unsubscribe(Adafruit_MQTT_Subscribe* subscription)
+{
+    for (uint8_t i = 0; i < MAXSUBSCRIPTIONS; ++i) {
+        if (subscriptions[i] != subscription) {
+            continue;
+        }
+        if (connected()) {
+            uint16_t length = unsubscribePacket(buffer, subscription->topic);
+            sendPacket(buffer, length);
+            if (subscription->qos > 0) {
+                processPacketsUntil(buffer, MQTT_CTRL_UNSUBACK, CONNECT_TIMEOUT_MS);
+            }
+        }
+        subscriptions[i] = nullptr;
+        return true;
+    }
+    return false;
+}
+
+bool Adafruit_MQTT::ping(uint8_t tries)
+{
+    while (tries-- > 0) {
+        uint8_t packet[2] = {MQTT_CTRL_PINGREQ << 4, 0};
+        if (!sendPacket(packet, sizeof(packet))) {
+            continue;
+        }
+        if (processPacketsUntil(buffer, MQTT_CTRL_PINGRESP, PING_TIMEOUT_MS) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Read one packet, truncated to maxSize
+ *
+ * @return bytes of the packet read, 0 on timeout
+ */
+uint16_t Adafruit_MQTT::readFullPacket(uint8_t* packet, uint16_t maxSize, uint16_t timeout)
+{
+    uint8_t* position = packet;
+    if (readPacket(position, 1, timeout) != 1) {
+        return 0;
+    }
+    ++position;
+
+    uint32_t value      = 0;
+    uint32_t multiplier = 1;
+    uint8_t  encoded;
+    do {
+        if (readPacket(position, 1, timeout) != 1) {
+            return 0;
+        }
+        encoded = *position++;
+        value += (encoded & 0x7F) * multiplier;
+        multiplier *= 128;
+        if (multiplier > 128UL * 128UL * 128UL) {
+            return 0;
+        }
+    } while (encoded & 0x80);
+
+    uint16_t header = position - packet;
+    uint16_t length = value > (uint32_t)(maxSize - header - 1) ? maxSize - header - 1 : value;
+    return header + readPacket(position, length, timeout);
+}
+
+/**
+ * Read packets until one of given type arrives - others, e.g. PUBLISH packets, are dropped
+ *
+ * @return length of the packet or 0 on timeout
+ */
+uint16_t Adafruit_MQTT::processPacketsUntil(uint8_t* packet, uint8_t packetType, uint16_t timeout)
+{
+    uint16_t length;
+    while ((length = readFullPacket(packet, MAXBUFFERSIZE, timeout)) != 0) {
+        if ((packet[0] >> 4) == packetType) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+uint16_t Adafruit_MQTT::connectPacket(uint8_t* packet)
+{
+    uint8_t* position = packet + 5;
+    position          = stringprint(position, "MQTT", 4);
+    *position++       = MQTT_PROTOCOL_LEVEL;
+
+    uint8_t flags = MQTT_CONN_CLEANSESSION;
+    if (username && username[0] != '\0') {
+        flags |= MQTT_CONN_USERNAMEFLAG;
+    }
+    if (password && password[0] != '\0') {
+        flags |= MQTT_CONN_PASSWORDFLAG;
+    }
+    *position++ = flags;
+    *position++ = MQTT_CONN_KEEPALIVE >> 8;
+    *position++ = MQTT_CONN_KEEPALIVE & 0xFF;
+
+    position = stringprint(position, clientid ? clientid : "", clientid ? strlen(clientid) : 0);
+    if (flags & MQTT_CONN_USERNAMEFLAG) {
+        position = stringprint(position, username, strlen(username));
+    }
+    if (flags & MQTT_CONN_PASSWORDFLAG) {
+        position = stringprint(position, password, strlen(password));
+    }
+
+    return finishPacket(packet, MQTT_CTRL_CONNECT << 4, position - packet - 5);
+}
+
+/**
+ * Build a PUBLISH packet or return 0, if it does not fit into MAXBUFFERSIZE
+ */
+uint16_t Adafruit_MQTT::publishPacket(uint8_t* packet, const char* topic, const uint8_t* payload, uint16_t length,
+                                      uint8_t qos)
+{
+    uint16_t topicLength = strlen(topic);
+    uint32_t remaining   = 2 + topicLength + (qos > 0 ? 2 : 0) + length;
+    if (5 + remaining > MAXBUFFERSIZE) {
+        return 0;
+    }
+
+    uint8_t* position = stringprint(packet + 5, topic, topicLength);
+    if (qos > 0) {
+        ++packetIdCounter;
+        *position++ = packetIdCounter >> 8;
+        *position++ = packetIdCounter & 0xFF;
+    }
+    memcpy(position, payload, length);
+
+    return finishPacket(packet, MQTT_CTRL_PUBLISH << 4 | qos << 1, remaining);
+}
+
+uint16_t Adafruit_MQTT::subscribePacket(uint8_t* packet, const char* topic, uint8_t qos)
+{
+    uint8_t* position = packet + 5;
+    ++packetIdCounter;
+    *position++ = packetIdCounter >> 8;
+    *position++ = packetIdCounter & 0xFF;
+    position    = stringprint(position, topic, strlen(topic));
+    *position++ = qos;
+
+    return finishPacket(packet, MQTT_CTRL_SUBSCRIBE << 4 | MQTT_QOS_1 << 1, position - packet - 5);
+}
+
+uint16_t Adafruit_MQTT::unsubscribePacket(uint8_t* packet, const char* topic)
+{
+    uint8_t* position = packet + 5;
+    ++packetIdCounter;
+    *position++ = packetIdCounter >> 8;
+    *position++ = packetIdCounter & 0xFF;
+    position    = stringprint(position, topic, strlen(topic));
+
+    return finishPacket(packet, MQTT_CTRL_UNSUBSCRIBE << 4 | MQTT_QOS_1 << 1, position - packet - 5);
+}
+
+bool Adafruit_MQTT_Client::disconnectServer(void)
+{
+    client->stop();
+    return true;
+}
+
+/**
+ * Read up to maxLength bytes, waiting up to timeout milliseconds for each byte
+ */
+uint16_t Adafruit_MQTT_Client::readPacket(uint8_t* packet, uint16_t maxLength, int16_t timeout)
+{
+    uint16_t length = 0;
+    while (length < maxLength && client->connected()) {
+        if (!client->waitAvailable(timeout > 0 ? timeout : 0)) {
+            break;
+        }
+        int read = client->read(packet + length, maxLength - length);
+        if (read > 0) {
+            length += read;
+        }
+    }
+    return length;
+}
+
+/**
+ * Send given packet in chunks of 250 bytes like the library
+ */
+bool Adafruit_MQTT_Client::sendPacket(uint8_t* packet, uint16_t length)
+{
+    while (length > 0) {
+        if (!client->connected()) {
+            return false;
+        }
+        uint16_t chunk = length > 250 ? 250 : length;
+        if (client->write(packet, chunk) != chunk) {
+            return false;
+        }
+        packet += chunk;
+        length -= chunk;
+    }
+    return true;
+}
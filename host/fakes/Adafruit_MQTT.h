@@ -0,0 +1,124 @@
+#ifndef ADAFRUIT_MQTT_H
+#define ADAFRUIT_MQTT_H
+
+/**
+ * Host (Linux) fake of the Adafruit MQTT library: a small MQTT 3.1.1 client with the same API, limits and
+ * timeouts as Adafruit_MQTT 1.0, so MqttClient runs unchanged against the broker stand-in
+ */
+
+#include <Arduino.h>
+
+#define MQTT_PROTOCOL_LEVEL 4
+
+#define MQTT_CTRL_CONNECT 0x1
+#define MQTT_CTRL_CONNECTACK 0x2
+#define MQTT_CTRL_PUBLISH 0x3
+#define MQTT_CTRL_PUBACK 0x4
+#define MQTT_CTRL_SUBSCRIBE 0x8
+#define MQTT_CTRL_SUBACK 0x9
+#define MQTT_CTRL_UNSUBSCRIBE 0xA
+#define MQTT_CTRL_UNSUBACK 0xB
+#define MQTT_CTRL_PINGREQ 0xC
+#define MQTT_CTRL_PINGRESP 0xD
+#define MQTT_CTRL_DISCONNECT 0xE
+
+#define MQTT_QOS_1 0x1
+#define MQTT_QOS_0 0x0
+
+#define CONNECT_TIMEOUT_MS 6000
+#define PUBLISH_TIMEOUT_MS 500
+#define PING_TIMEOUT_MS 500
+#define SUBACK_TIMEOUT_MS 500
+
+#define MQTT_CONN_USERNAMEFLAG 0x80
+#define MQTT_CONN_PASSWORDFLAG 0x40
+#define MQTT_CONN_CLEANSESSION 0x02
+#define MQTT_CONN_KEEPALIVE 300
+
+#define SUBSCRIPTIONDATALEN 20
+#define MAXBUFFERSIZE 150
+#define MAXSUBSCRIPTIONS 5
+
+class Adafruit_MQTT;
+
+/**
+ * Topic to publish to
+ */
+class Adafruit_MQTT_Publish
+{
+public:
+    Adafruit_MQTT_Publish(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos = 0);
+
+    bool publish(const char* payload);
+    bool publish(uint8_t* payload, uint16_t length);
+
+private:
+    Adafruit_MQTT* mqtt;
+    const char*    topic;
+    uint8_t        qos;
+};
+
+/**
+ * Topic to subscribe to, subscribed at the broker by each connect()
+ */
+class Adafruit_MQTT_Subscribe
+{
+public:
+    Adafruit_MQTT_Subscribe(Adafruit_MQTT* mqtt, const char* feed, uint8_t qos = 0);
+
+    const char* topic;
+    uint8_t     qos;
+    uint8_t     lastread[SUBSCRIPTIONDATALEN];
+    uint16_t    datalen;
+
+private:
+    Adafruit_MQTT* mqtt;
+};
+
+/**
+ * MQTT client protocol, the transport is implemented by Adafruit_MQTT_Client
+ */
+class Adafruit_MQTT
+{
+public:
+    Adafruit_MQTT(const char* server, uint16_t port, const char* clientId, const char* user, const char* password);
+    virtual ~Adafruit_MQTT() {}
+
+    int8_t          connect(void);
+    const char*     connectErrorString(int8_t code);
+    bool            disconnect(void);
+    virtual bool    connected(void) = 0;
+
+    bool publish(const char* topic, const char* payload, uint8_t qos = 0);
+    bool publish(const char* topic, uint8_t* payload, uint16_t length, uint8_t qos = 0);
+    bool subscribe(Adafruit_MQTT_Subscribe* subscription);
+    bool unsubscribe(Adafruit_MQTT_Subscribe* subscription);
+    bool ping(uint8_t tries = 1);
+
+protected:
+    virtual bool     connectServer(void)                                             = 0;
+    virtual bool     disconnectServer(void)                                          = 0;
+    virtual uint16_t readPacket(uint8_t* buffer, uint16_t maxLength, int16_t timeout) = 0;
+    virtual bool     sendPacket(uint8_t* buffer, uint16_t length)                    = 0;
+
+    uint16_t readFullPacket(uint8_t* buffer, uint16_t maxSize, uint16_t timeout);
+    uint16_t processPacketsUntil(uint8_t* buffer, uint8_t packetType, uint16_t timeout);
+
+    const char* servername;
+    uint16_t    portnum;
+    const char* clientid;
+    const char* username;
+    const char* password;
+
+    Adafruit_MQTT_Subscribe* subscriptions[MAXSUBSCRIPTIONS];
+    uint8_t                  buffer[MAXBUFFERSIZE];
+    uint16_t                 packetIdCounter;
+
+private:
+    uint16_t connectPacket(uint8_t* packet);
+    uint16_t publishPacket(uint8_t* packet, const char* topic, const uint8_t* payload, uint16_t length, uint8_t qos);
+    uint16_t subscribePacket(uint8_t* packet, const char* topic, uint8_t qos);
+    uint16_t unsubscribePacket(uint8_t* packet, const char* topic);
+};
+
+#endif // ADAFRUIT_MQTT_H
@@ -0,0 +1,44 @@
+#ifndef ADAFRUIT_MQTT_CLIENT_H
+#define ADAFRUIT_MQTT_CLIENT_H
+
+/**
+ * Host (Linux) fake of the Adafruit MQTT transport over an Arduino Client
+ */
+
+#include "Adafruit_MQTT.h"
+
+#define MQTT_CLIENT_READINTERVAL_MS 10
+
+/**
+ * MQTT over given TCP client
+ *
+ * readPacket() waits for the socket instead of polling every MQTT_CLIENT_READINTERVAL_MS like the library, the
+ * timeout restarts with each byte received the same way.
+ */
+class Adafruit_MQTT_Client : public Adafruit_MQTT
+{
+public:
+    Adafruit_MQTT_Client(Client* client, const char* server, uint16_t port, const char* user = "",
+                         const char* password = "") :
+        Adafruit_MQTT(server, port, "", user, password),
+        client(client)
+    {}
+    Adafruit_MQTT_Client(Client* client, const char* server, uint16_t port, const char* clientId, const char* user,
+                         const char* password) :
+        Adafruit_MQTT(server, port, clientId, user, password),
+        client(client)
+    {}
+
+    virtual bool connected(void) { return client->connected(); }
+
+protected:
+    virtual bool     connectServer(void) { return client->connect(servername, portnum) != 0; }
+    virtual bool     disconnectServer(void);
+    virtual uint16_t readPacket(uint8_t* buffer, uint16_t maxLength, int16_t timeout);
+    virtual bool     sendPacket(uint8_t* buffer, uint16_t length);
+
+private:
+    Client* client;
+};
+
+#endif // ADAFRUIT_MQTT_CLIENT_H
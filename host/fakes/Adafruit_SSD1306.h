@@ -0,0 +1,67 @@
+#ifndef ADAFRUIT_SSD1306_H
+#define ADAFRUIT_SSD1306_H
+
+/**
+ * Host (Linux) fake of the Adafruit SSD1306 library, the display buffer is kept in memory only
+ */
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+#define SSD1306_BLACK BLACK
+#define SSD1306_WHITE WHITE
+#define SSD1306_SWITCHCAPVCC 0x02
+
+class Adafruit_SSD1306 : public Adafruit_GFX
+{
+public:
+    Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* = &Wire, int8_t = -1) :
+        Adafruit_GFX(w, h),
+        buffer((uint8_t*)calloc(w * ((h + 7) / 8), 1))
+    {}
+    ~Adafruit_SSD1306() { free(buffer); }
+
+    bool begin(uint8_t = SSD1306_SWITCHCAPVCC, uint8_t = 0, bool = true, bool = true) { return buffer != nullptr; }
+    void display(void) {}
+    void clearDisplay(void) { memset(buffer, 0, bufferSize()); }
+
+    /**
+     * Set, clear or toggle given pixel in the SSD1306 page layout: one byte per column and page of 8 rows
+     */
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color)
+    {
+        if (x < 0 || x >= _width || y < 0 || y >= _height) {
+            return;
+        }
+        uint8_t* target = &buffer[x + (y / 8) * _width];
+        uint8_t  bit    = 1 << (y & 7);
+        switch (color) {
+        case WHITE:
+            *target |= bit;
+            break;
+        case BLACK:
+            *target &= ~bit;
+            break;
+        case INVERSE:
+            *target ^= bit;
+            break;
+        }
+    }
+
+    uint8_t* getBuffer(void) { return buffer; }
+
+private:
+    size_t bufferSize(void) const { return _width * ((_height + 7) / 8); }
+
+    Adafruit_SSD1306(const Adafruit_SSD1306&);
+    Adafruit_SSD1306& operator=(const Adafruit_SSD1306&);
+
+    uint8_t* buffer;
+};
+
+#endif // ADAFRUIT_SSD1306_H
@@ -0,0 +1,324 @@
+/**
+ * Host (Linux) fake of the Arduino core API used by the sketch
+ */
+
+#include "Arduino.h"
+#include "Wire.h"
+#include <chrono>
+#include <errno.h>
+#include <poll.h>
+#include <random>
+
+HardwareSerial Serial;
+EspClass       ESP;
+TwoWire        Wire;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+static host::Board        defaultBoard;
+static host::Board*       currentBoard = &defaultBoard;
+static host::WaitFunction waitFunction = nullptr;
+static uint64_t           edgeTime     = 0; // micros() of the edge being delivered, 0 outside of interrupt handlers
+static std::mt19937       randomEngine;
+
+namespace host {
+
+Board::Board() :
+    edgeCount(0),
+    nextEdge(0),
+    edgePin(0)
+{
+    memset(modes, INPUT, sizeof(modes));
+    memset(levels, HIGH, sizeof(levels));
+    memset(handlers, 0, sizeof(handlers));
+    memset(arguments, 0, sizeof(arguments));
+    memset(devices, 0, sizeof(devices));
+}
+
+Board& board(void)
+{
+    return *currentBoard;
+}
+
+/**
+ * Switch GPIO functions to given board, nullptr for the default board
+ */
+void setBoard(Board* board)
+{
+    currentBoard = board ? board : &defaultBoard;
+}
+
+/**
+ * Connect given device to given pin of the current board, nullptr to disconnect
+ */
+void attachDevice(uint8_t pin, PinDevice* device)
+{
+    if (pin < HOST_PINS) {
+        currentBoard->devices[pin] = device;
+    }
+}
+
+uint64_t microsSinceStart(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void setWaitFunction(WaitFunction wait)
+{
+    waitFunction = wait;
+}
+
+/**
+ * Wait by the wait function set, otherwise by poll()
+ */
+bool wait(int fd, short events, uint64_t deadline)
+{
+    if (waitFunction) {
+        return waitFunction(fd, events, deadline);
+    }
+    for (;;) {
+        uint64_t now     = microsSinceStart();
+        int      timeout = now < deadline ? (int)((deadline - now + 999) / 1000) : 0;
+        if (fd < 0) {
+            if (timeout > 0) {
+                struct timespec time = {(time_t)((deadline - now) / 1000000), (long)((deadline - now) % 1000000 * 1000)};
+                nanosleep(&time, nullptr);
+            }
+            return false;
+        }
+        struct pollfd request = {fd, events, 0};
+        int           ready   = poll(&request, 1, timeout);
+        if (ready >= 0 || errno != EINTR) {
+            return ready > 0;
+        }
+    }
+}
+
+} // namespace host
+
+/**
+ * Deliver the due edges of the pending pin device response to the interrupt handler of its pin
+ */
+static void deliverEdges(void)
+{
+    host::Board& board = *currentBoard;
+    while (board.nextEdge < board.edgeCount) {
+        uint32_t time = board.edges[board.nextEdge];
+        if ((int32_t)(time - (uint32_t)host::microsSinceStart()) > 0) {
+            return;
+        }
+        ++board.nextEdge;
+        board.levels[board.edgePin] ^= 1;
+        void (*handler)(void*) = board.handlers[board.edgePin];
+        if (handler) {
+            edgeTime = time;
+            handler(board.arguments[board.edgePin]);
+            edgeTime = 0;
+        }
+    }
+}
+
+unsigned long micros(void)
+{
+    return edgeTime ? edgeTime : host::microsSinceStart();
+}
+
+unsigned long millis(void)
+{
+    return host::microsSinceStart() / 1000;
+}
+
+/**
+ * Wait given time, a pin device response arriving meanwhile is delivered afterwards with its original timestamps
+ */
+void delay(unsigned long milliseconds)
+{
+    host::wait(-1, 0, host::microsSinceStart() + (uint64_t)milliseconds * 1000);
+    deliverEdges();
+}
+
+void delayMicroseconds(unsigned int microseconds)
+{
+    uint64_t deadline = host::microsSinceStart() + microseconds;
+    while (host::microsSinceStart() < deadline) {
+    }
+    deliverEdges();
+}
+
+void yield(void)
+{
+    host::wait(-1, 0, 0);
+}
+
+/**
+ * Set pin mode - releasing the line by INPUT_PULLUP triggers the response of a connected device
+ */
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    host::Board& board = *currentBoard;
+    if (pin >= HOST_PINS) {
+        return;
+    }
+    board.modes[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+        board.levels[pin] = HIGH;
+        if (board.devices[pin]) {
+            board.edgePin   = pin;
+            board.nextEdge  = 0;
+            board.edgeCount = board.devices[pin]->respond((uint32_t)micros(), board.edges, HOST_MAX_EDGES);
+        }
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < HOST_PINS) {
+        currentBoard->levels[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < HOST_PINS ? currentBoard->levels[pin] : LOW;
+}
+
+void attachInterruptArg(uint8_t interrupt, void (*handler)(void*), void* argument, int)
+{
+    if (interrupt < HOST_PINS) {
+        currentBoard->handlers[interrupt]  = handler;
+        currentBoard->arguments[interrupt] = argument;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    if (interrupt < HOST_PINS) {
+        currentBoard->handlers[interrupt] = nullptr;
+    }
+}
+
+uint8_t digitalPinToInterrupt(uint8_t pin)
+{
+    return pin;
+}
+
+void noInterrupts(void)
+{
+}
+
+void interrupts(void)
+{
+}
+
+long random(long max)
+{
+    return max > 0 ? (long)(randomEngine() % (unsigned long)max) : 0;
+}
+
+long random(long min, long max)
+{
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    randomEngine.seed(seed);
+}
+
+/**
+ * The host clock is set already
+ */
+void configTime(long, int, const char*, const char*, const char*)
+{
+}
+
+size_t Print::write(const uint8_t* data, size_t length)
+{
+    size_t written = 0;
+    while (length-- > 0) {
+        written += write(*data++);
+    }
+    return written;
+}
+
+size_t Print::printf(const char* format, ...)
+{
+    char    text[256];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t*)text, (size_t)length < sizeof(text) ? length : sizeof(text) - 1);
+}
+
+/**
+ * Read next byte within timeout or return -1
+ */
+int Stream::timedRead(void)
+{
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) {
+            return c;
+        }
+        yield();
+    } while (millis() - start < timeout);
+    return -1;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0 || c == terminator) {
+            break;
+        }
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
+
+/**
+ * Poll available() - network clients wait for their socket instead
+ */
+bool Client::waitAvailable(unsigned long milliseconds)
+{
+    unsigned long start = millis();
+    while (available() <= 0) {
+        if (millis() - start >= milliseconds) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length)
+{
+    return output ? fwrite(data, 1, length, output) : length;
+}
+
+void HardwareSerial::flush(void)
+{
+    if (output) {
+        fflush(output);
+    }
+}
+
+String::String(const char* value)
+{
+    snprintf(text, sizeof(text), "%s", value);
+}
+
+/**
+ * CPU cycles at 80 MHz derived from the steady clock
+ */
+uint32_t EspClass::getCycleCount(void)
+{
+    return (uint32_t)(host::microsSinceStart() * 80);
+}
@@ -0,0 +1,244 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/**
+ * Host (Linux) fake of the Arduino core API used by the sketch
+ *
+ * Time comes from a steady clock starting at 0, GPIO writes go to a simulated board, delay() sleeps or - in the
+ * fleet simulator - switches to the next node, see host::setWaitFunction().
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define F(text) (text)
+#define IRAM_ATTR
+
+// NodeMCU pin names as used by the ESP8266 branches of the sketch
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define LED_BUILTIN 2
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+
+#define SPI_FLASH_SEC_SIZE 4096 // flash sector size, defined by the ESP8266 and ESP32 cores
+
+#define HOST_PINS 40      // GPIO numbers of the simulated board
+#define HOST_MAX_EDGES 96 // edges of one pin device response, see host::PinDevice
+
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void          delay(unsigned long milliseconds);
+void          delayMicroseconds(unsigned int microseconds);
+void          yield(void);
+
+void    pinMode(uint8_t pin, uint8_t mode);
+void    digitalWrite(uint8_t pin, uint8_t value);
+int     digitalRead(uint8_t pin);
+void    attachInterruptArg(uint8_t interrupt, void (*handler)(void*), void* argument, int mode);
+void    detachInterrupt(uint8_t interrupt);
+uint8_t digitalPinToInterrupt(uint8_t pin);
+void    noInterrupts(void);
+void    interrupts(void);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+void configTime(long gmtOffset, int daylightOffset, const char* server1, const char* server2 = nullptr,
+                const char* server3 = nullptr);
+
+/**
+ * Text output base class
+ */
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t* data, size_t length);
+    size_t         write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    virtual int    availableForWrite(void) { return 0; }
+    virtual void   flush(void) {}
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t println(const char* text) { return print(text) + println(); }
+    size_t println(void) { return write("\r\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * Byte stream with timeout for the read functions
+ */
+class Stream : public Print
+{
+public:
+    virtual int available(void) = 0;
+    virtual int read(void)      = 0;
+    virtual int peek(void)      = 0;
+
+    void   setTimeout(unsigned long milliseconds) { timeout = milliseconds; }
+    size_t readBytesUntil(char terminator, char* buffer, size_t length);
+
+protected:
+    virtual int timedRead(void);
+
+    unsigned long timeout = 1000;
+};
+
+/**
+ * TCP client interface of the network libraries
+ */
+class Client : public Stream
+{
+public:
+    virtual int     connect(const char* host, uint16_t port)  = 0;
+    virtual int     read(uint8_t* buffer, size_t size)        = 0;
+    virtual uint8_t connected(void)                           = 0;
+    virtual void    stop(void)                                = 0;
+    using Stream::read;
+
+    /**
+     * Host only: wait up to given milliseconds for readable data, TRUE if available() > 0
+     */
+    virtual bool waitAvailable(unsigned long milliseconds);
+};
+
+/**
+ * Serial port writing to stdout, can be muted e.g. for the fleet simulator
+ */
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    void setOutput(FILE* file) { output = file; }
+
+    virtual size_t write(uint8_t value) { return write(&value, 1); }
+    virtual size_t write(const uint8_t* data, size_t length);
+    virtual int    availableForWrite(void) { return 128; } // UART TX FIFO of the ESP8266
+    virtual void   flush(void);
+    virtual int    available(void) { return 0; }
+    virtual int    read(void) { return -1; }
+    virtual int    peek(void) { return -1; }
+    using Print::write;
+
+private:
+    FILE* output = stdout;
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * Minimal Arduino String, only used for IPAddress::toString()
+ */
+class String
+{
+public:
+    String(const char* text = "");
+
+    const char* c_str(void) const { return text; }
+
+private:
+    char text[32];
+};
+
+/**
+ * ESP8266/ESP32 system functions - the host has plenty of heap and no RTC or flash
+ */
+class EspClass
+{
+public:
+    uint32_t getCycleCount(void);
+    uint32_t getCpuFreqMHz(void) { return 80; }
+    uint32_t getFreeHeap(void) { return 40000; }
+    uint32_t getMaxFreeBlockSize(void) { return 30000; }
+    uint32_t getMaxAllocHeap(void) { return 30000; }
+    uint8_t  getHeapFragmentation(void) { return 0; }
+    uint32_t getChipId(void) { return 0x00484F53; }
+    bool     rtcUserMemoryRead(uint32_t, uint32_t*, size_t) { return false; }
+    bool     rtcUserMemoryWrite(uint32_t, uint32_t*, size_t) { return false; }
+};
+
+extern EspClass ESP;
+
+namespace host {
+
+/**
+ * Device driving a pin of the simulated board, e.g. a DHT22 answering the start signal
+ */
+class PinDevice
+{
+public:
+    virtual ~PinDevice() {}
+
+    /**
+     * The host released the line by pinMode(INPUT_PULLUP) at given micros() time: store the timestamps of the edges
+     * the device drives in response and return their count
+     */
+    virtual uint8_t respond(uint32_t released, uint32_t* edges, uint8_t size) = 0;
+};
+
+/**
+ * GPIO state of one simulated board - each node of the fleet simulator has its own
+ *
+ * Edges of a pin device are delivered to the interrupt handler of the pin by the next delay() or
+ * delayMicroseconds() as far as they are due, with micros() returning the time of each edge.
+ */
+struct Board
+{
+    Board();
+
+    uint8_t    modes[HOST_PINS];
+    uint8_t    levels[HOST_PINS];
+    void       (*handlers[HOST_PINS])(void*);
+    void*      arguments[HOST_PINS]; // of the handlers
+    PinDevice* devices[HOST_PINS];
+    uint32_t   edges[HOST_MAX_EDGES]; // pending edges of a device response
+    uint8_t    edgeCount;
+    uint8_t    nextEdge;
+    uint8_t    edgePin;
+};
+
+Board& board(void);
+void   setBoard(Board* board);
+void   attachDevice(uint8_t pin, PinDevice* device);
+
+/**
+ * Waiting for given file descriptor (-1 for none) to get ready for given poll() events until given micros() time
+ *
+ * The default waits by poll(), the fleet simulator switches to other nodes instead. Returns TRUE if the file
+ * descriptor got ready before the deadline.
+ */
+typedef bool (*WaitFunction)(int fd, short events, uint64_t deadline);
+
+void     setWaitFunction(WaitFunction wait);
+bool     wait(int fd, short events, uint64_t deadline);
+uint64_t microsSinceStart(void);
+
+} // namespace host
+
+#endif // ARDUINO_H
@@ -0,0 +1,14 @@
+#ifndef DHT_H
+#define DHT_H
+
+/**
+ * Host (Linux) fake of the DHT sensor library - only the model constants are used, frames are read by DhtReceiver
+ * from a simulated sensor, see host::SimulatedDht
+ */
+
+#define DHT11 11
+#define DHT21 21
+#define DHT22 22
+#define AM2301 21
+
+#endif // DHT_H
@@ -0,0 +1,30 @@
+#ifndef DALLASTEMPERATURE_H
+#define DALLASTEMPERATURE_H
+
+/**
+ * Host (Linux) fake of the DallasTemperature library, a bus without devices - SimulatedTemperatureBus models
+ * DS18B20 devices behind the TemperatureBus interface instead
+ */
+
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C -127
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature
+{
+public:
+    DallasTemperature(OneWire*) {}
+
+    void    begin(void) {}
+    uint8_t getDeviceCount(void) { return 0; }
+    bool    isParasitePowerMode(void) { return false; }
+    bool    getAddress(uint8_t*, uint8_t) { return false; }
+    bool    setResolution(const uint8_t*, uint8_t, bool = false) { return false; }
+    bool    isConnected(const uint8_t*, uint8_t*) { return false; }
+    void    requestTemperatures(void) {}
+    float   getTempC(const uint8_t*) { return DEVICE_DISCONNECTED_C; }
+};
+
+#endif // DALLASTEMPERATURE_H
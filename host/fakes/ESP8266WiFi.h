@@ -0,0 +1,141 @@
+#ifndef ESP8266WIFI_H
+#define ESP8266WIFI_H
+
+/**
+ * Host (Linux) fake of the ESP8266/ESP32 WiFi library: always associated, TCP by real sockets
+ */
+
+#include <Arduino.h>
+#include <memory>
+
+#define WL_IDLE_STATUS 0
+#define WL_DISCONNECTED 6
+#define WL_CONNECTED 3
+#define WIFI_STA 1
+
+#define WIFI_CONNECT_TIMEOUT 5000 // milliseconds of a TCP connect, same as the ESP8266 core
+
+/**
+ * IPv4 address in network byte order like the ESP8266 core
+ */
+class IPAddress
+{
+public:
+    IPAddress(void) :
+        address(0)
+    {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) :
+        address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24))
+    {}
+    IPAddress(uint32_t address) :
+        address(address)
+    {}
+
+    operator uint32_t() const { return address; }
+    String toString(void) const;
+
+private:
+    uint32_t address;
+};
+
+/**
+ * TCP client on a non-blocking socket - copies share the connection like on the ESP8266
+ *
+ * Waiting for connect, data and send buffer space goes through host::wait(), so the fleet simulator can run other
+ * nodes meanwhile.
+ */
+class WiFiClient : public Client
+{
+public:
+    WiFiClient(void) {}
+    explicit WiFiClient(int fd);
+
+    virtual int     connect(const char* host, uint16_t port);
+    virtual size_t  write(uint8_t value) { return write(&value, 1); }
+    virtual size_t  write(const uint8_t* data, size_t length);
+    virtual int     available(void);
+    virtual int     read(void);
+    virtual int     read(uint8_t* buffer, size_t size);
+    virtual int     peek(void);
+    virtual uint8_t connected(void);
+    virtual void    stop(void);
+    virtual bool    waitAvailable(unsigned long milliseconds);
+    using Print::write;
+
+    void setNoDelay(bool noDelay);
+    int  fd(void) const { return socket ? socket->fd : -1; }
+
+    explicit operator bool() { return socket && socket->fd >= 0; }
+
+protected:
+    virtual int timedRead(void);
+
+private:
+    /**
+     * Connection shared by copies, closed with the last one
+     */
+    struct Socket
+    {
+        Socket(int fd) :
+            fd(fd)
+        {}
+        ~Socket();
+
+        int fd;
+    };
+
+    std::shared_ptr<Socket> socket;
+};
+
+/**
+ * TCP server listening on all interfaces
+ */
+class WiFiServer
+{
+public:
+    WiFiServer(uint16_t port) :
+        port(port),
+        fd(-1)
+    {}
+    ~WiFiServer() { close(); }
+
+    void       begin(void);
+    void       close(void);
+    void       setNoDelay(bool noDelay) { noDelayClients = noDelay; }
+    WiFiClient available(void);
+
+private:
+    uint16_t port;
+    int      fd;
+    bool     noDelayClients = false;
+};
+
+/**
+ * Station interface, connected as soon as begin() is called
+ */
+class ESP8266WiFiClass
+{
+public:
+    void    mode(int) {}
+    void    persistent(bool) {}
+    int     status(void) { return started ? WL_CONNECTED : WL_DISCONNECTED; }
+    void    begin(const char*, const char*, int32_t = 0, const uint8_t* = nullptr, bool = true) { started = true; }
+    bool    disconnect(bool = false) { return true; }
+    bool    config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress()) { return true; }
+    int32_t channel(void) { return 1; }
+
+    const uint8_t* BSSID(void) { return bssid; }
+    IPAddress      localIP(void) { return IPAddress(127, 0, 0, 1); }
+    IPAddress      gatewayIP(void) { return IPAddress(127, 0, 0, 1); }
+    IPAddress      subnetMask(void) { return IPAddress(255, 0, 0, 0); }
+    IPAddress      dnsIP(uint8_t = 0) { return IPAddress(127, 0, 0, 1); }
+    void           printDiag(Print& output) { output.println("host network"); }
+
+private:
+    bool    started  = false;
+    uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 1};
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif // ESP8266WIFI_H
@@ -0,0 +1,23 @@
+#ifndef ONEWIRE_H
+#define ONEWIRE_H
+
+/**
+ * Host (Linux) fake of the OneWire library, a bus without devices
+ */
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+    OneWire(uint8_t pin) :
+        pin(pin)
+    {}
+
+    void begin(uint8_t newPin) { pin = newPin; }
+
+private:
+    uint8_t pin;
+};
+
+#endif // ONEWIRE_H
@@ -0,0 +1,253 @@
+/**
+ * Host (Linux) fake of the ESP8266/ESP32 WiFi library: always associated, TCP by real sockets
+ */
+
+#include "ESP8266WiFi.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+ESP8266WiFiClass WiFi;
+
+/**
+ * Prepare given socket for host::wait(): non-blocking and without Nagle delay, which the loopback tests would
+ * otherwise measure instead of the code
+ */
+static void configureSocket(int fd)
+{
+    int enable = 1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+String IPAddress::toString(void) const
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (unsigned int)(address & 0xFF), (unsigned int)((address >> 8) & 0xFF),
+             (unsigned int)((address >> 16) & 0xFF), (unsigned int)(address >> 24));
+    return String(text);
+}
+
+WiFiClient::Socket::~Socket()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * Client of a connection accepted by WiFiServer
+ */
+WiFiClient::WiFiClient(int fd) :
+    socket(std::make_shared<Socket>(fd))
+{
+    configureSocket(fd);
+}
+
+/**
+ * Connect to given IPv4 address or host name within WIFI_CONNECT_TIMEOUT
+ *
+ * @return 1 if connected, 0 otherwise
+ */
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    stop();
+
+    struct addrinfo  hints;
+    struct addrinfo* addresses = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, nullptr, &hints, &addresses) != 0 || addresses == nullptr) {
+        return 0;
+    }
+    struct sockaddr_in address = *(struct sockaddr_in*)addresses->ai_addr;
+    address.sin_port           = htons(port);
+    freeaddrinfo(addresses);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    socket = std::make_shared<Socket>(fd);
+    configureSocket(fd);
+
+    if (::connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        int       error  = errno;
+        socklen_t length = sizeof(error);
+        if (error != EINPROGRESS ||
+            !host::wait(fd, POLLOUT, host::microsSinceStart() + WIFI_CONNECT_TIMEOUT * 1000ULL) ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            stop();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Send given data, waiting up to WIFI_CONNECT_TIMEOUT for send buffer space
+ *
+ * @return bytes sent, less than length on errors and timeouts
+ */
+size_t WiFiClient::write(const uint8_t* data, size_t length)
+{
+    size_t   written  = 0;
+    uint64_t deadline = host::microsSinceStart() + WIFI_CONNECT_TIMEOUT * 1000ULL;
+    while (socket && socket->fd >= 0 && written < length) {
+        ssize_t sent = send(socket->fd, data + written, length - written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!host::wait(socket->fd, POLLOUT, deadline)) {
+                break;
+            }
+        } else if (sent < 0 && errno != EINTR) {
+            break;
+        }
+    }
+    return written;
+}
+
+int WiFiClient::available(void)
+{
+    int bytes = 0;
+    if (!socket || socket->fd < 0 || ioctl(socket->fd, FIONREAD, &bytes) != 0) {
+        return 0;
+    }
+    return bytes;
+}
+
+int WiFiClient::read(void)
+{
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+/**
+ * Read available data without waiting
+ *
+ * @return bytes read, -1 if there are none
+ */
+int WiFiClient::read(uint8_t* buffer, size_t size)
+{
+    if (!socket || socket->fd < 0 || size == 0) {
+        return -1;
+    }
+    ssize_t received = recv(socket->fd, buffer, size, MSG_DONTWAIT);
+    return received > 0 ? (int)received : -1;
+}
+
+int WiFiClient::peek(void)
+{
+    uint8_t value;
+    if (!socket || socket->fd < 0 || recv(socket->fd, &value, 1, MSG_PEEK | MSG_DONTWAIT) != 1) {
+        return -1;
+    }
+    return value;
+}
+
+/**
+ * Return TRUE while the connection is open or data is available, like the ESP8266 core
+ */
+uint8_t WiFiClient::connected(void)
+{
+    if (!socket || socket->fd < 0) {
+        return false;
+    }
+    uint8_t value;
+    ssize_t received = recv(socket->fd, &value, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (received > 0) {
+        return true;
+    }
+    return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+void WiFiClient::stop(void)
+{
+    socket.reset();
+}
+
+bool WiFiClient::waitAvailable(unsigned long milliseconds)
+{
+    if (available() > 0) {
+        return true;
+    }
+    if (!socket || socket->fd < 0) {
+        return false;
+    }
+    return host::wait(socket->fd, POLLIN, host::microsSinceStart() + milliseconds * 1000ULL) && available() > 0;
+}
+
+void WiFiClient::setNoDelay(bool noDelay)
+{
+    int enable = noDelay ? 1 : 0;
+    if (socket && socket->fd >= 0) {
+        setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+}
+
+/**
+ * Read next byte within timeout, waiting for the socket instead of polling
+ */
+int WiFiClient::timedRead(void)
+{
+    int c = read();
+    if (c < 0 && waitAvailable(timeout)) {
+        c = read();
+    }
+    return c;
+}
+
+/**
+ * Listen on the port given to the constructor
+ */
+void WiFiServer::begin(void)
+{
+    close();
+    fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return;
+    }
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port        = htons(port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        close();
+    }
+}
+
+void WiFiServer::close(void)
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+/**
+ * Return the next pending connection or an unconnected client
+ */
+WiFiClient WiFiServer::available(void)
+{
+    int client = fd >= 0 ? accept(fd, nullptr, nullptr) : -1;
+    if (client < 0) {
+        return WiFiClient();
+    }
+    WiFiClient accepted(client);
+    accepted.setNoDelay(noDelayClients);
+    return accepted;
+}
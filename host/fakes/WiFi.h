@@ -0,0 +1,10 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+/**
+ * Host (Linux) fake of the ESP32 WiFi library, same as the ESP8266 one
+ */
+
+#include <ESP8266WiFi.h>
+
+#endif // WIFI_H
@@ -0,0 +1,14 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+/**
+ * Host (Linux) fake of the I2C library, the display fake keeps its pixels in memory
+ */
+
+class TwoWire
+{
+};
+
+extern TwoWire Wire;
+
+#endif // WIRE_H
@@ -0,0 +1,19 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+/**
+ * WLAN and MQTT settings of the host build - the broker stand-in listens on loopback
+ */
+
+#define WLAN_SSID "host"
+#define WLAN_PASS ""
+
+#define MQTT_SERVER "127.0.0.1"
+#define MQTT_SERVERPORT 1883 // the host executables pass the port of their broker stand-in instead
+#define MQTT_USERNAME "room-sensor"
+#define MQTT_KEY ""
+
+#define MQTT_RECONNECT_RETRIES 3
+#define MQTT_TIMEOUT 1000 // milliseconds
+
+#endif // SECRETS_H
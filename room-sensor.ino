@@ -3,12 +3,37 @@
 #define ARDUINO 150
 #endif
 
+#if defined(ESP32)
+#include <WiFi.h>
+#else
 #include <ESP8266WiFi.h>
-// Create an ESP8266 WiFiClient class to connect to the MQTT server.
+#endif
+// Create a WiFiClient class to connect to the MQTT server.
 WiFiClient client;
 // or... use WiFiFlientSecure for SSL
 //WiFiClientSecure client;
 
+// unit tests in setup() - comment out for fastest boot, needed by RUN_BENCHMARKS
+#define RUN_TESTS
+
+#if defined(RUN_BENCHMARKS) && !defined(RUN_TESTS)
+#define RUN_TESTS
+#endif
+
+// ESP32: sensors, rules and display in loop() on the application core, MQTT in a task on the protocol core
+#if defined(ESP32)
+#define DUAL_CORE
+#endif
+
+// logging
+#include "Logger.h"
+
+// loop() phase timing and heap statistics
+#include "Profiler.h"
+
+// heap allocations after setup(), enabled by ALLOCATION_GUARD
+#include "AllocationGuard.h"
+
 // MQTT client
 #include "MqttClient.h"
 #include "secrets.h"
@@ -19,71 +44,780 @@ MqttClient mqttClient(&client, MQTT_SERVER, MQTT_SERVERPORT, MQTT_USERNAME, MQTT
 #define UPDATE_TIMEOUT 2000
 #define DISPLAY_UPDATE_DELAY 10000
 
+#if defined(ESP32)
+#define I2C_SCL 22
+#define I2C_SDA 21
+#define OLED_RESET -1
+#else
 #define I2C_SCL D1
 #define I2C_SDA D2
 #define OLED_RESET LED_BUILTIN
+#endif
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 Adafruit_SSD1306 display(128, 64, &Wire, OLED_RESET);
 
+#include "DisplayFont.h"
+#include "NumberFormat.h"
+
+#ifdef RUN_BENCHMARKS
+#include "Benchmarks.h"
+#endif
+#ifdef RUN_TESTS
+#include "FleetSimulator.h"
+#include "SpscQueue.h"
+#include "TopicTrie.h"
+#endif
+
 // DHT22 sensor
 #include "SensorDHT.h"
 SensorDHT sensorDHT(DHT_IN); // setup temp sensor
 
 // DS18B20 sensor
 #include "SensorDS18B20.h"
+#include "SimulatedTemperatureBus.h"
 SensorDS18B20 sensorDS18B20;
 
+// relays
+#if defined(ESP32)
+#define RELAY_LIGHTS 26
+#else
+#define RELAY_LIGHTS D6
+#endif
+
+#include "Relays.h"
+RelayPorts relays(std::vector<int>{RELAY_LIGHTS});
+
+// local relay rules, e.g. "R0=T1<20.5~0.5@06:00-22:00" - see RuleEngine
+#define RULES_DEFAULT ""
+#define NTP_SERVER "pool.ntp.org"
+#define TIMEZONE_OFFSET 3600 // seconds
+#define DST_OFFSET 0         // seconds
+
+#include "RuleEngine.h"
+#include <time.h>
+RuleEngine rules;
+
+// sensors, rules, publish and wait steps of loop(), shared with the fleet simulator of the host build
+#include "NodeLoop.h"
+
+// compressed history of the DHT22 values for MQTT history requests, e.g. "temperature 86400 12"
+#define HISTORY_REPLY_BUCKETS 12 // max averages per reply, limited by the MQTT packet size
+
+#include "SampleHistory.h"
+StaticSampleHistory<HISTORY_BLOCKS> temperatureHistory;
+StaticSampleHistory<HISTORY_BLOCKS> humidityHistory;
+SecondsClock                        uptimeClock; // history times and uptime, continued across the millis() wrap
+
+// Prometheus metrics endpoint, e.g. "curl http://<node>:9100/metrics" - comment out to disable
+#define METRICS_PORT 9100
+#define METRICS_POLL_INTERVAL 100 // milliseconds between checks for requests while waiting for MQTT messages
+
+#include "MetricsServer.h"
+#ifdef METRICS_PORT
+/**
+ * MQTT client counter exported as metric
+ */
+struct MetricsCounter
+{
+    const char* name;
+    const char* help;
+    uint32_t MqttClient::Statistics::*value;
+};
+
+static const MetricsCounter mqttCounters[] = {
+    {"room_sensor_mqtt_published_total", "MQTT messages published", &MqttClient::Statistics::published},
+    {"room_sensor_mqtt_publish_failures_total", "MQTT messages failed to publish",
+     &MqttClient::Statistics::publishFailures},
+    {"room_sensor_mqtt_received_total", "MQTT messages received", &MqttClient::Statistics::received},
+    {"room_sensor_mqtt_dispatched_total", "MQTT messages of subscribed topics", &MqttClient::Statistics::dispatched},
+    {"room_sensor_mqtt_truncated_total", "MQTT messages dropped for their length", &MqttClient::Statistics::truncated},
+    {"room_sensor_mqtt_connects_total", "MQTT connects", &MqttClient::Statistics::connects},
+    {"room_sensor_mqtt_connect_failures_total", "MQTT connect attempts failed",
+     &MqttClient::Statistics::connectFailures},
+    {"room_sensor_mqtt_connection_losses_total", "MQTT connections lost", &MqttClient::Statistics::connectionLosses},
+};
+
+/**
+ * Value slots of the metrics page
+ */
+struct MetricsSlots
+{
+    int16_t temperature;
+    int16_t humidity;
+    int16_t probes[DS18B20_MAX_SENSORS]; // by slot of the DS18B20 registry
+    int16_t mqtt[sizeof(mqttCounters) / sizeof(mqttCounters[0])];
+    int16_t publishSeconds;
+    int16_t phaseP99[PROFILER_MAX_PHASES];
+    int16_t phaseMax[PROFILER_MAX_PHASES];
+    int16_t freeHeap;
+    int16_t fragmentation;
+    int16_t uptime;
+    int16_t requests;
+    uint8_t phases; // profiler phases in the layout
+};
+
+MetricsPage   metricsPage;
+MetricsServer metricsServer(metricsPage, METRICS_PORT);
+MetricsSlots  metricsSlots;
+bool          metricsLayoutChanged = true; // set by applyConfig(), the layout is rebuilt by the next sample
+#endif
+
+// device configuration in flash - the defines are the defaults without stored configuration
+#define CONFIG_ROOM "/arbeitszimmer"
+
+#include "DeviceConfig.h"
+// calibration curves as {count, {{raw, actual}, ...}} Celsius degrees, e.g. {2, {{10.0, 7.6}, {30.0, 27.0}}}
+constexpr CalibrationTable DHT_CALIBRATION     = {0, {}};
+constexpr CalibrationTable DS18B20_CALIBRATION = {0, {}};
+#include "FastBoot.h"
+FastBoot           fastBoot;
+FlashConfigStorage configStorage;
+DeviceConfig       config(configStorage);
+ConfigRecord       appliedConfig;         // configuration of current topics, sensors and relays
+bool               configChanged = false; // set by config topic, applied in loop() or by the network task
+
+#ifdef DUAL_CORE
+#include "SpscQueue.h"
+
+#define NETWORK_CORE 0              // protocol core running the WiFi stack
+#define NETWORK_STACK_SIZE 8192     // bytes
+#define NETWORK_POLL_INTERVAL 100   // milliseconds to wait for incoming messages per network task run
+
+/**
+ * Relay switch command or relay state change
+ */
+struct RelayCommand
+{
+    uint8_t port;
+    bool    on;
+};
+
+SpscQueue<SensorSample, 4> sensorSamples;   // loop() to network task
+SpscQueue<RelayCommand, 8> relayCommands;   // network task to loop()
+SpscQueue<RelayCommand, 8> relayStates;     // loop() to network task
+TaskHandle_t               networkTaskHandle = nullptr;
+SemaphoreHandle_t          stateMutex        = nullptr;
+
+/**
+ * Scoped lock of sensors, rules, relays, history and configuration, which are shared by loop() and the callbacks
+ * and config changes of the network task - never held while waiting for the network
+ */
+class StateLock
+{
+public:
+    StateLock() { xSemaphoreTake(stateMutex, portMAX_DELAY); }
+    ~StateLock() { xSemaphoreGive(stateMutex); }
+};
+
+#define STATE_LOCK() StateLock PROFILER_CONCAT(stateLock, __LINE__)
+#else
+#define STATE_LOCK()
+#endif
+
+/**
+ * loop() of the sketch: the steps of NodeLoop with configuration changes, display, history, metrics and the
+ * network task of dual-core boards
+ */
+class RoomSensorLoop : public NodeLoop
+{
+public:
+    RoomSensorLoop() :
+        NodeLoop(mqttClient, sensorDHT, sensorDS18B20, rules, relays)
+    {}
+
+protected:
+    virtual void applyChanges(void);
+    virtual bool readSensors(SensorSample& sample);
+    virtual void applyRules(void);
+    virtual void update(const SensorSample& sample);
+    virtual void show(const SensorSample& sample);
+    virtual void send(const SensorSample& sample);
+    virtual void wait(unsigned long milliseconds);
+    virtual void poll(void);
+    virtual void idle(unsigned long milliseconds);
+};
+
+RoomSensorLoop nodeLoop;
+
+/**
+ * Return configuration from compile time defaults
+ */
+ConfigRecord defaultConfig(void)
+{
+    ConfigRecord defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    strncpy(defaults.room, CONFIG_ROOM, sizeof(defaults.room) - 1);
+    strncpy(defaults.rules, RULES_DEFAULT, sizeof(defaults.rules) - 1);
+    defaults.updateTimeout      = UPDATE_TIMEOUT;
+    defaults.displayUpdateDelay = DISPLAY_UPDATE_DELAY;
+    defaults.dhtPin             = DHT_IN;
+    defaults.oneWirePin         = ONEWIRE_IN;
+    defaults.relayPin           = RELAY_LIGHTS;
+    defaults.dhtCalibration     = DHT_CALIBRATION;
+    defaults.ds18b20Calibration = DS18B20_CALIBRATION;
+    return defaults;
+}
+
 /**
  * Callback for switch relay topic
  */
-bool handleToggleSwitchMessage(std::string topicName, std::string message)
+bool handleToggleSwitchMessage(const char* topicName, const char* message, void*)
 {
-    Serial.printf("[main] handle switch message for '%s' with content '%s'\n", topicName.c_str(), message.c_str());
+    LOG_DEBUG(MAIN, "handle switch message for '%s' with content '%s'", topicName, message);
 
-    bool enabledState = (std::string(message) == "true");
-    // --- relays.togglePort(0, enabledState);
-    Serial.printf("[main] switch '%s' set to '%s'\n", topicName.c_str(), enabledState ? "ON" : "OFF");
+    bool enabledState = (strcmp(message, "true") == 0);
+#ifdef DUAL_CORE
+    // relays are switched by loop() on the other core
+    RelayCommand command = {0, enabledState};
+    relayCommands.push(command);
+#else
+    relays.togglePort(0, enabledState);
+#endif
+    LOG_INFO(MAIN, "switch '%s' set to '%s'", topicName, enabledState ? "ON" : "OFF");
     return true;
 }
 
 /**
- * Initial setup of serial debug console and connections
+ * Callback for rules command topic: replace local relay rules by message content
  */
-void setup()
+bool handleRulesMessage(const char*, const char* message, void*)
 {
-    Serial.begin(115200);
+    STATE_LOCK();
+    ConfigRecord changed = config.record();
+    if (strlen(message) >= sizeof(changed.rules) || !rules.compile(message)) {
+        LOG_ERROR(MAIN, "invalid rules '%s' ignored", message);
+        return false;
+    }
 
-    // run tests
-    TestTemperatureSensor testSensor;
-    testSensor.runTests();
+    // keep rules after reboot
+    strcpy(changed.rules, message);
+    if (config.save(changed)) {
+        strcpy(appliedConfig.rules, message);
+    }
+    return true;
+}
 
-    // MQTT
-    // Connect to WiFi access point.
-    Serial.println();
-    Serial.println();
-    Serial.printf("Connecting to WLAN '%s'...", WLAN_SSID);
+/**
+ * Callback for config command topic: store changed settings, e.g. "room=/kueche;display_delay=5000"
+ *
+ * The changes are applied by the next loop() run, as topics may be rebuilt.
+ */
+bool handleConfigMessage(const char*, const char* message, void*)
+{
+    STATE_LOCK();
+    if (!config.update(message)) {
+        LOG_ERROR(MAIN, "invalid config '%s' ignored", message);
+        return false;
+    }
+    configChanged = true;
+    return true;
+}
 
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(WLAN_SSID, WLAN_PASS);
+/**
+ * Callback for history command topic: publish averages of the last seconds in equal time buckets
+ *
+ * The request "<temperature|humidity> [seconds] [buckets]" is answered on the history status topic as
+ * "<series> <seconds> <buckets>:<average>,<average>,..." - buckets without samples are left empty.
+ */
+bool handleHistoryMessage(const char*, const char* message, void*)
+{
+    char          series[16];
+    unsigned long seconds = 3600;
+    unsigned int  buckets = HISTORY_REPLY_BUCKETS;
+    if (sscanf(message, "%15s %lu %u", series, &seconds, &buckets) < 1) {
+        series[0] = '\0';
+    }
 
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && ++retries < 3) {
-        delay(500);
-        Serial.print(".");
+    SampleHistory* history = nullptr;
+    if (strcmp(series, "temperature") == 0) {
+        history = &temperatureHistory;
+    } else if (strcmp(series, "humidity") == 0) {
+        history = &humidityHistory;
+    }
+    if (!history || buckets == 0 || buckets > HISTORY_REPLY_BUCKETS) {
+        LOG_ERROR(MAIN, "invalid history request '%s' ignored", message);
+        return false;
     }
-    Serial.println();
 
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("WiFi connected");
-        Serial.println("IP address: ");
-        Serial.println(WiFi.localIP());
-    } else {
-        Serial.println("WiFi not connected!");
+    float averages[HISTORY_REPLY_BUCKETS];
+    {
+        STATE_LOCK();
+        uint32_t now = uptimeClock.now();
+        history->query(seconds < now ? now - seconds : 0, now, averages, buckets);
     }
 
-    WiFi.printDiag(Serial);
+    char reply[128];
+    int  length = snprintf(reply, sizeof(reply), "%s %lu %u:", series, seconds, buckets);
+    for (unsigned int i = 0; i < buckets && length < (int)sizeof(reply) - 1; ++i) {
+        if (i > 0) {
+            reply[length++] = ',';
+            reply[length]   = '\0';
+        }
+        if (!std::isnan(averages[i])) {
+            int written = formatDecimal(reply + length, sizeof(reply) - length, averages[i], 1);
+            length += (written > 0) ? written : 0;
+        }
+    }
+    return mqttClient.publish("history", reply);
+}
+
+/**
+ * Create MQTT topics below given room path and register their callbacks
+ */
+void createTopics(const char* room)
+{
+    struct TopicDefinition
+    {
+        const char*                name;
+        const char*                path;
+        MqttClient::MqttTopicTypes type;
+        bool                       subscribe;
+    };
+    static const TopicDefinition topics[] = {
+        {"log", "log", MqttClient::STATUS, false},
+        {"temperature", "temperature", MqttClient::SENSOR, false},
+        {"temperature_heater", "temperature_heater", MqttClient::SENSOR, false},
+        {"humidity", "humidity", MqttClient::SENSOR, false},
+        {"boot", "boot", MqttClient::STATUS, false},
+        {"history", "history", MqttClient::STATUS, false},
+        {"lights", "lights", MqttClient::SWITCH, false},
+        {"switches", "+/set", MqttClient::SWITCH, true}, // one broker subscription for all switches and commands
+        {"commands", "+", MqttClient::COMMAND, true},
+        {"lights", "lights/set", MqttClient::SWITCH, true},
+        {"lights_available", "lights/available", MqttClient::SWITCH, true},
+        {"rules", "rules", MqttClient::COMMAND, true},
+        {"config", "config", MqttClient::COMMAND, true},
+        {"history", "history", MqttClient::COMMAND, true},
+    };
+    static bool created = false;
+
+    // all topics of the old room are removed first, so their subscriptions are free for the new ones
+    if (created) {
+        for (const TopicDefinition& topic : topics) {
+            if (topic.subscribe) {
+                mqttClient.removeSubscribeTopic(topic.name);
+            } else {
+                mqttClient.removePublishTopic(topic.name);
+            }
+        }
+    }
+
+    char path[MQTT_PATH_LENGTH];
+    for (const TopicDefinition& topic : topics) {
+        snprintf(path, sizeof(path), "%s/%s", room, topic.path);
+        if (topic.subscribe) {
+            mqttClient.createSubscribeTopic(topic.name, path, topic.type);
+        } else {
+            mqttClient.createPublishTopic(topic.name, path, topic.type);
+        }
+    }
+    created = true;
+
+    mqttClient.addNotifyCallback("lights", &handleToggleSwitchMessage);
+    mqttClient.addNotifyCallback("rules", &handleRulesMessage);
+    mqttClient.addNotifyCallback("config", &handleConfigMessage);
+    mqttClient.addNotifyCallback("history", &handleHistoryMessage);
+
+    // subscriptions are sent to the broker on the next connect
+    mqttClient.disconnect();
+}
+
+/**
+ * Rebuild topics, sensors and relays which differ from the current configuration
+ */
+void applyConfig(void)
+{
+    const ConfigRecord& current = config.record();
+
+    sensorDHT.setTemperatureOffset(current.dhtTemperatureOffset);
+    sensorDHT.setCalibration(current.dhtCalibration);
+    sensorDHT.setPin(current.dhtPin);
+
+    sensorDS18B20.setTemperatureOffset(current.ds18b20TemperatureOffset);
+    sensorDS18B20.setCalibration(current.ds18b20Calibration);
+    sensorDS18B20.clearCalibrations();
+    for (const ConfigSensorCurve& curve : current.ds18b20Curves) {
+        if (curve.sensor[0] != '\0' && !sensorDS18B20.setCalibration(curve.sensor, curve.table)) {
+            LOG_WARN(MAIN, "invalid stored curve of sensor '%s' ignored", curve.sensor);
+        }
+    }
+    if (current.oneWirePin != appliedConfig.oneWirePin) {
+        sensorDS18B20.setPin(current.oneWirePin);
+        sensorDS18B20.sensorsAvailable();
+    }
+    if (current.heaterSensor[0] != '\0' && !sensorDS18B20.setCurrentSensor(current.heaterSensor)) {
+        LOG_WARN(MAIN, "heater sensor '%s' not found", current.heaterSensor);
+    }
+
+    if (current.relayPin != appliedConfig.relayPin) {
+        relays.setOutputPorts(std::vector<int>{current.relayPin});
+    }
+    if (strcmp(current.room, appliedConfig.room) != 0) {
+        createTopics(current.room);
+    }
+    if (strcmp(current.rules, appliedConfig.rules) != 0 && !rules.compile(current.rules)) {
+        LOG_ERROR(MAIN, "invalid stored rules '%s' ignored", current.rules);
+    }
+
+#ifdef METRICS_PORT
+    metricsLayoutChanged = true;
+#endif
+    appliedConfig = current;
+}
+
+/**
+ * Apply configuration changed by the config topic
+ */
+void applyConfigIfChanged(void)
+{
+    if (!configChanged) {
+        return;
+    }
+
+    // rebuilding topics and relays is no steady state
+    STATE_LOCK();
+    bool guarded  = AllocationGuard::armed();
+    configChanged = false;
+    AllocationGuard::disarm();
+    applyConfig();
+    if (guarded) {
+        AllocationGuard::arm();
+    }
+}
+
+/**
+ * Publish sensor values of one loop() run, the first one with the boot time
+ */
+void publishSample(const SensorSample& sample)
+{
+    if (nodeLoop.publish(sample) && fastBoot.firstPublished()) {
+        LOG_INFO(BOOT, "time to first publish: %lu ms", fastBoot.timeToFirstPublish());
+        mqttClient.publish("boot", (float)fastBoot.timeToFirstPublish(), 0);
+    }
+}
+
+/**
+ * Publish switch state of given relay
+ */
+void publishRelayState(int port, bool state)
+{
+    if (port == 0) {
+        mqttClient.publish("lights", state ? "true" : "false");
+    }
+}
+
+#ifdef METRICS_PORT
+/**
+ * Write the layout of the metrics page for the registered DS18B20 sensors and the current profiler phases
+ */
+void buildMetrics(uint8_t phases)
+{
+    MetricsSlots& slots = metricsSlots;
+    metricsPage.clear();
+
+    metricsPage.addFamily("room_sensor_temperature_celsius", "gauge", "Temperature of the DHT22");
+    slots.temperature = metricsPage.addMetric("room_sensor_temperature_celsius", "sensor", "dht22");
+    metricsPage.addFamily("room_sensor_humidity_percent", "gauge", "Relative humidity of the DHT22");
+    slots.humidity = metricsPage.addMetric("room_sensor_humidity_percent", "sensor", "dht22");
+
+    metricsPage.addFamily("room_sensor_ds18b20_temperature_celsius", "gauge", "Last temperature read of each DS18B20");
+    for (size_t i = 0; i < DS18B20_MAX_SENSORS; ++i) {
+        const SensorDS18B20::SensorData* probe = sensorDS18B20.registeredSensor(i);
+        slots.probes[i] = probe ? metricsPage.addMetric("room_sensor_ds18b20_temperature_celsius", "probe", probe->name)
+                                : METRICS_NONE;
+    }
+
+    for (size_t i = 0; i < sizeof(mqttCounters) / sizeof(mqttCounters[0]); ++i) {
+        metricsPage.addFamily(mqttCounters[i].name, "counter", mqttCounters[i].help);
+        slots.mqtt[i] = metricsPage.addMetric(mqttCounters[i].name);
+    }
+    metricsPage.addFamily("room_sensor_mqtt_publish_seconds_total", "counter", "Time spent publishing MQTT messages");
+    slots.publishSeconds = metricsPage.addMetric("room_sensor_mqtt_publish_seconds_total");
+
+    // the profiler restarts its statistics with each report
+    metricsPage.addFamily("room_sensor_loop_phase_p99_seconds", "gauge", "p99 bound of loop phases since report");
+    for (uint8_t i = 0; i < phases; ++i) {
+        slots.phaseP99[i] = metricsPage.addMetric("room_sensor_loop_phase_p99_seconds", "phase",
+                                                  profiler.phaseStats(i)->name);
+    }
+    metricsPage.addFamily("room_sensor_loop_phase_max_seconds", "gauge", "Longest loop phases since report");
+    for (uint8_t i = 0; i < phases; ++i) {
+        slots.phaseMax[i] = metricsPage.addMetric("room_sensor_loop_phase_max_seconds", "phase",
+                                                  profiler.phaseStats(i)->name);
+    }
+
+    metricsPage.addFamily("room_sensor_free_heap_bytes", "gauge", "Free heap");
+    slots.freeHeap = metricsPage.addMetric("room_sensor_free_heap_bytes");
+    metricsPage.addFamily("room_sensor_heap_fragmentation_percent", "gauge", "Heap fragmentation");
+    slots.fragmentation = metricsPage.addMetric("room_sensor_heap_fragmentation_percent");
+    metricsPage.addFamily("room_sensor_uptime_seconds", "gauge", "Time since boot");
+    slots.uptime = metricsPage.addMetric("room_sensor_uptime_seconds");
+    metricsPage.addFamily("room_sensor_metrics_requests_total", "counter", "Metrics requests served");
+    slots.requests = metricsPage.addMetric("room_sensor_metrics_requests_total");
+    slots.phases   = phases;
+
+    if (metricsPage.overflowed()) {
+        LOG_ERROR(MAIN, "metrics page full - raise METRICS_PAGE_SIZE or METRICS_MAX_VALUES");
+    }
+}
+
+/**
+ * Update the metrics page by the values of one loop() run - rebuilds the layout after configuration changes
+ *
+ * In dual-core mode the MQTT counters are read without lock while the network task updates them, so single values
+ * may lag one update behind.
+ */
+void updateMetrics(float temperature, float humidity)
+{
+    uint8_t phases = 0;
+    while (profiler.phaseStats(phases)) {
+        ++phases;
+    }
+    if (metricsLayoutChanged || phases != metricsSlots.phases) {
+        metricsLayoutChanged = false;
+        buildMetrics(phases);
+    }
+
+    const MetricsSlots& slots = metricsSlots;
+    metricsPage.set(slots.temperature, temperature);
+    metricsPage.set(slots.humidity, humidity);
+    for (size_t i = 0; i < DS18B20_MAX_SENSORS; ++i) {
+        const SensorDS18B20::SensorData* probe = sensorDS18B20.registeredSensor(i);
+        metricsPage.set(slots.probes[i], probe ? probe->lastTemperature : NAN);
+    }
+
+    const MqttClient::Statistics& stats = mqttClient.statistics();
+    for (size_t i = 0; i < sizeof(mqttCounters) / sizeof(mqttCounters[0]); ++i) {
+        metricsPage.set(slots.mqtt[i], stats.*mqttCounters[i].value);
+    }
+    metricsPage.set(slots.publishSeconds, stats.publishMicrosSum / 1e6f, 3);
+
+    for (uint8_t i = 0; i < phases; ++i) {
+        metricsPage.set(slots.phaseP99[i], profiler.percentile(i, 99) / 1e6f, 6);
+        metricsPage.set(slots.phaseMax[i], profiler.phaseStats(i)->max / 1e6f, 6);
+    }
+
+    const Profiler::HeapStats& heap = profiler.heapStats();
+    metricsPage.set(slots.freeHeap, heap.freeHeap);
+    metricsPage.set(slots.fragmentation, (uint32_t)heap.fragmentation);
+    metricsPage.set(slots.uptime, uptimeClock.now());
+    metricsPage.set(slots.requests, metricsServer.statistics().requests);
+}
+
+/**
+ * Answer pending metrics requests
+ */
+void serveMetrics(void)
+{
+    // the TCP connections of the WiFi core are allocated per request
+    bool guarded = AllocationGuard::armed();
+    AllocationGuard::disarm();
+    metricsServer.handle();
+    if (guarded) {
+        AllocationGuard::arm();
+    }
+}
+#endif
+
+#ifdef DUAL_CORE
+/**
+ * Switch relays as commanded by the network task
+ */
+void applyRelayCommands(void)
+{
+    RelayCommand command;
+    while (relayCommands.pop(command)) {
+        STATE_LOCK();
+        relays.togglePort(command.port, command.on);
+    }
+}
+
+/**
+ * MQTT connection, publishing and incoming messages on the protocol core
+ *
+ * The task drains the log as well, so the error sink publishes from this task only.
+ */
+void networkTask(void* parameter)
+{
+    logger.setConsumerTask(xTaskGetCurrentTaskHandle());
+
+    for (;;) {
+        applyConfigIfChanged();
+
+        SensorSample sample;
+        while (sensorSamples.pop(sample)) {
+            publishSample(sample);
+        }
+        RelayCommand state;
+        while (relayStates.pop(state)) {
+            publishRelayState(state.port, state.on);
+        }
+
+        // connect() returns at once during reconnect backoff
+        if (mqttClient.connect()) {
+            mqttClient.waitForMessages(NETWORK_POLL_INTERVAL);
+            logger.drain();
+        } else {
+            logger.idle(NETWORK_POLL_INTERVAL);
+        }
+    }
+}
+#endif
+
+/**
+ * Replacement of logger.idle() in loop(): in dual-core mode relay commands are applied while waiting, metrics
+ * requests are answered as well
+ */
+void idleLoop(unsigned long milliseconds)
+{
+#if defined(DUAL_CORE) || defined(METRICS_PORT)
+    unsigned long start = millis();
+    do {
+#ifdef DUAL_CORE
+        applyRelayCommands();
+#endif
+#ifdef METRICS_PORT
+        serveMetrics();
+#endif
+        logger.idle(10);
+    } while (millis() - start < milliseconds);
+#else
+    logger.idle(milliseconds);
+#endif
+}
+
+/**
+ * Initial setup of serial debug console and connections
+ */
+void setup()
+{
+    Serial.begin(115200);
+#ifdef DUAL_CORE
+    stateMutex = xSemaphoreCreateMutex();
+#endif
+
+    // configuration from flash or compile time defaults
+    config.load(defaultConfig());
+    LOG_INFO(CONFIG, "%s config #%u loaded in %u us", config.isStored() ? "stored" : "default",
+             (unsigned int)config.record().sequence, (unsigned int)config.loadMicros());
+
+    // WiFi association runs in background while tests, display and sensors are initialized
+    fastBoot.load();
+    fastBoot.beginWiFi(WLAN_SSID, WLAN_PASS);
+    configTime(TIMEZONE_OFFSET, DST_OFFSET, NTP_SERVER);
+
+#ifdef RUN_TESTS
+    // each test object in its own scope, so they take turns on the loop task stack instead of adding up
+    {
+        TestLogger test;
+        test.runTests();
+    }
+    {
+        TestProfiler test;
+        test.runTests();
+    }
+    {
+        TestTemperatureSensor test;
+        test.runTests();
+    }
+    {
+        TestNumberFormat test;
+        test.runTests();
+    }
+    {
+        TestRuleEngine test;
+        test.runTests();
+    }
+    {
+        // the relay outputs are only initialized off on the device, so all test relays share the relay pin
+        TestRelayPorts test(std::vector<int>{RELAY_LIGHTS, RELAY_LIGHTS, RELAY_LIGHTS});
+        test.runTests();
+    }
+    {
+        TestSimulatedTemperatureBus test;
+        test.runTests();
+    }
+    {
+        TestDeviceConfig test;
+        test.runTests();
+    }
+    {
+        TestFastBoot test;
+        test.runTests();
+    }
+    {
+        TestFleetSimulator test;
+        test.runTests();
+    }
+    {
+        TestSampleHistory test;
+        test.runTests();
+    }
+    {
+        TestSpscQueue test;
+        test.runTests();
+    }
+    {
+        TestDhtReceiver test;
+        test.runTests();
+    }
+    {
+        TestTopicTrie test;
+        test.runTests();
+    }
+    {
+        TestCalibration test;
+        test.runTests();
+    }
+    {
+        TestMetricsServer test;
+        test.runTests();
+    }
+#endif
+#ifdef RUN_BENCHMARKS
+    {
+        TestNumberFormat test;
+        test.runBenchmark();
+    }
+    {
+        TestSimulatedTemperatureBus test;
+        test.runBenchmark();
+    }
+    {
+        TestDeviceConfig test;
+        test.runBenchmark();
+    }
+    {
+        TestFleetSimulator test;
+        test.runBenchmark();
+    }
+    {
+        TestSampleHistory test;
+        test.runBenchmark();
+    }
+    {
+        TestSpscQueue test;
+        test.runBenchmark();
+    }
+    {
+        TestDhtReceiver test;
+        test.runBenchmark();
+    }
+    {
+        TestTopicTrie test;
+        test.runBenchmark();
+    }
+    {
+        TestCalibration test;
+        test.runBenchmark();
+    }
+    {
+        TestMetricsServer test;
+        test.runBenchmark();
+    }
+#endif
 
     // by default, we'll generate the high voltage from the 3.3v line internally! (neat!)
     display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
@@ -92,88 +826,203 @@ void setup()
     // Clear the buffer.
     display.clearDisplay();
 
-    delay(1000);
+#ifdef RUN_TESTS
+    {
+        TestDisplayFont test(display);
+        test.runTests();
+#ifdef RUN_BENCHMARKS
+        test.runBenchmark();
+#endif
+    }
+#endif
 
-    mqttClient.createPublishTopic("temperature", "/arbeitszimmer/temperature", MqttClient::SENSOR);
-    mqttClient.createPublishTopic("temperature_heater", "/arbeitszimmer/temperature_heater", MqttClient::SENSOR);
-    mqttClient.createPublishTopic("humidity", "/arbeitszimmer/humidity", MqttClient::SENSOR);
-    mqttClient.createPublishTopic("lights", "/arbeitszimmer/lights", MqttClient::SWITCH);
-    mqttClient.createSubscribeTopic("lights", "/arbeitszimmer/lights/set", MqttClient::SWITCH);
-    mqttClient.createSubscribeTopic("lights_available", "/arbeitszimmer/lights/available", MqttClient::SWITCH);
+    // DS18B20 devices of the last boot are restored without bus search
+    sensorDS18B20.setPin(config.record().oneWirePin);
+    fastBoot.initSensors(sensorDS18B20);
 
-    mqttClient.addNotifyCallback("lights", &handleToggleSwitchMessage);
+    rules.registerSensor(0, &sensorDHT);
+    rules.registerSensor(1, &sensorDS18B20);
+
+    // the first call creates all topics and compiles the rules
+    appliedConfig            = defaultConfig();
+    appliedConfig.room[0]    = '\0';
+    appliedConfig.rules[0]   = '\0';
+    appliedConfig.oneWirePin = config.record().oneWirePin;
+    applyConfig();
+
+#ifdef RUN_TESTS
+    {
+        TestMqttClient test(mqttClient);
+        test.runTests();
+    }
+    {
+        TestAllocationGuard test(mqttClient);
+        test.runTests();
+    }
+#endif
+
+    // publish switch state only on real relay state changes
+    relays.addStateCallback([](int port, bool state) {
+#ifdef DUAL_CORE
+        // MQTT belongs to the network task, which also switches relays on config changes
+        if (xTaskGetCurrentTaskHandle() != networkTaskHandle) {
+            RelayCommand change = {(uint8_t)port, state};
+            relayStates.push(change);
+            return;
+        }
+#endif
+        publishRelayState(port, state);
+    });
+
+    // forward error log lines to MQTT
+    logger.setErrorSink([](const char* line) { mqttClient.publish("log", line); });
 
     // first read often gets invalid values
     sensorDHT.temperature();
     sensorDHT.humidity();
 
-    sensorDS18B20.sensorsAvailable();
+    if (!fastBoot.waitForWiFi(WLAN_SSID, WLAN_PASS)) {
+        LOG_ERROR(MAIN, "WiFi not connected!");
+    }
+#ifdef METRICS_PORT
+    metricsServer.begin();
+    nodeLoop.setPollInterval(METRICS_POLL_INTERVAL); // shorter waits, so metrics requests are answered in time
+#endif
+#if LOG_LEVEL_MAIN >= LOG_LEVEL_DEBUG
+    logger.flush(); // keep order of log lines and blocking diagnostic output
+    WiFi.printDiag(Serial);
+#endif
+
+#ifdef RUN_BENCHMARKS
+    mqttClient.connect();
+    {
+        BenchmarkSuite benchmarks(mqttClient, sensorDS18B20, display);
+        benchmarks.runAll();
+    }
+    {
+        TestMqttClient test(mqttClient);
+        test.runLoadTest();
+    }
+#endif
+
+    logger.flush();
+
+#ifdef DUAL_CORE
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_STACK_SIZE, nullptr, 1, &networkTaskHandle, NETWORK_CORE);
+#endif
 }
 
 /**
- * Read sensor, output data on OLED and via MQTT
+ * Apply configuration changed by the config topic - the network task does it in dual-core mode
  */
-void loop()
+void RoomSensorLoop::applyChanges(void)
 {
-    float temperature = sensorDHT.temperature();
-    float humidity    = sensorDHT.humidity();
+#ifndef DUAL_CORE
+    applyConfigIfChanged();
+#endif
+}
 
-    float temperatureHeater = sensorDS18B20.temperature();
+bool RoomSensorLoop::readSensors(SensorSample& sample)
+{
+    STATE_LOCK();
+    return NodeLoop::readSensors(sample);
+}
 
+void RoomSensorLoop::applyRules(void)
+{
+    STATE_LOCK();
+    NodeLoop::applyRules();
+}
+
+/**
+ * Metrics of each run, the display is cleared also for invalid values
+ */
+void RoomSensorLoop::update(const SensorSample& sample)
+{
+#ifdef METRICS_PORT
+    {
+        STATE_LOCK();
+        updateMetrics(sample.temperature, sample.humidity);
+    }
+#endif
     display.clearDisplay();
-    display.setCursor(8, 0);
-    display.setTextColor(WHITE); // 'inverted' text
+}
 
-    if (!sensorDHT.isTemperatureValid() || !sensorDHT.isHumidityValid()) {
-        delay(UPDATE_TIMEOUT);
-        return;
+/**
+ * Add valid values to the history and output them on OLED
+ */
+void RoomSensorLoop::show(const SensorSample& sample)
+{
+    {
+        PROFILE_PHASE("history");
+        STATE_LOCK();
+        uint32_t now = uptimeClock.now();
+        temperatureHistory.add(now, sample.temperature);
+        humidityHistory.add(now, sample.humidity);
     }
 
-    display.setTextSize(4);
-    char temperatureStr[5];
-    sprintf(temperatureStr, "%02.1f", temperature);
-    display.print(temperatureStr);
-    display.println((char)247);
-    display.setCursor(32, 48);
-    display.setTextSize(2);
+    {
+        // pre-scaled glyphs instead of GFX setTextSize(), see DisplayFont
+        PROFILE_PHASE("render");
+        char text[NUMBER_FORMAT_BUFFER_SIZE];
+        formatDecimal(text, sizeof(text), sample.temperature, 1);
+        int16_t x = DisplayFont::drawText(display, 8, 0, text, 4);
+        DisplayFont::drawChar(display, x, 0, DISPLAY_FONT_DEGREE, 4);
 
-    char humidityStr[5];
-    sprintf(humidityStr, "%02.1f", humidity);
-    display.print(humidityStr);
-    display.println("%");
+        formatDecimal(text, sizeof(text), sample.humidity, 1);
+        x = DisplayFont::drawText(display, 32, 48, text, 2);
+        DisplayFont::drawChar(display, x, 48, '%', 2);
+    }
 
-    display.display();
+    {
+        PROFILE_PHASE("flush");
+        display.display();
+    }
+}
 
-    // publish temp+humidity via MQTT
-    char temperatureHeaterStr[5];
-    sprintf(temperatureHeaterStr, "%02.1f", temperatureHeater);
-    mqttClient.publish("temperature_heater", temperatureHeaterStr);
+/**
+ * Publish values via MQTT - in dual-core mode the network task publishes
+ */
+void RoomSensorLoop::send(const SensorSample& sample)
+{
+#ifdef DUAL_CORE
+    sensorSamples.push(sample);
+#else
+    publishSample(sample);
+#endif
+}
 
-    Serial.print(F("\nSending temp val "));
-    Serial.print(temperatureStr);
-    Serial.print("...");
-    if (!mqttClient.publish("temperature", temperatureStr)) {
-        Serial.println(F("Failed"));
-    } else {
-        Serial.println(F("OK!"));
-    }
+/**
+ * Wait for MQTT messages - in dual-core mode the network task receives them, loop() idles
+ */
+void RoomSensorLoop::wait(unsigned long milliseconds)
+{
+#ifdef DUAL_CORE
+    idleLoop(milliseconds);
+#else
+    NodeLoop::wait(milliseconds);
+#endif
+}
 
-    Serial.print(F("\nSending humidity val "));
-    Serial.print(humidityStr);
-    Serial.print("...");
-    if (!mqttClient.publish("humidity", humidityStr)) {
-        Serial.println(F("Failed"));
-    } else {
-        Serial.println(F("OK!"));
-    }
+/**
+ * Answer metrics requests between the waits for MQTT messages
+ */
+void RoomSensorLoop::poll(void)
+{
+#ifdef METRICS_PORT
+    serveMetrics();
+#endif
+}
 
-    if (mqttClient.connected()) {
-        if (!mqttClient.waitForMessages(DISPLAY_UPDATE_DELAY)) {
-            Serial.println("[mqtt] wait for messages aborted");
-        } else {
-            Serial.println("[mqtt] wait for messages successful");
-        }
-    } else {
-        delay(DISPLAY_UPDATE_DELAY);
-    }
+void RoomSensorLoop::idle(unsigned long milliseconds)
+{
+    idleLoop(milliseconds);
+}
+
+/**
+ * Read sensor, output data on OLED and via MQTT - in dual-core mode the network task publishes
+ */
+void loop()
+{
+    nodeLoop.run(config.record().updateTimeout, config.record().displayUpdateDelay);
 }